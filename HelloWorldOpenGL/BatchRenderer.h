@@ -0,0 +1,165 @@
+#ifndef BATCH_RENDERER_H
+#define BATCH_RENDERER_H
+
+#include <glad/glad.h>
+
+#include "GLState.h"
+#include "StreamBuffer.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+/*******************************************************************************************************************************
+Instanced quad batches
+*******************************************************************************************************************************/
+/* One glDrawElements per rectangle stops scaling long before a million rectangles: the driver overhead per call is the
+   bottleneck, not the GPU. Instead we keep the rectangle mesh (the VAO/VBO/EBO from HelloWindow.cpp) as it is and add a
+   second buffer with one QuadInstance per rectangle. glVertexAttribDivisor(location, 1) makes GL advance those
+   attributes once per *instance* instead of once per vertex, and glDrawElementsInstanced draws them all in one call.
+   The instance data changes every frame, so it is written into a StreamBuffer (see StreamBuffer.h) and the attribute
+   pointers are moved to wherever this frame's copy landed.
+
+   Instance attributes (see instancedVertexShaderSource):
+       location 1: vec4 transform  (xy = offset in NDC, zw = scale)
+       location 2: vec4 color      (RGBA8, normalized to 0..1) */
+struct QuadInstance
+{
+    float x, y;
+    float scaleX, scaleY;
+    uint8_t color[4];
+};
+
+const char* const instancedVertexShaderSource =
+"#version 330 core\n"
+"layout (location = 0) in vec3 aPos;\n"
+"layout (location = 1) in vec4 aTransform;\n"
+"layout (location = 2) in vec4 aColor;\n"
+"out vec4 vertexColor;\n"
+"void main()\n"
+"{\n"
+"   gl_Position = vec4(aPos.xy * aTransform.zw + aTransform.xy, aPos.z, 1.0);\n"
+"   vertexColor = aColor;\n"
+"}\0";
+
+const char* const instancedFragmentShaderSource =
+"#version 330 core\n"
+"in vec4 vertexColor;\n"
+"out vec4 FragColor;\n"
+"void main()\n"
+"{\n"
+"   FragColor = vertexColor;\n"
+"}\n\0";
+
+class BatchRenderer
+{
+public:
+    /* vao must already have the mesh's vertex attributes and EBO set up. Larger batches than maxInstancesPerDraw are
+       split into several draws; they all share one stream buffer region per frame, which starts out holding
+       maxInstancesPerDraw instances and grows when a frame needs more. */
+    BatchRenderer(unsigned int vao, GLsizei indexCount, GLenum indexType, size_t maxInstancesPerDraw = 1 << 20)
+        : vao(vao), indexCount(indexCount), indexType(indexType), capacity(maxInstancesPerDraw),
+          stream(new StreamBuffer(GL_ARRAY_BUFFER, maxInstancesPerDraw * sizeof(QuadInstance)))
+    {
+        glState.bindVertexArray(vao);
+        glEnableVertexAttribArray(1);
+        glVertexAttribDivisor(1, 1); // Advance once per instance
+        glEnableVertexAttribArray(2);
+        glVertexAttribDivisor(2, 1);
+        glState.bindVertexArray(0);
+    }
+
+    BatchRenderer(const BatchRenderer&) = delete;
+    BatchRenderer& operator=(const BatchRenderer&) = delete;
+
+    void clear() { instances.clear(); }
+    void add(const QuadInstance& instance) { instances.push_back(instance); }
+    std::vector<QuadInstance>& data() { return instances; }
+    size_t size() const { return instances.size(); }
+
+    /* Uploads the instances into this frame's region and draws them with as few glDrawElementsInstanced calls as
+       maxInstancesPerDraw allows. Call once per frame: every call takes the next region of the ring. */
+    void draw(unsigned int program)
+    {
+        const size_t bytes = instances.size() * sizeof(QuadInstance);
+        if (bytes == 0)
+            return;
+        if (bytes > stream->capacity())
+        {
+            /* The old buffer goes now; GL keeps its storage until the draws still reading it are done */
+            const size_t grown = std::max(stream->capacity() * 2, bytes);
+            stream.reset();
+            stream.reset(new StreamBuffer(GL_ARRAY_BUFFER, grown));
+        }
+
+        /* Without persistent mapping the region has to be unmapped before drawing, so copy everything first */
+        stream->beginFrame();
+        StreamBuffer::Allocation upload = stream->allocate(bytes, 4);
+        if (upload.data)
+            std::memcpy(upload.data, instances.data(), bytes);
+        stream->commit();
+        if (!upload.data)
+        {
+            stream->endFrame();
+            return; // The region couldn't be mapped; skip the frame rather than draw stale instances
+        }
+
+        glState.useProgram(program);
+        glState.bindVertexArray(vao);
+        glState.bindBuffer(GL_ARRAY_BUFFER, stream->buffer());
+        for (size_t first = 0; first < instances.size(); first += capacity)
+        {
+            const size_t count = std::min(capacity, instances.size() - first);
+            const size_t offset = upload.offset + first * sizeof(QuadInstance);
+
+            /* Point the instance attributes at this chunk of the frame's region */
+            glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(QuadInstance),
+                (void*)(offset + offsetof(QuadInstance, x)));
+            glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(QuadInstance),
+                (void*)(offset + offsetof(QuadInstance, color)));
+            glState.drawElementsInstanced(GL_TRIANGLES, indexCount, indexType, 0, (GLsizei)count);
+        }
+        stream->endFrame();
+    }
+
+    const StreamBuffer& streamBuffer() const { return *stream; }
+
+private:
+    unsigned int vao;
+    GLsizei indexCount;
+    GLenum indexType;
+    size_t capacity;
+    std::unique_ptr<StreamBuffer> stream;
+    std::vector<QuadInstance> instances;
+};
+
+/* Fills the batch with count small rectangles on a grid covering the screen */
+inline void fillQuadGrid(BatchRenderer& batch, size_t count, uint32_t seed = 1)
+{
+    batch.clear();
+    batch.data().reserve(count);
+
+    size_t side = 1;
+    while (side * side < count)
+        side++;
+    const float cell = 2.0f / (float)side;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        seed = seed * 1664525u + 1013904223u; // LCG; all we need is something that isn't a flat color
+        QuadInstance quad;
+        quad.x = -1.0f + cell * ((float)(i % side) + 0.5f);
+        quad.y = -1.0f + cell * ((float)(i / side) + 0.5f);
+        quad.scaleX = quad.scaleY = cell * 0.8f;
+        quad.color[0] = (uint8_t)(seed >> 24);
+        quad.color[1] = (uint8_t)(seed >> 16);
+        quad.color[2] = (uint8_t)(seed >> 8);
+        quad.color[3] = 255;
+        batch.add(quad);
+    }
+}
+
+#endif
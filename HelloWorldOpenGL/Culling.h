@@ -0,0 +1,482 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include "Mat4.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/*******************************************************************************************************************************
+Frustum culling
+*******************************************************************************************************************************/
+/* Without culling everything we know about gets drawn, visible or not. With 100k+ objects that means the CPU spends
+   most of the frame recording draws the GPU then clips away. Here:
+
+       Aabb, Frustum      Boxes, and the six planes of a camera's view volume taken from its view-projection matrix
+       cullBruteForce     The obvious loop: test every box, one at a time. Kept as the reference and the baseline.
+       SceneBvh           A 4-wide bounding volume hierarchy. Each node holds the boxes of its (up to) four children
+                          side by side so one SSE test checks all four; leaves hold up to eight objects, tested with
+                          one AVX instruction per plane (two SSE ones without AVX). A whole subtree outside the
+                          frustum is skipped with one test, and one completely inside is accepted without testing the
+                          objects in it. Objects that move are updated in place and refit() only touches the nodes
+                          above them; the tree's shape stays the same until the next build(). */
+struct Aabb
+{
+    float min[3];
+    float max[3];
+};
+
+struct Frustum
+{
+    /* a, b, c, d per plane: (x, y, z) is inside when a*x + b*y + c*z + d >= 0 for all six */
+    float planes[6][4];
+
+    /* The planes of the clip volume -w <= x, y, z <= w, pulled back into world space (Gribb & Hartmann) */
+    static Frustum fromMatrix(const Mat4& viewProjection)
+    {
+        Frustum f;
+        for (int axis = 0; axis < 3; axis++)
+            for (int c = 0; c < 4; c++)
+            {
+                f.planes[axis * 2][c] = viewProjection.at(3, c) + viewProjection.at(axis, c);
+                f.planes[axis * 2 + 1][c] = viewProjection.at(3, c) - viewProjection.at(axis, c);
+            }
+        return f;
+    }
+
+    /* A box is outside if even its corner furthest along a plane's normal is behind that plane. Conservative: a box
+       near a frustum corner can pass without touching the frustum, which only costs a wasted draw. */
+    bool intersects(const Aabb& box) const
+    {
+        for (const float* p : planes)
+        {
+            float d = p[3];
+            for (int axis = 0; axis < 3; axis++)
+                d += std::max(p[axis] * box.min[axis], p[axis] * box.max[axis]);
+            if (d < 0.0f)
+                return false;
+        }
+        return true;
+    }
+};
+
+/* Scalar baseline: replaces visible with the indices of the boxes that intersect the frustum */
+inline void cullBruteForce(const std::vector<Aabb>& boxes, const Frustum& frustum, std::vector<uint32_t>& visible)
+{
+    visible.clear();
+    for (size_t i = 0; i < boxes.size(); i++)
+        if (frustum.intersects(boxes[i]))
+            visible.push_back((uint32_t)i);
+}
+
+/* The frustum planes with every coefficient repeated across 8 lanes, so the vector tests can load them directly */
+struct FrustumLanes
+{
+    alignas(32) float v[6][4][8];
+
+    explicit FrustumLanes(const Frustum& frustum)
+    {
+        for (int p = 0; p < 6; p++)
+            for (int c = 0; c < 4; c++)
+                for (int lane = 0; lane < 8; lane++)
+                    v[p][c][lane] = frustum.planes[p][c];
+    }
+};
+
+/* Tests 4 boxes stored as separate min/max arrays. Sets bit i of outside if box i is completely outside the frustum,
+   bit i of inside if it is completely inside. Same arithmetic (and so the same answers) as Frustum::intersects. */
+inline void frustumTest4(const FrustumLanes& f, const float* const bounds[6], unsigned int& outside, unsigned int& inside)
+{
+#ifdef HELLO_SSE2
+    const __m128 zero = _mm_setzero_ps();
+    __m128 lo[3], hi[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        lo[axis] = _mm_loadu_ps(bounds[axis]);
+        hi[axis] = _mm_loadu_ps(bounds[axis + 3]);
+    }
+
+    __m128 out = zero;
+    __m128 in = _mm_cmpeq_ps(zero, zero);
+    for (int p = 0; p < 6; p++)
+    {
+        __m128 far = _mm_load_ps(f.v[p][3]);
+        __m128 near = far;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            const __m128 n = _mm_load_ps(f.v[p][axis]);
+            const __m128 a = _mm_mul_ps(n, lo[axis]), b = _mm_mul_ps(n, hi[axis]);
+            far = _mm_add_ps(far, _mm_max_ps(a, b));
+            near = _mm_add_ps(near, _mm_min_ps(a, b));
+        }
+        out = _mm_or_ps(out, _mm_cmplt_ps(far, zero));
+        in = _mm_and_ps(in, _mm_cmpge_ps(near, zero));
+    }
+    outside = (unsigned int)_mm_movemask_ps(out);
+    inside = (unsigned int)_mm_movemask_ps(in);
+#else
+    outside = inside = 0;
+    for (int lane = 0; lane < 4; lane++)
+    {
+        bool out = false, in = true;
+        for (int p = 0; p < 6; p++)
+        {
+            float far = f.v[p][3][0], near = far;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                const float a = f.v[p][axis][0] * bounds[axis][lane], b = f.v[p][axis][0] * bounds[axis + 3][lane];
+                far += std::max(a, b);
+                near += std::min(a, b);
+            }
+            out = out || far < 0.0f;
+            in = in && near >= 0.0f;
+        }
+        outside |= out ? 1u << lane : 0u;
+        inside |= in ? 1u << lane : 0u;
+    }
+#endif
+}
+
+/* Same for 8 boxes; only the outside mask, which is all the leaves need */
+inline unsigned int frustumOutside8(const FrustumLanes& f, const float* const bounds[6])
+{
+#ifdef HELLO_AVX
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 lo[3], hi[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        lo[axis] = _mm256_loadu_ps(bounds[axis]);
+        hi[axis] = _mm256_loadu_ps(bounds[axis + 3]);
+    }
+
+    __m256 out = zero;
+    for (int p = 0; p < 6; p++)
+    {
+        __m256 far = _mm256_load_ps(f.v[p][3]);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            const __m256 n = _mm256_load_ps(f.v[p][axis]);
+            far = _mm256_add_ps(far, _mm256_max_ps(_mm256_mul_ps(n, lo[axis]), _mm256_mul_ps(n, hi[axis])));
+        }
+        out = _mm256_or_ps(out, _mm256_cmp_ps(far, zero, _CMP_LT_OQ));
+    }
+    return (unsigned int)_mm256_movemask_ps(out);
+#else
+    const float* const upper[6] = { bounds[0] + 4, bounds[1] + 4, bounds[2] + 4, bounds[3] + 4, bounds[4] + 4, bounds[5] + 4 };
+    unsigned int outLow, outHigh, in;
+    frustumTest4(f, bounds, outLow, in);
+    frustumTest4(f, upper, outHigh, in);
+    return outLow | (outHigh << 4);
+#endif
+}
+
+class SceneBvh
+{
+public:
+    static const uint32_t LeafSize = 8;
+
+    /* Builds the tree over boxes; object i keeps index i in everything the BVH reports */
+    void build(const std::vector<Aabb>& boxes)
+    {
+        nodes.clear();
+        leaves.clear();
+        dirty.clear();
+        dirtyCount = 0;
+        objectSlot.assign(boxes.size(), 0);
+        for (std::vector<float>& v : items)
+            v.clear();
+        slotObject.clear();
+        if (boxes.empty())
+        {
+            root = Empty;
+            return;
+        }
+
+        std::vector<uint32_t> order(boxes.size());
+        for (uint32_t i = 0; i < (uint32_t)order.size(); i++)
+            order[i] = i;
+        root = buildRange(boxes, order, 0, (uint32_t)order.size(), -1, 0);
+        dirty.assign(nodes.size(), 0);
+    }
+
+    /* Moves an object. The tree is out of date until the next refit(). */
+    void update(uint32_t object, const Aabb& box)
+    {
+        const uint32_t slot = objectSlot[object];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            items[axis][slot] = box.min[axis];
+            items[axis + 3][slot] = box.max[axis];
+        }
+        const Leaf& leaf = leaves[slot / LeafSize];
+        if (leaf.node >= 0)
+            markDirty((uint32_t)leaf.node);
+    }
+
+    /* Recomputes the bounds of every node above an updated object, bottom-up, and stops going up as soon as a node's
+       bounds didn't change. Returns the number of nodes it visited. */
+    size_t refit()
+    {
+        size_t visited = 0;
+        for (size_t i = nodes.size(); i-- > 0 && dirtyCount > 0;)
+        {
+            if (!dirty[i])
+                continue;
+            dirty[i] = 0;
+            dirtyCount--;
+            visited++;
+
+            const Aabb before = nodeBounds((uint32_t)i);
+            refitNode((uint32_t)i);
+            const Aabb after = nodeBounds((uint32_t)i);
+            if (nodes[i].parent >= 0 && !sameBounds(before, after))
+                markDirty((uint32_t)nodes[i].parent);
+        }
+        return visited;
+    }
+
+    /* Replaces visible with the objects whose boxes intersect the frustum (in no particular order) */
+    void cull(const Frustum& frustum, std::vector<uint32_t>& visible) const
+    {
+        visible.clear();
+        if (root == Empty)
+            return;
+
+        const FrustumLanes lanes(frustum);
+        struct Pending { int32_t ref; bool inside; };
+        Pending stack[256];
+        int top = 0;
+        stack[top++] = Pending{ root, false };
+
+        while (top > 0)
+        {
+            const Pending entry = stack[--top];
+            if (entry.ref < 0)
+            {
+                emitLeaf(lanes, (uint32_t)~entry.ref, entry.inside, visible);
+                continue;
+            }
+
+            const Node& node = nodes[entry.ref];
+            unsigned int outside = 0, inside = 0xF;
+            if (!entry.inside)
+            {
+                const float* const bounds[6] = { node.minX, node.minY, node.minZ, node.maxX, node.maxY, node.maxZ };
+                frustumTest4(lanes, bounds, outside, inside);
+            }
+            for (unsigned int lane = 0; lane < 4; lane++)
+                if (((node.laneMask & ~outside) >> lane) & 1u)
+                    stack[top++] = Pending{ node.child[lane], ((inside >> lane) & 1u) != 0 };
+        }
+    }
+
+    size_t objectCount() const { return objectSlot.size(); }
+    size_t nodeCount() const { return nodes.size(); }
+    size_t leafCount() const { return leaves.size(); }
+
+private:
+    static const int32_t Empty = INT32_MIN;
+
+    /* Child bounds side by side: lane i of every array describes child i */
+    struct Node
+    {
+        float minX[4], minY[4], minZ[4], maxX[4], maxY[4], maxZ[4];
+        int32_t child[4];  // >= 0: node index, < 0: ~leaf index
+        uint32_t laneMask; // which children exist
+        int32_t parent;
+        uint32_t parentLane;
+    };
+
+    /* Objects firstSlot .. firstSlot + count - 1 in the item arrays; a leaf always owns LeafSize slots */
+    struct Leaf
+    {
+        uint32_t firstSlot;
+        uint32_t count;
+        int32_t node; // -1 when the leaf is the root
+        uint32_t lane;
+    };
+
+    int32_t buildRange(const std::vector<Aabb>& boxes, std::vector<uint32_t>& order, uint32_t begin, uint32_t end,
+                       int32_t parent, uint32_t parentLane)
+    {
+        if (end - begin <= LeafSize)
+            return makeLeaf(boxes, order, begin, end, parent, parentLane);
+
+        const int32_t index = (int32_t)nodes.size();
+        nodes.push_back(Node());
+        nodes[index].parent = parent;
+        nodes[index].parentLane = parentLane;
+
+        /* Two rounds of median splits along the widest axis give four roughly equal children */
+        const uint32_t middle = split(boxes, order, begin, end);
+        const uint32_t ranges[5] = { begin, split(boxes, order, begin, middle), middle, split(boxes, order, middle, end), end };
+
+        uint32_t laneMask = 0;
+        int32_t children[4];
+        for (uint32_t lane = 0; lane < 4; lane++)
+        {
+            children[lane] = Empty;
+            if (ranges[lane + 1] > ranges[lane])
+            {
+                children[lane] = buildRange(boxes, order, ranges[lane], ranges[lane + 1], index, lane);
+                laneMask |= 1u << lane;
+            }
+        }
+
+        Node& node = nodes[index]; // Only now: the recursion may have reallocated nodes
+        node.laneMask = laneMask;
+        for (int lane = 0; lane < 4; lane++)
+            node.child[lane] = children[lane];
+        refitNode((uint32_t)index);
+        return index;
+    }
+
+    int32_t makeLeaf(const std::vector<Aabb>& boxes, const std::vector<uint32_t>& order, uint32_t begin, uint32_t end,
+                     int32_t parent, uint32_t parentLane)
+    {
+        Leaf leaf;
+        leaf.firstSlot = (uint32_t)slotObject.size();
+        leaf.count = end - begin;
+        leaf.node = parent;
+        leaf.lane = parentLane;
+
+        for (uint32_t i = 0; i < LeafSize; i++)
+        {
+            const bool used = begin + i < end;
+            const uint32_t object = used ? order[begin + i] : 0;
+            const Aabb box = used ? boxes[object] : Aabb();
+            for (int axis = 0; axis < 3; axis++)
+            {
+                items[axis].push_back(box.min[axis]);
+                items[axis + 3].push_back(box.max[axis]);
+            }
+            slotObject.push_back(object);
+            if (used)
+                objectSlot[object] = leaf.firstSlot + i;
+        }
+
+        leaves.push_back(leaf);
+        return ~(int32_t)(leaves.size() - 1);
+    }
+
+    /* Partitions order[begin, end) around its median along the widest axis of the box centres; returns the middle */
+    static uint32_t split(const std::vector<Aabb>& boxes, std::vector<uint32_t>& order, uint32_t begin, uint32_t end)
+    {
+        if (end - begin < 2)
+            return end;
+
+        float lo[3] = { 1e30f, 1e30f, 1e30f }, hi[3] = { -1e30f, -1e30f, -1e30f };
+        for (uint32_t i = begin; i < end; i++)
+            for (int axis = 0; axis < 3; axis++)
+            {
+                const float c = boxes[order[i]].min[axis] + boxes[order[i]].max[axis];
+                lo[axis] = std::min(lo[axis], c);
+                hi[axis] = std::max(hi[axis], c);
+            }
+        int axis = 0;
+        if (hi[1] - lo[1] > hi[axis] - lo[axis])
+            axis = 1;
+        if (hi[2] - lo[2] > hi[axis] - lo[axis])
+            axis = 2;
+
+        const uint32_t middle = begin + (end - begin) / 2;
+        std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+            [&](uint32_t a, uint32_t b)
+            { return boxes[a].min[axis] + boxes[a].max[axis] < boxes[b].min[axis] + boxes[b].max[axis]; });
+        return middle;
+    }
+
+    /* Recomputes the four child boxes of a node from its children */
+    void refitNode(uint32_t index)
+    {
+        Node& node = nodes[index];
+        for (uint32_t lane = 0; lane < 4; lane++)
+        {
+            Aabb box = { { 1e30f, 1e30f, 1e30f }, { -1e30f, -1e30f, -1e30f } };
+            if ((node.laneMask >> lane) & 1u)
+            {
+                if (node.child[lane] < 0)
+                {
+                    const Leaf& leaf = leaves[~node.child[lane]];
+                    for (uint32_t slot = leaf.firstSlot; slot < leaf.firstSlot + leaf.count; slot++)
+                        for (int axis = 0; axis < 3; axis++)
+                        {
+                            box.min[axis] = std::min(box.min[axis], items[axis][slot]);
+                            box.max[axis] = std::max(box.max[axis], items[axis + 3][slot]);
+                        }
+                }
+                else
+                    box = nodeBounds((uint32_t)node.child[lane]);
+            }
+            node.minX[lane] = box.min[0];
+            node.minY[lane] = box.min[1];
+            node.minZ[lane] = box.min[2];
+            node.maxX[lane] = box.max[0];
+            node.maxY[lane] = box.max[1];
+            node.maxZ[lane] = box.max[2];
+        }
+    }
+
+    /* The box around all of a node's children */
+    Aabb nodeBounds(uint32_t index) const
+    {
+        const Node& node = nodes[index];
+        Aabb box = { { 1e30f, 1e30f, 1e30f }, { -1e30f, -1e30f, -1e30f } };
+        for (uint32_t lane = 0; lane < 4; lane++)
+            if ((node.laneMask >> lane) & 1u)
+            {
+                box.min[0] = std::min(box.min[0], node.minX[lane]);
+                box.min[1] = std::min(box.min[1], node.minY[lane]);
+                box.min[2] = std::min(box.min[2], node.minZ[lane]);
+                box.max[0] = std::max(box.max[0], node.maxX[lane]);
+                box.max[1] = std::max(box.max[1], node.maxY[lane]);
+                box.max[2] = std::max(box.max[2], node.maxZ[lane]);
+            }
+        return box;
+    }
+
+    static bool sameBounds(const Aabb& a, const Aabb& b)
+    {
+        for (int axis = 0; axis < 3; axis++)
+            if (a.min[axis] != b.min[axis] || a.max[axis] != b.max[axis])
+                return false;
+        return true;
+    }
+
+    void markDirty(uint32_t node)
+    {
+        if (!dirty[node])
+        {
+            dirty[node] = 1;
+            dirtyCount++;
+        }
+    }
+
+    void emitLeaf(const FrustumLanes& lanes, uint32_t index, bool inside, std::vector<uint32_t>& visible) const
+    {
+        const Leaf& leaf = leaves[index];
+        unsigned int outside = 0;
+        if (!inside)
+        {
+            const uint32_t s = leaf.firstSlot;
+            const float* const bounds[6] = { &items[0][s], &items[1][s], &items[2][s], &items[3][s], &items[4][s], &items[5][s] };
+            outside = frustumOutside8(lanes, bounds);
+        }
+        for (uint32_t i = 0; i < leaf.count; i++)
+            if (!((outside >> i) & 1u))
+                visible.push_back(slotObject[leaf.firstSlot + i]);
+    }
+
+    int32_t root = Empty;
+    std::vector<Node> nodes;
+    std::vector<Leaf> leaves;
+    std::vector<float> items[6];      // minX, minY, minZ, maxX, maxY, maxZ per slot
+    std::vector<uint32_t> slotObject; // slot -> object
+    std::vector<uint32_t> objectSlot; // object -> slot
+    std::vector<uint8_t> dirty;       // per node, set by update()
+    size_t dirtyCount = 0;
+};
+
+#endif
@@ -0,0 +1,321 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* The copy next to GLFW's examples; static so any number of files may include this header */
+#define STB_IMAGE_WRITE_STATIC
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "../glfw-3.3.2/deps/stb_image_write.h"
+
+/*******************************************************************************************************************************
+Asynchronous frame capture
+*******************************************************************************************************************************/
+/* glReadPixels into client memory blocks until the GPU has finished the frame and copied it out, and encoding a PNG
+   right after takes longer than the frame itself. Here neither happens on the render loop:
+
+       frame N      capture() queues glReadPixels into pixel pack buffer N % Slots and puts a fence after it.
+                    The call returns right away; the GPU does the copy when it gets there.
+       frame N+1..  capture() checks the older fences without waiting. Once one has signalled, its buffer is mapped,
+                    copied out (flipping it the right way up on the way) and handed to the encoder thread.
+       encoder      Writes the PNG and gives the memory back for reuse.
+
+   The main thread only waits when it comes back to a buffer whose fence still hasn't signalled, Slots frames later
+   (counted as a stall). If the encoder falls behind, more than maxQueued frames waiting for it, new frames are
+   dropped (and counted) instead of piling up in memory; their numbers are skipped in the file names.
+
+   The encoder is pluggable and sees the frames in order, so the same machinery feeds video (FrameStream.h). A stream
+   can't skip frames: with dropWhenFull = false the render loop waits for room instead, so an encoder that can't keep
+   up slows rendering down to its pace while memory stays bounded at maxQueued frames. On OSMesa the frame is already
+   in CPU memory; captureMemory() takes it from there without a readback.
+
+       FrameCapture capture("shot_%05u.png");
+       ...draw...
+       capture.capture(width, height);  // reads the current read framebuffer, before glfwSwapBuffers
+       ...
+       capture.finish();                // at exit: waits for the last frames and their files */
+class FrameCapture
+{
+public:
+    static const unsigned int Slots = 3;
+
+    struct Stats
+    {
+        unsigned int captured = 0; // capture() calls
+        unsigned int written = 0;  // files written
+        unsigned int dropped = 0;  // frames skipped because the encoder was behind
+        unsigned int waits = 0;    // frames that waited for the encoder instead (dropWhenFull = false)
+        unsigned int failed = 0;   // files that couldn't be written
+        unsigned int stalls = 0;   // capture() had to wait for the GPU
+        double maxCaptureMs = 0.0; // main-thread time of the slowest capture()
+        double encodeMs = 0.0;     // encoder time, all frames
+    };
+
+    /* Runs on the encoder thread, one frame at a time in capture order. rgba is top row first and may be modified.
+       Returns false if the frame couldn't be written. */
+    typedef std::function<bool(std::vector<uint8_t>& rgba, int width, int height, unsigned int frame)> Encoder;
+
+    /* Writes each frame to a PNG file; pattern is a printf format with one %u for the frame number */
+    static Encoder pngEncoder(const std::string& pattern)
+    {
+        return [pattern](std::vector<uint8_t>& rgba, int width, int height, unsigned int frame)
+        {
+            char path[1024];
+            std::snprintf(path, sizeof(path), pattern.c_str(), frame);
+            /* The framebuffer's alpha is whatever blending left there; a screenshot should be opaque */
+            for (size_t i = 3; i < rgba.size(); i += 4)
+                rgba[i] = 255;
+            if (stbi_write_png(path, width, height, 4, rgba.data(), width * 4))
+                return true;
+            std::cout << "ERROR::FRAME_CAPTURE::WRITE_FAILED " << path << std::endl;
+            return false;
+        };
+    }
+
+    explicit FrameCapture(const std::string& pattern = "capture_%05u.png", unsigned int maxQueued = 4)
+        : FrameCapture(pngEncoder(pattern), maxQueued, true)
+    {
+    }
+
+    FrameCapture(Encoder encode, unsigned int maxQueued, bool dropWhenFull)
+        : maxQueued(std::max(1u, maxQueued)), dropWhenFull(dropWhenFull), encoder(1)
+    {
+        shared->encode = encode;
+        for (Slot& slot : slots)
+            glGenBuffers(1, &slot.buffer);
+    }
+
+    ~FrameCapture()
+    {
+        finish();
+        for (Slot& slot : slots)
+            glDeleteBuffers(1, &slot.buffer);
+    }
+
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    /* Queues a readback of the bottom-left width x height pixels of the read framebuffer */
+    void capture(int width, int height)
+    {
+        if (width <= 0 || height <= 0)
+            return; // Minimized
+        const double start = glfwGetTime();
+        collect();
+
+        Slot& slot = slots[stats.captured % Slots];
+        if (slot.fence)
+        {
+            stats.stalls += glClientWaitSync(slot.fence, 0, 0) == GL_TIMEOUT_EXPIRED;
+            retire(slot, true);
+        }
+
+        const size_t bytes = (size_t)width * height * 4;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        if (slot.capacity < bytes)
+        {
+            glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)bytes, NULL, GL_STREAM_READ);
+            slot.capacity = bytes;
+        }
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0); // Later glReadPixels calls with a pointer would write into it otherwise
+        slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        slot.width = width;
+        slot.height = height;
+        slot.frame = stats.captured++;
+
+        stats.maxCaptureMs = std::max(stats.maxCaptureMs, (glfwGetTime() - start) * 1000.0);
+    }
+
+    /* Queues a frame that is in CPU memory already, rows bottom-up like GL's (the OSMesa colour buffer). The copy is
+       made before this returns. Don't mix with capture() on one FrameCapture; frames could come out of order. */
+    void captureMemory(const uint8_t* rgba, int width, int height)
+    {
+        if (width <= 0 || height <= 0)
+            return;
+        const double start = glfwGetTime();
+        const unsigned int frame = stats.captured++;
+        std::vector<uint8_t> pixels;
+        if (reserve(pixels))
+        {
+            copyFlipped(rgba, width, height, pixels);
+            queue(std::move(pixels), width, height, frame, true);
+        }
+        stats.maxCaptureMs = std::max(stats.maxCaptureMs, (glfwGetTime() - start) * 1000.0);
+    }
+
+    /* Waits for every queued frame to be read back and written */
+    void finish()
+    {
+        for (unsigned int i = 0; i < Slots; i++)
+        {
+            Slot& slot = slots[(stats.captured + i) % Slots];
+            if (slot.fence)
+            {
+                encoder.wait(); // Make room rather than drop the last frames
+                retire(slot, true);
+            }
+        }
+        encoder.wait();
+    }
+
+    /* Encoder-side numbers are only final after finish() */
+    Stats statistics() const
+    {
+        Stats s = stats;
+        std::lock_guard<std::mutex> lock(shared->mutex);
+        s.written = shared->written;
+        s.failed = shared->failed;
+        s.encodeMs = shared->encodeMs;
+        return s;
+    }
+
+    void printSummary(std::ostream& out) const
+    {
+        const Stats s = statistics();
+        out << "Capture: " << s.written << " of " << s.captured << " frames written (" << s.dropped << " dropped, "
+            << s.failed << " failed, " << s.waits << " waited for the encoder), " << s.stalls
+            << " stalls, slowest capture() " << s.maxCaptureMs << " ms, "
+            << (s.written ? s.encodeMs / s.written : 0.0) << " ms per encode" << std::endl;
+    }
+
+private:
+    struct Slot
+    {
+        unsigned int buffer = 0;
+        size_t capacity = 0;
+        GLsync fence = 0;
+        int width = 0, height = 0;
+        unsigned int frame = 0;
+    };
+
+    /* Shared with the encoder thread */
+    struct Shared
+    {
+        Encoder encode;
+        mutable std::mutex mutex;
+        std::condition_variable room; // queued went down
+        std::vector<std::vector<uint8_t>> spare; // Frame memory to reuse, so steady capturing doesn't allocate
+        unsigned int queued = 0;
+        unsigned int written = 0;
+        unsigned int failed = 0;
+        double encodeMs = 0.0;
+    };
+
+    /* Retires the slots whose readback is done, oldest first, without waiting for the others. It stops at the first
+       one still pending: a newer fence may signal in the meantime, but retiring it first would queue its frame ahead
+       of the older one's. */
+    void collect()
+    {
+        for (unsigned int i = 0; i < Slots; i++)
+        {
+            Slot& slot = slots[(stats.captured + i) % Slots];
+            if (!slot.fence)
+                continue;
+            if (glClientWaitSync(slot.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+                break;
+            retire(slot, false);
+        }
+    }
+
+    /* Maps the slot's buffer and hands a copy to the encoder, unless it is too far behind */
+    void retire(Slot& slot, bool wait)
+    {
+        if (wait)
+            glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, (GLuint64)10000000000);
+        glDeleteSync(slot.fence);
+        slot.fence = 0;
+
+        std::vector<uint8_t> pixels;
+        if (!reserve(pixels))
+            return;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        const GLsizeiptr bytes = (GLsizeiptr)slot.width * slot.height * 4;
+        const uint8_t* mapped = (const uint8_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+        if (mapped)
+        {
+            copyFlipped(mapped, slot.width, slot.height, pixels);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        queue(std::move(pixels), slot.width, slot.height, slot.frame, mapped != NULL);
+    }
+
+    /* Claims a place in the encoder's queue and memory for one frame. False if the frame is to be dropped. */
+    bool reserve(std::vector<uint8_t>& pixels)
+    {
+        std::unique_lock<std::mutex> lock(shared->mutex);
+        if (shared->queued >= maxQueued)
+        {
+            if (dropWhenFull)
+            {
+                stats.dropped++;
+                return false;
+            }
+            stats.waits++;
+            shared->room.wait(lock, [&] { return shared->queued < maxQueued; });
+        }
+        shared->queued++;
+        if (!shared->spare.empty())
+        {
+            pixels.swap(shared->spare.back());
+            shared->spare.pop_back();
+        }
+        return true;
+    }
+
+    /* GL's rows go bottom-up, image files' and video frames' top-down */
+    static void copyFlipped(const uint8_t* rgba, int width, int height, std::vector<uint8_t>& pixels)
+    {
+        const size_t rowBytes = (size_t)width * 4;
+        pixels.resize(rowBytes * height);
+        for (int y = 0; y < height; y++)
+            std::memcpy(&pixels[(size_t)(height - 1 - y) * rowBytes], rgba + (size_t)y * rowBytes, rowBytes);
+    }
+
+    void queue(std::vector<uint8_t>&& pixels, int width, int height, unsigned int frame, bool ok)
+    {
+        std::shared_ptr<Shared> s = shared;
+        std::shared_ptr<std::vector<uint8_t>> rgba = std::make_shared<std::vector<uint8_t>>(std::move(pixels));
+        encoder.submit([s, rgba, width, height, frame, ok](unsigned int)
+        {
+            const double start = glfwGetTime();
+            const bool written = ok && s->encode(*rgba, width, height, frame);
+            if (!ok)
+                std::cout << "ERROR::FRAME_CAPTURE::MAP_FAILED frame " << frame << std::endl;
+
+            std::lock_guard<std::mutex> lock(s->mutex);
+            s->queued--;
+            s->written += written;
+            s->failed += !written;
+            s->encodeMs += (glfwGetTime() - start) * 1000.0;
+            s->spare.push_back(std::move(*rgba));
+            s->room.notify_one();
+        });
+    }
+
+    unsigned int maxQueued;
+    bool dropWhenFull;
+    Slot slots[Slots];
+    Stats stats;
+    std::shared_ptr<Shared> shared = std::make_shared<Shared>();
+    ThreadPool encoder; // Last, so it is joined before the rest goes away
+};
+
+#endif
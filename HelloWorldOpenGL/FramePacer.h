@@ -0,0 +1,175 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#ifdef __linux__
+#include <cerrno>
+#include <time.h>
+#else
+#include <chrono>
+#include <thread>
+#endif
+
+/*******************************************************************************************************************************
+Frame pacing
+*******************************************************************************************************************************/
+/* Without vsync the render loop runs as fast as glfwSwapBuffers returns and keeps a core at 100%. FramePacer holds
+   it to a fixed frame period instead:
+
+       pacer.wait();        // top of the loop: returns when the next frame should start
+       ...input, render, swap...
+       pacer.endFrame();
+
+   Sleeping is cheap but imprecise (the scheduler may wake us late by tens to hundreds of microseconds), and spinning
+   is precise but burns the CPU. So wait() sleeps with clock_nanosleep(TIMER_ABSTIME) until spinMs before the
+   target - an absolute deadline, so time spent before the call doesn't add up - and spins on glfwGetTimerValue for the
+   rest. How late each wake-up was (the "wake error") is measured on the same timer and reported by printSummary.
+
+   Low-latency mode: by default a frame starts at its deadline, so input is read at the start of the period and sits
+   around until the frame shows. In low-latency mode the deadline is when the frame should be *done*; wait() returns
+   as late as possible, estimated from how long recent frames took, and the loop samples input after waking. */
+class FramePacer
+{
+public:
+    FramePacer(double framesPerSecond, bool lowLatency = false, double spinMs = 0.5)
+        : frequency(glfwGetTimerFrequency()), lowLatency(lowLatency)
+    {
+        period = (uint64_t)((double)frequency / framesPerSecond);
+        spin = (uint64_t)(spinMs * (double)frequency / 1000.0);
+        wakeErrors.reserve(4096);
+    }
+
+    bool isLowLatency() const { return lowLatency; }
+
+    /* Blocks until the next frame should start */
+    void wait()
+    {
+        uint64_t now = glfwGetTimerValue();
+        if (!started)
+        {
+            deadline = now + (lowLatency ? period : 0);
+            started = true;
+        }
+
+        /* In low-latency mode, start early enough to finish by the deadline. The margin covers frames that run a bit
+           longer than the estimate. */
+        const uint64_t lead = lowLatency ? std::min(period, workEstimate + spin) : 0;
+        const uint64_t target = deadline - lead;
+
+        if (target > now)
+        {
+            if (target - now > spin)
+            {
+                sleepUntil(target - spin, now);
+                const uint64_t woke = glfwGetTimerValue();
+                sleptTicks += woke - now;
+                oversleptTicks += woke > target - spin ? woke - (target - spin) : 0;
+                now = woke;
+            }
+
+            const uint64_t spinStart = now;
+            while (now < target)
+                now = glfwGetTimerValue();
+            spunTicks += now - spinStart;
+            wakeErrors.push_back(toUs(now - target));
+        }
+        else if (target < now)
+            lateFrames++;
+
+        frameStart = now;
+        deadline += period;
+
+        /* If we fell more than a frame behind (a hitch, the window being dragged), don't try to catch up with a burst
+           of unpaced frames; just restart the schedule from here. */
+        if (deadline + period < now)
+            deadline = now + (lowLatency ? period : 0);
+    }
+
+    /* Call once the frame has been submitted (after glfwSwapBuffers) */
+    void endFrame()
+    {
+        /* Jump up to slow frames right away, forget them slowly */
+        const uint64_t work = glfwGetTimerValue() - frameStart;
+        workEstimate = std::max(work, workEstimate - workEstimate / 16 + work / 16);
+        frames++;
+    }
+
+    /* Microseconds between the target and the moment wait() actually returned, for every frame that waited */
+    const std::vector<double>& wakeErrorsUs() const { return wakeErrors; }
+
+    void printSummary(std::ostream& out) const
+    {
+        if (frames == 0)
+            return;
+
+        std::vector<double> sorted(wakeErrors);
+        std::sort(sorted.begin(), sorted.end());
+        double sum = 0.0;
+        for (double e : sorted)
+            sum += e;
+
+        out << "Frame pacer: " << frames << " frames at " << (double)frequency / (double)period << " fps"
+            << (lowLatency ? " (low latency)" : "") << ", " << lateFrames << " late" << std::endl;
+        if (!sorted.empty())
+            out << "  wake error avg " << sum / (double)sorted.size() << " us, p99 " << percentile(sorted, 0.99)
+                << " us, max " << sorted.back() << " us" << std::endl;
+        out << "  slept " << toUs(sleptTicks) / 1000.0 << " ms (overslept " << toUs(oversleptTicks) / 1000.0
+            << " ms), spun " << toUs(spunTicks) / 1000.0 << " ms" << std::endl;
+    }
+
+private:
+    double toUs(uint64_t ticks) const { return (double)ticks * 1e6 / (double)frequency; }
+
+    static double percentile(const std::vector<double>& sorted, double p)
+    {
+        size_t i = (size_t)(p * (double)(sorted.size() - 1) + 0.5);
+        return sorted[std::min(i, sorted.size() - 1)];
+    }
+
+    /* Sleeps until the GLFW timer reads target. now is the current timer value. */
+    void sleepUntil(uint64_t target, uint64_t now) const
+    {
+        const uint64_t ns = (uint64_t)((double)(target - now) * 1e9 / (double)frequency);
+#ifdef __linux__
+        /* GLFW's timer isn't guaranteed to be CLOCK_MONOTONIC, so translate the deadline through "now" on both clocks */
+        timespec wake;
+        clock_gettime(CLOCK_MONOTONIC, &wake);
+        wake.tv_sec += (time_t)(ns / 1000000000u);
+        wake.tv_nsec += (long)(ns % 1000000000u);
+        if (wake.tv_nsec >= 1000000000L)
+        {
+            wake.tv_sec++;
+            wake.tv_nsec -= 1000000000L;
+        }
+        /* An absolute deadline means a signal interrupting the sleep doesn't push the wake-up back */
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR)
+            ;
+#else
+        std::this_thread::sleep_for(std::chrono::nanoseconds(ns));
+#endif
+    }
+
+    uint64_t frequency;
+    uint64_t period = 0;
+    uint64_t spin = 0;
+    bool lowLatency;
+    bool started = false;
+    uint64_t deadline = 0;
+    uint64_t frameStart = 0;
+    uint64_t workEstimate = 0;
+
+    unsigned int frames = 0;
+    unsigned int lateFrames = 0;
+    uint64_t sleptTicks = 0;
+    uint64_t oversleptTicks = 0;
+    uint64_t spunTicks = 0;
+    std::vector<double> wakeErrors;
+};
+
+#endif
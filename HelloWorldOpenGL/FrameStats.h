@@ -0,0 +1,148 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <GLFW/glfw3.h>
+
+#include "GLState.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*******************************************************************************************************************************
+Per-frame statistics
+*******************************************************************************************************************************/
+/* One row per rendered frame:
+       cpuMs      Time from the start of the frame until we hand it to glfwSwapBuffers (input + building/submitting GL work)
+       swapMs     Time spent inside glfwSwapBuffers. With OSMesa this is where the software rasterizer actually finishes the frame
+       drawCalls  Number of glDraw* calls we issued
+       stateCalls / stateCallsElided   State changes that reached GL / that the GLStateCache skipped */
+struct FrameSample
+{
+    unsigned int frame;
+    double cpuMs;
+    double swapMs;
+    unsigned int drawCalls;
+    unsigned int stateCalls;
+    unsigned int stateCallsElided;
+};
+
+class FrameStats
+{
+public:
+    FrameStats(unsigned int expectedFrames = 0)
+        : timerFrequency((double)glfwGetTimerFrequency())
+    {
+        samples.reserve(expectedFrames);
+    }
+
+    void beginFrame()
+    {
+        frameStart = glfwGetTimerValue();
+        current = FrameSample();
+        current.frame = (unsigned int)samples.size();
+    }
+
+    /* Adds up the GLStateCache counters for this frame; the caller resets them afterwards */
+    void recordState(const GLStateCounters& counters)
+    {
+        current.drawCalls += counters.draws;
+        current.stateCalls += counters.issued;
+        current.stateCallsElided += counters.elided;
+    }
+
+    void beginSwap() { swapStart = glfwGetTimerValue(); }
+
+    void endFrame()
+    {
+        const uint64_t now = glfwGetTimerValue();
+        current.cpuMs = toMs(swapStart - frameStart);
+        current.swapMs = toMs(now - swapStart);
+        samples.push_back(current);
+    }
+
+    const std::vector<FrameSample>& frames() const { return samples; }
+
+    /* Picks the format from the file extension: ".json" writes JSON, everything else CSV */
+    bool write(const std::string& path) const
+    {
+        std::ofstream out(path.c_str());
+        if (!out)
+        {
+            std::cout << "ERROR::FRAME_STATS::CANNOT_OPEN " << path << std::endl;
+            return false;
+        }
+
+        const bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+        if (json)
+            writeJson(out);
+        else
+            writeCsv(out);
+        return (bool)out;
+    }
+
+    void printSummary(std::ostream& out) const
+    {
+        if (samples.empty())
+            return;
+
+        std::vector<double> total;
+        total.reserve(samples.size());
+        double cpu = 0.0, swap = 0.0, issued = 0.0, elided = 0.0;
+        for (const FrameSample& s : samples)
+        {
+            cpu += s.cpuMs;
+            swap += s.swapMs;
+            issued += s.stateCalls;
+            elided += s.stateCallsElided;
+            total.push_back(s.cpuMs + s.swapMs);
+        }
+        std::sort(total.begin(), total.end());
+
+        const double n = (double)samples.size();
+        out << samples.size() << " frames: cpu " << cpu / n << " ms, swap " << swap / n << " ms avg, "
+            << "frame p50 " << percentile(total, 0.50) << " ms, p99 " << percentile(total, 0.99) << " ms; "
+            << issued / n << " state calls/frame issued, " << elided / n << " elided" << std::endl;
+    }
+
+private:
+    double toMs(uint64_t ticks) const { return (double)ticks * 1000.0 / timerFrequency; }
+
+    static double percentile(const std::vector<double>& sorted, double p)
+    {
+        size_t i = (size_t)(p * (double)(sorted.size() - 1) + 0.5);
+        return sorted[std::min(i, sorted.size() - 1)];
+    }
+
+    void writeCsv(std::ostream& out) const
+    {
+        out << "frame,cpu_ms,swap_ms,draw_calls,state_calls,state_calls_elided\n";
+        for (const FrameSample& s : samples)
+            out << s.frame << ',' << s.cpuMs << ',' << s.swapMs << ',' << s.drawCalls << ',' << s.stateCalls << ','
+                << s.stateCallsElided << '\n';
+    }
+
+    void writeJson(std::ostream& out) const
+    {
+        out << "{\n  \"frames\": [\n";
+        for (size_t i = 0; i < samples.size(); i++)
+        {
+            const FrameSample& s = samples[i];
+            out << "    {\"frame\": " << s.frame << ", \"cpu_ms\": " << s.cpuMs << ", \"swap_ms\": " << s.swapMs
+                << ", \"draw_calls\": " << s.drawCalls << ", \"state_calls\": " << s.stateCalls
+                << ", \"state_calls_elided\": " << s.stateCallsElided << '}' << (i + 1 < samples.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n}\n";
+    }
+
+    double timerFrequency;
+    uint64_t frameStart = 0;
+    uint64_t swapStart = 0;
+    FrameSample current = FrameSample();
+    std::vector<FrameSample> samples;
+};
+
+#endif
@@ -0,0 +1,310 @@
+#ifndef FRAME_STREAM_H
+#define FRAME_STREAM_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "FrameCapture.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <csignal>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*******************************************************************************************************************************
+RGBA to YUV 4:2:0
+*******************************************************************************************************************************/
+/* Full-range BT.601 (JPEG/JFIF), which is what Y4M's C420jpeg means: chroma sits in the middle of each 2x2 block and
+   is converted from the block's average colour. Integer arithmetic with 8 fractional bits, so the SSE2 path and the
+   scalar one give the same bytes:
+       Y = ( 77 R + 150 G +  29 B) / 256
+       U = (-43 R -  85 G + 128 B) / 256 + 128
+       V = (128 R - 107 G -  21 B) / 256 + 128
+   rgba is top row first with stride bytes per row; the planes are width x height and ceil(width/2) x ceil(height/2).
+   An odd last column or row repeats its neighbour for chroma. */
+inline void rgbaToYuv420Pixel(const uint8_t* rgba, int width, int height, size_t stride, int x, int y, uint8_t* yPlane,
+                              uint8_t* uPlane, uint8_t* vPlane)
+{
+    /* The 2x2 block at (x, y), both even */
+    int r = 0, g = 0, b = 0;
+    for (int dy = 0; dy < 2; dy++)
+        for (int dx = 0; dx < 2; dx++)
+        {
+            const int px = std::min(x + dx, width - 1), py = std::min(y + dy, height - 1);
+            const uint8_t* p = rgba + py * stride + (size_t)px * 4;
+            if (px == x + dx && py == y + dy)
+                yPlane[(size_t)py * width + px] = (uint8_t)((77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8);
+            r += p[0];
+            g += p[1];
+            b += p[2];
+        }
+    const size_t c = (size_t)(y / 2) * ((width + 1) / 2) + x / 2;
+    uPlane[c] = (uint8_t)std::min(255, (-43 * r - 85 * g + 128 * b + 131072 + 512) >> 10);
+    vPlane[c] = (uint8_t)std::min(255, (128 * r - 107 * g - 21 * b + 131072 + 512) >> 10);
+}
+
+inline void rgbaToYuv420(const uint8_t* rgba, int width, int height, size_t stride, uint8_t* yPlane, uint8_t* uPlane,
+                         uint8_t* vPlane)
+{
+    const int chromaWidth = (width + 1) / 2;
+    for (int y = 0; y < height; y += 2)
+    {
+        int x = 0;
+#ifdef HELLO_SSE2
+        /* 8 x 2 pixels per step: 16 luma and 4 + 4 chroma samples */
+        if (y + 1 < height)
+        {
+            const __m128i low = _mm_set1_epi32(0xff);
+            const __m128i yCoefficients = _mm_setr_epi16(77, 150, 77, 150, 77, 150, 77, 150);
+            const __m128i uCoefficients = _mm_setr_epi16(-43, -85, -43, -85, -43, -85, -43, -85);
+            const __m128i vCoefficients = _mm_setr_epi16(-107, -21, -107, -21, -107, -21, -107, -21);
+            const __m128i ones = _mm_set1_epi16(1);
+            const __m128i blueCoefficient = _mm_set1_epi16(29), half = _mm_set1_epi16(128);
+            const __m128i bias = _mm_set1_epi32(131072 + 512);
+            for (; x + 8 <= width; x += 8)
+            {
+                __m128i r[2], g[2], b[2];
+                for (int row = 0; row < 2; row++)
+                {
+                    const uint8_t* p = rgba + (size_t)(y + row) * stride + (size_t)x * 4;
+                    const __m128i p0 = _mm_loadu_si128((const __m128i*)p);
+                    const __m128i p1 = _mm_loadu_si128((const __m128i*)(p + 16));
+
+                    /* One channel per 16-bit lane, 8 pixels */
+                    r[row] = _mm_packs_epi32(_mm_and_si128(p0, low), _mm_and_si128(p1, low));
+                    g[row] = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), low),
+                                             _mm_and_si128(_mm_srli_epi32(p1, 8), low));
+                    b[row] = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), low),
+                                             _mm_and_si128(_mm_srli_epi32(p1, 16), low));
+
+                    /* R and G interleaved as 16-bit pairs so one madd does 77 R + 150 G per pixel, in 32 bits */
+                    const __m128i rgLow = _mm_unpacklo_epi16(r[row], g[row]);
+                    const __m128i rgHigh = _mm_unpackhi_epi16(r[row], g[row]);
+                    const __m128i lumaLow = _mm_madd_epi16(rgLow, yCoefficients);
+                    const __m128i lumaHigh = _mm_madd_epi16(rgHigh, yCoefficients);
+                    const __m128i blue = _mm_add_epi16(_mm_mullo_epi16(b[row], blueCoefficient), half);
+                    const __m128i blueLow = _mm_unpacklo_epi16(blue, _mm_setzero_si128());
+                    const __m128i blueHigh = _mm_unpackhi_epi16(blue, _mm_setzero_si128());
+                    const __m128i y0 = _mm_srli_epi32(_mm_add_epi32(lumaLow, blueLow), 8);
+                    const __m128i y1 = _mm_srli_epi32(_mm_add_epi32(lumaHigh, blueHigh), 8);
+                    const __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(y0, y1), _mm_setzero_si128());
+                    _mm_storel_epi64((__m128i*)(yPlane + (size_t)(y + row) * width + x), bytes);
+                }
+
+                /* 2x2 sums: rows added, then neighbouring lanes by madd with 1s; at most 1020 each */
+                const __m128i r4 = _mm_madd_epi16(_mm_add_epi16(r[0], r[1]), ones);
+                const __m128i g4 = _mm_madd_epi16(_mm_add_epi16(g[0], g[1]), ones);
+                const __m128i b4 = _mm_madd_epi16(_mm_add_epi16(b[0], b[1]), ones);
+                const __m128i rg = _mm_or_si128(r4, _mm_slli_epi32(g4, 16));
+                const __m128i gb = _mm_or_si128(g4, _mm_slli_epi32(b4, 16));
+                const __m128i u = _mm_srai_epi32(
+                    _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(rg, uCoefficients), _mm_slli_epi32(b4, 7)), bias), 10);
+                const __m128i v = _mm_srai_epi32(
+                    _mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(gb, vCoefficients), _mm_slli_epi32(r4, 7)), bias), 10);
+                const __m128i chroma = _mm_packus_epi16(_mm_packs_epi32(u, v), _mm_setzero_si128());
+                const size_t c = (size_t)(y / 2) * chromaWidth + x / 2;
+                const int uBytes = _mm_cvtsi128_si32(chroma), vBytes = _mm_cvtsi128_si32(_mm_srli_si128(chroma, 4));
+                std::memcpy(uPlane + c, &uBytes, 4);
+                std::memcpy(vPlane + c, &vBytes, 4);
+            }
+        }
+#endif
+        for (; x < width; x += 2)
+            rgbaToYuv420Pixel(rgba, width, height, stride, x, y, yPlane, uPlane, vPlane);
+    }
+}
+
+/*******************************************************************************************************************************
+Frame streaming
+*******************************************************************************************************************************/
+/* Writes a sequence of frames to a file, a named pipe or an already open descriptor (stdout), for an encoder running
+   as a separate process:
+       Y4m   YUV4MPEG2, 4:2:0. The header carries size and frame rate, so e.g. `ffmpeg -i frames.y4m out.mp4` or
+             `x264 --demuxer y4m -o out.264 -` need no other options.
+       Raw   RGBA, top row first, nothing else: `ffmpeg -f rawvideo -pix_fmt rgba -s WxH -r FPS -i - out.mp4`
+   writeFrame() is a FrameCapture encoder, so conversion and writing happen on the capture's encoder thread, frames in
+   order. Give the FrameCapture dropWhenFull = false: when the consumer reads slower than we render, write() blocks
+   on the full pipe, frames queue up to maxQueued, and then the render loop waits. Memory stays bounded and no frame
+   is lost. Writing to a pipe whose reader has gone away fails with EPIPE instead of killing us (SIGPIPE is ignored
+   once a stream is open).
+
+       FrameStream stream("frames.y4m", FrameStream::Y4m, 60);
+       FrameCapture capture(stream.encoder(), 3, false); */
+class FrameStream
+{
+public:
+    enum Format
+    {
+        Y4m,
+        Raw
+    };
+
+    struct Stats
+    {
+        unsigned int frames = 0;
+        size_t bytes = 0;
+        double convertMs = 0.0; // RGBA to YUV
+        double writeMs = 0.0;   // includes time blocked on a full pipe
+    };
+
+    /* "-" is stdout and "fd:N" descriptor N, e.g. a pipe set up by the process that started us. Anything else is a
+       file name; opening a named pipe waits until something opens it for reading. */
+    FrameStream(const std::string& path, Format format, int fps) : format(format), fps(std::max(fps, 1))
+    {
+        if (path == "-" || path.compare(0, 3, "fd:") == 0)
+            descriptor = path == "-" ? 1 : std::atoi(path.c_str() + 3);
+#ifdef _WIN32
+        if (descriptor >= 0)
+            _setmode(descriptor, _O_BINARY);
+        else
+        {
+            descriptor = _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, 0644);
+            owned = true;
+        }
+#else
+        std::signal(SIGPIPE, SIG_IGN);
+        if (descriptor < 0)
+        {
+            descriptor = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            owned = true;
+        }
+#endif
+        if (descriptor < 0)
+            std::cout << "ERROR::FRAME_STREAM::OPEN_FAILED " << path << ": " << std::strerror(errno) << std::endl;
+    }
+
+    ~FrameStream()
+    {
+        if (owned && descriptor >= 0)
+#ifdef _WIN32
+            _close(descriptor);
+#else
+            ::close(descriptor);
+#endif
+    }
+
+    FrameStream(const FrameStream&) = delete;
+    FrameStream& operator=(const FrameStream&) = delete;
+
+    bool isOpen() const { return descriptor >= 0; }
+
+    /* Only read it once the FrameCapture feeding this has finished */
+    const Stats& statistics() const { return stats; }
+
+    void printSummary(std::ostream& out) const
+    {
+        out << "Stream: " << stats.frames << " frames, " << (double)stats.bytes / (1024.0 * 1024.0) << " MB, "
+            << (stats.frames ? stats.convertMs / stats.frames : 0.0) << " ms converting and "
+            << (stats.frames ? stats.writeMs / stats.frames : 0.0) << " ms writing per frame" << std::endl;
+    }
+
+    /* For FrameCapture. The stream has to outlive it. */
+    FrameCapture::Encoder encoder()
+    {
+        return [this](std::vector<uint8_t>& rgba, int width, int height, unsigned int)
+        {
+            return writeFrame(rgba.data(), width, height);
+        };
+    }
+
+    /* rgba is top row first. Every frame must have the size of the first one. */
+    bool writeFrame(const uint8_t* rgba, int width, int height)
+    {
+        if (descriptor < 0 || failed)
+            return false;
+        if (stats.frames == 0)
+        {
+            frameWidth = width;
+            frameHeight = height;
+            if (format == Y4m)
+            {
+                char header[128];
+                const int length = std::snprintf(header, sizeof(header), "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n",
+                                                 width, height, fps);
+                if (!writeAll(header, (size_t)length))
+                    return false;
+            }
+        }
+        else if (width != frameWidth || height != frameHeight)
+        {
+            std::cout << "ERROR::FRAME_STREAM::SIZE_CHANGED " << frameWidth << "x" << frameHeight << " to " << width
+                      << "x" << height << "; the stream can't change size, frame skipped" << std::endl;
+            return false;
+        }
+
+        bool ok;
+        if (format == Y4m)
+        {
+            const double start = glfwGetTime();
+            const size_t lumaBytes = (size_t)width * height;
+            const size_t chromaBytes = (size_t)((width + 1) / 2) * ((height + 1) / 2);
+            static const char frameHeader[] = "FRAME\n";
+            yuv.resize(sizeof(frameHeader) - 1 + lumaBytes + chromaBytes * 2);
+            std::memcpy(yuv.data(), frameHeader, sizeof(frameHeader) - 1);
+            uint8_t* planes = yuv.data() + sizeof(frameHeader) - 1;
+            rgbaToYuv420(rgba, width, height, (size_t)width * 4, planes, planes + lumaBytes,
+                         planes + lumaBytes + chromaBytes);
+            stats.convertMs += (glfwGetTime() - start) * 1000.0;
+            ok = writeAll(yuv.data(), yuv.size());
+        }
+        else
+            ok = writeAll(rgba, (size_t)width * height * 4);
+        stats.frames += ok;
+        return ok;
+    }
+
+private:
+    bool writeAll(const void* data, size_t size)
+    {
+        const double start = glfwGetTime();
+        const char* p = (const char*)data;
+        while (size > 0)
+        {
+#ifdef _WIN32
+            const int written = _write(descriptor, p, (unsigned int)std::min<size_t>(size, 1 << 30));
+#else
+            const ssize_t written = ::write(descriptor, p, size);
+#endif
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written <= 0)
+            {
+                std::cout << "ERROR::FRAME_STREAM::WRITE_FAILED " << std::strerror(errno) << std::endl;
+                failed = true; // A broken pipe stays broken; don't print this for every frame that follows
+                return false;
+            }
+            p += written;
+            size -= (size_t)written;
+            stats.bytes += (size_t)written;
+        }
+        stats.writeMs += (glfwGetTime() - start) * 1000.0;
+        return true;
+    }
+
+    Format format;
+    int fps;
+    int descriptor = -1;
+    bool owned = false;
+    bool failed = false;
+    int frameWidth = 0, frameHeight = 0;
+    std::vector<uint8_t> yuv;
+    Stats stats;
+};
+
+#endif
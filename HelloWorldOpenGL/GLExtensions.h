@@ -0,0 +1,163 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+/*******************************************************************************************************************************
+Entry points newer than our GLAD loader
+*******************************************************************************************************************************/
+/* glad.c was generated for core 4.0 without extensions, so anything from 4.1+ or from an extension has to be looked up
+   by hand. Each feature gets a flag; only call its functions when the flag is set.
+   Call loadGLExtensions() once, right after gladLoadGLLoader, with the context current. */
+
+/* GL 4.1 / ARB_get_program_binary */
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+
+typedef void (APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+
+/* KHR_parallel_shader_compile (ARB_parallel_shader_compile uses the same enum values) */
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+
+typedef void (APIENTRYP PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)(GLuint count);
+
+/* GL 4.4 / ARB_buffer_storage */
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+/* GL 4.2 / ARB_texture_storage */
+typedef void (APIENTRYP PFNGLTEXSTORAGE2DPROC)(GLenum target, GLsizei levels, GLenum internalformat, GLsizei width, GLsizei height);
+
+/* Compressed texture formats. RGTC (BC4/BC5) is core since 3.0 and already in glad.h.
+   EXT_texture_compression_s3tc (BC1-BC3) never became core, but every desktop driver has it. */
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+/* GL 4.2 / ARB_texture_compression_bptc (BC7) */
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+/* GL 4.3 / ARB_ES3_compatibility (ETC2; desktop drivers often decompress it on upload) */
+#define GL_COMPRESSED_RGB8_ETC2 0x9274
+
+/* GL 4.3 / ARB_shader_storage_buffer_object. Bound with the core glBindBufferRange, so there's nothing to load. */
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#define GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT 0x90DF
+
+/* GL 4.3 / ARB_multi_draw_indirect. The commands' baseInstance field also needs GL 4.2 / ARB_base_instance. */
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+
+/* ARB_bindless_texture (never core) */
+typedef GLuint64 (APIENTRYP PFNGLGETTEXTUREHANDLEARBPROC)(GLuint texture);
+typedef void (APIENTRYP PFNGLMAKETEXTUREHANDLERESIDENTARBPROC)(GLuint64 handle);
+typedef void (APIENTRYP PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC)(GLuint64 handle);
+
+struct GLExtensions
+{
+    int major = 0;
+    int minor = 0;
+
+    bool programBinary = false;
+    PFNGLGETPROGRAMBINARYPROC GetProgramBinary = NULL;
+    PFNGLPROGRAMBINARYPROC ProgramBinary = NULL;
+    PFNGLPROGRAMPARAMETERIPROC ProgramParameteri = NULL;
+
+    bool parallelShaderCompile = false;
+    PFNGLMAXSHADERCOMPILERTHREADSKHRPROC MaxShaderCompilerThreads = NULL;
+
+    bool bufferStorage = false;
+    PFNGLBUFFERSTORAGEPROC BufferStorage = NULL;
+
+    bool textureStorage = false;
+    PFNGLTEXSTORAGE2DPROC TexStorage2D = NULL;
+
+    bool textureCompressionS3tc = false;
+    bool textureCompressionBptc = false;
+    bool textureCompressionEtc2 = false;
+
+    bool shaderStorageBuffer = false;
+
+    bool multiDrawIndirect = false;
+    PFNGLMULTIDRAWELEMENTSINDIRECTPROC MultiDrawElementsIndirect = NULL;
+
+    bool bindlessTexture = false;
+    PFNGLGETTEXTUREHANDLEARBPROC GetTextureHandle = NULL;
+    PFNGLMAKETEXTUREHANDLERESIDENTARBPROC MakeTextureHandleResident = NULL;
+    PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC MakeTextureHandleNonResident = NULL;
+
+    bool atLeast(int wantMajor, int wantMinor) const
+    {
+        return major > wantMajor || (major == wantMajor && minor >= wantMinor);
+    }
+};
+
+inline GLExtensions glext;
+
+template <typename T>
+inline T loadGLProc(const char* name)
+{
+    return (T)glfwGetProcAddress(name);
+}
+
+inline void loadGLExtensions()
+{
+    glGetIntegerv(GL_MAJOR_VERSION, &glext.major);
+    glGetIntegerv(GL_MINOR_VERSION, &glext.minor);
+
+    if (glext.atLeast(4, 1) || glfwExtensionSupported("GL_ARB_get_program_binary"))
+    {
+        glext.GetProgramBinary = loadGLProc<PFNGLGETPROGRAMBINARYPROC>("glGetProgramBinary");
+        glext.ProgramBinary = loadGLProc<PFNGLPROGRAMBINARYPROC>("glProgramBinary");
+        glext.ProgramParameteri = loadGLProc<PFNGLPROGRAMPARAMETERIPROC>("glProgramParameteri");
+
+        /* A driver may advertise the feature but support zero binary formats, in which case saving is pointless */
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        glext.programBinary = glext.GetProgramBinary && glext.ProgramBinary && glext.ProgramParameteri && formats > 0;
+    }
+
+    if (glfwExtensionSupported("GL_KHR_parallel_shader_compile"))
+        glext.MaxShaderCompilerThreads = loadGLProc<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>("glMaxShaderCompilerThreadsKHR");
+    else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile"))
+        glext.MaxShaderCompilerThreads = loadGLProc<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>("glMaxShaderCompilerThreadsARB");
+    glext.parallelShaderCompile = glext.MaxShaderCompilerThreads != NULL;
+
+    if (glext.atLeast(4, 4) || glfwExtensionSupported("GL_ARB_buffer_storage"))
+        glext.BufferStorage = loadGLProc<PFNGLBUFFERSTORAGEPROC>("glBufferStorage");
+    glext.bufferStorage = glext.BufferStorage != NULL;
+
+    if (glext.atLeast(4, 2) || glfwExtensionSupported("GL_ARB_texture_storage"))
+        glext.TexStorage2D = loadGLProc<PFNGLTEXSTORAGE2DPROC>("glTexStorage2D");
+    glext.textureStorage = glext.TexStorage2D != NULL;
+
+    glext.textureCompressionS3tc = glfwExtensionSupported("GL_EXT_texture_compression_s3tc") != 0;
+    glext.textureCompressionBptc = glext.atLeast(4, 2) || glfwExtensionSupported("GL_ARB_texture_compression_bptc");
+    glext.textureCompressionEtc2 = glext.atLeast(4, 3) || glfwExtensionSupported("GL_ARB_ES3_compatibility");
+    glext.shaderStorageBuffer =
+        glext.atLeast(4, 3) || glfwExtensionSupported("GL_ARB_shader_storage_buffer_object");
+
+    const bool baseInstance = glext.atLeast(4, 2) || glfwExtensionSupported("GL_ARB_base_instance");
+    if (baseInstance && (glext.atLeast(4, 3) || glfwExtensionSupported("GL_ARB_multi_draw_indirect")))
+        glext.MultiDrawElementsIndirect = loadGLProc<PFNGLMULTIDRAWELEMENTSINDIRECTPROC>("glMultiDrawElementsIndirect");
+    glext.multiDrawIndirect = glext.MultiDrawElementsIndirect != NULL;
+
+    if (glfwExtensionSupported("GL_ARB_bindless_texture"))
+    {
+        glext.GetTextureHandle = loadGLProc<PFNGLGETTEXTUREHANDLEARBPROC>("glGetTextureHandleARB");
+        glext.MakeTextureHandleResident =
+            loadGLProc<PFNGLMAKETEXTUREHANDLERESIDENTARBPROC>("glMakeTextureHandleResidentARB");
+        glext.MakeTextureHandleNonResident =
+            loadGLProc<PFNGLMAKETEXTUREHANDLENONRESIDENTARBPROC>("glMakeTextureHandleNonResidentARB");
+    }
+    glext.bindlessTexture =
+        glext.GetTextureHandle && glext.MakeTextureHandleResident && glext.MakeTextureHandleNonResident;
+}
+
+#endif
@@ -0,0 +1,271 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/glad.h>
+
+#include "GLExtensions.h"
+
+#include <cstddef>
+
+/*******************************************************************************************************************************
+GL state cache
+*******************************************************************************************************************************/
+/* Every GL call costs driver time even if it sets what is already set (e.g. glUseProgram with the program that is
+   already in use). This remembers the last value we set for the state we touch a lot and skips calls that wouldn't
+   change anything. It only knows about calls made through it, so code that changes state behind its back must call
+   invalidate() afterwards.
+
+   Counters are per frame: read them with counters() and clear them with resetCounters() at the end of each frame. */
+struct GLStateCounters
+{
+    unsigned int issued = 0;  // state calls that reached GL
+    unsigned int elided = 0;  // state calls we skipped because nothing changed
+    unsigned int draws = 0;   // glDraw* calls
+};
+
+class GLStateCache
+{
+public:
+    static const unsigned int MaxTextureUnits = 32;
+    static const unsigned int MaxUniformBindings = 16;
+
+    GLStateCache() { invalidate(); }
+
+    /* Forget everything we know; the next call of each kind goes to GL */
+    void invalidate()
+    {
+        program = Unknown;
+        vertexArray = Unknown;
+        arrayBuffer = Unknown;
+        uniformBuffer = Unknown;
+        activeUnit = Unknown;
+        for (unsigned int unit = 0; unit < MaxTextureUnits; unit++)
+            textures[unit] = Textures();
+        for (unsigned int index = 0; index < MaxUniformBindings; index++)
+            uniformBindings[index] = BufferRange();
+        blend = Flag::Unknown;
+        blendSrc = blendDst = Unknown;
+        depthTest = Flag::Unknown;
+        depthMask = Flag::Unknown;
+        depthFunc = Unknown;
+    }
+
+    void useProgram(unsigned int id)
+    {
+        if (changed(program, id))
+            glUseProgram(id);
+    }
+
+    /* The element array binding is part of the VAO, so it is cached per VAO by GL itself; we only track the VAO */
+    void bindVertexArray(unsigned int id)
+    {
+        if (changed(vertexArray, id))
+            glBindVertexArray(id);
+    }
+
+    void bindBuffer(GLenum target, unsigned int id)
+    {
+        unsigned int* slot = bufferSlot(target);
+        if (!slot)
+        {
+            glBindBuffer(target, id); // A target we don't track; always forward
+            frameCounters.issued++;
+            return;
+        }
+        if (changed(*slot, id))
+            glBindBuffer(target, id);
+    }
+
+    /* A range of a buffer on an indexed binding point. Only uniform buffer bindings are cached; like GL, this
+       also changes the target's generic binding. */
+    void bindBufferRange(GLenum target, unsigned int index, unsigned int id, size_t offset, size_t size)
+    {
+        if (target == GL_UNIFORM_BUFFER && index < MaxUniformBindings)
+        {
+            BufferRange& bound = uniformBindings[index];
+            if (bound.id == id && bound.offset == offset && bound.size == size)
+            {
+                frameCounters.elided++;
+                return;
+            }
+            bound.id = id;
+            bound.offset = offset;
+            bound.size = size;
+        }
+        glBindBufferRange(target, index, id, (GLintptr)offset, (GLsizeiptr)size);
+        frameCounters.issued++;
+        if (unsigned int* slot = bufferSlot(target))
+            *slot = id;
+    }
+
+    /* Call after glDeleteBuffers/glDeleteVertexArrays/... so a recycled name isn't mistaken for the old binding */
+    void forgetBuffer(unsigned int id)
+    {
+        if (arrayBuffer == id) arrayBuffer = Unknown;
+        if (uniformBuffer == id) uniformBuffer = Unknown;
+        for (BufferRange& bound : uniformBindings)
+            if (bound.id == id) bound = BufferRange();
+    }
+    void forgetVertexArray(unsigned int id) { if (vertexArray == id) vertexArray = Unknown; }
+    void forgetProgram(unsigned int id) { if (program == id) program = Unknown; }
+    void forgetTexture(unsigned int id)
+    {
+        for (Textures& bound : textures)
+        {
+            if (bound.texture2D == id) bound.texture2D = Unknown;
+            if (bound.texture2DArray == id) bound.texture2DArray = Unknown;
+        }
+    }
+
+    void bindTexture(unsigned int unit, GLenum target, unsigned int id)
+    {
+        Textures& bound = textures[unit];
+        unsigned int& slot = target == GL_TEXTURE_2D_ARRAY ? bound.texture2DArray : bound.texture2D;
+        if (slot == id)
+        {
+            frameCounters.elided++;
+            return;
+        }
+        setActiveUnit(unit);
+        glBindTexture(target, id);
+        slot = id;
+        frameCounters.issued++;
+    }
+
+    void setBlend(bool enabled)
+    {
+        if (changed(blend, enabled ? Flag::On : Flag::Off))
+            enabled ? glEnable(GL_BLEND) : glDisable(GL_BLEND);
+    }
+
+    void setBlendFunc(GLenum src, GLenum dst)
+    {
+        if (blendSrc == src && blendDst == dst)
+        {
+            frameCounters.elided++;
+            return;
+        }
+        blendSrc = src;
+        blendDst = dst;
+        glBlendFunc(src, dst);
+        frameCounters.issued++;
+    }
+
+    void setDepthTest(bool enabled)
+    {
+        if (changed(depthTest, enabled ? Flag::On : Flag::Off))
+            enabled ? glEnable(GL_DEPTH_TEST) : glDisable(GL_DEPTH_TEST);
+    }
+
+    void setDepthMask(bool write)
+    {
+        if (changed(depthMask, write ? Flag::On : Flag::Off))
+            glDepthMask(write ? GL_TRUE : GL_FALSE);
+    }
+
+    void setDepthFunc(GLenum func)
+    {
+        if (changed(depthFunc, func))
+            glDepthFunc(func);
+    }
+
+    /* Draw calls go through here only so they can be counted */
+    void drawElements(GLenum mode, GLsizei count, GLenum type, const void* offset)
+    {
+        glDrawElements(mode, count, type, offset);
+        frameCounters.draws++;
+    }
+
+    void drawElementsInstanced(GLenum mode, GLsizei count, GLenum type, const void* offset, GLsizei instances)
+    {
+        glDrawElementsInstanced(mode, count, type, offset, instances);
+        frameCounters.draws++;
+    }
+
+    void drawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, const void* offset, GLint baseVertex)
+    {
+        glDrawElementsBaseVertex(mode, count, type, offset, baseVertex);
+        frameCounters.draws++;
+    }
+
+    /* One call however many commands it carries; only when glext.multiDrawIndirect is set */
+    void multiDrawElementsIndirect(GLenum mode, GLenum type, const void* offset, GLsizei drawCount)
+    {
+        glext.MultiDrawElementsIndirect(mode, type, offset, drawCount, 0);
+        frameCounters.draws++;
+    }
+
+    const GLStateCounters& counters() const { return frameCounters; }
+    void resetCounters() { frameCounters = GLStateCounters(); }
+
+private:
+    static const unsigned int Unknown = 0xFFFFFFFFu;
+    enum class Flag { Unknown, Off, On };
+
+    struct Textures
+    {
+        unsigned int texture2D = Unknown;
+        unsigned int texture2DArray = Unknown;
+    };
+
+    struct BufferRange
+    {
+        unsigned int id = Unknown;
+        size_t offset = 0;
+        size_t size = 0;
+    };
+
+    /* Updates the cached value and the counters. True means the caller has to issue the GL call */
+    template <typename T>
+    bool changed(T& cached, T wanted)
+    {
+        if (cached == wanted)
+        {
+            frameCounters.elided++;
+            return false;
+        }
+        cached = wanted;
+        frameCounters.issued++;
+        return true;
+    }
+
+    unsigned int* bufferSlot(GLenum target)
+    {
+        switch (target)
+        {
+        case GL_ARRAY_BUFFER: return &arrayBuffer;
+        case GL_UNIFORM_BUFFER: return &uniformBuffer;
+        default: return 0;
+        }
+    }
+
+    void setActiveUnit(unsigned int unit)
+    {
+        if (activeUnit != unit)
+        {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            activeUnit = unit;
+            frameCounters.issued++;
+        }
+    }
+
+    unsigned int program;
+    unsigned int vertexArray;
+    unsigned int arrayBuffer;
+    unsigned int uniformBuffer;
+    unsigned int activeUnit;
+    Textures textures[MaxTextureUnits];
+    BufferRange uniformBindings[MaxUniformBindings];
+    Flag blend;
+    GLenum blendSrc, blendDst;
+    Flag depthTest;
+    Flag depthMask;
+    GLenum depthFunc;
+
+    GLStateCounters frameCounters;
+};
+
+/* One context, one cache */
+inline GLStateCache glState;
+
+#endif
@@ -0,0 +1,236 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+/*******************************************************************************************************************************
+GPU timer queries
+*******************************************************************************************************************************/
+/* glfwGetTime around a glDrawElements call only measures how long it takes to *queue* the draw; the GPU runs it later.
+   To time the GPU side we ask it to write a timestamp (glQueryCounter(GL_TIMESTAMP)) at the start and end of each
+   named scope. Timestamps rather than GL_TIME_ELAPSED queries because elapsed queries can't be nested or overlap.
+
+   Reading a query result before the GPU got there blocks until it does, so queries are recycled through a ring
+   FramesInFlight frames deep: the results read in beginFrame() belong to a frame the GPU finished long ago. If one is
+   somehow still not available we drop that frame's samples instead of waiting.
+
+       profiler.beginFrame();
+       { GpuScope scope(profiler, "draw"); ...GL calls... }
+       profiler.endFrame();
+       profiler.report(std::cout);   // min / avg / p99 per scope, in milliseconds
+
+   Scopes are identified by name; use string literals or other strings that outlive the profiler. */
+class GpuProfiler
+{
+public:
+    static const unsigned int FramesInFlight = 5;
+    static const size_t MaxSamples = 4096; // p99 is computed over the most recent samples
+
+    struct ScopeStats
+    {
+        double minMs = 0.0;
+        double avgMs = 0.0;
+        double p99Ms = 0.0;
+        size_t count = 0;
+    };
+
+    GpuProfiler() {}
+
+    ~GpuProfiler()
+    {
+        for (Frame& frame : frames)
+            if (!frame.queries.empty())
+                glDeleteQueries((GLsizei)frame.queries.size(), frame.queries.data());
+    }
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    void beginFrame()
+    {
+        current = (current + 1) % FramesInFlight;
+        collect(frames[current]);
+        frames[current].used = 0;
+        frames[current].scopes.clear();
+        inFrame = true;
+    }
+
+    void endFrame() { inFrame = false; }
+
+    /* Prefer GpuScope over calling these directly */
+    size_t beginScope(const char* name)
+    {
+        if (!inFrame)
+            return NoScope;
+        Frame& frame = frames[current];
+        PendingScope scope;
+        scope.name = name;
+        scope.begin = nextQuery(frame);
+        scope.end = 0;
+        glQueryCounter(scope.begin, GL_TIMESTAMP);
+        frame.scopes.push_back(scope);
+        return frame.scopes.size() - 1;
+    }
+
+    void endScope(size_t handle)
+    {
+        if (handle == NoScope || !inFrame)
+            return;
+        Frame& frame = frames[current];
+        frame.scopes[handle].end = nextQuery(frame);
+        glQueryCounter(frame.scopes[handle].end, GL_TIMESTAMP);
+    }
+
+    /* NULL until the scope has produced at least one result */
+    const ScopeStats* stats(const std::string& name)
+    {
+        std::map<std::string, Scope>::iterator found = scopes.find(name);
+        if (found == scopes.end() || found->second.count == 0)
+            return NULL;
+        summarize(found->second);
+        return &found->second.summary;
+    }
+
+    unsigned int droppedFrames() const { return dropped; }
+
+    void report(std::ostream& out)
+    {
+        out << "GPU scopes (ms):" << std::endl;
+        for (std::map<std::string, Scope>::iterator it = scopes.begin(); it != scopes.end(); ++it)
+        {
+            summarize(it->second);
+            const ScopeStats& s = it->second.summary;
+            out << "  " << it->first << ": min " << s.minMs << " avg " << s.avgMs << " p99 " << s.p99Ms << " (" << s.count
+                << " samples)" << std::endl;
+        }
+        if (dropped)
+            out << "  " << dropped << " frame(s) dropped because their results weren't ready yet" << std::endl;
+    }
+
+    static const size_t NoScope = (size_t)-1;
+
+private:
+    struct PendingScope
+    {
+        const char* name;
+        GLuint begin;
+        GLuint end;
+    };
+
+    struct Frame
+    {
+        std::vector<GLuint> queries;
+        size_t used = 0;
+        std::vector<PendingScope> scopes;
+    };
+
+    struct Scope
+    {
+        double minMs = 1e30;
+        double totalMs = 0.0;
+        size_t count = 0;
+        std::vector<double> recent; // ring of the last MaxSamples samples
+        ScopeStats summary;
+    };
+
+    GLuint nextQuery(Frame& frame)
+    {
+        if (frame.used == frame.queries.size())
+        {
+            /* Grow in chunks; queries are kept for the life of the profiler */
+            const size_t oldSize = frame.queries.size();
+            frame.queries.resize(oldSize + 16);
+            glGenQueries(16, &frame.queries[oldSize]);
+        }
+        return frame.queries[frame.used++];
+    }
+
+    void collect(Frame& frame)
+    {
+        if (frame.scopes.empty())
+            return;
+
+        /* The last query written is the last one to become available; if it isn't, don't wait for any of them */
+        GLint available = 0;
+        glGetQueryObjectiv(frame.queries[frame.used - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+        {
+            dropped++;
+            return;
+        }
+
+        for (const PendingScope& pending : frame.scopes)
+        {
+            if (!pending.end)
+                continue; // Scope was never closed
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(pending.begin, GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(pending.end, GL_QUERY_RESULT, &end);
+            add(scopes[pending.name], (double)(end - begin) / 1e6);
+        }
+    }
+
+    static void add(Scope& scope, double ms)
+    {
+        scope.minMs = std::min(scope.minMs, ms);
+        scope.totalMs += ms;
+        if (scope.recent.size() < MaxSamples)
+            scope.recent.push_back(ms);
+        else
+            scope.recent[scope.count % MaxSamples] = ms;
+        scope.count++;
+    }
+
+    static void summarize(Scope& scope)
+    {
+        ScopeStats& s = scope.summary;
+        s.count = scope.count;
+        if (scope.count == 0)
+            return;
+        s.minMs = scope.minMs;
+        s.avgMs = scope.totalMs / (double)scope.count;
+
+        std::vector<double> sorted(scope.recent);
+        const size_t rank = std::min(sorted.size() - 1, (size_t)(0.99 * (double)(sorted.size() - 1) + 0.5));
+        std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+        s.p99Ms = sorted[rank];
+    }
+
+    Frame frames[FramesInFlight];
+    unsigned int current = FramesInFlight - 1;
+    bool inFrame = false;
+    unsigned int dropped = 0;
+    std::map<std::string, Scope> scopes;
+};
+
+/* Times everything issued between its construction and destruction */
+class GpuScope
+{
+public:
+    GpuScope(GpuProfiler& profiler, const char* name)
+        : profiler(profiler), handle(profiler.beginScope(name)) {}
+    ~GpuScope() { end(); }
+
+    /* Ends the scope early, e.g. before the end of a loop body; the destructor then does nothing */
+    void end()
+    {
+        profiler.endScope(handle);
+        handle = GpuProfiler::NoScope;
+    }
+
+    GpuScope(const GpuScope&) = delete;
+    GpuScope& operator=(const GpuScope&) = delete;
+
+private:
+    GpuProfiler& profiler;
+    size_t handle;
+};
+
+#endif
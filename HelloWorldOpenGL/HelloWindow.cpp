@@ -1,46 +1,87 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+#include "BatchRenderer.h"
+#include "CommandList.h"
+#include "Culling.h"
+#include "FrameCapture.h"
+#include "FrameStats.h"
+#include "FrameStream.h"
+#include "GLExtensions.h"
+#include "FramePacer.h"
+#include "GLState.h"
+#include "GpuProfiler.h"
+#include "MeshFile.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "OcclusionCulling.h"
+#include "ProgramCache.h"
+#include "RenderGraph.h"
+#include "ShaderHotReload.h"
+#include "ShaderPipeline.h"
+#include "Simulation.h"
+#include "TextureFile.h"
+#include "TextureStreamer.h"
+#include "ThreadPool.h"
+#include "UniformBuffer.h"
+#include "VertexPacking.h"
+#include "RunOptions.h"
+
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <memory>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
-void processInput(GLFWwindow* window);
+void processInput(GLFWwindow* window, Simulation* simulation = NULL);
 
 /******************************************************************************************************************************* 
 Shaders written in GLSL
 *******************************************************************************************************************************/
 
-/* Vertex shader */
-const char* vertexShaderSource = 
-"#version 330 core\n" // Version declaration
-
-/* Declare all input vertex attributes in vertex shader with "in" keyword */
-/* Right now all we care about position, so we only need a single vertex attribute */
-"layout (location = 0) in vec3 aPos;\n" 
-
-"void main()\n"
-"{\n"
-/* To set the output of the vertex shader we have to assign the position data to the predefined gl_Position variable*/
-/* gl_Position is a vec4 behind the scenes. As such, we have to cast our input(vec3) to vec4*/
-"   gl_Position = vec4(aPos.x, aPos.y, aPos.z, 1.0);\n" 
-"}\0";
-
-/* Fragment shader */
-/* For color! */
-const char* fragmentShaderSource = 
-"#version 330 core\n"
-"out vec4 FragColor;\n"
-"void main()\n"
-"{\n"
-"   FragColor = vec4(1.0f, 0.5f, 0.2f, 1.0f);\n" // Represented in RGBA
-"}\n\0";
+/* The vertex and fragment shader used to be string literals here. They now live in shaders/hello.vert and
+   shaders/hello.frag (--shaders DIR), so editing them doesn't need a rebuild - and with --hot-reload, not even a
+   restart (see ShaderHotReload.h). */
+const char* const vertexShaderFile = "hello.vert";
+const char* const fragmentShaderFile = "hello.frag";
+
+/* The same rectangle with texture coordinates, for --texture */
+const char* const texturedVertexShaderFile = "textured.vert";
+const char* const texturedFragmentShaderFile = "textured.frag";
+
+/* --uniform-buffer: --draws take their positions from uniform blocks instead of glUniform (UniformBuffer.h). The
+   blocks below are what hello_blocks.vert has to declare; that is checked once the program is linked. */
+const char* const blocksVertexShaderFile = "hello_blocks.vert";
+
+#define FRAME_UNIFORMS(MEMBER) \
+    MEMBER(vec4, camera)        // xy = the point in the middle of the window
+HELLO_UNIFORM_BLOCK(FrameUniforms, Std140, FRAME_UNIFORMS);
+
+#define DRAW_UNIFORMS(MEMBER) \
+    MEMBER(vec4, position)      // xy = where the rectangle's centre is in the world
+HELLO_UNIFORM_BLOCK(DrawUniforms, Std140, DRAW_UNIFORMS);
+
+const unsigned int FrameUniformBinding = 0;
+const unsigned int DrawUniformBinding = 1;
 
 /*******************************************************************************************************************************
 End shaders written in GLSL
 *******************************************************************************************************************************/
 
-int main()
+#ifdef HELLO_OSMESA
+/* From glfw3native.h, which would also pull in GL/osmesa.h for types we don't need */
+extern "C" int glfwGetOSMesaColorBuffer(GLFWwindow* window, int* width, int* height, int* format, void** buffer);
+#endif
+
+int main(int argc, char** argv)
 {
+    RunOptions options;
+    if (!parseRunOptions(argc, argv, options))
+        return -1;
+
+    /* --stream -: stdout carries the video, so everything we print goes to stderr */
+    if (options.streamPath == "-")
+        std::cout.rdbuf(std::cerr.rdbuf());
 
     /*******************************************************************************************************************************
     Window setup
@@ -57,6 +98,10 @@ int main()
     /* For Mac OS X */
     //glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 
+    /* Benchmark runs on build boxes have nobody looking at the window */
+    if (options.headless)
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
     /* Create window*/
     GLFWwindow* window = glfwCreateWindow(800, 600, "LearnOpenGL", NULL, NULL);
     if (window == NULL)
@@ -74,6 +119,10 @@ int main()
         std::cout << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    loadGLExtensions(); // Anything newer than GL 4.0 isn't covered by our GLAD loader
+
+    /* Swap interval 0 lets glfwSwapBuffers return as soon as the frame is done instead of waiting for vblank */
+    glfwSwapInterval(options.vsync ? 1 : 0);
     /*******************************************************************************************************************************
     End window setup
     *******************************************************************************************************************************/
@@ -83,63 +132,68 @@ int main()
     /*******************************************************************************************************************************
     Shader operations
     *******************************************************************************************************************************/
-    /* In order for OpenGL to use the shader it has to dynamically compile it at run-time from its source code */
-    unsigned int vertexShader; // vertexShader will be stored as an unsigned int
-    vertexShader = glCreateShader(GL_VERTEX_SHADER); // We provide the type of shader we want to create as an argument.
-
-    /* Attach the shader source to the shader object. */
-    /* Parameters:
-       1: Shader object to compile
-       2: Number of strings we're passing as source code
-       3: Source code
-       4: (Tutorial just says to leave NULL */
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL); 
-
-    /* Compile vertex shader written in GLSL */
-    glCompileShader(vertexShader); 
-
-    /* Check for successful compilation */
-    int success;
-    char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success)
+    /* In order for OpenGL to use the shader it has to dynamically compile it at run-time from its source code.
+       Compiling and linking gets slow once there are many shaders, so the linked program is cached on disk as a driver
+       binary and reused on the next launch when the sources and driver haven't changed (see ProgramCache.h).
+       The compile/link steps themselves live in Shader.h.
+       We only *submit* the program here. Checking whether it compiled makes us wait for the compiler, so that
+       happens after the buffer setup below and the driver gets to compile in the meantime (see ShaderPipeline.h). */
+    ProgramCache programCache(options.shaderCacheDir);
+    ShaderPipeline shaderPipeline(programCache);
+    const std::string vertexShaderPath = options.shaderDir + "/" + vertexShaderFile;
+    const std::string fragmentShaderPath = options.shaderDir + "/" + fragmentShaderFile;
+    std::string vertexShaderSource, fragmentShaderSource;
+    if (!loadShaderFile(vertexShaderPath, vertexShaderSource) || !loadShaderFile(fragmentShaderPath, fragmentShaderSource))
     {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+        glfwTerminate();
+        return -1;
     }
+    ShaderPipeline::Handle helloProgram = shaderPipeline.submit(vertexShaderSource.c_str(), fragmentShaderSource.c_str());
 
-
-    int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success)
+    /* --texture draws the rectangle with a streamed texture once one is available */
+    ShaderPipeline::Handle texturedProgramHandle = 0;
+    if (!options.texturePath.empty())
     {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+        std::string texturedVertexSource, texturedFragmentSource;
+        if (!loadShaderFile(options.shaderDir + "/" + texturedVertexShaderFile, texturedVertexSource) ||
+            !loadShaderFile(options.shaderDir + "/" + texturedFragmentShaderFile, texturedFragmentSource))
+        {
+            glfwTerminate();
+            return -1;
+        }
+        texturedProgramHandle = shaderPipeline.submit(texturedVertexSource.c_str(), texturedFragmentSource.c_str());
     }
 
-    /* Link shaders */
-    unsigned int shaderProgram;
-    shaderProgram = glCreateProgram(); // Returns ID reference
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-    /* Check for linking errors */
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    ShaderPipeline::Handle blocksProgramHandle = 0;
+    if (options.uniformBuffer && options.draws > 0)
+    {
+        std::string blocksVertexSource;
+        if (!loadShaderFile(options.shaderDir + "/" + blocksVertexShaderFile, blocksVertexSource))
+        {
+            glfwTerminate();
+            return -1;
+        }
+        blocksProgramHandle = shaderPipeline.submit(blocksVertexSource.c_str(), fragmentShaderSource.c_str());
     }
 
+    /* --instances N draws N copies of the rectangle with a single instanced draw (see BatchRenderer.h) */
+    ShaderPipeline::Handle instancedProgram = 0;
+    if (options.instances > 0)
+        instancedProgram = shaderPipeline.submit(instancedVertexShaderSource, instancedFragmentShaderSource);
+
+    /* Meshes from files may have quantized positions that the vertex shader has to decode (see Mesh.h) */
+    ShaderPipeline::Handle meshProgramHandle = 0;
+    if (!options.meshPath.empty())
+        meshProgramHandle = shaderPipeline.submit(meshVertexShaderSource, meshFragmentShaderSource);
+
+    /* --lods draws spheres in perspective, so it needs a transform per object (see MeshSimplifier.h) */
+    ShaderPipeline::Handle lodProgramHandle = 0;
+    if (options.lods > 0)
+        lodProgramHandle = shaderPipeline.submit(lodVertexShaderSource, meshFragmentShaderSource);
+
     /* Linking results in a program object we can call like so: 
     glUseProgram(shaderProgram); 
     Every shader and rendering call after glUseProgram will use this program (and, by extension, its shaders) */
-
-    /* Delete shader objects as we no longer need them */
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
     /*******************************************************************************************************************************
     End shader operations
     *******************************************************************************************************************************/
@@ -248,60 +302,640 @@ int main()
     // VAOs requires a call to glBindVertexArray anyways so we generally don't unbind VAOs (nor VBOs) when it's not directly necessary.
     glBindVertexArray(0);
 
+    /* --write-mesh saves the rectangle as a .hmesh file, --mesh draws a .hmesh file instead of the rectangle (see MeshFile.h).
+       --optimize reorders triangles and vertices first (MeshOptimizer.h), --pack uses the compact encodings from VertexPacking.h */
+    if (!options.writeMeshPath.empty())
+    {
+        MeshData rectangle;
+        rectangle.positions.assign(vertices, vertices + 12);
+        rectangle.indices.assign(indices, indices + 6);
+
+        if (options.optimizeMesh)
+            optimizeMesh(rectangle).print(std::cout);
+
+        if (options.packMesh)
+        {
+            PackedMesh packed = packMesh(rectangle);
+            packed.report.print(std::cout);
+            writeMeshFile(options.writeMeshPath, packed.layout, packed.vertices.data(), (uint32_t)packed.vertexCount,
+                          packed.indices.data(), (uint32_t)packed.indexCount, packed.indexType);
+        }
+        else
+        {
+            VertexLayout rectangleLayout;
+            std::vector<float> interleaved = rectangle.interleave(rectangleLayout);
+            writeMeshFile(options.writeMeshPath, rectangleLayout, interleaved.data(), (uint32_t)rectangle.vertexCount(),
+                          rectangle.indices.data(), (uint32_t)rectangle.indices.size(), GL_UNSIGNED_INT);
+        }
+    }
+
+    GpuMesh mesh;
+    if (!options.meshPath.empty())
+    {
+        const double start = glfwGetTime();
+        if (loadMeshFile(options.meshPath, mesh))
+            std::cout << "Loaded " << options.meshPath << " (" << mesh.indexCount / 3 << " triangles) in "
+                      << (glfwGetTime() - start) * 1000.0 << " ms" << std::endl;
+    }
+
     // uncomment this call to draw in wireframe polygons.
-    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    // A texture wouldn't show in wireframe, so --texture draws filled polygons.
+    if (options.texturePath.empty())
+        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
     /*******************************************************************************************************************************
     End buffer operations
     *******************************************************************************************************************************/
 
+    /* First point where we need the program: wait for whatever compilation is still outstanding */
+    shaderPipeline.finish();
+    unsigned int shaderProgram = shaderPipeline.program(helloProgram);
+    GLint offsetLocation = glGetUniformLocation(shaderProgram, "uOffset");
+    unsigned int texturedProgram = 0;
+    GLint texturedOffsetLocation = -1;
+    if (texturedProgramHandle)
+    {
+        texturedProgram = shaderPipeline.program(texturedProgramHandle);
+        texturedOffsetLocation = glGetUniformLocation(texturedProgram, "uOffset");
+        glState.useProgram(texturedProgram);
+        glUniform1i(glGetUniformLocation(texturedProgram, "uTexture"), 0); // Texture unit 0
+    }
+    unsigned int blocksProgram = 0;
+    if (blocksProgramHandle)
+    {
+        blocksProgram = shaderPipeline.program(blocksProgramHandle);
+        if (!bindUniformBlock<FrameUniforms>(blocksProgram, FrameUniformBinding) ||
+            !bindUniformBlock<DrawUniforms>(blocksProgram, DrawUniformBinding))
+        {
+            std::cout << "Falling back to glUniform for --draws" << std::endl;
+            glDeleteProgram(blocksProgram);
+            blocksProgram = 0;
+        }
+    }
+
+    /* --hot-reload: recompile on a background thread whenever the files are saved. The loop below swaps the new
+       program in between frames; it never waits for the compiler. */
+    std::unique_ptr<ShaderReloader> shaderReloader;
+    size_t helloReload = 0;
+    if (options.hotReload)
+    {
+        shaderReloader.reset(new ShaderReloader(window));
+        helloReload = shaderReloader->watch(vertexShaderPath, fragmentShaderPath, shaderProgram);
+        if (!shaderReloader->start())
+            shaderReloader.reset();
+    }
+    MeshProgram meshProgram(mesh.vao ? shaderPipeline.program(meshProgramHandle) : 0);
+
+    std::unique_ptr<BatchRenderer> batch;
+    unsigned int batchProgram = 0;
+    if (options.instances > 0)
+    {
+        batchProgram = shaderPipeline.program(instancedProgram);
+        const size_t perDraw = std::min(options.instances, (size_t)1 << 20);
+        batch.reset(new BatchRenderer(VAO, 6, GL_UNSIGNED_INT, perDraw)); // Adds the instance attributes to our rectangle's VAO
+        fillQuadGrid(*batch, options.instances);
+    }
+    programCache.printReport(std::cout);
+    std::cout << "Shader startup cost on the main thread: " << shaderPipeline.blockingMs() << " ms" << std::endl;
+
 
 
 
     /*******************************************************************************************************************************
     Render loop
     *******************************************************************************************************************************/
-    while (!glfwWindowShouldClose(window))
+    FrameStats stats(options.frames);
+    /* Scopes only record while the profiler is inside a frame, so without --gpu-profile they cost nothing */
+    std::unique_ptr<GpuProfiler> gpuProfiler(new GpuProfiler());
+    std::unique_ptr<FramePacer> pacer;
+    if (options.fps > 0.0)
+        pacer.reset(new FramePacer(options.fps, options.lowLatency));
+
+    /* The simulation ticks on its own thread; the loop below only samples it */
+    std::unique_ptr<Simulation> simulation;
+    if (options.simulationHz > 0.0)
     {
-        // Input
-        processInput(window);
+        simulation.reset(new Simulation(options.simulationHz));
+        simulation->start();
+    }
 
-        // Render
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f); // Set color to clear the screen with
-        glClear(GL_COLOR_BUFFER_BIT); // Clear color buffer and and fill with color specified in glClearColor
+    /* With --draws every rectangle is its own draw call. Working out the draws is spread over the workers, each
+       recording into its own command list; only replaying them touches GL. */
+    std::unique_ptr<ThreadPool> workers;
+    std::vector<CommandList> drawLists;
+    CommandQueue drawQueue;
+
+    /* The rectangles sit on a grid inside the window. With --cull the grid covers a world 8 windows across instead,
+       the camera wanders over it, and only what the BVH finds inside the view gets recorded. */
+    const float worldSize = options.cull ? 8.0f : 1.0f;
+    std::vector<float> objectHome;
+    std::vector<Aabb> objectBoxes;
+    SceneBvh sceneBvh;
+    std::vector<uint32_t> visibleObjects;
+    if (options.draws > 0 || !options.texturePath.empty() || options.lods > 0)
+    {
+        /* One command list per slot, and a queue merges at most CommandQueue::MaxLists of them */
+        const unsigned int threads = options.threads ? options.threads - 1 : ThreadPool::defaultThreads();
+        workers.reset(new ThreadPool(std::min(threads, (unsigned int)CommandQueue::MaxLists - 1)));
+    }
+    if (options.draws > 0)
+    {
+        drawLists.resize(workers->slots());
+
+        const size_t side = (size_t)std::ceil(std::sqrt((double)options.draws));
+        objectHome.resize(options.draws * 2);
+        objectBoxes.resize(options.draws);
+        for (size_t i = 0; i < options.draws; i++)
+        {
+            const float x = (((float)(i % side) + 0.5f) / (float)side - 0.5f) * worldSize;
+            const float y = (((float)(i / side) + 0.5f) / (float)side - 0.5f) * worldSize;
+            objectHome[i * 2] = x;
+            objectHome[i * 2 + 1] = y;
+            objectBoxes[i] = Aabb{ { x - 0.5f, y - 0.5f, 0.0f }, { x + 0.5f, y + 0.5f, 0.0f } }; // The rectangle is 1x1
+        }
+        if (options.cull)
+            sceneBvh.build(objectBoxes);
+    }
+    std::unique_ptr<UniformRing> uniformRing;
+    if (blocksProgram)
+        uniformRing.reset(new UniformRing(sizeof(FrameUniforms) + options.draws * sizeof(DrawUniforms),
+                                          workers->slots())); // Grows on the first frame if blocks need padding
+
+    /* --texture: .htex files from tools/TextureCooker are compressed already and go straight from the mapped file to
+       GL (TextureFile.h). Anything else is decoded by the workers and the loop below uploads a bounded amount of it
+       each frame. */
+    const std::string& texturePath = options.texturePath;
+    GpuTexture cookedTexture;
+    std::unique_ptr<TextureStreamer> textureStreamer;
+    size_t streamedTexture = 0;
+    if (texturePath.size() > 5 && texturePath.compare(texturePath.size() - 5, 5, ".htex") == 0)
+    {
+        const double start = glfwGetTime();
+        if (loadTextureFile(texturePath, cookedTexture))
+            std::cout << "Loaded " << texturePath << " (" << cookedTexture.width << "x" << cookedTexture.height
+                      << ", " << cookedTexture.levels << " levels) in " << (glfwGetTime() - start) * 1000.0 << " ms"
+                      << std::endl;
+    }
+    else if (!texturePath.empty())
+    {
+        const size_t budget = std::max<size_t>((size_t)(options.uploadBudgetMb * 1024.0 * 1024.0), 64 * 1024);
+        textureStreamer.reset(new TextureStreamer(*workers, budget));
+        streamedTexture = textureStreamer->requestFile(options.texturePath);
+    }
+
+    /* --render-graph: the frame goes through off-screen targets, declared anew every frame (RenderGraph.h) */
+    std::unique_ptr<RenderGraph> renderGraph;
+    if (options.renderGraph)
+        renderGraph.reset(new RenderGraph());
+
+    /* --lods N: a dense sphere is simplified into N levels on the workers, then drawn LodSide x LodSide times in rows
+       going away from the camera. Each sphere picks the coarsest level whose error stays under a pixel. */
+    const size_t LodSide = 16;
+    GpuLodMesh lodMesh;
+    std::vector<int> lodLevels; // per sphere, -1 until the first frame picks one
+    size_t lodFrames = 0, lodTriangles = 0, lodSwitches = 0;
+    if (options.lods > 0)
+    {
+        const double start = glfwGetTime();
+        const std::vector<LodLevel> chain = buildLodChain(makeSphereMesh(128, 64), options.lods, workers.get());
+        std::cout << "Built " << chain.size() << " levels of detail in " << (glfwGetTime() - start) * 1000.0
+                  << " ms (triangles/error):";
+        for (const LodLevel& level : chain)
+            std::cout << " " << level.mesh.triangleCount() << "/" << level.error;
+        std::cout << std::endl;
+
+        lodMesh.create(chain);
+        lodLevels.assign(LodSide * LodSide, -1);
+        glState.setDepthTest(true);
+    }
 
-        /* Use the compiled shader program */
-        glUseProgram(shaderProgram);
+    /* --occlusion: two walls across the field, between rows 3 and 4 and rows 8 and 9. They are drawn as stretched
+       cubes and are also the occluders, since a box is already as simple as an occluder gets. */
+    GpuLodMesh wallMesh;
+    std::vector<Aabb> walls, sphereBoxes;
+    std::vector<uint32_t> allSpheres, visibleSpheres;
+    std::unique_ptr<OcclusionCuller> occlusion;
+    size_t occludedSpheres = 0;
+    if (lodMesh.vao && options.occlusion)
+    {
+        wallMesh.create(std::vector<LodLevel>(1, LodLevel{ makeBoxMesh(), 0.0f }));
+        occlusion.reset(new OcclusionCuller());
+        for (float z : { -12.5f, -27.5f })
+        {
+            walls.push_back(Aabb{ { -12.0f, -0.5f, z - 0.25f }, { 12.0f, 1.4f, z + 0.25f } });
+            occlusion->addOccluder(walls.back());
+        }
+        for (uint32_t i = 0; i < (uint32_t)lodLevels.size(); i++)
+        {
+            const float x = ((float)(i % LodSide) - 7.5f) * 1.5f, z = -2.0f - 3.0f * (float)(i / LodSide);
+            sphereBoxes.push_back(Aabb{ { x - 0.5f, -0.5f, z - 0.5f }, { x + 0.5f, 0.5f, z + 0.5f } });
+            allSpheres.push_back(i);
+        }
+    }
+    const unsigned int lodProgram = lodMesh.vao ? shaderPipeline.program(lodProgramHandle) : 0;
+    const GLint lodTransformLocation = lodProgram ? glGetUniformLocation(lodProgram, "uTransform") : -1;
+
+    /* --capture N: every Nth frame is saved without the loop waiting on the readback or the PNG encoder */
+    std::unique_ptr<FrameCapture> frameCapture;
+    if (options.captureEvery > 0)
+        frameCapture.reset(new FrameCapture());
+    unsigned int frameNumber = 0;
+
+    /* --stream PATH: every frame, in order. On OSMesa the frame is in CPU memory already and is taken from there. */
+    std::unique_ptr<FrameStream> frameStream;
+    std::unique_ptr<FrameCapture> streamCapture;
+    bool streamFromOSMesa = false;
+    if (!options.streamPath.empty())
+    {
+        frameStream.reset(new FrameStream(options.streamPath, options.streamRaw ? FrameStream::Raw : FrameStream::Y4m,
+                                          options.fps > 0.0 ? (int)(options.fps + 0.5) : 60));
+        if (frameStream->isOpen())
+            streamCapture.reset(new FrameCapture(frameStream->encoder(), 3, false));
+#ifdef HELLO_OSMESA
+        int format = 0;
+        streamFromOSMesa = glfwGetOSMesaColorBuffer(window, NULL, NULL, &format, NULL) && format == GL_RGBA;
+#endif
+    }
+
+    while (!glfwWindowShouldClose(window))
+    {
+        /* In benchmark mode we stop after a fixed number of frames so runs are comparable */
+        if (options.benchmark() && stats.frames().size() >= options.frames)
+            break;
+
+        /* Sleep until it's time for this frame. In low-latency mode we wake just early enough to render, so
+           events are polled now rather than at the end of the previous frame. */
+        if (pacer)
+        {
+            pacer->wait();
+            if (pacer->isLowLatency())
+                glfwPollEvents();
+        }
+
+        /* Frame boundary: nothing is using the old program any more */
+        if (shaderReloader && shaderReloader->update())
+        {
+            shaderProgram = shaderReloader->program(helloReload);
+            offsetLocation = glGetUniformLocation(shaderProgram, "uOffset");
+        }
+
+        stats.beginFrame();
+        if (options.gpuProfile)
+            gpuProfiler->beginFrame();
 
-        /* We only have a single VAO - no need to bind it every time - but we'll do so to keep things a bit more organized */
-        glBindVertexArray(VAO); 
+        // Input
+        processInput(window, simulation.get());
 
-        /* As opposed to glDrawArrays, glDrawElements indicates we want to render the triangles from an index buffer.
-           We're going to draw using indices provided in the EBO currently bound. This means we have to bind the corresponding EBO 
-           each time we want to render an object with indices. The last EBO that gets bound while is stored as the VAO's EBO.
-           That last sentence seems self-explanetory, but I'm keeping it for completeness. See VertexArrayObjectsEBO for visualization. */
+        /* Texture uploads are counted as part of the frame; the budget keeps them from growing into a hitch */
+        if (textureStreamer)
+        {
+            GpuScope uploadScope(*gpuProfiler, "upload");
+            textureStreamer->update();
+        }
+
+        // Render
+        GpuScope frameScope(*gpuProfiler, "frame");
+        auto renderScene = [&]()
+        {
+            {
+                GpuScope clearScope(*gpuProfiler, "clear");
+                glClearColor(0.2f, 0.3f, 0.3f, 1.0f); // Set color to clear the screen with
+                glClear(GL_COLOR_BUFFER_BIT); // Clear color buffer and and fill with color specified in glClearColor
+                if (lodMesh.vao)
+                    glClear(GL_DEPTH_BUFFER_BIT);
+            }
+
+            GpuScope drawScope(*gpuProfiler, "draw");
+            if (batch)
+                batch->draw(batchProgram);
+            else if (lodMesh.vao)
+            {
+                /* The camera rises a little above the rows and dollies back and forth along them */
+                int width = 0, height = 0;
+                glfwGetFramebufferSize(window, &width, &height);
+                const float fovY = 0.9f;
+                const float cameraZ = 4.0f + 26.0f * (0.5f - 0.5f * std::cos((float)glfwGetTime() * 0.25f));
+                const Mat4 viewProjection =
+                    Mat4::perspective(fovY, (float)width / (float)std::max(height, 1), 0.1f, 200.0f) *
+                    Mat4::translation(0.0f, -1.0f, -cameraZ);
+
+                glState.useProgram(lodProgram);
+                if (occlusion)
+                {
+                    occlusion->render(viewProjection, workers.get());
+                    occlusion->cull(sphereBoxes, allSpheres, visibleSpheres, workers.get());
+                    occludedSpheres += allSpheres.size() - visibleSpheres.size();
+                    for (const Aabb& wall : walls)
+                    {
+                        Mat4 model = Mat4::translation(0.5f * (wall.min[0] + wall.max[0]),
+                                                       0.5f * (wall.min[1] + wall.max[1]),
+                                                       0.5f * (wall.min[2] + wall.max[2]));
+                        for (int axis = 0; axis < 3; axis++)
+                            model.at(axis, axis) = wall.max[axis] - wall.min[axis];
+                        const Mat4 transform = viewProjection * model;
+                        glUniformMatrix4fv(lodTransformLocation, 1, GL_FALSE, transform.m);
+                        wallMesh.draw(0);
+                    }
+                }
+                for (size_t n = 0; n < (occlusion ? visibleSpheres.size() : lodLevels.size()); n++)
+                {
+                    const size_t i = occlusion ? visibleSpheres[n] : n;
+                    const float x = ((float)(i % LodSide) - 7.5f) * 1.5f, z = -2.0f - 3.0f * (float)(i / LodSide);
+                    const float distance = std::sqrt(x * x + 1.0f + (z - cameraZ) * (z - cameraZ));
+                    const int level = selectLod(lodMesh.errors.data(), lodMesh.levelCount(), lodLevels[i],
+                                                pixelsPerUnit(distance, fovY, (float)height));
+                    lodSwitches += lodLevels[i] >= 0 && level != lodLevels[i];
+                    lodLevels[i] = level;
+
+                    const Mat4 transform = viewProjection * Mat4::translation(x, 0.0f, z);
+                    glUniformMatrix4fv(lodTransformLocation, 1, GL_FALSE, transform.m);
+                    lodMesh.draw(level);
+                    lodTriangles += lodMesh.triangles(level);
+                }
+                lodFrames++;
+            }
+            else if (mesh.vao)
+                mesh.draw(meshProgram);
+            else if (options.draws > 0)
+            {
+                const SimState state = simulation ? simulation->sample() : SimState();
+                /* All rectangles are opaque, in one layer and at one depth, so only program and VAO tell keys apart */
+                const uint64_t key = makeSortKey(0, false, shaderProgram, VAO, 0.0f);
+
+                /* Everything follows the simulated offset; with --cull the camera wanders over the world instead */
+                float camera[2] = { -state.position[0], -state.position[1] };
+                size_t drawCount = options.draws;
+                if (options.cull)
+                {
+                    const float time = (float)glfwGetTime();
+                    camera[0] = simulation ? state.position[0] * worldSize : 3.0f * std::sin(time * 0.3f);
+                    camera[1] = simulation ? state.position[1] * worldSize : 3.0f * std::cos(time * 0.2f);
+
+                    /* Every 64th rectangle sways; the BVH only refits the nodes above those */
+                    for (size_t i = 0; i < options.draws; i += 64)
+                    {
+                        const float sway = 0.25f * std::sin(time + (float)i);
+                        objectBoxes[i].min[0] = objectHome[i * 2] + sway - 0.5f;
+                        objectBoxes[i].max[0] = objectHome[i * 2] + sway + 0.5f;
+                        sceneBvh.update((uint32_t)i, objectBoxes[i]);
+                    }
+                    sceneBvh.refit();
+
+                    const Mat4 viewProjection = Mat4::orthographic(-1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f) *
+                                                Mat4::translation(-camera[0], -camera[1], 0.0f);
+                    sceneBvh.cull(Frustum::fromMatrix(viewProjection), visibleObjects);
+                    drawCount = visibleObjects.size();
+                }
+
+                for (CommandList& list : drawLists)
+                    list.clear();
+
+                /* With --uniform-buffer the camera goes in a per-frame block and each draw gets a block with its
+                   position; the ring copies all of them to GL in one go */
+                uint32_t frameBlock = 0;
+                if (uniformRing)
+                {
+                    uniformRing->beginFrame();
+                    FrameUniforms frameUniforms = {};
+                    frameUniforms.camera = { camera[0], camera[1], 0.0f, 0.0f };
+                    frameBlock = uniformRing->writer(0).push(frameUniforms);
+                }
+                const uint64_t blocksKey = makeSortKey(0, false, blocksProgram, VAO, 0.0f);
+
+                workers->parallelFor(drawCount, 1024, [&](size_t begin, size_t end, unsigned int worker)
+                {
+                    CommandList& list = drawLists[worker];
+                    for (size_t n = begin; n < end; n++)
+                    {
+                        const size_t i = options.cull ? visibleObjects[n] : n;
+                        const Aabb& box = objectBoxes[i];
+                        const float x = (box.min[0] + box.max[0]) * 0.5f, y = (box.min[1] + box.max[1]) * 0.5f;
+                        if (uniformRing)
+                        {
+                            DrawUniforms drawUniforms = {};
+                            drawUniforms.position = { x, y, 0.0f, 0.0f };
+                            const uint32_t block = uniformRing->writer(worker).push(drawUniforms);
+                            list.drawWithBlock(blocksKey, (uint32_t)i, blocksProgram, VAO, 6, GL_UNSIGNED_INT, block,
+                                               sizeof(DrawUniforms));
+                            continue;
+                        }
+                        UniformValue offset = { offsetLocation, 2, { x - camera[0], y - camera[1], 0.0f, 0.0f } };
+                        list.draw(key, (uint32_t)i, shaderProgram, VAO, 6, GL_UNSIGNED_INT, 0, &offset, 1);
+                    }
+                });
+
+                if (uniformRing)
+                {
+                    uniformRing->upload();
+                    uniformRing->bind(FrameUniformBinding, 0, frameBlock, sizeof(FrameUniforms));
+                    drawQueue.replay(drawLists.data(), drawLists.size(), uniformRing.get(), DrawUniformBinding);
+                    uniformRing->endFrame();
+                }
+                else
+                    drawQueue.replay(drawLists.data(), drawLists.size());
+            }
+            else
+            {
+                /* Use the compiled shader program */
+                /* State changes go through glState (GLState.h), which skips the GL call when the value is already set */
+                unsigned int texture = cookedTexture.id;
+                if (textureStreamer)
+                    texture = textureStreamer->texture(streamedTexture);
+                glState.useProgram(texture ? texturedProgram : shaderProgram);
+                if (texture)
+                    glState.bindTexture(0, GL_TEXTURE_2D, texture);
+                if (simulation)
+                {
+                    const SimState state = simulation->sample();
+                    glUniform2f(texture ? texturedOffsetLocation : offsetLocation, state.position[0], state.position[1]);
+                }
+
+                /* We only have a single VAO - no need to bind it every time - but we'll do so to keep things a bit more organized.
+                   Thanks to the state cache only the first frame actually reaches the driver. */
+                glState.bindVertexArray(VAO); 
+
+                /* As opposed to glDrawArrays, glDrawElements indicates we want to render the triangles from an index buffer.
+                   We're going to draw using indices provided in the EBO currently bound. This means we have to bind the corresponding EBO 
+                   each time we want to render an object with indices. The last EBO that gets bound while is stored as the VAO's EBO.
+                   That last sentence seems self-explanetory, but I'm keeping it for completeness. See VertexArrayObjectsEBO for visualization. */
       
-        //glDrawArrays(GL_TRIANGLES, 0, 6);
-        /* Parameters:
-           1: Drawing mode
-           2: Number of elements
-           3: Type of indices
-           4: EBO offset */
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0); 
+                //glDrawArrays(GL_TRIANGLES, 0, 6);
+                /* Parameters:
+                   1: Drawing mode
+                   2: Number of elements
+                   3: Type of indices
+                   4: EBO offset */
+                glState.drawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0); 
+            }
+        };
+
+        if (renderGraph)
+        {
+            /* The scene is drawn off-screen and shown with a blurred thumbnail of itself in the top right corner.
+               The blur is just halving the image three times and stretching the result back up. "thumbnail" is
+               the size of "quarter" and only starts after it's done, so the two share a texture. */
+            typedef RenderGraph::Resource Resource;
+            int width = 0, height = 0;
+            glfwGetFramebufferSize(window, &width, &height);
+            width = std::max(8, width);
+            height = std::max(8, height);
+
+            renderGraph->reset();
+            const Resource sceneColor = renderGraph->createTexture("scene color", width, height, GL_RGBA8);
+            const Resource half = renderGraph->createTexture("half", width / 2, height / 2, GL_RGBA8);
+            const Resource quarter = renderGraph->createTexture("quarter", width / 4, height / 4, GL_RGBA8);
+            const Resource eighth = renderGraph->createTexture("eighth", width / 8, height / 8, GL_RGBA8);
+            const Resource thumbnail = renderGraph->createTexture("thumbnail", width / 4, height / 4, GL_RGBA8);
+
+            renderGraph->addPass("scene").write(sceneColor).run([&](RenderGraph::PassContext&) { renderScene(); });
+            renderGraph->addPass("half").read(sceneColor).write(half).run(
+                [=](RenderGraph::PassContext& pass) { pass.blit(sceneColor); });
+            renderGraph->addPass("quarter").read(half).write(quarter).run(
+                [=](RenderGraph::PassContext& pass) { pass.blit(half); });
+            renderGraph->addPass("eighth").read(quarter).write(eighth).run(
+                [=](RenderGraph::PassContext& pass) { pass.blit(quarter); });
+            renderGraph->addPass("thumbnail").read(eighth).write(thumbnail).run(
+                [=](RenderGraph::PassContext& pass) { pass.blit(eighth); });
+            renderGraph->addPass("present")
+                .read(sceneColor)
+                .read(thumbnail)
+                .write(renderGraph->backbuffer(width, height))
+                .run([=](RenderGraph::PassContext& pass)
+                {
+                    pass.blit(sceneColor);
+                    pass.blit(thumbnail, width - width / 4 - 8, height - height / 4 - 8, width / 4, height / 4);
+                });
+
+            if (renderGraph->compile())
+                renderGraph->execute(gpuProfiler.get());
+        }
+        else
+            renderScene();
 
         // glBindVertexArray(0); // no need to unbind it every time 
-
+        frameScope.end();
+        gpuProfiler->endFrame();
+
+        stats.recordState(glState.counters());
+        glState.resetCounters();
+
+        if (frameCapture && frameNumber++ % options.captureEvery == 0)
+        {
+            int width = 0, height = 0;
+            glfwGetFramebufferSize(window, &width, &height);
+            frameCapture->capture(width, height);
+        }
+        if (streamCapture && !streamFromOSMesa)
+        {
+            int width = 0, height = 0;
+            glfwGetFramebufferSize(window, &width, &height);
+            streamCapture->capture(width, height);
+        }
+
+        stats.beginSwap();
         glfwSwapBuffers(window); // Double buffered. Avoid flickering issues common to single buffer
-        glfwPollEvents(); // Check for mouse/keyboard input etc.
+        stats.endFrame();
+#ifdef HELLO_OSMESA
+        if (streamCapture && streamFromOSMesa)
+        {
+            int width = 0, height = 0;
+            void* pixels = NULL;
+            glFinish(); // The software rasterizer may still be working on it
+            if (glfwGetOSMesaColorBuffer(window, &width, &height, NULL, &pixels))
+                streamCapture->captureMemory((const uint8_t*)pixels, width, height);
+        }
+#endif
+        if (pacer)
+            pacer->endFrame();
+
+        if (!pacer || !pacer->isLowLatency())
+            glfwPollEvents(); // Check for mouse/keyboard input etc.
+    }
+
+    if (options.benchmark())
+        stats.printSummary(std::cout);
+    if (!options.statsPath.empty())
+        stats.write(options.statsPath);
+    if (options.gpuProfile)
+        gpuProfiler->report(std::cout);
+    if (pacer)
+        pacer->printSummary(std::cout);
+    if (simulation)
+    {
+        simulation->stop();
+        simulation->printSummary(std::cout);
+    }
+    if (textureStreamer)
+    {
+        textureStreamer->printSummary(std::cout);
+        textureStreamer.reset(); // Deletes its textures and pixel buffer, so it has to go before the context too
+    }
+    if (options.draws > 0)
+        drawQueue.printSummary(std::cout);
+    if (uniformRing)
+    {
+        uniformRing->printSummary(std::cout);
+        uniformRing.reset();
+    }
+    if (renderGraph)
+    {
+        renderGraph->printSummary(std::cout);
+        renderGraph.reset(); // Its targets and framebuffers are GL objects too
     }
+    if (frameCapture)
+    {
+        frameCapture->finish();
+        frameCapture->printSummary(std::cout);
+        frameCapture.reset(); // Its pixel buffers and fences belong to the context
+    }
+    if (streamCapture)
+    {
+        streamCapture->finish();
+        streamCapture->printSummary(std::cout);
+        frameStream->printSummary(std::cout);
+        streamCapture.reset();
+    }
+    frameStream.reset(); // Closing it tells the reader the video is over
+    gpuProfiler.reset(); // Query objects have to go while the context is still alive
     /*******************************************************************************************************************************
     End render loop
     *******************************************************************************************************************************/
 
     /* (Optional) De-allocate all resources once they've outlived their purpose */
+    shaderReloader.reset(); // Stops its thread; shaderProgram is still ours to delete
     glDeleteVertexArrays(1, &VAO);
+    glState.forgetVertexArray(VAO);
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
+    glDeleteProgram(shaderProgram);
+    if (texturedProgram)
+        glDeleteProgram(texturedProgram);
+    if (blocksProgram)
+        glDeleteProgram(blocksProgram);
+    if (cookedTexture.id)
+        cookedTexture.destroy();
+    batch.reset();
+    if (lodMesh.vao)
+    {
+        if (lodFrames > 0)
+            std::cout << "LOD: " << lodTriangles / lodFrames << " triangles per frame instead of "
+                      << (size_t)lodMesh.triangles(0) * lodLevels.size() << ", "
+                      << (double)lodSwitches / (double)lodFrames << " level switches per frame" << std::endl;
+        lodMesh.destroy();
+        if (occlusion && lodFrames > 0)
+            std::cout << "Occlusion: " << (double)occludedSpheres / (double)lodFrames << " of " << lodLevels.size()
+                      << " spheres hidden behind the walls per frame" << std::endl;
+        if (wallMesh.vao)
+            wallMesh.destroy();
+    }
+    if (lodProgram)
+        glDeleteProgram(lodProgram);
+    if (mesh.vao)
+        mesh.destroy();
+    if (meshProgram.id)
+        glDeleteProgram(meshProgram.id);
+    if (batchProgram)
+        glDeleteProgram(batchProgram);
 
     glfwTerminate();
     return 0;
@@ -322,8 +956,19 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 
 
 
-void processInput(GLFWwindow* window)
+void processInput(GLFWwindow* window, Simulation* simulation)
 {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
-}
\ No newline at end of file
+
+    /* Only the main thread may read input, so we pass the key state over to the simulation thread */
+    if (simulation)
+    {
+        uint32_t keys = 0;
+        keys |= glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS ? (uint32_t)Simulation::InputLeft : 0;
+        keys |= glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS ? (uint32_t)Simulation::InputRight : 0;
+        keys |= glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS ? (uint32_t)Simulation::InputUp : 0;
+        keys |= glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS ? (uint32_t)Simulation::InputDown : 0;
+        simulation->setInput(keys);
+    }
+}
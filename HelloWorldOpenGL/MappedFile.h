@@ -0,0 +1,134 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*******************************************************************************************************************************
+Read-only memory-mapped file
+*******************************************************************************************************************************/
+/* Maps a whole file into our address space instead of reading it into a heap buffer. The OS pages data in as it is
+   touched, so handing a pointer into the mapping straight to glBufferData copies the bytes exactly once: from the page
+   cache into the driver. Only meant for big read-only assets (meshes, textures). */
+class MappedFile
+{
+public:
+    MappedFile() {}
+    explicit MappedFile(const std::string& path) { open(path); }
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path)
+    {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+            FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return fail(path);
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+            return fail(path);
+        length = (size_t)fileSize.QuadPart;
+
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!mapping)
+            return fail(path);
+        bytes = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!bytes)
+            return fail(path);
+#else
+        descriptor = ::open(path.c_str(), O_RDONLY);
+        if (descriptor < 0)
+            return fail(path);
+
+        struct stat info;
+        if (fstat(descriptor, &info) != 0 || info.st_size == 0)
+            return fail(path);
+        length = (size_t)info.st_size;
+
+        void* address = mmap(NULL, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (address == MAP_FAILED)
+            return fail(path);
+        bytes = (const uint8_t*)address;
+
+        /* We read front to back exactly once, so ask for aggressive read-ahead */
+        madvise(address, length, MADV_SEQUENTIAL);
+        madvise(address, length, MADV_WILLNEED);
+#endif
+        return true;
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        if (bytes)
+            UnmapViewOfFile(bytes);
+        if (mapping)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (bytes)
+            munmap((void*)bytes, length);
+        if (descriptor >= 0)
+            ::close(descriptor);
+        descriptor = -1;
+#endif
+        bytes = NULL;
+        length = 0;
+    }
+
+    bool isOpen() const { return bytes != NULL; }
+    const uint8_t* data() const { return bytes; }
+    size_t size() const { return length; }
+
+    /* Bounds-checked view into the file, NULL if [offset, offset + count) doesn't fit */
+    const uint8_t* range(uint64_t offset, uint64_t count) const
+    {
+        if (offset > length || count > length - offset)
+            return NULL;
+        return bytes + offset;
+    }
+
+private:
+    bool fail(const std::string& path)
+    {
+        std::cout << "ERROR::MAPPED_FILE::CANNOT_MAP " << path << std::endl;
+        close();
+        return false;
+    }
+
+    const uint8_t* bytes = NULL;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#else
+    int descriptor = -1;
+#endif
+};
+
+#endif
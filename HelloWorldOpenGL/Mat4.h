@@ -0,0 +1,78 @@
+#ifndef MAT4_H
+#define MAT4_H
+
+#include <cmath>
+
+/*******************************************************************************************************************************
+4x4 matrices
+*******************************************************************************************************************************/
+/* Just enough matrix code for cameras and culling. Column-major like GL, so m can be passed straight to
+   glUniformMatrix4fv with transpose = GL_FALSE: element (row, column) is m[column * 4 + row]. */
+struct Mat4
+{
+    float m[16];
+
+    float& at(int row, int column) { return m[column * 4 + row]; }
+    float at(int row, int column) const { return m[column * 4 + row]; }
+
+    static Mat4 identity()
+    {
+        Mat4 r = Mat4();
+        r.at(0, 0) = r.at(1, 1) = r.at(2, 2) = r.at(3, 3) = 1.0f;
+        return r;
+    }
+
+    static Mat4 translation(float x, float y, float z)
+    {
+        Mat4 r = identity();
+        r.at(0, 3) = x;
+        r.at(1, 3) = y;
+        r.at(2, 3) = z;
+        return r;
+    }
+
+    /* Same as glOrtho */
+    static Mat4 orthographic(float left, float right, float bottom, float top, float zNear, float zFar)
+    {
+        Mat4 r = identity();
+        r.at(0, 0) = 2.0f / (right - left);
+        r.at(1, 1) = 2.0f / (top - bottom);
+        r.at(2, 2) = -2.0f / (zFar - zNear);
+        r.at(0, 3) = -(right + left) / (right - left);
+        r.at(1, 3) = -(top + bottom) / (top - bottom);
+        r.at(2, 3) = -(zFar + zNear) / (zFar - zNear);
+        return r;
+    }
+
+    /* Same as gluPerspective; fovY in radians. The camera looks down -z. */
+    static Mat4 perspective(float fovY, float aspect, float zNear, float zFar)
+    {
+        const float f = 1.0f / std::tan(fovY * 0.5f);
+        Mat4 r = Mat4();
+        r.at(0, 0) = f / aspect;
+        r.at(1, 1) = f;
+        r.at(2, 2) = (zFar + zNear) / (zNear - zFar);
+        r.at(2, 3) = 2.0f * zFar * zNear / (zNear - zFar);
+        r.at(3, 2) = -1.0f;
+        return r;
+    }
+
+    Mat4 operator*(const Mat4& b) const
+    {
+        Mat4 r;
+        for (int row = 0; row < 4; row++)
+            for (int column = 0; column < 4; column++)
+                r.at(row, column) = at(row, 0) * b.at(0, column) + at(row, 1) * b.at(1, column) +
+                                    at(row, 2) * b.at(2, column) + at(row, 3) * b.at(3, column);
+        return r;
+    }
+
+    /* Transforms the point (x, y, z, 1); out receives x, y, z, w before the perspective divide */
+    void transformPoint(float x, float y, float z, float out[4]) const
+    {
+        for (int row = 0; row < 4; row++)
+            out[row] = at(row, 0) * x + at(row, 1) * y + at(row, 2) * z + at(row, 3);
+    }
+};
+
+#endif
@@ -0,0 +1,298 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <glad/glad.h>
+
+#include "GLState.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*******************************************************************************************************************************
+Vertex layouts and meshes on the GPU
+*******************************************************************************************************************************/
+/* The same information we pass to glVertexAttribPointer in HelloWindow.cpp, but as data so it can be stored in a file
+   (MeshFile.h) or chosen at run time, and applied to any VAO. */
+struct VertexAttribute
+{
+    uint32_t location;    // layout (location = N) in the vertex shader
+    uint32_t components;  // 1-4
+    uint32_t type;        // GL_FLOAT, GL_HALF_FLOAT, GL_SHORT, ...
+    uint32_t normalized;  // GL_TRUE maps integer types to [0,1] / [-1,1]
+    uint32_t offset;      // bytes from the start of the vertex
+};
+
+struct VertexLayout
+{
+    static const uint32_t MaxAttributes = 8;
+
+    uint32_t stride = 0;
+    uint32_t attributeCount = 0;
+    VertexAttribute attributes[MaxAttributes] = {};
+
+    /* Quantized positions (see VertexPacking.h) are stored relative to the mesh bounds. The vertex shader turns them
+       back into model space with position * positionScale + positionOffset; for float positions this is identity. */
+    float positionScale[3] = { 1.0f, 1.0f, 1.0f };
+    float positionOffset[3] = { 0.0f, 0.0f, 0.0f };
+
+    void add(uint32_t location, uint32_t components, uint32_t type, bool normalized, uint32_t offset)
+    {
+        if (attributeCount < MaxAttributes)
+            attributes[attributeCount++] = VertexAttribute{ location, components, type, normalized ? 1u : 0u, offset };
+    }
+
+    /* Points the attributes at the buffer bound to GL_ARRAY_BUFFER, starting baseOffset bytes into it.
+       The VAO to configure must be bound. */
+    void apply(size_t baseOffset = 0) const
+    {
+        for (uint32_t i = 0; i < attributeCount; i++)
+        {
+            const VertexAttribute& a = attributes[i];
+            glVertexAttribPointer(a.location, (GLint)a.components, a.type, a.normalized ? GL_TRUE : GL_FALSE,
+                (GLsizei)stride, (void*)(baseOffset + a.offset));
+            glEnableVertexAttribArray(a.location);
+        }
+    }
+};
+
+/* A mesh on the CPU, one array per attribute. This is what tools and mesh processing passes work on before the data
+   is interleaved and uploaded. normals and uvs may be empty. */
+struct MeshData
+{
+    std::vector<float> positions;  // xyz per vertex
+    std::vector<float> normals;    // xyz per vertex
+    std::vector<float> uvs;        // uv per vertex
+    std::vector<uint32_t> indices; // three per triangle
+
+    size_t vertexCount() const { return positions.size() / 3; }
+    size_t triangleCount() const { return indices.size() / 3; }
+
+    /* Interleaves the attributes as plain floats: position at location 0, normal at 1, uv at 2 */
+    std::vector<float> interleave(VertexLayout& layout) const
+    {
+        const bool hasNormals = !normals.empty();
+        const bool hasUvs = !uvs.empty();
+        const uint32_t floats = 3 + (hasNormals ? 3 : 0) + (hasUvs ? 2 : 0);
+
+        layout = VertexLayout();
+        layout.stride = floats * sizeof(float);
+        layout.add(0, 3, GL_FLOAT, false, 0);
+        if (hasNormals)
+            layout.add(1, 3, GL_FLOAT, false, 3 * sizeof(float));
+        if (hasUvs)
+            layout.add(2, 2, GL_FLOAT, false, (hasNormals ? 6 : 3) * sizeof(float));
+
+        std::vector<float> out;
+        out.reserve(vertexCount() * floats);
+        for (size_t v = 0; v < vertexCount(); v++)
+        {
+            out.insert(out.end(), &positions[v * 3], &positions[v * 3] + 3);
+            if (hasNormals)
+                out.insert(out.end(), &normals[v * 3], &normals[v * 3] + 3);
+            if (hasUvs)
+                out.insert(out.end(), &uvs[v * 2], &uvs[v * 2] + 2);
+        }
+        return out;
+    }
+};
+
+/* A flat (z = 0) grid of columns x rows quads spanning [-1,1]^2, facing +z. Handy as a dense test mesh. */
+inline MeshData makeGridMesh(uint32_t columns, uint32_t rows)
+{
+    MeshData mesh;
+    const uint32_t stride = columns + 1;
+    for (uint32_t y = 0; y <= rows; y++)
+        for (uint32_t x = 0; x <= columns; x++)
+        {
+            const float u = (float)x / (float)columns, v = (float)y / (float)rows;
+            mesh.positions.insert(mesh.positions.end(), { u * 2.0f - 1.0f, v * 2.0f - 1.0f, 0.0f });
+            mesh.normals.insert(mesh.normals.end(), { 0.0f, 0.0f, 1.0f });
+            mesh.uvs.insert(mesh.uvs.end(), { u, v });
+        }
+
+    mesh.indices.reserve((size_t)columns * rows * 6);
+    for (uint32_t y = 0; y < rows; y++)
+        for (uint32_t x = 0; x < columns; x++)
+        {
+            const uint32_t i = y * stride + x;
+            mesh.indices.insert(mesh.indices.end(), { i, i + 1, i + stride, i + 1, i + stride + 1, i + stride });
+        }
+    return mesh;
+}
+
+/* A UV sphere of radius 0.5 with segments around and rings from pole to pole. Unlike the grid it has curvature, so
+   normals and quantization actually matter. */
+inline MeshData makeSphereMesh(uint32_t segments, uint32_t rings)
+{
+    MeshData mesh;
+    const float pi = 3.14159265358979f;
+    for (uint32_t r = 0; r <= rings; r++)
+        for (uint32_t s = 0; s <= segments; s++)
+        {
+            const float u = (float)s / (float)segments, v = (float)r / (float)rings;
+            const float theta = u * 2.0f * pi, phi = v * pi;
+            const float x = std::cos(theta) * std::sin(phi), y = std::cos(phi), z = std::sin(theta) * std::sin(phi);
+            mesh.positions.insert(mesh.positions.end(), { x * 0.5f, y * 0.5f, z * 0.5f });
+            mesh.normals.insert(mesh.normals.end(), { x, y, z });
+            mesh.uvs.insert(mesh.uvs.end(), { u, v });
+        }
+
+    const uint32_t stride = segments + 1;
+    mesh.indices.reserve((size_t)segments * rings * 6);
+    for (uint32_t r = 0; r < rings; r++)
+        for (uint32_t s = 0; s < segments; s++)
+        {
+            const uint32_t i = r * stride + s;
+            mesh.indices.insert(mesh.indices.end(), { i, i + stride, i + 1, i + 1, i + stride, i + stride + 1 });
+        }
+    return mesh;
+}
+
+/* A unit cube centred on the origin, four vertices per face so each face gets its own normal */
+inline MeshData makeBoxMesh()
+{
+    MeshData mesh;
+    for (int face = 0; face < 6; face++)
+    {
+        const int axis = face / 2, u = (axis + 1) % 3, v = (axis + 2) % 3;
+        const float sign = face % 2 ? 1.0f : -1.0f;
+        const uint32_t base = (uint32_t)mesh.vertexCount();
+        for (int corner = 0; corner < 4; corner++)
+        {
+            float position[3], normal[3] = { 0.0f, 0.0f, 0.0f };
+            position[axis] = 0.5f * sign;
+            position[u] = corner & 1 ? 0.5f : -0.5f;
+            position[v] = corner & 2 ? 0.5f : -0.5f;
+            normal[axis] = sign;
+            mesh.positions.insert(mesh.positions.end(), position, position + 3);
+            mesh.normals.insert(mesh.normals.end(), normal, normal + 3);
+            mesh.uvs.insert(mesh.uvs.end(), { corner & 1 ? 1.0f : 0.0f, corner & 2 ? 1.0f : 0.0f });
+        }
+        /* (u, v, axis) is right-handed, so counter-clockwise in u-v faces +axis; flip it for the -axis face */
+        if (sign > 0.0f)
+            mesh.indices.insert(mesh.indices.end(), { base, base + 1, base + 3, base, base + 3, base + 2 });
+        else
+            mesh.indices.insert(mesh.indices.end(), { base, base + 3, base + 1, base, base + 2, base + 3 });
+    }
+    return mesh;
+}
+
+/* Size in bytes of one index of the given GL type */
+inline size_t indexSize(GLenum type)
+{
+    return type == GL_UNSIGNED_BYTE ? 1 : type == GL_UNSIGNED_SHORT ? 2 : 4;
+}
+
+/* Vertex shader for meshes: undoes position quantization and shades by normal so the surface is visible */
+const char* const meshVertexShaderSource =
+"#version 330 core\n"
+"layout (location = 0) in vec3 aPos;\n"
+"layout (location = 1) in vec3 aNormal;\n"
+"uniform vec3 uPositionScale;\n"
+"uniform vec3 uPositionOffset;\n"
+"out vec4 vertexColor;\n"
+"void main()\n"
+"{\n"
+"   gl_Position = vec4(aPos * uPositionScale + uPositionOffset, 1.0);\n"
+"   vertexColor = vec4(normalize(aNormal + vec3(1e-6)) * 0.5 + 0.5, 1.0);\n"
+"}\0";
+
+const char* const meshFragmentShaderSource =
+"#version 330 core\n"
+"in vec4 vertexColor;\n"
+"out vec4 FragColor;\n"
+"void main()\n"
+"{\n"
+"   FragColor = vertexColor;\n"
+"}\n\0";
+
+/* A linked mesh program and the uniforms GpuMesh::draw sets on it */
+struct MeshProgram
+{
+    unsigned int id = 0;
+    GLint positionScale = -1;
+    GLint positionOffset = -1;
+
+    explicit MeshProgram(unsigned int program = 0)
+        : id(program)
+    {
+        if (program)
+        {
+            positionScale = glGetUniformLocation(program, "uPositionScale");
+            positionOffset = glGetUniformLocation(program, "uPositionOffset");
+        }
+    }
+};
+
+/* A VAO with its vertex and index buffers, ready for glDrawElements */
+struct GpuMesh
+{
+    unsigned int vao = 0;
+    unsigned int vbo = 0;
+    unsigned int ebo = 0;
+    GLsizei indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    float positionScale[3] = { 1.0f, 1.0f, 1.0f };
+    float positionOffset[3] = { 0.0f, 0.0f, 0.0f };
+
+    /* Creates the objects and uploads both blobs. Either pointer may be NULL to only allocate the storage. */
+    void create(const VertexLayout& layout, const void* vertices, size_t vertexBytes,
+                const void* indices, size_t indexCount, GLenum type)
+    {
+        this->indexCount = (GLsizei)indexCount;
+        this->indexType = type;
+        setDecode(layout);
+
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &vbo);
+        glGenBuffers(1, &ebo);
+
+        glState.bindVertexArray(vao);
+        glState.bindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)vertexBytes, vertices, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo); // Stored in the VAO
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)(indexCount * indexSize(type)), indices, GL_STATIC_DRAW);
+        layout.apply();
+        glState.bindVertexArray(0);
+    }
+
+    void setDecode(const VertexLayout& layout)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            positionScale[i] = layout.positionScale[i];
+            positionOffset[i] = layout.positionOffset[i];
+        }
+    }
+
+    void draw() const
+    {
+        glState.bindVertexArray(vao);
+        glState.drawElements(GL_TRIANGLES, indexCount, indexType, 0);
+    }
+
+    /* Same, with a MeshProgram so quantized positions get decoded */
+    void draw(const MeshProgram& program) const
+    {
+        glState.useProgram(program.id);
+        if (program.positionScale >= 0)
+            glUniform3fv(program.positionScale, 1, positionScale);
+        if (program.positionOffset >= 0)
+            glUniform3fv(program.positionOffset, 1, positionOffset);
+        draw();
+    }
+
+    void destroy()
+    {
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &vbo);
+        glDeleteBuffers(1, &ebo);
+        glState.forgetVertexArray(vao);
+        glState.forgetBuffer(vbo);
+        vao = vbo = ebo = 0;
+    }
+};
+
+#endif
@@ -0,0 +1,218 @@
+#ifndef MESH_FILE_H
+#define MESH_FILE_H
+
+#include <glad/glad.h>
+
+#include "GLState.h"
+#include "MappedFile.h"
+#include "Mesh.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+/*******************************************************************************************************************************
+Binary mesh files (.hmesh)
+*******************************************************************************************************************************/
+/* A mesh file is laid out exactly the way GL wants the data, so loading is: map the file, check the header, hand the
+   two blobs to the driver. There is no parsing and no intermediate copy.
+
+       MeshFileHeader        magic, counts, vertex layout, where the blobs are
+       padding
+       vertex blob           vertexCount * layout.stride bytes, starts on a MeshFileAlignment boundary
+       padding
+       index blob            indexCount * indexSize(indexType) bytes, starts on a MeshFileAlignment boundary
+
+   All values are little-endian (we only target x86/ARM). Blobs are page aligned so a driver that can DMA straight
+   from the mapping (or the OS, when it pages the file in) never has to deal with a blob straddling a partial page. */
+const uint32_t MeshFileMagic = 0x48534D48; // "HMSH"
+const uint32_t MeshFileVersion = 2; // 2: VertexLayout carries the position decode transform
+const uint64_t MeshFileAlignment = 4096;
+
+struct MeshFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t indexType;     // GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    uint32_t reserved;
+    uint64_t vertexOffset;
+    uint64_t vertexBytes;
+    uint64_t indexOffset;
+    uint64_t indexBytes;
+    VertexLayout layout;
+};
+
+inline uint64_t alignMeshOffset(uint64_t offset)
+{
+    return (offset + MeshFileAlignment - 1) / MeshFileAlignment * MeshFileAlignment;
+}
+
+/* Writes a mesh file. vertices must hold vertexCount * layout.stride bytes, indices indexCount indices of indexType */
+inline bool writeMeshFile(const std::string& path, const VertexLayout& layout, const void* vertices, uint32_t vertexCount,
+                          const void* indices, uint32_t indexCount, GLenum indexType)
+{
+    MeshFileHeader header = MeshFileHeader();
+    header.magic = MeshFileMagic;
+    header.version = MeshFileVersion;
+    header.vertexCount = vertexCount;
+    header.indexCount = indexCount;
+    header.indexType = indexType;
+    header.layout = layout;
+    header.vertexBytes = (uint64_t)vertexCount * layout.stride;
+    header.indexBytes = (uint64_t)indexCount * indexSize(indexType);
+    header.vertexOffset = alignMeshOffset(sizeof(MeshFileHeader));
+    header.indexOffset = alignMeshOffset(header.vertexOffset + header.vertexBytes);
+
+    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        std::cout << "ERROR::MESH_FILE::CANNOT_WRITE " << path << std::endl;
+        return false;
+    }
+
+    static const char zeros[MeshFileAlignment] = {};
+    out.write((const char*)&header, sizeof(header));
+    out.write(zeros, (std::streamsize)(header.vertexOffset - sizeof(header)));
+    out.write((const char*)vertices, (std::streamsize)header.vertexBytes);
+    out.write(zeros, (std::streamsize)(header.indexOffset - header.vertexOffset - header.vertexBytes));
+    out.write((const char*)indices, (std::streamsize)header.indexBytes);
+    return (bool)out;
+}
+
+/* Bytes one vertex takes of an attribute, or 0 if glVertexAttribPointer wouldn't accept its type and components */
+inline uint64_t attributeBytes(const VertexAttribute& attribute)
+{
+    if (attribute.components < 1 || attribute.components > 4)
+        return 0;
+    switch (attribute.type)
+    {
+    case GL_BYTE:
+    case GL_UNSIGNED_BYTE:
+        return attribute.components;
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT:
+    case GL_HALF_FLOAT:
+        return attribute.components * 2u;
+    case GL_INT:
+    case GL_UNSIGNED_INT:
+    case GL_FLOAT:
+        return attribute.components * 4u;
+    case GL_INT_2_10_10_10_REV:
+    case GL_UNSIGNED_INT_2_10_10_10_REV:
+        return attribute.components == 4 ? 4 : 0;
+    default:
+        return 0;
+    }
+}
+
+/* Every attribute has to lie inside the stride, or GL reads past the end of the vertex buffer on the last vertex */
+inline bool validMeshLayout(const VertexLayout& layout)
+{
+    if (layout.attributeCount > VertexLayout::MaxAttributes)
+        return false;
+    for (uint32_t i = 0; i < layout.attributeCount; i++)
+    {
+        const VertexAttribute& attribute = layout.attributes[i];
+        const uint64_t bytes = attributeBytes(attribute);
+        if (bytes == 0 || attribute.location >= 16 || (uint64_t)attribute.offset + bytes > layout.stride)
+            return false;
+    }
+    return true;
+}
+
+/* The largest index in the blob; GL doesn't check indices against the vertex buffer, so an out of range one reads
+   whatever memory follows it */
+inline uint32_t maxMeshIndex(const uint8_t* indices, uint32_t indexCount, GLenum indexType)
+{
+    uint32_t largest = 0;
+    for (uint32_t i = 0; i < indexCount; i++)
+    {
+        uint32_t index;
+        if (indexType == GL_UNSIGNED_BYTE)
+            index = indices[i];
+        else if (indexType == GL_UNSIGNED_SHORT)
+        {
+            uint16_t value;
+            std::memcpy(&value, indices + i * 2u, 2);
+            index = value;
+        }
+        else
+            std::memcpy(&index, indices + i * 4u, 4);
+        largest = std::max(largest, index);
+    }
+    return largest;
+}
+
+/* Copies size bytes into the buffer bound to target. Large blobs go in slices so the driver's staging memory stays
+   small and the page faults on the mapping are spread over the upload instead of happening all at once. */
+inline void uploadMapped(GLenum target, const uint8_t* data, uint64_t size)
+{
+    const uint64_t Slice = 32u << 20;
+    if (size <= Slice)
+    {
+        glBufferData(target, (GLsizeiptr)size, data, GL_STATIC_DRAW);
+        return;
+    }
+
+    glBufferData(target, (GLsizeiptr)size, NULL, GL_STATIC_DRAW);
+    for (uint64_t offset = 0; offset < size; offset += Slice)
+        glBufferSubData(target, (GLintptr)offset, (GLsizeiptr)std::min(Slice, size - offset), data + offset);
+}
+
+/* Maps the file, validates it and uploads it into mesh. Returns false (and prints why) if the file is unusable */
+inline bool loadMeshFile(const std::string& path, GpuMesh& mesh)
+{
+    MappedFile file(path);
+    if (!file.isOpen())
+        return false;
+
+    const MeshFileHeader* header = (const MeshFileHeader*)file.range(0, sizeof(MeshFileHeader));
+    if (!header || header->magic != MeshFileMagic || header->version != MeshFileVersion)
+    {
+        std::cout << "ERROR::MESH_FILE::NOT_A_MESH_FILE " << path << std::endl;
+        return false;
+    }
+
+    const VertexLayout& layout = header->layout;
+    const bool validIndexType = header->indexType == GL_UNSIGNED_BYTE || header->indexType == GL_UNSIGNED_SHORT ||
+                                header->indexType == GL_UNSIGNED_INT;
+    const uint8_t* vertices = file.range(header->vertexOffset, header->vertexBytes);
+    const uint8_t* indices = file.range(header->indexOffset, header->indexBytes);
+    if (!vertices || !indices || !validIndexType || !validMeshLayout(layout) ||
+        header->vertexBytes != (uint64_t)header->vertexCount * layout.stride ||
+        header->indexBytes != (uint64_t)header->indexCount * indexSize(header->indexType))
+    {
+        std::cout << "ERROR::MESH_FILE::CORRUPT " << path << std::endl;
+        return false;
+    }
+    if (header->indexCount && maxMeshIndex(indices, header->indexCount, header->indexType) >= header->vertexCount)
+    {
+        std::cout << "ERROR::MESH_FILE::INDEX_OUT_OF_RANGE " << path << std::endl;
+        return false;
+    }
+
+    mesh.indexCount = (GLsizei)header->indexCount;
+    mesh.indexType = header->indexType;
+    mesh.setDecode(layout);
+    glGenVertexArrays(1, &mesh.vao);
+    glGenBuffers(1, &mesh.vbo);
+    glGenBuffers(1, &mesh.ebo);
+
+    glState.bindVertexArray(mesh.vao);
+    glState.bindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+    uploadMapped(GL_ARRAY_BUFFER, vertices, header->vertexBytes);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo); // Stored in the VAO
+    uploadMapped(GL_ELEMENT_ARRAY_BUFFER, indices, header->indexBytes);
+    layout.apply();
+    glState.bindVertexArray(0);
+
+    /* glBufferData/glBufferSubData have copied the data by the time they return, so the mapping can go now */
+    return true;
+}
+
+#endif
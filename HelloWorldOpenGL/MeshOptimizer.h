@@ -0,0 +1,326 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include "Mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+/*******************************************************************************************************************************
+Triangle and vertex order optimization
+*******************************************************************************************************************************/
+/* The GPU runs the vertex shader once per index unless the vertex is still in the small post-transform cache, so the
+   order of triangles decides how often shared vertices are shaded again. optimizeMesh() runs three passes, in this
+   order because each one keeps what the previous one achieved:
+
+       1: optimizeVertexCache   Tipsify (Sander, Nehab, Barczak 2007). Walks the mesh fanning around recently used
+                                vertices so shared vertices are reused while they are still cached.
+       2: optimizeOverdraw      Cuts the result into clusters at cache-flush points and sorts the clusters outside-in
+                                (by how far their normal points away from the mesh center), so front-most surfaces
+                                tend to be drawn first and hide what's behind. Triangles inside a cluster keep their
+                                order, so the cache gains mostly survive.
+       3: optimizeVertexFetch   Renumbers vertices in the order the indices first use them, so vertex fetches walk
+                                memory front to back instead of jumping around.
+
+   Cache quality is measured as
+       ACMR  average cache miss ratio: vertex shader runs per triangle (0.5 is the limit for a big regular grid, 3 the worst)
+       ATVR  average transformed vertex ratio: vertex shader runs per vertex (1.0 is perfect)
+   using a FIFO cache simulation, which is what most hardware behaves like. */
+struct CacheStats
+{
+    double acmr = 0.0;
+    double atvr = 0.0;
+};
+
+inline CacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, unsigned int cacheSize = 16)
+{
+    std::vector<uint32_t> insertedAt(vertexCount, 0); // "timestamp" when the vertex entered the FIFO, 0 = never
+    uint32_t time = cacheSize + 1;                     // so fresh entries are never mistaken for cached ones
+    size_t misses = 0;
+
+    for (uint32_t index : indices)
+    {
+        if (time - insertedAt[index] > cacheSize)
+        {
+            insertedAt[index] = time++;
+            misses++;
+        }
+    }
+
+    CacheStats stats;
+    if (!indices.empty())
+        stats.acmr = (double)misses / (double)(indices.size() / 3);
+    if (vertexCount)
+        stats.atvr = (double)misses / (double)vertexCount;
+    return stats;
+}
+
+/*******************************************************************************************************************************
+1: Tipsify
+*******************************************************************************************************************************/
+inline std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount,
+                                                 unsigned int cacheSize = 16)
+{
+    const size_t triangleCount = indices.size() / 3;
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    if (triangleCount == 0)
+        return result;
+
+    /* Vertex -> triangles adjacency as offsets into one array */
+    std::vector<uint32_t> liveTriangles(vertexCount, 0);
+    for (uint32_t index : indices)
+        liveTriangles[index]++;
+    std::vector<uint32_t> adjacencyStart(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        adjacencyStart[v + 1] = adjacencyStart[v] + liveTriangles[v];
+    std::vector<uint32_t> adjacency(indices.size());
+    {
+        std::vector<uint32_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+            adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+    }
+
+    std::vector<uint32_t> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> deadEndStack;
+    uint32_t time = cacheSize + 1;
+    size_t cursor = 1; // Next vertex to try when we're completely stuck
+
+    int fanning = 0;
+    while (fanning >= 0)
+    {
+        std::vector<uint32_t> candidates;
+
+        /* Emit all remaining triangles around the fanning vertex */
+        for (uint32_t a = adjacencyStart[fanning]; a < adjacencyStart[fanning + 1]; a++)
+        {
+            const uint32_t triangle = adjacency[a];
+            if (emitted[triangle])
+                continue;
+            emitted[triangle] = true;
+
+            for (int corner = 0; corner < 3; corner++)
+            {
+                const uint32_t v = indices[triangle * 3 + corner];
+                result.push_back(v);
+                deadEndStack.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                if (time - cacheTime[v] > cacheSize)
+                    cacheTime[v] = time++;
+            }
+        }
+
+        /* Next fanning vertex: a candidate that still has triangles and will still be in the cache after we emit
+           them, preferring the one that entered the cache earliest */
+        int best = -1;
+        int bestPriority = -1;
+        for (uint32_t v : candidates)
+        {
+            if (liveTriangles[v] == 0)
+                continue;
+            int priority = 0;
+            if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+                priority = (int)(time - cacheTime[v]);
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                best = (int)v;
+            }
+        }
+
+        if (best < 0)
+        {
+            /* Dead end: back up through recently emitted vertices, then scan for any vertex with work left */
+            while (!deadEndStack.empty() && best < 0)
+            {
+                const uint32_t v = deadEndStack.back();
+                deadEndStack.pop_back();
+                if (liveTriangles[v] > 0)
+                    best = (int)v;
+            }
+            while (best < 0 && cursor < vertexCount + 1)
+            {
+                if (liveTriangles[cursor - 1] > 0)
+                    best = (int)(cursor - 1);
+                cursor++;
+            }
+        }
+        fanning = best;
+    }
+    return result;
+}
+
+/*******************************************************************************************************************************
+2: Overdraw
+*******************************************************************************************************************************/
+inline std::vector<uint32_t> optimizeOverdraw(const std::vector<uint32_t>& indices, const std::vector<float>& positions,
+                                              unsigned int cacheSize = 16)
+{
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return indices;
+
+    /* Split where the FIFO simulation shows a burst of misses: a triangle with all three vertices missing means
+       Tipsify jumped somewhere new, so cutting there costs (almost) nothing in cache efficiency */
+    std::vector<size_t> clusterStart(1, 0);
+    {
+        std::vector<uint32_t> insertedAt(positions.size() / 3, 0);
+        uint32_t time = cacheSize + 1;
+        for (size_t t = 0; t < triangleCount; t++)
+        {
+            int misses = 0;
+            for (int corner = 0; corner < 3; corner++)
+            {
+                const uint32_t v = indices[t * 3 + corner];
+                if (time - insertedAt[v] > cacheSize)
+                {
+                    insertedAt[v] = time++;
+                    misses++;
+                }
+            }
+            if (misses == 3 && t - clusterStart.back() >= 32) // Don't make clusters too small to sort meaningfully
+                clusterStart.push_back(t);
+        }
+    }
+    clusterStart.push_back(triangleCount);
+
+    /* Mesh centroid */
+    double center[3] = { 0.0, 0.0, 0.0 };
+    const size_t vertexCount = positions.size() / 3;
+    for (size_t v = 0; v < vertexCount; v++)
+        for (int i = 0; i < 3; i++)
+            center[i] += positions[v * 3 + i];
+    for (int i = 0; i < 3; i++)
+        center[i] /= (double)std::max<size_t>(vertexCount, 1);
+
+    /* Sort key per cluster: dot(cluster center - mesh center, cluster normal). Big = on the outside, facing out */
+    struct Cluster { size_t first, last; double key; };
+    std::vector<Cluster> clusters;
+    for (size_t c = 0; c + 1 < clusterStart.size(); c++)
+    {
+        double centroid[3] = { 0.0, 0.0, 0.0 }, normal[3] = { 0.0, 0.0, 0.0 };
+        for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; t++)
+        {
+            const float* p0 = &positions[indices[t * 3 + 0] * 3];
+            const float* p1 = &positions[indices[t * 3 + 1] * 3];
+            const float* p2 = &positions[indices[t * 3 + 2] * 3];
+            const double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            const double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            const double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            const double area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) * 0.5;
+            for (int i = 0; i < 3; i++)
+            {
+                centroid[i] += (p0[i] + p1[i] + p2[i]) / 3.0 * area;
+                normal[i] += n[i]; // Already area weighted
+            }
+        }
+        const double normalLength = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        const double totalArea = normalLength * 0.5;
+        double key = 0.0;
+        if (normalLength > 0.0)
+            for (int i = 0; i < 3; i++)
+                key += (centroid[i] / std::max(totalArea, 1e-30) - center[i]) * normal[i] / normalLength;
+        clusters.push_back(Cluster{ clusterStart[c], clusterStart[c + 1], key });
+    }
+
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.key > b.key; });
+
+    std::vector<uint32_t> result;
+    result.reserve(indices.size());
+    for (const Cluster& cluster : clusters)
+        result.insert(result.end(), indices.begin() + cluster.first * 3, indices.begin() + cluster.last * 3);
+    return result;
+}
+
+/*******************************************************************************************************************************
+3: Vertex fetch
+*******************************************************************************************************************************/
+/* Renumbers vertices in first-use order and rewrites every attribute array and the indices to match.
+   Vertices no index refers to are dropped. */
+inline void optimizeVertexFetch(MeshData& mesh)
+{
+    const uint32_t Unused = 0xFFFFFFFFu;
+    std::vector<uint32_t> remap(mesh.vertexCount(), Unused);
+    uint32_t next = 0;
+    for (uint32_t& index : mesh.indices)
+    {
+        if (remap[index] == Unused)
+            remap[index] = next++;
+        index = remap[index];
+    }
+
+    auto reorder = [&](std::vector<float>& attribute, size_t components) {
+        if (attribute.empty())
+            return;
+        std::vector<float> reordered((size_t)next * components);
+        for (size_t v = 0; v < remap.size(); v++)
+            if (remap[v] != Unused)
+                std::copy(&attribute[v * components], &attribute[v * components] + components, &reordered[remap[v] * components]);
+        attribute.swap(reordered);
+    };
+    reorder(mesh.positions, 3);
+    reorder(mesh.normals, 3);
+    reorder(mesh.uvs, 2);
+}
+
+/* How far apart consecutive vertex fetches are, on average, in vertices. Lower means better locality. */
+inline double averageFetchDistance(const std::vector<uint32_t>& indices)
+{
+    if (indices.size() < 2)
+        return 0.0;
+    double total = 0.0;
+    for (size_t i = 1; i < indices.size(); i++)
+        total += std::fabs((double)indices[i] - (double)indices[i - 1]);
+    return total / (double)(indices.size() - 1);
+}
+
+/*******************************************************************************************************************************
+All three passes
+*******************************************************************************************************************************/
+struct MeshOptimizationReport
+{
+    CacheStats before, after;
+    double fetchDistanceBefore = 0.0, fetchDistanceAfter = 0.0;
+
+    void print(std::ostream& out) const
+    {
+        out << "Mesh optimization: ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> "
+            << after.atvr << ", average fetch distance " << fetchDistanceBefore << " -> " << fetchDistanceAfter
+            << " vertices" << std::endl;
+    }
+};
+
+inline MeshOptimizationReport optimizeMesh(MeshData& mesh, unsigned int cacheSize = 16)
+{
+    MeshOptimizationReport report;
+    report.before = analyzeVertexCache(mesh.indices, mesh.vertexCount(), cacheSize);
+    report.fetchDistanceBefore = averageFetchDistance(mesh.indices);
+
+    mesh.indices = optimizeVertexCache(mesh.indices, mesh.vertexCount(), cacheSize);
+    mesh.indices = optimizeOverdraw(mesh.indices, mesh.positions, cacheSize);
+    optimizeVertexFetch(mesh);
+
+    report.after = analyzeVertexCache(mesh.indices, mesh.vertexCount(), cacheSize);
+    report.fetchDistanceAfter = averageFetchDistance(mesh.indices);
+    return report;
+}
+
+/* Deterministically shuffles the triangle order, to simulate an exporter that doesn't care */
+inline void shuffleTriangles(std::vector<uint32_t>& indices, uint32_t seed = 1)
+{
+    const size_t triangleCount = indices.size() / 3;
+    for (size_t t = triangleCount; t > 1; t--)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        const size_t other = seed % t;
+        for (int corner = 0; corner < 3; corner++)
+            std::swap(indices[(t - 1) * 3 + corner], indices[other * 3 + corner]);
+    }
+}
+
+#endif
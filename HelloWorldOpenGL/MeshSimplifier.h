@@ -0,0 +1,728 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <glad/glad.h>
+
+#include "GLState.h"
+#include "Mesh.h"
+#include "MeshOptimizer.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+/*******************************************************************************************************************************
+Mesh simplification with quadric error metrics
+*******************************************************************************************************************************/
+/* A dense mesh far away costs the same vertex work as up close while most of its triangles are smaller than a pixel.
+   simplify() removes vertices one edge collapse at a time, cheapest first, until the mesh is down to a triangle
+   budget (Garland & Heckbert 1997).
+
+   The cost of a collapse comes from quadrics: every vertex keeps the sum of the squared-distance functions of the
+   triangles around it, so the error of moving it is one quadratic form instead of a walk over the original surface.
+   To keep attributes as well as shape the quadrics live in 8 dimensions: position, normal and uv, each scaled by a
+   weight (Garland & Heckbert 1998, "Simplifying surfaces with color and texture"). A collapse that would smear a
+   uv seam or bend shading costs as much as one that moves the surface.
+
+   Collapses are half-edge collapses, moving u onto its neighbour v. No new vertices are made, so the attributes of
+   every vertex that survives are exact and each level can reuse the source vertex data. A collapse is skipped when
+   it would:
+       - flip or squash a triangle
+       - make the surface non-manifold (the link condition)
+       - move a vertex that is on an open border anywhere but along that border
+       - move a vertex on an attribute seam (a position shared by vertices with different normals or uvs), because
+         the copies on the other side of the seam would tear away
+   Border edges also get a plane perpendicular to the surface added to their quadrics, so outlines stay put.
+
+   The quadrics and topology of the source are built once (triangles in parallel) and shared read-only, so any number
+   of simplify() calls can run at the same time; buildLodChain() runs one per level on a ThreadPool. The source mesh
+   must outlive the simplifier. */
+struct SimplifyOptions
+{
+    float normalWeight = 0.5f;  // a unit of normal difference costs like this fraction of the mesh's size in distance
+    float uvWeight = 0.5f;      // same for a unit of uv
+    float borderWeight = 10.0f; // how much harder borders are held in place than the surface
+};
+
+class MeshSimplifier
+{
+public:
+    static const int Dimensions = 8; // position, normal, uv
+
+    MeshSimplifier(const MeshData& source, const SimplifyOptions& options = SimplifyOptions(), ThreadPool* pool = NULL)
+        : source(source)
+    {
+        const size_t vertexCount = source.vertexCount();
+        const size_t triangleCount = source.triangleCount();
+
+        /* Positions are scaled by the bounding box diagonal so the weights don't depend on the mesh's units */
+        float low[3] = { 1e30f, 1e30f, 1e30f }, high[3] = { -1e30f, -1e30f, -1e30f };
+        for (size_t v = 0; v < vertexCount; v++)
+            for (int i = 0; i < 3; i++)
+            {
+                low[i] = std::min(low[i], source.positions[v * 3 + i]);
+                high[i] = std::max(high[i], source.positions[v * 3 + i]);
+            }
+        extent = 0.0;
+        for (int i = 0; i < 3; i++)
+            extent += vertexCount ? (double)(high[i] - low[i]) * (high[i] - low[i]) : 0.0;
+        extent = extent > 0.0 ? std::sqrt(extent) : 1.0;
+
+        points.assign(vertexCount * Dimensions, 0.0);
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            double* p = &points[v * Dimensions];
+            for (int i = 0; i < 3; i++)
+                p[i] = source.positions[v * 3 + i] / extent;
+            if (!source.normals.empty())
+                for (int i = 0; i < 3; i++)
+                    p[3 + i] = source.normals[v * 3 + i] * options.normalWeight;
+            if (!source.uvs.empty())
+                for (int i = 0; i < 2; i++)
+                    p[6 + i] = source.uvs[v * 2 + i] * options.uvWeight;
+        }
+
+        /* Vertex -> triangles, as offsets into one array */
+        firstTriangle.assign(vertexCount + 1, 0);
+        for (uint32_t index : source.indices)
+            firstTriangle[index + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            firstTriangle[v + 1] += firstTriangle[v];
+        vertexTriangles.resize(source.indices.size());
+        std::vector<uint32_t> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+        for (size_t i = 0; i < source.indices.size(); i++)
+            vertexTriangles[fill[source.indices[i]]++] = (uint32_t)(i / 3);
+
+        classifyVertices();
+
+        /* One quadric per triangle, in parallel; then each vertex sums its own triangles' (also in parallel) */
+        std::vector<Quadric> triangleQuadrics(triangleCount);
+        auto buildTriangles = [&](size_t begin, size_t end, unsigned int) {
+            for (size_t t = begin; t < end; t++)
+                triangleQuadrics[t] = triangleQuadric(t);
+        };
+        auto sumVertices = [&](size_t begin, size_t end, unsigned int) {
+            for (size_t v = begin; v < end; v++)
+            {
+                Quadric q;
+                for (uint32_t i = firstTriangle[v]; i < firstTriangle[v + 1]; i++)
+                    q.add(triangleQuadrics[vertexTriangles[i]]);
+                quadrics[v] = q;
+            }
+        };
+        quadrics.resize(vertexCount);
+        if (pool)
+        {
+            pool->parallelFor(triangleCount, 1024, buildTriangles);
+            pool->parallelFor(vertexCount, 1024, sumVertices);
+        }
+        else
+        {
+            buildTriangles(0, triangleCount, 0);
+            sumVertices(0, vertexCount, 0);
+        }
+        addBorderPlanes(options.borderWeight);
+    }
+
+    /* Collapses edges until at most targetTriangles are left or nothing more can go. The result shares the source's
+       vertex data, compacted and reordered by optimizeMesh(). error receives the largest deviation any collapse
+       caused, in the mesh's units (attribute changes count through their weights). Safe to call from several threads
+       at once. */
+    MeshData simplify(size_t targetTriangles, float* error = NULL) const
+    {
+        Collapser state(*this);
+        state.run(targetTriangles);
+
+        MeshData result;
+        result.positions = source.positions;
+        result.normals = source.normals;
+        result.uvs = source.uvs;
+        for (size_t t = 0; t < source.triangleCount(); t++)
+            if (state.triangleAlive[t])
+                result.indices.insert(result.indices.end(), &state.indices[t * 3], &state.indices[t * 3] + 3);
+        optimizeMesh(result); // also drops the vertices no triangle uses any more
+
+        if (error)
+            *error = (float)(state.maxError * extent);
+        return result;
+    }
+
+private:
+    /* A symmetric 8x8 matrix (upper triangle, row by row), a vector and a constant: error(p) = p'Ap + 2b'p + c.
+       weight is the triangle area summed in, to turn the area-weighted error back into a distance. */
+    struct Quadric
+    {
+        static const int MatrixSize = Dimensions * (Dimensions + 1) / 2;
+
+        double a[MatrixSize] = {};
+        double b[Dimensions] = {};
+        double c = 0.0;
+        double weight = 0.0;
+
+        void add(const Quadric& q)
+        {
+            for (int i = 0; i < MatrixSize; i++)
+                a[i] += q.a[i];
+            for (int i = 0; i < Dimensions; i++)
+                b[i] += q.b[i];
+            c += q.c;
+            weight += q.weight;
+        }
+
+        double evaluate(const double* p) const
+        {
+            double sum = c;
+            int k = 0;
+            for (int i = 0; i < Dimensions; i++)
+            {
+                sum += a[k++] * p[i] * p[i] + 2.0 * b[i] * p[i];
+                for (int j = i + 1; j < Dimensions; j++)
+                    sum += 2.0 * a[k++] * p[i] * p[j];
+            }
+            return std::max(sum, 0.0);
+        }
+    };
+
+    enum class Kind : uint8_t { Interior, Border, Locked };
+
+    /* The squared distance to the triangle's plane in 8D, times its area:
+           A = I - e1e1' - e2e2',  b = (p.e1)e1 + (p.e2)e2 - p,  c = p.p - (p.e1)^2 - (p.e2)^2
+       with e1, e2 an orthonormal basis of the plane and p any of its corners */
+    Quadric triangleQuadric(size_t t) const
+    {
+        Quadric q;
+        const double* p0 = &points[source.indices[t * 3] * Dimensions];
+        const double* p1 = &points[source.indices[t * 3 + 1] * Dimensions];
+        const double* p2 = &points[source.indices[t * 3 + 2] * Dimensions];
+
+        double e1[Dimensions], e2[Dimensions];
+        double length1 = 0.0;
+        for (int i = 0; i < Dimensions; i++)
+        {
+            e1[i] = p1[i] - p0[i];
+            length1 += e1[i] * e1[i];
+        }
+        if (length1 <= 1e-24)
+            return q;
+        length1 = std::sqrt(length1);
+        double along = 0.0;
+        for (int i = 0; i < Dimensions; i++)
+        {
+            e1[i] /= length1;
+            along += (p2[i] - p0[i]) * e1[i];
+        }
+        double length2 = 0.0;
+        for (int i = 0; i < Dimensions; i++)
+        {
+            e2[i] = p2[i] - p0[i] - along * e1[i];
+            length2 += e2[i] * e2[i];
+        }
+        if (length2 <= 1e-24)
+            return q;
+        length2 = std::sqrt(length2);
+        for (int i = 0; i < Dimensions; i++)
+            e2[i] /= length2;
+
+        /* Area from positions only, so attributes don't change how much a triangle counts */
+        double edgeA[3], edgeB[3];
+        for (int i = 0; i < 3; i++)
+        {
+            edgeA[i] = p1[i] - p0[i];
+            edgeB[i] = p2[i] - p0[i];
+        }
+        const double cross[3] = { edgeA[1] * edgeB[2] - edgeA[2] * edgeB[1], edgeA[2] * edgeB[0] - edgeA[0] * edgeB[2],
+                                  edgeA[0] * edgeB[1] - edgeA[1] * edgeB[0] };
+        const double area = 0.5 * std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+
+        double pe1 = 0.0, pe2 = 0.0, pp = 0.0;
+        for (int i = 0; i < Dimensions; i++)
+        {
+            pe1 += p0[i] * e1[i];
+            pe2 += p0[i] * e2[i];
+            pp += p0[i] * p0[i];
+        }
+        int k = 0;
+        for (int i = 0; i < Dimensions; i++)
+        {
+            for (int j = i; j < Dimensions; j++)
+                q.a[k++] = area * ((i == j ? 1.0 : 0.0) - e1[i] * e1[j] - e2[i] * e2[j]);
+            q.b[i] = area * (pe1 * e1[i] + pe2 * e2[i] - p0[i]);
+        }
+        q.c = area * (pp - pe1 * pe1 - pe2 * pe2);
+        q.weight = area;
+        return q;
+    }
+
+    static uint64_t edgeKey(uint32_t a, uint32_t b)
+    {
+        return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+    }
+
+    /* Border vertices are on an edge only one triangle uses; seam vertices share their position with another vertex */
+    void classifyVertices()
+    {
+        const size_t vertexCount = source.vertexCount();
+        kinds.assign(vertexCount, Kind::Interior);
+
+        std::unordered_map<uint64_t, uint32_t> edgeUses;
+        edgeUses.reserve(source.indices.size());
+        for (size_t t = 0; t < source.triangleCount(); t++)
+            for (int corner = 0; corner < 3; corner++)
+                edgeUses[edgeKey(source.indices[t * 3 + corner], source.indices[t * 3 + (corner + 1) % 3])]++;
+        std::vector<uint32_t> nonManifold;
+        for (const auto& edge : edgeUses)
+            if (edge.second == 1)
+            {
+                kinds[edge.first >> 32] = Kind::Border;
+                kinds[edge.first & 0xFFFFFFFFu] = Kind::Border;
+                borderEdges.push_back(edge.first);
+            }
+            else if (edge.second > 2)
+            {
+                nonManifold.push_back((uint32_t)(edge.first >> 32)); // non-manifold to begin with; leave it alone
+                nonManifold.push_back((uint32_t)(edge.first & 0xFFFFFFFFu));
+            }
+        for (uint32_t v : nonManifold)
+            kinds[v] = Kind::Locked;
+
+        /* Equal positions end up next to each other once the vertices are sorted by position */
+        std::vector<uint32_t> order(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++)
+            order[v] = (uint32_t)v;
+        const float* positions = source.positions.data();
+        auto less = [positions](uint32_t a, uint32_t b) {
+            return std::lexicographical_compare(positions + a * 3, positions + a * 3 + 3, positions + b * 3,
+                                                positions + b * 3 + 3);
+        };
+        std::sort(order.begin(), order.end(), less);
+        for (size_t i = 1; i < order.size(); i++)
+            if (!less(order[i - 1], order[i]))
+                kinds[order[i - 1]] = kinds[order[i]] = Kind::Locked;
+    }
+
+    /* A plane through each border edge, perpendicular to its triangle, in the position part of both ends' quadrics */
+    void addBorderPlanes(float borderWeight)
+    {
+        for (uint64_t edge : borderEdges)
+        {
+            const uint32_t a = (uint32_t)(edge >> 32), b = (uint32_t)(edge & 0xFFFFFFFFu);
+            uint32_t triangle = 0xFFFFFFFFu;
+            for (uint32_t i = firstTriangle[a]; i < firstTriangle[a + 1]; i++)
+            {
+                const uint32_t* corners = &source.indices[vertexTriangles[i] * 3];
+                if (corners[0] == b || corners[1] == b || corners[2] == b)
+                    triangle = vertexTriangles[i];
+            }
+            if (triangle == 0xFFFFFFFFu)
+                continue;
+
+            const uint32_t* corners = &source.indices[triangle * 3];
+            const double* p0 = &points[corners[0] * Dimensions];
+            const double* p1 = &points[corners[1] * Dimensions];
+            const double* p2 = &points[corners[2] * Dimensions];
+            const double* pa = &points[a * Dimensions];
+            const double* pb = &points[b * Dimensions];
+            double u[3], w[3], edgeDir[3];
+            for (int i = 0; i < 3; i++)
+            {
+                u[i] = p1[i] - p0[i];
+                w[i] = p2[i] - p0[i];
+                edgeDir[i] = pb[i] - pa[i];
+            }
+            const double normal[3] = { u[1] * w[2] - u[2] * w[1], u[2] * w[0] - u[0] * w[2], u[0] * w[1] - u[1] * w[0] };
+            double m[3] = { edgeDir[1] * normal[2] - edgeDir[2] * normal[1], edgeDir[2] * normal[0] - edgeDir[0] * normal[2],
+                            edgeDir[0] * normal[1] - edgeDir[1] * normal[0] };
+            const double length = std::sqrt(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+            if (length <= 1e-24)
+                continue;
+            for (double& value : m)
+                value /= length;
+
+            const double weight =
+                borderWeight * (edgeDir[0] * edgeDir[0] + edgeDir[1] * edgeDir[1] + edgeDir[2] * edgeDir[2]);
+            const double d = -(m[0] * pa[0] + m[1] * pa[1] + m[2] * pa[2]);
+            Quadric plane;
+            int k = 0;
+            for (int i = 0; i < Dimensions; i++)
+            {
+                for (int j = i; j < Dimensions; j++, k++)
+                    if (i < 3 && j < 3)
+                        plane.a[k] = weight * m[i] * m[j];
+                if (i < 3)
+                    plane.b[i] = weight * d * m[i];
+            }
+            plane.c = weight * d * d;
+            quadrics[a].add(plane);
+            quadrics[b].add(plane);
+        }
+    }
+
+    /* The mutable part of one simplify() call */
+    struct Collapser
+    {
+        struct Candidate
+        {
+            double priority;
+            double cost;
+            uint32_t from, to;
+            uint32_t fromVersion, toVersion;
+
+            bool operator<(const Candidate& other) const { return priority > other.priority; } // lowest on top
+        };
+
+        const MeshSimplifier& mesh;
+        std::vector<uint32_t> indices;
+        std::vector<uint8_t> triangleAlive;
+        std::vector<Quadric> quadrics;
+        std::vector<std::vector<uint32_t>> triangles; // live triangles around each vertex
+        std::vector<uint32_t> versions;
+        std::vector<uint8_t> removed;
+        std::priority_queue<Candidate> queue;
+        size_t liveTriangles;
+        double maxError = 0.0;
+
+        explicit Collapser(const MeshSimplifier& mesh)
+            : mesh(mesh), indices(mesh.source.indices), triangleAlive(mesh.source.triangleCount(), 1),
+              quadrics(mesh.quadrics), triangles(mesh.source.vertexCount()), versions(mesh.source.vertexCount(), 0),
+              removed(mesh.source.vertexCount(), 0), liveTriangles(mesh.source.triangleCount())
+        {
+            for (size_t v = 0; v < triangles.size(); v++)
+                triangles[v].assign(&mesh.vertexTriangles[0] + mesh.firstTriangle[v],
+                                    &mesh.vertexTriangles[0] + mesh.firstTriangle[v + 1]);
+        }
+
+        void push(uint32_t from, uint32_t to)
+        {
+            if (mesh.kinds[from] == Kind::Locked)
+                return;
+            Quadric sum = quadrics[from];
+            sum.add(quadrics[to]);
+            const double* target = &mesh.points[to * Dimensions];
+            const double cost = sum.evaluate(target);
+
+            /* On flat, evenly textured parts every collapse costs nothing, and without a tie-breaker the same vertex
+               keeps winning and ends up in a fan of long thin triangles. A tiny bias towards short edges spreads the
+               collapses out; it's far below any real error. */
+            const double* origin = &mesh.points[from * Dimensions];
+            const double lengthSquared = (target[0] - origin[0]) * (target[0] - origin[0]) +
+                                         (target[1] - origin[1]) * (target[1] - origin[1]) +
+                                         (target[2] - origin[2]) * (target[2] - origin[2]);
+            const double priority = cost + 1e-6 * sum.weight * lengthSquared;
+            queue.push(Candidate{ priority, cost, from, to, versions[from], versions[to] });
+        }
+
+        void run(size_t targetTriangles)
+        {
+            for (size_t t = 0; t < indices.size() / 3; t++)
+                for (int corner = 0; corner < 3; corner++)
+                {
+                    const uint32_t a = indices[t * 3 + corner], b = indices[t * 3 + (corner + 1) % 3];
+                    push(a, b);
+                    push(b, a);
+                }
+
+            while (liveTriangles > targetTriangles && !queue.empty())
+            {
+                const Candidate candidate = queue.top();
+                queue.pop();
+                if (removed[candidate.from] || removed[candidate.to] || versions[candidate.from] != candidate.fromVersion ||
+                    versions[candidate.to] != candidate.toVersion)
+                    continue; // stale; a newer entry exists if the collapse is still possible
+                if (!canCollapse(candidate.from, candidate.to))
+                    continue;
+                collapse(candidate.from, candidate.to);
+
+                const double weight = quadrics[candidate.to].weight;
+                if (weight > 0.0)
+                    maxError = std::max(maxError, std::sqrt(candidate.cost / weight));
+            }
+        }
+
+        bool contains(uint32_t t, uint32_t v) const
+        {
+            return indices[t * 3] == v || indices[t * 3 + 1] == v || indices[t * 3 + 2] == v;
+        }
+
+        void neighbours(uint32_t v, std::vector<uint32_t>& out) const
+        {
+            out.clear();
+            for (uint32_t t : triangles[v])
+                for (int corner = 0; corner < 3; corner++)
+                    if (indices[t * 3 + corner] != v)
+                        out.push_back(indices[t * 3 + corner]);
+            std::sort(out.begin(), out.end());
+            out.erase(std::unique(out.begin(), out.end()), out.end());
+        }
+
+        bool canCollapse(uint32_t from, uint32_t to)
+        {
+            size_t shared = 0;
+            for (uint32_t t : triangles[from])
+                shared += contains(t, to);
+            if (shared == 0 || (mesh.kinds[from] == Kind::Border && shared != 1))
+                return false; // not an edge any more, or a border vertex leaving its border
+
+            /* Link condition: the only vertices both ends see are the third corners of the triangles on the edge */
+            neighbours(from, fromRing);
+            neighbours(to, toRing);
+            size_t common = 0;
+            for (size_t i = 0, j = 0; i < fromRing.size() && j < toRing.size();)
+            {
+                if (fromRing[i] == toRing[j])
+                    common++, i++, j++;
+                else if (fromRing[i] < toRing[j])
+                    i++;
+                else
+                    j++;
+            }
+            if (common != shared)
+                return false;
+
+            /* No triangle that survives may flip or collapse to a sliver */
+            const double* target = &mesh.points[to * Dimensions];
+            for (uint32_t t : triangles[from])
+            {
+                if (contains(t, to))
+                    continue;
+                const double* corners[3];
+                const double* moved[3];
+                for (int corner = 0; corner < 3; corner++)
+                {
+                    const uint32_t v = indices[t * 3 + corner];
+                    corners[corner] = &mesh.points[v * Dimensions];
+                    moved[corner] = v == from ? target : corners[corner];
+                }
+                double before[3], after[3];
+                normal(corners, before);
+                normal(moved, after);
+                const double lengths = std::sqrt((before[0] * before[0] + before[1] * before[1] + before[2] * before[2]) *
+                                                 (after[0] * after[0] + after[1] * after[1] + after[2] * after[2]));
+                if (lengths <= 1e-30 ||
+                    before[0] * after[0] + before[1] * after[1] + before[2] * after[2] < 0.25 * lengths)
+                    return false;
+            }
+            return true;
+        }
+
+        static void normal(const double* const corners[3], double out[3])
+        {
+            double u[3], w[3];
+            for (int i = 0; i < 3; i++)
+            {
+                u[i] = corners[1][i] - corners[0][i];
+                w[i] = corners[2][i] - corners[0][i];
+            }
+            out[0] = u[1] * w[2] - u[2] * w[1];
+            out[1] = u[2] * w[0] - u[0] * w[2];
+            out[2] = u[0] * w[1] - u[1] * w[0];
+        }
+
+        void collapse(uint32_t from, uint32_t to)
+        {
+            for (uint32_t t : triangles[from])
+            {
+                if (contains(t, to))
+                {
+                    triangleAlive[t] = 0;
+                    liveTriangles--;
+                    continue;
+                }
+                for (int corner = 0; corner < 3; corner++)
+                    if (indices[t * 3 + corner] == from)
+                        indices[t * 3 + corner] = to;
+                triangles[to].push_back(t);
+            }
+            triangles[from].clear();
+            std::vector<uint32_t>& around = triangles[to];
+            around.erase(std::remove_if(around.begin(), around.end(), [&](uint32_t t) { return !triangleAlive[t]; }),
+                         around.end());
+            /* The third corners lost a triangle too */
+            for (uint32_t v : fromRing)
+            {
+                std::vector<uint32_t>& list = triangles[v];
+                list.erase(std::remove_if(list.begin(), list.end(), [&](uint32_t t) { return !triangleAlive[t]; }),
+                           list.end());
+            }
+
+            quadrics[to].add(quadrics[from]);
+            removed[from] = 1;
+            versions[to]++;
+
+            neighbours(to, toRing);
+            for (uint32_t v : toRing)
+            {
+                push(v, to);
+                push(to, v);
+            }
+        }
+
+        std::vector<uint32_t> fromRing, toRing;
+    };
+
+    const MeshData& source;
+    double extent = 1.0;
+    std::vector<double> points;           // Dimensions per vertex, scaled
+    std::vector<uint32_t> firstTriangle;  // vertexTriangles[firstTriangle[v] .. firstTriangle[v + 1]) are v's
+    std::vector<uint32_t> vertexTriangles;
+    std::vector<Kind> kinds;
+    std::vector<uint64_t> borderEdges;
+    std::vector<Quadric> quadrics;
+};
+
+/*******************************************************************************************************************************
+LOD chains
+*******************************************************************************************************************************/
+/* Level 0 is the source mesh, each further level has about `ratio` times the triangles of the one before. All levels
+   are simplified from the source (not from each other, so errors don't pile up) at the same time on the pool.
+   error is the level's deviation from the source in mesh units; level 0's is 0. */
+struct LodLevel
+{
+    MeshData mesh;
+    float error = 0.0f;
+};
+
+inline std::vector<LodLevel> buildLodChain(const MeshData& source, unsigned int levels, ThreadPool* pool = NULL,
+                                           float ratio = 0.5f, const SimplifyOptions& options = SimplifyOptions())
+{
+    std::vector<LodLevel> chain(std::max(1u, levels));
+    chain[0].mesh = source;
+    const MeshSimplifier simplifier(source, options, pool);
+
+    auto simplifyLevels = [&](size_t begin, size_t end, unsigned int) {
+        for (size_t level = begin + 1; level < end + 1; level++)
+        {
+            const size_t target = (size_t)((double)source.triangleCount() * std::pow((double)ratio, (double)level));
+            chain[level].mesh = simplifier.simplify(target, &chain[level].error);
+        }
+    };
+    if (pool)
+        pool->parallelFor(chain.size() - 1, 1, simplifyLevels);
+    else
+        simplifyLevels(0, chain.size() - 1, 0);
+
+    /* A coarser level is never allowed to claim less error than a finer one; selection relies on that order */
+    for (size_t level = 1; level < chain.size(); level++)
+        chain[level].error = std::max(chain[level].error, chain[level - 1].error);
+    return chain;
+}
+
+/* Pixels one unit of object-space error covers at `distance` from a perspective camera with vertical field of view
+   fovY (radians) on a viewport screenHeight pixels tall */
+inline float pixelsPerUnit(float distance, float fovY, float screenHeight)
+{
+    return screenHeight / (2.0f * std::tan(fovY * 0.5f) * std::max(distance, 1e-4f));
+}
+
+/* Picks the coarsest level whose error stays under thresholdPixels on screen. To stop objects near a switching
+   distance from flipping back and forth every frame, it only goes coarser once that level is below
+   threshold * (1 - hysteresis), and only goes finer once the current level is above threshold * (1 + hysteresis).
+   current < 0 means no level yet. */
+inline int selectLod(const float* errors, int levelCount, int current, float pixelsPerUnit, float thresholdPixels = 1.0f,
+                     float hysteresis = 0.25f)
+{
+    auto coarsest = [&](float threshold) {
+        int level = 0;
+        while (level + 1 < levelCount && errors[level + 1] * pixelsPerUnit <= threshold)
+            level++;
+        return level;
+    };
+    if (current < 0 || current >= levelCount)
+        return coarsest(thresholdPixels);
+
+    const int coarser = coarsest(thresholdPixels * (1.0f - hysteresis));
+    if (coarser > current)
+        return coarser;
+    if (errors[current] * pixelsPerUnit > thresholdPixels * (1.0f + hysteresis))
+        return coarsest(thresholdPixels);
+    return current;
+}
+
+/* Every level of a chain in one VAO: the vertices back to back in one buffer, the indices in another, each level
+   drawn with its own index range and base vertex */
+struct GpuLodMesh
+{
+    struct Level
+    {
+        uint32_t indexCount;
+        uint32_t firstIndex;
+        int32_t baseVertex;
+    };
+
+    unsigned int vao = 0;
+    unsigned int vbo = 0;
+    unsigned int ebo = 0;
+    std::vector<Level> levels;
+    std::vector<float> errors;
+
+    void create(const std::vector<LodLevel>& chain)
+    {
+        VertexLayout layout;
+        std::vector<float> vertices;
+        std::vector<uint32_t> indices;
+        for (const LodLevel& lod : chain)
+        {
+            const std::vector<float> interleaved = lod.mesh.interleave(layout);
+            levels.push_back(Level{ (uint32_t)lod.mesh.indices.size(), (uint32_t)indices.size(),
+                                    (int32_t)(vertices.size() / (layout.stride / sizeof(float))) });
+            errors.push_back(lod.error);
+            vertices.insert(vertices.end(), interleaved.begin(), interleaved.end());
+            indices.insert(indices.end(), lod.mesh.indices.begin(), lod.mesh.indices.end());
+        }
+
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &vbo);
+        glGenBuffers(1, &ebo);
+        glState.bindVertexArray(vao);
+        glState.bindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)(vertices.size() * sizeof(float)), vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo); // Stored in the VAO
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)(indices.size() * sizeof(uint32_t)), indices.data(),
+                     GL_STATIC_DRAW);
+        layout.apply();
+        glState.bindVertexArray(0);
+    }
+
+    int levelCount() const { return (int)levels.size(); }
+    uint32_t triangles(int level) const { return levels[level].indexCount / 3; }
+
+    void draw(int level) const
+    {
+        const Level& l = levels[level];
+        glState.bindVertexArray(vao);
+        glState.drawElementsBaseVertex(GL_TRIANGLES, (GLsizei)l.indexCount, GL_UNSIGNED_INT,
+                                       (const void*)(uintptr_t)(l.firstIndex * sizeof(uint32_t)), l.baseVertex);
+    }
+
+    void destroy()
+    {
+        glDeleteVertexArrays(1, &vao);
+        glDeleteBuffers(1, &vbo);
+        glDeleteBuffers(1, &ebo);
+        glState.forgetVertexArray(vao);
+        glState.forgetBuffer(vbo);
+        glState.forgetBuffer(ebo);
+        vao = vbo = ebo = 0;
+        levels.clear();
+        errors.clear();
+    }
+};
+
+/* Vertex shader for LOD scenes: a model-view-projection matrix per object, shaded by normal like the mesh shader */
+const char* const lodVertexShaderSource =
+"#version 330 core\n"
+"layout (location = 0) in vec3 aPos;\n"
+"layout (location = 1) in vec3 aNormal;\n"
+"uniform mat4 uTransform;\n"
+"out vec4 vertexColor;\n"
+"void main()\n"
+"{\n"
+"   gl_Position = uTransform * vec4(aPos, 1.0);\n"
+"   vertexColor = vec4(normalize(aNormal + vec3(1e-6)) * 0.5 + 0.5, 1.0);\n"
+"}\0";
+
+#endif
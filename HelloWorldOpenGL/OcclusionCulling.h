@@ -0,0 +1,449 @@
+#ifndef OCCLUSION_CULLING_H
+#define OCCLUSION_CULLING_H
+
+#include "Culling.h"
+#include "Mat4.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/*******************************************************************************************************************************
+Software occlusion culling
+*******************************************************************************************************************************/
+/* Frustum culling keeps everything in front of the camera, including whatever is hidden behind a wall. On a GPU that
+   costs vertex work; on llvmpipe, where the "GPU" is the same CPU cores, every hidden object is rasterized and shaded
+   for nothing. OcclusionCuller finds those objects before they are recorded:
+
+       1. A few simplified occluders (boxes, or low-poly meshes that stay inside the real geometry) are rasterized into
+          a small depth buffer, 256 x 128 by default. The buffer is cut into bands of 8 rows; each band is one job on
+          the pool and rasterizes every occluder triangle that touches it, so no two threads write the same pixel.
+          Pixels are filled 8 at a time: three edge functions and the depth plane are evaluated for a whole row of
+          8 with one AVX instruction each (two SSE ones without AVX).
+       2. A min/max hierarchy is built on top: every level halves the resolution and keeps the nearest and the
+          farthest depth of the 2 x 2 cells below.
+       3. Each object's box is projected to a screen rectangle and its nearest depth. Starting from the top of the
+          hierarchy, a cell whose farthest depth is still nearer than the box hides the box there; a cell whose nearest
+          depth is behind it means the box is visible. Only cells in between are looked at more closely.
+
+   Depth is window depth (0 at the near plane, 1 at the far one), like the GL depth buffer. Pixels are sampled at their
+   centres, so an occluder's silhouette can be off by up to a pixel of this small buffer. That's the usual trade-off
+   (Intel's Masked Occlusion Culling makes the same one); occluders should be a little smaller than what they stand for.
+   Boxes that cross the near plane are always visible. */
+class OcclusionCuller
+{
+public:
+    static const int BandHeight = 8;
+
+    struct Stats
+    {
+        size_t triangles = 0;  // occluder triangles submitted
+        size_t rasterized = 0; // of those, triangles left after near plane clipping and back-of-screen rejection
+        size_t tested = 0;     // boxes tested since the last render()
+        size_t occluded = 0;   // of those, boxes found hidden
+    };
+
+    /* width is rounded up to a multiple of 8 and height to a multiple of BandHeight */
+    OcclusionCuller(int width = 256, int height = 128)
+        : width((std::max(width, 8) + 7) & ~7),
+          height((std::max(height, (int)BandHeight) + BandHeight - 1) / BandHeight * BandHeight)
+    {
+        depth.assign((size_t)this->width * this->height, 1.0f);
+        int w = this->width, h = this->height;
+        while (w > 1 || h > 1)
+        {
+            w = (w + 1) / 2;
+            h = (h + 1) / 2;
+            Level level;
+            level.width = w;
+            level.height = h;
+            level.nearest.assign((size_t)w * h, 1.0f);
+            level.farthest.assign((size_t)w * h, 1.0f);
+            levels.push_back(level);
+        }
+    }
+
+    int bufferWidth() const { return width; }
+    int bufferHeight() const { return height; }
+    const Stats& stats() const { return statistics; }
+
+    /* Row-major window depth, row 0 at the bottom like GL; valid after render() */
+    const float* depthData() const { return depth.data(); }
+
+    /* Forgets the occluders of the last frame */
+    void clearOccluders()
+    {
+        vertices.clear();
+        indices.clear();
+    }
+
+    /* Adds a world-space triangle mesh: xyz per vertex, three indices per triangle. Winding doesn't matter. */
+    void addOccluder(const float* positions, size_t vertexCount, const uint32_t* triangleIndices, size_t indexCount)
+    {
+        const uint32_t base = (uint32_t)(vertices.size() / 3);
+        vertices.insert(vertices.end(), positions, positions + vertexCount * 3);
+        for (size_t i = 0; i < indexCount; i++)
+            indices.push_back(base + triangleIndices[i]);
+    }
+
+    /* Adds a solid box, the most common simplified occluder (walls, buildings, the ground) */
+    void addOccluder(const Aabb& box)
+    {
+        float corners[8 * 3];
+        for (int c = 0; c < 8; c++)
+            for (int axis = 0; axis < 3; axis++)
+                corners[c * 3 + axis] = (c >> axis) & 1 ? box.max[axis] : box.min[axis];
+        static const uint32_t faces[36] = {
+            0, 2, 6, 0, 6, 4,  1, 5, 7, 1, 7, 3,  // -x, +x
+            0, 4, 5, 0, 5, 1,  2, 3, 7, 2, 7, 6,  // -y, +y
+            0, 1, 3, 0, 3, 2,  4, 6, 7, 4, 7, 5   // -z, +z
+        };
+        addOccluder(corners, 8, faces, 36);
+    }
+
+    /* Rasterizes the occluders as seen through viewProjection and rebuilds the hierarchy. pool may be NULL. */
+    void render(const Mat4& viewProjection, ThreadPool* pool = NULL)
+    {
+        const size_t triangleCount = indices.size() / 3;
+        view = viewProjection;
+        statistics = Stats();
+        statistics.triangles = triangleCount;
+
+        /* Clipping against the near plane turns a triangle into at most two, so each gets two slots */
+        setup.resize(triangleCount * 2);
+        auto setupTriangles = [&](size_t begin, size_t end, unsigned int)
+        {
+            for (size_t t = begin; t < end; t++)
+                setupTriangle(viewProjection, t);
+        };
+        auto rasterizeBands = [&](size_t begin, size_t end, unsigned int)
+        {
+            for (size_t band = begin; band < end; band++)
+                rasterizeBand((int)band);
+        };
+        const size_t bands = (size_t)(height / BandHeight);
+        if (pool)
+        {
+            pool->parallelFor(triangleCount, 256, setupTriangles);
+            pool->parallelFor(bands, 1, rasterizeBands);
+        }
+        else
+        {
+            setupTriangles(0, triangleCount, 0);
+            rasterizeBands(0, bands, 0);
+        }
+
+        for (const RasterTriangle& triangle : setup)
+            statistics.rasterized += triangle.x0 <= triangle.x1 && triangle.y0 <= triangle.y1;
+
+        /* The first level is filled band by band above; the rest are small enough for one thread */
+        for (size_t l = 1; l < levels.size(); l++)
+            reduceLevel(l, 0, levels[l].height);
+    }
+
+    /* True if any part of the box may be visible over the occluders of the last render() */
+    bool visible(const Aabb& box) const
+    {
+        float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, nearest = 1.0f;
+        for (int c = 0; c < 8; c++)
+        {
+            float clip[4];
+            view.transformPoint(c & 1 ? box.max[0] : box.min[0], c & 2 ? box.max[1] : box.min[1],
+                                c & 4 ? box.max[2] : box.min[2], clip);
+            if (clip[2] < -clip[3] || clip[3] <= 0.0f)
+                return true;
+            const float inverse = 1.0f / clip[3];
+            const float x = (clip[0] * inverse * 0.5f + 0.5f) * (float)width;
+            const float y = (clip[1] * inverse * 0.5f + 0.5f) * (float)height;
+            minX = std::min(minX, x);
+            maxX = std::max(maxX, x);
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+            nearest = std::min(nearest, clip[2] * inverse * 0.5f + 0.5f);
+        }
+
+        /* Every pixel the rectangle touches, not just those whose centre is inside it */
+        const int x0 = std::max(0, (int)std::floor(minX)), x1 = std::min(width - 1, (int)std::floor(maxX));
+        const int y0 = std::max(0, (int)std::floor(minY)), y1 = std::min(height - 1, (int)std::floor(maxY));
+        if (x0 > x1 || y0 > y1)
+            return false; // Off screen
+        const int top = (int)levels.size();
+        return visibleIn(top, x0 >> top, y0 >> top, x1 >> top, y1 >> top, x0, y0, x1, y1, std::max(nearest, 0.0f));
+    }
+
+    /* Keeps the candidates (indices into boxes, e.g. what SceneBvh::cull returned) that may be visible, in order */
+    void cull(const std::vector<Aabb>& boxes, const std::vector<uint32_t>& candidates, std::vector<uint32_t>& kept,
+              ThreadPool* pool = NULL)
+    {
+        flags.resize(candidates.size());
+        auto test = [&](size_t begin, size_t end, unsigned int)
+        {
+            for (size_t i = begin; i < end; i++)
+                flags[i] = visible(boxes[candidates[i]]);
+        };
+        if (pool)
+            pool->parallelFor(candidates.size(), 512, test);
+        else
+            test(0, candidates.size(), 0);
+
+        kept.clear();
+        for (size_t i = 0; i < candidates.size(); i++)
+            if (flags[i])
+                kept.push_back(candidates[i]);
+        statistics.tested += candidates.size();
+        statistics.occluded += candidates.size() - kept.size();
+    }
+
+private:
+    /* Edge functions and depth plane as a * x + b * y + c at pixel centres, plus the pixel bounds (inclusive) */
+    struct RasterTriangle
+    {
+        float edges[3][3];
+        float plane[3];
+        int x0, y0, x1, y1;
+    };
+
+    struct Level
+    {
+        int width, height;
+        std::vector<float> nearest;
+        std::vector<float> farthest;
+    };
+
+    void setupTriangle(const Mat4& viewProjection, size_t t)
+    {
+        RasterTriangle* out = &setup[t * 2];
+        out[0].x0 = out[1].x0 = 1;
+        out[0].x1 = out[1].x1 = 0;
+
+        /* Clip space, then Sutherland-Hodgman against the near plane z >= -w */
+        float in[3][4], polygon[4][4];
+        for (int v = 0; v < 3; v++)
+        {
+            const float* p = &vertices[(size_t)indices[t * 3 + v] * 3];
+            viewProjection.transformPoint(p[0], p[1], p[2], in[v]);
+        }
+        int count = 0;
+        for (int v = 0; v < 3; v++)
+        {
+            const float* a = in[v];
+            const float* b = in[(v + 1) % 3];
+            const float da = a[2] + a[3], db = b[2] + b[3];
+            if (da >= 0.0f)
+                std::copy(a, a + 4, polygon[count++]);
+            if ((da >= 0.0f) != (db >= 0.0f))
+            {
+                const float s = da / (da - db);
+                for (int c = 0; c < 4; c++)
+                    polygon[count][c] = a[c] + (b[c] - a[c]) * s;
+                count++;
+            }
+        }
+
+        float screen[4][3];
+        for (int v = 0; v < count; v++)
+        {
+            const float inverse = 1.0f / std::max(polygon[v][3], 1e-6f);
+            screen[v][0] = (polygon[v][0] * inverse * 0.5f + 0.5f) * (float)width;
+            screen[v][1] = (polygon[v][1] * inverse * 0.5f + 0.5f) * (float)height;
+            screen[v][2] = polygon[v][2] * inverse * 0.5f + 0.5f;
+        }
+        for (int v = 2; v < count; v++)
+            setupScreenTriangle(screen[0], screen[v - 1], screen[v], out[v - 2]);
+    }
+
+    void setupScreenTriangle(const float* v0, const float* v1, const float* v2, RasterTriangle& out) const
+    {
+        float area = (v1[0] - v0[0]) * (v2[1] - v0[1]) - (v1[1] - v0[1]) * (v2[0] - v0[0]);
+        if (area == 0.0f)
+            return;
+        if (area < 0.0f) // Occluders are solid, so both windings count; make it counter-clockwise
+        {
+            std::swap(v1, v2);
+            area = -area;
+        }
+
+        const float* const corners[3] = { v0, v1, v2 };
+        for (int e = 0; e < 3; e++)
+        {
+            const float* a = corners[e];
+            const float* b = corners[(e + 1) % 3];
+            out.edges[e][0] = a[1] - b[1];
+            out.edges[e][1] = b[0] - a[0];
+            out.edges[e][2] = -(out.edges[e][0] * a[0] + out.edges[e][1] * a[1]);
+        }
+        const float dzdx = ((v1[2] - v0[2]) * (v2[1] - v0[1]) - (v2[2] - v0[2]) * (v1[1] - v0[1])) / area;
+        const float dzdy = ((v2[2] - v0[2]) * (v1[0] - v0[0]) - (v1[2] - v0[2]) * (v2[0] - v0[0])) / area;
+        out.plane[0] = dzdx;
+        out.plane[1] = dzdy;
+        out.plane[2] = v0[2] - dzdx * v0[0] - dzdy * v0[1];
+
+        /* Pixels whose centre (p + 0.5) is inside the triangle's bounding box, clamped to the buffer */
+        const float minX = std::min({ v0[0], v1[0], v2[0] }), maxX = std::max({ v0[0], v1[0], v2[0] });
+        const float minY = std::min({ v0[1], v1[1], v2[1] }), maxY = std::max({ v0[1], v1[1], v2[1] });
+        out.x0 = std::max(0, (int)std::ceil(minX - 0.5f));
+        out.x1 = std::min(width - 1, (int)std::floor(maxX - 0.5f));
+        out.y0 = std::max(0, (int)std::ceil(minY - 0.5f));
+        out.y1 = std::min(height - 1, (int)std::floor(maxY - 0.5f));
+        if (std::min({ v0[2], v1[2], v2[2] }) >= 1.0f) // Entirely behind the far plane hides nothing
+            out.x1 = out.x0 - 1;
+    }
+
+    void rasterizeBand(int band)
+    {
+        const int bandY0 = band * BandHeight, bandY1 = bandY0 + BandHeight - 1;
+        std::fill(depth.begin() + (size_t)bandY0 * width, depth.begin() + (size_t)(bandY1 + 1) * width, 1.0f);
+
+        for (const RasterTriangle& t : setup)
+        {
+            if (t.x0 > t.x1 || t.y0 > t.y1 || t.y1 < bandY0 || t.y0 > bandY1)
+                continue;
+            for (int y = std::max(t.y0, bandY0); y <= std::min(t.y1, bandY1); y++)
+            {
+                float* row = &depth[(size_t)y * width];
+                for (int x = t.x0 & ~7; x <= t.x1; x += 8)
+                    depthBlock8(t, row + x, (float)x + 0.5f, (float)y + 0.5f);
+            }
+        }
+
+        /* This band's share of the first hierarchy level */
+        reduceLevel(0, bandY0 / 2, (bandY1 + 1) / 2);
+    }
+
+    /* Writes the triangle's depth into the pixels of row[0..3] it covers where it is nearer. x is the centre of the
+       first one. */
+    static void depthBlock4(const RasterTriangle& t, float* row, float x, float y)
+    {
+#ifdef HELLO_SSE2
+        const __m128 px = _mm_add_ps(_mm_set1_ps(x), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+        const __m128 py = _mm_set1_ps(y);
+        const __m128 zero = _mm_setzero_ps();
+        __m128 inside = _mm_cmpeq_ps(zero, zero);
+        for (int e = 0; e < 3; e++)
+        {
+            const __m128 f = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.edges[e][0]), px),
+                                                   _mm_mul_ps(_mm_set1_ps(t.edges[e][1]), py)),
+                                        _mm_set1_ps(t.edges[e][2]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(f, zero));
+        }
+        if (_mm_movemask_ps(inside) == 0)
+            return;
+        const __m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(t.plane[0]), px),
+                                               _mm_mul_ps(_mm_set1_ps(t.plane[1]), py)),
+                                    _mm_set1_ps(t.plane[2]));
+        const __m128 old = _mm_loadu_ps(row);
+        _mm_storeu_ps(row, _mm_or_ps(_mm_and_ps(inside, _mm_min_ps(old, z)), _mm_andnot_ps(inside, old)));
+#else
+        for (int lane = 0; lane < 4; lane++)
+        {
+            const float px = x + (float)lane;
+            bool inside = true;
+            for (int e = 0; e < 3; e++)
+                inside = inside && t.edges[e][0] * px + t.edges[e][1] * y + t.edges[e][2] >= 0.0f;
+            if (inside)
+                row[lane] = std::min(row[lane], t.plane[0] * px + t.plane[1] * y + t.plane[2]);
+        }
+#endif
+    }
+
+    /* Same for row[0..7] */
+    static void depthBlock8(const RasterTriangle& t, float* row, float x, float y)
+    {
+#ifdef HELLO_AVX
+        const __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+        const __m256 px = _mm256_add_ps(_mm256_set1_ps(x), lanes);
+        const __m256 py = _mm256_set1_ps(y);
+        const __m256 zero = _mm256_setzero_ps();
+        __m256 inside = _mm256_cmp_ps(zero, zero, _CMP_EQ_OQ);
+        for (int e = 0; e < 3; e++)
+        {
+            const __m256 f = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(t.edges[e][0]), px),
+                                                         _mm256_mul_ps(_mm256_set1_ps(t.edges[e][1]), py)),
+                                           _mm256_set1_ps(t.edges[e][2]));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(f, zero, _CMP_GE_OQ));
+        }
+        if (_mm256_movemask_ps(inside) == 0)
+            return;
+        const __m256 z = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(t.plane[0]), px),
+                                                     _mm256_mul_ps(_mm256_set1_ps(t.plane[1]), py)),
+                                       _mm256_set1_ps(t.plane[2]));
+        const __m256 old = _mm256_loadu_ps(row);
+        _mm256_storeu_ps(row, _mm256_blendv_ps(old, _mm256_min_ps(old, z), inside));
+#else
+        depthBlock4(t, row, x, y);
+        depthBlock4(t, row + 4, x + 4.0f, y);
+#endif
+    }
+
+    float nearestAt(int level, int x, int y) const
+    {
+        if (level == 0)
+            return depth[(size_t)y * width + x];
+        const Level& l = levels[level - 1];
+        return l.nearest[(size_t)y * l.width + x];
+    }
+
+    float farthestAt(int level, int x, int y) const
+    {
+        if (level == 0)
+            return depth[(size_t)y * width + x];
+        const Level& l = levels[level - 1];
+        return l.farthest[(size_t)y * l.width + x];
+    }
+
+    /* Fills rows [y0, y1) of levels[index] from the level below it (the depth buffer for index 0) */
+    void reduceLevel(size_t index, int y0, int y1)
+    {
+        Level& level = levels[index];
+        const int below = (int)index; // Level number of the source in nearestAt/farthestAt terms
+        const int belowWidth = index == 0 ? width : levels[index - 1].width;
+        const int belowHeight = index == 0 ? height : levels[index - 1].height;
+        for (int y = y0; y < std::min(y1, level.height); y++)
+        {
+            const int sy0 = y * 2, sy1 = std::min(y * 2 + 1, belowHeight - 1);
+            for (int x = 0; x < level.width; x++)
+            {
+                const int sx0 = x * 2, sx1 = std::min(x * 2 + 1, belowWidth - 1);
+                const size_t cell = (size_t)y * level.width + x;
+                level.nearest[cell] = std::min({ nearestAt(below, sx0, sy0), nearestAt(below, sx1, sy0),
+                                                 nearestAt(below, sx0, sy1), nearestAt(below, sx1, sy1) });
+                level.farthest[cell] = std::max({ farthestAt(below, sx0, sy0), farthestAt(below, sx1, sy0),
+                                                  farthestAt(below, sx0, sy1), farthestAt(below, sx1, sy1) });
+            }
+        }
+    }
+
+    /* Cells [cx0, cx1] x [cy0, cy1] of a level, all overlapping the pixel rectangle [x0, x1] x [y0, y1] */
+    bool visibleIn(int level, int cx0, int cy0, int cx1, int cy1, int x0, int y0, int x1, int y1, float z) const
+    {
+        for (int cy = cy0; cy <= cy1; cy++)
+            for (int cx = cx0; cx <= cx1; cx++)
+            {
+                if (z <= nearestAt(level, cx, cy))
+                    return true; // In front of everything in the cell
+                if (z > farthestAt(level, cx, cy))
+                    continue; // Behind everything in the cell
+                const int child = level - 1; // Only reached above level 0, where nearest == farthest
+                if (visibleIn(child, std::max(cx * 2, x0 >> child), std::max(cy * 2, y0 >> child),
+                              std::min(cx * 2 + 1, x1 >> child), std::min(cy * 2 + 1, y1 >> child), x0, y0, x1, y1, z))
+                    return true;
+            }
+        return false;
+    }
+
+    int width, height;
+    std::vector<float> depth;
+    std::vector<Level> levels; // levels[i] is hierarchy level i + 1; level 0 is depth itself
+
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<RasterTriangle> setup;
+    std::vector<uint8_t> flags;
+    Mat4 view = Mat4::identity();
+    Stats statistics;
+};
+
+#endif
@@ -0,0 +1,245 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "GLExtensions.h"
+#include "Shader.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*******************************************************************************************************************************
+On-disk program binary cache
+*******************************************************************************************************************************/
+/* Compiling and linking GLSL happens on every launch and gets slow once there are many shaders. Drivers can hand us the
+   linked program as an opaque blob (glGetProgramBinary) and take it back later (glProgramBinary), skipping the compile.
+   The blob is only valid for the exact driver that produced it, so the cache key hashes the shader sources together
+   with GL_VENDOR/GL_RENDERER/GL_VERSION. A driver update changes the key; a driver that still rejects a blob
+   (GL_LINK_STATUS false after glProgramBinary) makes us fall back to a normal compile and overwrite the entry.
+
+   One file per program: <directory>/<key in hex>.bin = CacheFileHeader + binary */
+class ProgramCache
+{
+public:
+    struct Stats
+    {
+        unsigned int hits = 0;
+        unsigned int misses = 0;
+        unsigned int rejected = 0;  // found on disk but the driver refused it
+        double loadMs = 0.0;        // time spent in glProgramBinary for hits
+        double compileMs = 0.0;     // time spent compiling + linking misses
+        double savedMs = 0.0;       // compile time recorded with each hit minus what the hit cost
+    };
+
+    /* An empty directory disables the cache; load() then always compiles */
+    explicit ProgramCache(const std::string& directory)
+        : directory(directory), timerFrequency((double)glfwGetTimerFrequency())
+    {
+        const char* parts[] = {
+            (const char*)glGetString(GL_VENDOR),
+            (const char*)glGetString(GL_RENDERER),
+            (const char*)glGetString(GL_VERSION) };
+        for (const char* part : parts)
+        {
+            driverString += part ? part : "?";
+            driverString += '|';
+        }
+
+        if (enabled())
+        {
+            std::error_code error;
+            std::filesystem::create_directories(directory, error);
+        }
+    }
+
+    bool enabled() const { return !directory.empty() && glext.programBinary; }
+
+    /* 64-bit FNV-1a over the driver string and every source (each terminated, so "ab"+"c" != "a"+"bc") */
+    uint64_t key(const char* const* sources, size_t count) const
+    {
+        uint64_t hash = 14695981039346656037ull;
+        hash = fnv1a(hash, driverString.c_str(), driverString.size() + 1);
+        for (size_t i = 0; i < count; i++)
+            hash = fnv1a(hash, sources[i], std::char_traits<char>::length(sources[i]) + 1);
+        return hash;
+    }
+
+    /* Returns a linked program on a hit, 0 on a miss (or if the driver rejected the stored binary) */
+    unsigned int tryLoad(uint64_t key)
+    {
+        if (!enabled())
+            return 0;
+
+        std::ifstream in(pathFor(key), std::ios::binary);
+        if (!in)
+            return 0;
+
+        CacheFileHeader header;
+        if (!in.read((char*)&header, sizeof(header)) || header.magic != Magic || header.version != Version ||
+            header.key != key)
+            return 0;
+
+        /* The file is the header and then exactly the binary; a length that disagrees means it's truncated or corrupt,
+           and trusting it could ask for gigabytes */
+        const std::streampos binaryStart = in.tellg();
+        in.seekg(0, std::ios::end);
+        const std::streamoff remaining = in.tellg() - binaryStart;
+        if (header.length == 0 || remaining != (std::streamoff)header.length)
+            return 0;
+        in.seekg(binaryStart);
+
+        std::vector<char> binary(header.length);
+        if (!in.read(binary.data(), binary.size()))
+            return 0;
+
+        const uint64_t start = glfwGetTimerValue();
+        unsigned int program = glCreateProgram();
+        glext.ProgramBinary(program, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+
+        int success = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            glDeleteProgram(program);
+            stats.rejected++;
+            return 0;
+        }
+
+        const double ms = toMs(glfwGetTimerValue() - start);
+        stats.hits++;
+        stats.loadMs += ms;
+        if (header.compileMs > ms)
+            stats.savedMs += header.compileMs - ms;
+        return program;
+    }
+
+    /* Call before glLinkProgram on a miss, otherwise some drivers refuse to hand out the binary afterwards */
+    void prepareForStore(unsigned int program) const
+    {
+        if (enabled())
+            glext.ProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    /* Saves a freshly linked program. compileMs is remembered so later hits can report the time they saved */
+    void store(uint64_t key, unsigned int program, double compileMs)
+    {
+        stats.misses++;
+        stats.compileMs += compileMs;
+        if (!enabled())
+            return;
+
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+
+        std::vector<char> binary(length);
+        CacheFileHeader header;
+        header.key = key;
+        header.compileMs = compileMs;
+        glext.GetProgramBinary(program, length, NULL, &header.binaryFormat, binary.data());
+        header.length = (uint32_t)length;
+
+        /* Write to a temporary name first so a crash mid-write never leaves a truncated entry behind */
+        const std::string path = pathFor(key);
+        const std::string temporary = path + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            if (!out.write((const char*)&header, sizeof(header)) || !out.write(binary.data(), binary.size()))
+                return;
+        }
+        std::error_code error;
+        std::filesystem::rename(temporary, path, error);
+    }
+
+    /* Convenience for the common vertex + fragment case: load from the cache or compile, link and store */
+    unsigned int load(const char* vertexSource, const char* fragmentSource)
+    {
+        const char* sources[] = { vertexSource, fragmentSource };
+        const uint64_t programKey = key(sources, 2);
+
+        unsigned int program = tryLoad(programKey);
+        if (program)
+            return program;
+
+        const uint64_t start = glfwGetTimerValue();
+        unsigned int vertexShader = compileShader(GL_VERTEX_SHADER, vertexSource, "VERTEX");
+        unsigned int fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentSource, "FRAGMENT");
+
+        program = glCreateProgram();
+        glAttachShader(program, vertexShader);
+        glAttachShader(program, fragmentShader);
+        prepareForStore(program);
+        glLinkProgram(program);
+        const bool linked = checkProgramLinked(program);
+
+        /* Delete shader objects as we no longer need them */
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+
+        if (linked)
+            store(programKey, program, toMs(glfwGetTimerValue() - start));
+        return program;
+    }
+
+    const Stats& statistics() const { return stats; }
+
+    void printReport(std::ostream& out) const
+    {
+        out << "Program cache: " << stats.hits << " hit(s), " << stats.misses << " miss(es)";
+        if (stats.rejected)
+            out << ", " << stats.rejected << " rejected by driver";
+        out << "; compiled in " << stats.compileMs << " ms, loaded in " << stats.loadMs << " ms, saved ~"
+            << stats.savedMs << " ms";
+        if (!enabled())
+            out << " (cache disabled" << (glext.programBinary ? "" : ": no program binary support") << ")";
+        out << std::endl;
+    }
+
+private:
+    static const uint32_t Magic = 0x43504248; // "HBPC"
+    static const uint32_t Version = 1;
+
+    struct CacheFileHeader
+    {
+        uint32_t magic = Magic;
+        uint32_t version = Version;
+        uint64_t key = 0;
+        GLenum binaryFormat = 0;
+        uint32_t length = 0;
+        double compileMs = 0.0;
+    };
+
+    static uint64_t fnv1a(uint64_t hash, const char* data, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= (unsigned char)data[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    std::string pathFor(uint64_t key) const
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+        return (std::filesystem::path(directory) / name).string();
+    }
+
+    double toMs(uint64_t ticks) const { return (double)ticks * 1000.0 / timerFrequency; }
+
+    std::string directory;
+    std::string driverString;
+    double timerFrequency;
+    Stats stats;
+};
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/*******************************************************************************************************************************
+LSD radix sort for 64-bit sort keys
+*******************************************************************************************************************************/
+/* Sorts entries by key, then by sequence number, so equal keys come out in a fixed order. Comparison sorts need
+   log2(n) passes over the data with unpredictable branches in each (20 for a million draws); this needs at most 8
+   branch-free passes over 13-bit digits, from the least significant up, each stable so it keeps the order the earlier
+   digits made. A million entries don't fit in cache, so every pass costs a full read and scattered write of the
+   array; wider digits mean fewer of them, and 13 bits measured quickest.
+
+   Entries usually arrive in sequence order already (lists are gathered in order and each records its draws in
+   order), and then stability alone keeps equal keys in sequence order: the three sequence passes only run when a
+   quick scan finds an entry out of order. All histograms are counted in one read of the input, and a digit that is
+   the same in every entry (unused key fields, a layer everything shares) can't change the order, so its pass is
+   skipped; typical draw keys need 4 or 5 passes. Below about a thousand entries clearing the histograms costs more than
+   the sort, so small inputs go to std::sort. */
+struct SortEntry
+{
+    uint64_t key;
+    uint32_t sequence;
+    uint32_t payload; // whatever the caller needs to find the item again
+};
+
+/* scratch is resized to entries.size() and may end up swapped with entries; keep both around between calls so the
+   memory is reused */
+inline void radixSort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch)
+{
+    const unsigned int DigitBits = 13, Buckets = 1u << DigitBits, Mask = Buckets - 1;
+    const unsigned int SequencePasses = 3, KeyPasses = 5; // ceil(32 / 13), ceil(64 / 13)
+    const unsigned int Passes = SequencePasses + KeyPasses;
+    const size_t SmallSort = 1024;
+    const size_t count = entries.size();
+    if (count < SmallSort)
+    {
+        std::sort(entries.begin(), entries.end(), [](const SortEntry& a, const SortEntry& b)
+            { return a.key != b.key ? a.key < b.key : a.sequence < b.sequence; });
+        return;
+    }
+    scratch.resize(count);
+
+    bool inSequence = true;
+    for (size_t i = 1; i < count && inSequence; i++)
+        inSequence = entries[i - 1].sequence <= entries[i].sequence;
+
+    static thread_local uint32_t histograms[Passes][Buckets];
+    for (unsigned int pass = inSequence ? SequencePasses : 0; pass < Passes; pass++)
+        for (unsigned int d = 0; d < Buckets; d++)
+            histograms[pass][d] = 0;
+    for (const SortEntry& entry : entries)
+    {
+        if (!inSequence)
+            for (unsigned int p = 0; p < SequencePasses; p++)
+                histograms[p][(entry.sequence >> (p * DigitBits)) & Mask]++;
+        for (unsigned int p = 0; p < KeyPasses; p++)
+            histograms[SequencePasses + p][(unsigned int)(entry.key >> (p * DigitBits)) & Mask]++;
+    }
+
+    SortEntry* from = entries.data();
+    SortEntry* to = scratch.data();
+    for (unsigned int pass = inSequence ? SequencePasses : 0; pass < Passes; pass++)
+    {
+        const bool sequencePass = pass < SequencePasses;
+        const unsigned int shift = (sequencePass ? pass : pass - SequencePasses) * DigitBits;
+        uint32_t* histogram = histograms[pass];
+        const unsigned int first = sequencePass ? (from[0].sequence >> shift) & Mask
+                                                : (unsigned int)(from[0].key >> shift) & Mask;
+        if (histogram[first] == count)
+            continue;
+
+        uint32_t sum = 0;
+        for (unsigned int d = 0; d < Buckets; d++)
+        {
+            const uint32_t size = histogram[d];
+            histogram[d] = sum; // now the offset each digit's entries start at
+            sum += size;
+        }
+
+        /* The field is fixed per pass, so the inner loops don't branch on which one they read */
+        if (sequencePass)
+            for (size_t i = 0; i < count; i++)
+                to[histogram[(from[i].sequence >> shift) & Mask]++] = from[i];
+        else
+            for (size_t i = 0; i < count; i++)
+                to[histogram[(unsigned int)(from[i].key >> shift) & Mask]++] = from[i];
+        std::swap(from, to);
+    }
+
+    if (from != entries.data())
+        entries.swap(scratch);
+}
+
+#endif
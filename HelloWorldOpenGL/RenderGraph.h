@@ -0,0 +1,745 @@
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <glad/glad.h>
+
+#include "GLExtensions.h"
+#include "GLState.h"
+#include "GpuProfiler.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <vector>
+
+/*******************************************************************************************************************************
+Render graph: off-screen passes and the transient targets between them
+*******************************************************************************************************************************/
+/* Every frame the loop declares its passes and the render targets each one reads and writes, then compiles and runs
+   the graph:
+
+       RenderGraph::Resource color = graph.createTexture("scene color", width, height, GL_RGBA8);
+       graph.addPass("scene").write(color).run([&](RenderGraph::PassContext& pass) { ...draw... });
+       graph.addPass("present").read(color).write(graph.backbuffer(width, height)).run(...);
+       graph.compile();
+       graph.execute(profiler);
+
+   Declared targets are only descriptions. compile() works out, without touching GL:
+       - which passes matter: those writing the backbuffer or marked keep(), and everything they depend on. The rest
+         are dropped, and so are the targets only they used.
+       - an order. Dependencies go first; among the passes free to go next it prefers one with the same targets as the
+         pass before, so the framebuffer doesn't have to change.
+       - which targets can share storage. Two targets of the same size and format whose lifetimes (first to last use,
+         in that order) don't overlap get the same texture or renderbuffer.
+   GL has no way to place two images in the same memory, so sharing whole objects is how aliasing works here. The
+   objects and the framebuffers made from them outlive the frame; execute() hands them to the next frame's targets
+   and deletes the ones that went unused for a few frames (after a resize, say). */
+class RenderGraph
+{
+public:
+    typedef uint32_t Resource;
+    static constexpr Resource NoResource = 0xFFFFFFFFu;
+
+    enum class Kind { Texture, Renderbuffer, Backbuffer };
+
+    class PassContext;
+    typedef std::function<void(PassContext& pass)> Execute;
+
+    /* Returned by addPass. It points into the graph, so finish with it before adding the next pass. */
+    struct Pass
+    {
+        const char* name;          // Also its GPU profiler scope, so it has to outlive the graph (a literal)
+        std::vector<Resource> reads;
+        std::vector<Resource> writes; // Colour attachments in this order, plus at most one depth target
+        Execute execute;
+        bool sideEffects = false;
+
+        Pass& read(Resource resource)
+        {
+            reads.push_back(resource);
+            return *this;
+        }
+        Pass& write(Resource resource)
+        {
+            writes.push_back(resource);
+            return *this;
+        }
+        /* Never culled, e.g. because the CPU reads back what it draws */
+        Pass& keep()
+        {
+            sideEffects = true;
+            return *this;
+        }
+        Pass& run(Execute function)
+        {
+            execute = std::move(function);
+            return *this;
+        }
+    };
+
+    /* What a pass's function gets. Its targets are bound and the viewport covers them. */
+    class PassContext
+    {
+    public:
+        int width() const { return targetWidth; }
+        int height() const { return targetHeight; }
+
+        /* The texture behind a Texture resource the pass reads */
+        unsigned int texture(Resource resource) const { return graph.objectOf(resource); }
+
+        /* Copies a colour target into (x, y, width, height) of the pass's targets, linearly filtered */
+        void blit(Resource source, int x, int y, int width, int height) const
+        {
+            graph.blit(source, x, y, width, height);
+        }
+        void blit(Resource source) const { blit(source, 0, 0, targetWidth, targetHeight); }
+
+    private:
+        friend class RenderGraph;
+        PassContext(RenderGraph& graph, int width, int height)
+            : graph(graph), targetWidth(width), targetHeight(height) {}
+
+        RenderGraph& graph;
+        int targetWidth;
+        int targetHeight;
+    };
+
+    /* Of the last compile() and execute() */
+    struct Statistics
+    {
+        size_t passes = 0;           // declared
+        size_t culledPasses = 0;
+        size_t targets = 0;          // transient targets the remaining passes use
+        size_t sharedTargets = 0;    // textures/renderbuffers those were packed into
+        size_t targetBytes = 0;      // memory the targets would need with one object each
+        size_t sharedBytes = 0;      // memory they need packed
+        size_t declaredBinds = 0;    // framebuffer changes if the passes ran in declaration order
+        size_t sortedBinds = 0;      // framebuffer changes in the compiled order
+        size_t framebufferBinds = 0; // glBindFramebuffer calls execute() made, including restoring the backbuffer
+    };
+
+    RenderGraph() = default;
+    ~RenderGraph()
+    {
+        for (const std::pair<const std::vector<uint64_t>, unsigned int>& entry : framebuffers)
+            glDeleteFramebuffers(1, &entry.second);
+        for (const Target& target : targets)
+            deleteTarget(target);
+    }
+
+    /* Drops last frame's passes and targets (not the GL objects behind them) */
+    void reset()
+    {
+        passes.clear();
+        resources.clear();
+        order.clear();
+        slots.clear();
+        backbufferResource = NoResource;
+        compiled = false;
+    }
+
+    Resource createTexture(const char* name, int width, int height, GLenum format)
+    {
+        return addResource(name, Kind::Texture, width, height, format);
+    }
+
+    /* For targets that are drawn to but never sampled, like a depth buffer */
+    Resource createRenderbuffer(const char* name, int width, int height, GLenum format)
+    {
+        return addResource(name, Kind::Renderbuffer, width, height, format);
+    }
+
+    /* The window's framebuffer. Passes writing it are the graph's outputs. */
+    Resource backbuffer(int width, int height)
+    {
+        if (backbufferResource == NoResource)
+            backbufferResource = addResource("backbuffer", Kind::Backbuffer, width, height, GL_RGBA8);
+        return backbufferResource;
+    }
+
+    Pass& addPass(const char* name)
+    {
+        passes.push_back(Pass());
+        passes.back().name = name;
+        return passes.back();
+    }
+
+    /* Culls, orders and packs the declared passes and targets. False (printing why) if the graph makes no sense;
+       execute() then does nothing. */
+    bool compile()
+    {
+        stats = Statistics();
+        stats.passes = passes.size();
+        order.clear();
+        slots.clear();
+        compiled = false;
+
+        /* Writers of each resource in declaration order. A pass may only read what an earlier pass wrote. */
+        std::vector<std::vector<uint32_t>> writers(resources.size());
+        for (uint32_t p = 0; p < (uint32_t)passes.size(); p++)
+        {
+            const Pass& pass = passes[p];
+            for (Resource resource : pass.reads)
+            {
+                if (resource >= resources.size())
+                    return fail("UNKNOWN_RESOURCE", pass, resource);
+                if (resources[resource].kind != Kind::Backbuffer && writers[resource].empty())
+                    return fail("READ_BEFORE_WRITE", pass, resource);
+            }
+            int depthTargets = 0;
+            for (Resource resource : pass.writes)
+            {
+                if (resource >= resources.size())
+                    return fail("UNKNOWN_RESOURCE", pass, resource);
+                const ResourceInfo& info = resources[resource];
+                const ResourceInfo& first = resources[pass.writes[0]];
+                if (info.width != first.width || info.height != first.height)
+                    return fail("TARGET_SIZE_MISMATCH", pass, resource);
+                if ((info.kind == Kind::Backbuffer) != (first.kind == Kind::Backbuffer))
+                    return fail("BACKBUFFER_WITH_TARGETS", pass, resource);
+                if (isDepthFormat(info.format) && ++depthTargets > 1)
+                    return fail("TOO_MANY_DEPTH_TARGETS", pass, resource);
+                writers[resource].push_back(p);
+            }
+        }
+
+        /* Culling: start from the outputs and pull in every earlier writer of what they read or write */
+        std::vector<char> live(passes.size(), 0);
+        std::vector<uint32_t> stack;
+        for (uint32_t p = 0; p < (uint32_t)passes.size(); p++)
+        {
+            const Pass& pass = passes[p];
+            if (pass.sideEffects || (backbufferResource != NoResource &&
+                                     std::find(pass.writes.begin(), pass.writes.end(), backbufferResource) !=
+                                         pass.writes.end()))
+            {
+                live[p] = 1;
+                stack.push_back(p);
+            }
+        }
+        while (!stack.empty())
+        {
+            const uint32_t p = stack.back();
+            stack.pop_back();
+            for (int list = 0; list < 2; list++)
+                for (Resource resource : list == 0 ? passes[p].reads : passes[p].writes)
+                    for (uint32_t writer : writers[resource])
+                        if (writer < p && !live[writer])
+                        {
+                            live[writer] = 1;
+                            stack.push_back(writer);
+                        }
+        }
+
+        /* Dependencies between the live passes: a read waits for the last write before it, a write for the last
+           write and every read since */
+        std::vector<std::vector<uint32_t>> successors(passes.size());
+        std::vector<uint32_t> waitingFor(passes.size(), 0);
+        std::vector<uint32_t> lastWriter(resources.size(), NoResource);
+        std::vector<std::vector<uint32_t>> readersSinceWrite(resources.size());
+        const std::vector<Resource>* current = NULL;
+        for (uint32_t p = 0; p < (uint32_t)passes.size(); p++)
+        {
+            if (!live[p])
+            {
+                stats.culledPasses++;
+                continue;
+            }
+            const Pass& pass = passes[p];
+            for (Resource resource : pass.reads)
+                if (lastWriter[resource] != NoResource)
+                    addDependency(lastWriter[resource], p, successors, waitingFor);
+            for (Resource resource : pass.writes)
+            {
+                if (lastWriter[resource] != NoResource)
+                    addDependency(lastWriter[resource], p, successors, waitingFor);
+                for (uint32_t reader : readersSinceWrite[resource])
+                    if (reader != p)
+                        addDependency(reader, p, successors, waitingFor);
+            }
+            for (Resource resource : pass.reads)
+                readersSinceWrite[resource].push_back(p);
+            for (Resource resource : pass.writes)
+            {
+                lastWriter[resource] = p;
+                readersSinceWrite[resource].clear();
+            }
+            stats.declaredBinds += changesTargets(pass, current);
+        }
+
+        /* Ordering: of the passes whose dependencies have run, take the first declared one that keeps the current
+           targets, or else the first declared one */
+        std::vector<uint32_t> ready;
+        for (uint32_t p = 0; p < (uint32_t)passes.size(); p++)
+            if (live[p] && waitingFor[p] == 0)
+                ready.push_back(p);
+        current = NULL;
+        while (!ready.empty())
+        {
+            size_t pick = 0;
+            bool pickKeeps = keepsTargets(passes[ready[0]], current);
+            for (size_t i = 1; i < ready.size(); i++)
+            {
+                const bool keeps = keepsTargets(passes[ready[i]], current);
+                if ((keeps && !pickKeeps) || (keeps == pickKeeps && ready[i] < ready[pick]))
+                {
+                    pick = i;
+                    pickKeeps = keeps;
+                }
+            }
+            const uint32_t p = ready[pick];
+            ready.erase(ready.begin() + (ptrdiff_t)pick);
+            order.push_back(p);
+            stats.sortedBinds += changesTargets(passes[p], current);
+            for (uint32_t next : successors[p])
+                if (--waitingFor[next] == 0)
+                    ready.push_back(next);
+        }
+
+        /* Lifetimes in that order, then packing: targets in order of first use, each into the first slot of its
+           description that is free by then. For intervals that greedy choice needs the fewest slots. */
+        for (ResourceInfo& info : resources)
+            info.firstUse = info.lastUse = -1;
+        for (int position = 0; position < (int)order.size(); position++)
+            for (int list = 0; list < 2; list++)
+                for (Resource resource : list == 0 ? passes[order[position]].reads : passes[order[position]].writes)
+                {
+                    ResourceInfo& info = resources[resource];
+                    if (info.firstUse < 0)
+                        info.firstUse = position;
+                    info.lastUse = position;
+                }
+
+        std::vector<Resource> transients;
+        for (Resource resource = 0; resource < (Resource)resources.size(); resource++)
+            if (resources[resource].kind != Kind::Backbuffer && resources[resource].firstUse >= 0)
+                transients.push_back(resource);
+        std::stable_sort(transients.begin(), transients.end(), [&](Resource a, Resource b)
+        {
+            return resources[a].firstUse < resources[b].firstUse;
+        });
+        for (Resource resource : transients)
+        {
+            ResourceInfo& info = resources[resource];
+            const size_t bytes = targetBytes(info);
+            info.slot = NoResource;
+            for (uint32_t s = 0; s < (uint32_t)slots.size() && info.slot == NoResource; s++)
+                if (sameDescription(slots[s], info) && slots[s].lastUse < info.firstUse)
+                    info.slot = s;
+            if (info.slot == NoResource)
+            {
+                Slot slot;
+                slot.kind = info.kind;
+                slot.width = info.width;
+                slot.height = info.height;
+                slot.format = info.format;
+                info.slot = (uint32_t)slots.size();
+                slots.push_back(slot);
+                stats.sharedTargets++;
+                stats.sharedBytes += bytes;
+            }
+            slots[info.slot].lastUse = info.lastUse;
+            stats.targets++;
+            stats.targetBytes += bytes;
+        }
+
+        compiled = true;
+        return true;
+    }
+
+    /* Runs the compiled passes. The backbuffer is bound again when it returns. */
+    void execute(GpuProfiler* profiler = NULL)
+    {
+        if (!compiled)
+            return;
+        frame++;
+        stats.framebufferBinds = 0;
+
+        /* Hand each slot an object of its description, preferring ones made in earlier frames */
+        for (Slot& slot : slots)
+        {
+            slot.target = NoResource;
+            for (uint32_t t = 0; t < (uint32_t)targets.size() && slot.target == NoResource; t++)
+                if (targets[t].lastFrame != frame && sameDescription(targets[t], slot))
+                    slot.target = t;
+            if (slot.target == NoResource)
+            {
+                slot.target = (uint32_t)targets.size();
+                targets.push_back(createTarget(slot));
+            }
+            targets[slot.target].lastFrame = frame;
+        }
+        releaseUnusedTargets();
+
+        unsigned int bound = NoFramebuffer;
+        readBound = false;
+        for (uint32_t p : order)
+        {
+            const Pass& pass = passes[p];
+            int width = 0, height = 0;
+            if (!pass.writes.empty())
+            {
+                const ResourceInfo& first = resources[pass.writes[0]];
+                width = first.width;
+                height = first.height;
+                const unsigned int framebuffer =
+                    first.kind == Kind::Backbuffer ? 0 : framebufferFor(pass.writes, GL_FRAMEBUFFER);
+                if (framebuffer != bound)
+                {
+                    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+                    bound = framebuffer;
+                    readBound = false;
+                    stats.framebufferBinds++;
+                }
+                glViewport(0, 0, width, height);
+            }
+            if (pass.execute)
+            {
+                const size_t scope = profiler ? profiler->beginScope(pass.name) : GpuProfiler::NoScope;
+                PassContext context(*this, width, height);
+                pass.execute(context);
+                if (profiler)
+                    profiler->endScope(scope);
+            }
+        }
+        if ((bound != 0 && bound != NoFramebuffer) || readBound)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            stats.framebufferBinds++;
+        }
+
+        totalFrames++;
+        totalBinds += stats.framebufferBinds;
+        peakBytes = std::max(peakBytes, stats.sharedBytes);
+    }
+
+    const Statistics& statistics() const { return stats; }
+    const std::vector<uint32_t>& passOrder() const { return order; }
+    bool isCulled(size_t pass) const
+    {
+        return compiled && std::find(order.begin(), order.end(), (uint32_t)pass) == order.end();
+    }
+
+    void printSummary(std::ostream& out) const
+    {
+        out << "Render graph: " << stats.passes << " passes (" << stats.culledPasses << " culled), "
+            << stats.targets << " transient targets in " << stats.sharedTargets << " objects, "
+            << stats.sharedBytes / 1024 << " KB instead of " << stats.targetBytes / 1024 << " KB" << std::endl;
+        out << "  framebuffer changes per frame: " << stats.sortedBinds << " sorted, " << stats.declaredBinds
+            << " in declaration order; " << (totalFrames ? (double)totalBinds / (double)totalFrames : 0.0)
+            << " binds per frame over " << totalFrames << " frames" << std::endl;
+        out << "  peak transient memory " << peakBytes / 1024 << " KB, " << targets.size() << " objects and "
+            << framebuffers.size() << " framebuffers alive" << std::endl;
+    }
+
+    /* Bytes per pixel of the formats createTexture/createRenderbuffer accept, 0 for anything else */
+    static size_t formatBytes(GLenum format)
+    {
+        const FormatInfo* info = formatInfo(format);
+        return info ? info->bytes : 0;
+    }
+
+private:
+    static constexpr unsigned int NoFramebuffer = 0xFFFFFFFFu;
+    static constexpr uint64_t KeepUnusedFrames = 3;
+
+    struct FormatInfo
+    {
+        GLenum format;
+        size_t bytes;
+        GLenum pixelFormat; // for glTexImage2D when glTexStorage2D isn't there
+        GLenum pixelType;
+    };
+
+    struct ResourceInfo
+    {
+        const char* name;
+        Kind kind;
+        int width;
+        int height;
+        GLenum format;
+        int firstUse;
+        int lastUse;
+        uint32_t slot;
+    };
+
+    /* One object's worth of storage in this frame's plan */
+    struct Slot
+    {
+        Kind kind;
+        int width;
+        int height;
+        GLenum format;
+        int lastUse = -1;
+        uint32_t target = NoResource; // into targets, set by execute()
+    };
+
+    /* A texture or renderbuffer that lives across frames */
+    struct Target
+    {
+        Kind kind;
+        int width;
+        int height;
+        GLenum format;
+        unsigned int id;
+        uint64_t lastFrame;
+    };
+
+    static const FormatInfo* formatInfo(GLenum format)
+    {
+        static const FormatInfo formats[] = {
+            { GL_RGBA8, 4, GL_RGBA, GL_UNSIGNED_BYTE },
+            { GL_RGB10_A2, 4, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV },
+            { GL_R11F_G11F_B10F, 4, GL_RGB, GL_UNSIGNED_INT_10F_11F_11F_REV },
+            { GL_RGBA16F, 8, GL_RGBA, GL_HALF_FLOAT },
+            { GL_RGBA32F, 16, GL_RGBA, GL_FLOAT },
+            { GL_R8, 1, GL_RED, GL_UNSIGNED_BYTE },
+            { GL_RG8, 2, GL_RG, GL_UNSIGNED_BYTE },
+            { GL_R16F, 2, GL_RED, GL_HALF_FLOAT },
+            { GL_RG16F, 4, GL_RG, GL_HALF_FLOAT },
+            { GL_R32F, 4, GL_RED, GL_FLOAT },
+            { GL_DEPTH_COMPONENT24, 4, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT },
+            { GL_DEPTH_COMPONENT32F, 4, GL_DEPTH_COMPONENT, GL_FLOAT },
+            { GL_DEPTH24_STENCIL8, 4, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8 },
+            { GL_DEPTH32F_STENCIL8, 8, GL_DEPTH_STENCIL, GL_FLOAT_32_UNSIGNED_INT_24_8_REV },
+        };
+        for (const FormatInfo& info : formats)
+            if (info.format == format)
+                return &info;
+        return NULL;
+    }
+
+    static bool isDepthFormat(GLenum format)
+    {
+        return format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F || hasStencil(format);
+    }
+    static bool hasStencil(GLenum format) { return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8; }
+
+    static size_t targetBytes(const ResourceInfo& info)
+    {
+        return (size_t)info.width * (size_t)info.height * formatBytes(info.format);
+    }
+
+    template <typename A, typename B>
+    static bool sameDescription(const A& a, const B& b)
+    {
+        return a.kind == b.kind && a.width == b.width && a.height == b.height && a.format == b.format;
+    }
+
+    Resource addResource(const char* name, Kind kind, int width, int height, GLenum format)
+    {
+        if (!formatInfo(format) || width <= 0 || height <= 0)
+            std::cout << "ERROR::RENDER_GRAPH::BAD_TARGET " << name << " (" << width << "x" << height << ", format 0x"
+                      << std::hex << format << std::dec << ")" << std::endl;
+        ResourceInfo info;
+        info.name = name;
+        info.kind = kind;
+        info.width = std::max(1, width);
+        info.height = std::max(1, height);
+        info.format = formatInfo(format) ? format : GL_RGBA8;
+        info.firstUse = info.lastUse = -1;
+        info.slot = NoResource;
+        resources.push_back(info);
+        return (Resource)resources.size() - 1;
+    }
+
+    bool fail(const char* what, const Pass& pass, Resource resource)
+    {
+        std::cout << "ERROR::RENDER_GRAPH::" << what << " pass " << pass.name << ", resource "
+                  << (resource < resources.size() ? resources[resource].name : "?") << std::endl;
+        order.clear();
+        return false;
+    }
+
+    static void addDependency(uint32_t before, uint32_t after, std::vector<std::vector<uint32_t>>& successors,
+                              std::vector<uint32_t>& waitingFor)
+    {
+        successors[before].push_back(after);
+        waitingFor[after]++;
+    }
+
+    /* Passes without targets (say, one that only fills a buffer) don't care what is bound */
+    static bool keepsTargets(const Pass& pass, const std::vector<Resource>* current)
+    {
+        return pass.writes.empty() || (current && *current == pass.writes);
+    }
+
+    static size_t changesTargets(const Pass& pass, const std::vector<Resource>*& current)
+    {
+        if (keepsTargets(pass, current))
+            return 0;
+        current = &pass.writes;
+        return 1;
+    }
+
+    unsigned int objectOf(Resource resource) const
+    {
+        if (resource >= resources.size() || resources[resource].slot == NoResource)
+            return 0;
+        const Slot& slot = slots[resources[resource].slot];
+        return slot.target == NoResource ? 0 : targets[slot.target].id;
+    }
+
+    Target createTarget(const Slot& slot)
+    {
+        Target target;
+        target.kind = slot.kind;
+        target.width = slot.width;
+        target.height = slot.height;
+        target.format = slot.format;
+        target.id = 0;
+        target.lastFrame = frame;
+        if (slot.kind == Kind::Texture)
+        {
+            glGenTextures(1, &target.id);
+            glState.bindTexture(0, GL_TEXTURE_2D, target.id);
+            if (glext.textureStorage)
+                glext.TexStorage2D(GL_TEXTURE_2D, 1, slot.format, slot.width, slot.height);
+            else
+            {
+                const FormatInfo* info = formatInfo(slot.format);
+                glTexImage2D(GL_TEXTURE_2D, 0, (GLint)slot.format, slot.width, slot.height, 0, info->pixelFormat,
+                             info->pixelType, NULL);
+            }
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
+        else
+        {
+            glGenRenderbuffers(1, &target.id);
+            glBindRenderbuffer(GL_RENDERBUFFER, target.id);
+            glRenderbufferStorage(GL_RENDERBUFFER, slot.format, slot.width, slot.height);
+            glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        }
+        return target;
+    }
+
+    static void deleteTarget(const Target& target)
+    {
+        if (target.kind == Kind::Texture)
+        {
+            glDeleteTextures(1, &target.id);
+            glState.forgetTexture(target.id);
+        }
+        else
+            glDeleteRenderbuffers(1, &target.id);
+    }
+
+    static uint64_t attachmentKey(const Target& target)
+    {
+        return ((uint64_t)target.kind << 32) | target.id;
+    }
+
+    void releaseUnusedTargets()
+    {
+        for (size_t t = targets.size(); t-- > 0;)
+        {
+            if (targets[t].lastFrame + KeepUnusedFrames >= frame)
+                continue;
+            const uint64_t key = attachmentKey(targets[t]);
+            for (std::map<std::vector<uint64_t>, unsigned int>::iterator it = framebuffers.begin();
+                 it != framebuffers.end();)
+            {
+                if (std::find(it->first.begin(), it->first.end(), key) != it->first.end())
+                {
+                    glDeleteFramebuffers(1, &it->second);
+                    it = framebuffers.erase(it);
+                }
+                else
+                    ++it;
+            }
+            deleteTarget(targets[t]);
+
+            /* Slots point at targets by index; the last one moves into the gap */
+            const uint32_t moved = (uint32_t)targets.size() - 1;
+            targets[t] = targets[moved];
+            targets.pop_back();
+            for (Slot& slot : slots)
+                if (slot.target == moved)
+                    slot.target = (uint32_t)t;
+        }
+    }
+
+    /* The framebuffer with exactly these attachments, made on first use and left bound to bindTarget */
+    unsigned int framebufferFor(const std::vector<Resource>& attachments, GLenum bindTarget)
+    {
+        std::vector<uint64_t> key;
+        for (Resource resource : attachments)
+            key.push_back(attachmentKey(targets[slots[resources[resource].slot].target]));
+        std::map<std::vector<uint64_t>, unsigned int>::iterator found = framebuffers.find(key);
+        if (found != framebuffers.end())
+            return found->second;
+
+        unsigned int framebuffer = 0;
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(bindTarget, framebuffer);
+        GLenum drawBuffers[8];
+        GLsizei colorCount = 0;
+        for (Resource resource : attachments)
+        {
+            const ResourceInfo& info = resources[resource];
+            const GLenum attachment = !isDepthFormat(info.format) ? GL_COLOR_ATTACHMENT0 + colorCount
+                                      : hasStencil(info.format)   ? GL_DEPTH_STENCIL_ATTACHMENT
+                                                                  : GL_DEPTH_ATTACHMENT;
+            if (!isDepthFormat(info.format) && colorCount < 8)
+                drawBuffers[colorCount++] = attachment;
+            if (info.kind == Kind::Texture)
+                glFramebufferTexture2D(bindTarget, attachment, GL_TEXTURE_2D, objectOf(resource), 0);
+            else
+                glFramebufferRenderbuffer(bindTarget, attachment, GL_RENDERBUFFER, objectOf(resource));
+        }
+        /* Draw buffers belong to the draw framebuffer; one only made for reading keeps the default */
+        if (bindTarget != GL_READ_FRAMEBUFFER)
+        {
+            if (colorCount > 0)
+                glDrawBuffers(colorCount, drawBuffers);
+            else
+                glDrawBuffer(GL_NONE);
+        }
+        if (glCheckFramebufferStatus(bindTarget) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::RENDER_GRAPH::FRAMEBUFFER_INCOMPLETE " << resources[attachments[0]].name << std::endl;
+        framebuffers[key] = framebuffer;
+        return framebuffer;
+    }
+
+    void blit(Resource source, int x, int y, int width, int height)
+    {
+        if (source >= resources.size() || resources[source].slot == NoResource ||
+            isDepthFormat(resources[source].format))
+        {
+            std::cout << "ERROR::RENDER_GRAPH::CANNOT_BLIT "
+                      << (source < resources.size() ? resources[source].name : "?") << std::endl;
+            return;
+        }
+        const std::vector<Resource> attachments(1, source);
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebufferFor(attachments, GL_READ_FRAMEBUFFER));
+        readBound = true;
+        const ResourceInfo& info = resources[source];
+        glBlitFramebuffer(0, 0, info.width, info.height, x, y, x + width, y + height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    }
+
+    std::vector<Pass> passes;
+    std::vector<ResourceInfo> resources;
+    Resource backbufferResource = NoResource;
+    bool compiled = false;
+    std::vector<uint32_t> order; // pass indices, compiled order
+    std::vector<Slot> slots;
+
+    std::vector<Target> targets;
+    std::map<std::vector<uint64_t>, unsigned int> framebuffers; // attachment keys -> framebuffer
+    uint64_t frame = 0;
+    bool readBound = false;
+
+    Statistics stats;
+    uint64_t totalFrames = 0;
+    uint64_t totalBinds = 0;
+    size_t peakBytes = 0;
+};
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef RUN_OPTIONS_H
+#define RUN_OPTIONS_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+/* Where HelloWindow.cpp finds its GLSL files. CMake points this at the source tree; other builds run from the
+   project directory. */
+#ifndef HELLO_SHADER_DIR
+#define HELLO_SHADER_DIR "shaders"
+#endif
+
+/*******************************************************************************************************************************
+Command line options
+*******************************************************************************************************************************/
+/* Without arguments the program behaves like before: open a window and render until it is closed.
+   The options below turn it into a benchmark that can run unattended on a build box:
+       --headless           Don't show the window. On a HELLO_HEADLESS build GLFW uses its null platform + OSMesa anyway.
+       --frames N           Render exactly N frames, then exit.
+       --stats FILE         Write per-frame timings to FILE. ".json" writes JSON, anything else writes CSV.
+       --vsync              Keep the swap interval at 1. Benchmarks default to 0 so they measure our own work.
+       --shader-cache DIR   Where linked program binaries are cached (default "shader_cache").
+       --no-shader-cache    Always compile shaders from source.
+       --instances N        Draw N rectangles per frame with one instanced draw instead of the single rectangle.
+       --mesh FILE          Draw a .hmesh file instead of the rectangle.
+       --write-mesh FILE    Save the rectangle as a .hmesh file.
+       --pack               With --write-mesh: use compact vertex/index encodings (VertexPacking.h).
+       --optimize           With --write-mesh: optimize triangle and vertex order (MeshOptimizer.h).
+       --gpu-profile        Time the clear and draw on the GPU with timer queries and print min/avg/p99 at exit.
+       --fps N              Pace the loop to N frames per second (FramePacer.h) instead of running flat out.
+       --low-latency        With --fps: start each frame as late as possible and read input right before rendering.
+       --simulate HZ        Move the rectangle from a fixed-rate simulation thread (Simulation.h); arrow keys push it.
+       --draws N            Draw N rectangles with one draw call each, recorded on worker threads (CommandList.h).
+       --threads N          Threads recording --draws, counting the main thread (default: one per core, at most 256).
+       --cull               With --draws: spread the rectangles over a world much larger than the window and only
+                            draw the ones a BVH frustum test finds visible (Culling.h).
+       --uniform-buffer     With --draws: give each draw its position in a uniform block instead of with glUniform.
+                            All blocks of a frame are uploaded at once (UniformBuffer.h).
+       --shaders DIR        Where hello.vert and hello.frag are (default: the shaders directory next to the sources).
+       --hot-reload         Rebuild the rectangle's program in the background whenever its shader files are saved.
+       --texture FILE       Put a binary .ppm image on the rectangle. It is decoded on worker threads and uploaded a
+                            little per frame, smallest mip first, so it sharpens in instead of stalling (TextureStreamer.h).
+                            A .htex file from tools/TextureCooker is block-compressed already and loaded straight from
+                            the mapped file (TextureFile.h).
+       --upload-budget MB   With --texture: most texture data uploaded in one frame (default 4).
+       --render-graph       Draw into an off-screen target and add a blurred thumbnail of the picture in the corner,
+                            through a render graph that shares and reuses its intermediate targets (RenderGraph.h).
+       --lods N             Draw a field of dense spheres instead of the rectangle, each at one of N levels of detail
+                            (2-8, 5 is a good start) simplified on worker threads and picked by how many pixels the
+                            error would cover (MeshSimplifier.h).
+       --occlusion          With --lods: put two walls across the field and skip the spheres hidden behind them, found
+                            by rasterizing the walls on the CPU into a small depth buffer (OcclusionCulling.h).
+       --capture N          Save every Nth frame as capture_NNNNN.png. Frames are read back through fenced pixel buffers
+                            and encoded on a separate thread, so the render loop doesn't wait (FrameCapture.h).
+       --stream PATH        Write every frame to PATH as a Y4M video stream for an encoder in another process: a file, a
+                            named pipe, - for stdout (our own output then goes to stderr) or fd:N. Converted to YUV on
+                            a worker; if the reader falls behind the loop waits instead of dropping (FrameStream.h).
+       --stream-raw         With --stream: write raw RGBA frames instead of Y4M. */
+struct RunOptions
+{
+    bool headless = false;
+    bool vsync = true;
+    unsigned int frames = 0; // 0 = run until the window is closed
+    std::string statsPath;
+    std::string shaderCacheDir = "shader_cache";
+    size_t instances = 0;
+    std::string meshPath;
+    std::string writeMeshPath;
+    bool packMesh = false;
+    bool optimizeMesh = false;
+    bool gpuProfile = false;
+    double fps = 0.0; // 0 = unpaced
+    bool lowLatency = false;
+    double simulationHz = 0.0; // 0 = static scene
+    size_t draws = 0;
+    unsigned int threads = 0; // 0 = one per core
+    bool cull = false;
+    bool uniformBuffer = false;
+    std::string shaderDir = HELLO_SHADER_DIR;
+    bool hotReload = false;
+    std::string texturePath;
+    double uploadBudgetMb = 4.0;
+    bool renderGraph = false;
+    unsigned int lods = 0;
+    bool occlusion = false;
+    unsigned int captureEvery = 0; // 0 = no capture
+    std::string streamPath;
+    bool streamRaw = false;
+
+    bool benchmark() const { return frames > 0; }
+};
+
+inline bool parseRunOptions(int argc, char** argv, RunOptions& options)
+{
+    bool vsyncRequested = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (std::strcmp(arg, "--headless") == 0)
+            options.headless = true;
+        else if (std::strcmp(arg, "--vsync") == 0)
+            vsyncRequested = true;
+        else if (std::strcmp(arg, "--frames") == 0 && hasValue)
+            options.frames = (unsigned int)std::strtoul(argv[++i], NULL, 10);
+        else if (std::strcmp(arg, "--stats") == 0 && hasValue)
+            options.statsPath = argv[++i];
+        else if (std::strcmp(arg, "--shader-cache") == 0 && hasValue)
+            options.shaderCacheDir = argv[++i];
+        else if (std::strcmp(arg, "--no-shader-cache") == 0)
+            options.shaderCacheDir.clear();
+        else if (std::strcmp(arg, "--instances") == 0 && hasValue)
+            options.instances = (size_t)std::strtoull(argv[++i], NULL, 10);
+        else if (std::strcmp(arg, "--mesh") == 0 && hasValue)
+            options.meshPath = argv[++i];
+        else if (std::strcmp(arg, "--write-mesh") == 0 && hasValue)
+            options.writeMeshPath = argv[++i];
+        else if (std::strcmp(arg, "--pack") == 0)
+            options.packMesh = true;
+        else if (std::strcmp(arg, "--optimize") == 0)
+            options.optimizeMesh = true;
+        else if (std::strcmp(arg, "--gpu-profile") == 0)
+            options.gpuProfile = true;
+        else if (std::strcmp(arg, "--fps") == 0 && hasValue)
+            options.fps = std::strtod(argv[++i], NULL);
+        else if (std::strcmp(arg, "--low-latency") == 0)
+            options.lowLatency = true;
+        else if (std::strcmp(arg, "--simulate") == 0 && hasValue)
+            options.simulationHz = std::strtod(argv[++i], NULL);
+        else if (std::strcmp(arg, "--draws") == 0 && hasValue)
+            options.draws = (size_t)std::strtoull(argv[++i], NULL, 10);
+        else if (std::strcmp(arg, "--threads") == 0 && hasValue)
+            options.threads = std::min(256u, (unsigned int)std::strtoul(argv[++i], NULL, 10)); // CommandQueue::MaxLists
+        else if (std::strcmp(arg, "--cull") == 0)
+            options.cull = true;
+        else if (std::strcmp(arg, "--uniform-buffer") == 0)
+            options.uniformBuffer = true;
+        else if (std::strcmp(arg, "--shaders") == 0 && hasValue)
+            options.shaderDir = argv[++i];
+        else if (std::strcmp(arg, "--hot-reload") == 0)
+            options.hotReload = true;
+        else if (std::strcmp(arg, "--texture") == 0 && hasValue)
+            options.texturePath = argv[++i];
+        else if (std::strcmp(arg, "--upload-budget") == 0 && hasValue)
+            options.uploadBudgetMb = std::strtod(argv[++i], NULL);
+        else if (std::strcmp(arg, "--render-graph") == 0)
+            options.renderGraph = true;
+        else if (std::strcmp(arg, "--lods") == 0 && hasValue)
+            options.lods = std::min(8u, std::max(2u, (unsigned int)std::strtoul(argv[++i], NULL, 10)));
+        else if (std::strcmp(arg, "--occlusion") == 0)
+            options.occlusion = true;
+        else if (std::strcmp(arg, "--capture") == 0 && hasValue)
+            options.captureEvery = std::max(1u, (unsigned int)std::strtoul(argv[++i], NULL, 10));
+        else if (std::strcmp(arg, "--stream") == 0 && hasValue)
+            options.streamPath = argv[++i];
+        else if (std::strcmp(arg, "--stream-raw") == 0)
+            options.streamRaw = true;
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " [--headless] [--frames N] [--stats FILE.csv|FILE.json] [--vsync]"
+                      << " [--shader-cache DIR | --no-shader-cache] [--instances N]"
+                      << " [--mesh FILE] [--write-mesh FILE [--pack] [--optimize]] [--gpu-profile]"
+                      << " [--fps N [--low-latency]] [--simulate HZ]"
+                      << " [--draws N [--threads N] [--cull] [--uniform-buffer]]"
+                      << " [--shaders DIR] [--hot-reload] [--texture FILE.ppm|FILE.htex [--upload-budget MB]]"
+                      << " [--render-graph] [--lods N [--occlusion]] [--capture N]"
+                      << " [--stream PATH|-|fd:N [--stream-raw]]" << std::endl;
+            return false;
+        }
+    }
+
+    /* A fixed frame count means we're measuring, so don't let the display rate hide the render loop's cost */
+    if (options.benchmark())
+        options.vsync = vsyncRequested;
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <glad/glad.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+/*******************************************************************************************************************************
+Shader compile/link helpers
+*******************************************************************************************************************************/
+/* Reads a whole shader source file into source. Returns false (and prints why) if it can't be read. */
+inline bool loadShaderFile(const std::string& path, std::string& source)
+{
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file)
+    {
+        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ " << path << std::endl;
+        return false;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    source = contents.str();
+    return true;
+}
+
+/* In order for OpenGL to use a shader it has to dynamically compile it at run-time from its source code.
+   "label" only shows up in error messages, e.g. "VERTEX" -> ERROR::SHADER::VERTEX::COMPILATION_FAILED */
+inline unsigned int compileShader(GLenum type, const char* source, const char* label)
+{
+    unsigned int shader = glCreateShader(type); // We provide the type of shader we want to create as an argument.
+
+    /* Attach the shader source to the shader object. */
+    /* Parameters:
+       1: Shader object to compile
+       2: Number of strings we're passing as source code
+       3: Source code
+       4: (Tutorial just says to leave NULL */
+    glShaderSource(shader, 1, &source, NULL);
+
+    /* Compile shader written in GLSL */
+    glCompileShader(shader);
+
+    /* Check for successful compilation */
+    int success;
+    char infoLog[512];
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        glGetShaderInfoLog(shader, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::" << label << "::COMPILATION_FAILED\n" << infoLog << std::endl;
+    }
+    return shader;
+}
+
+/* Check for linking errors. Returns false (and prints the log) when the program can't be used */
+inline bool checkProgramLinked(unsigned int program)
+{
+    int success;
+    char infoLog[512];
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(program, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    }
+    return success != 0;
+}
+
+#endif
@@ -0,0 +1,336 @@
+#ifndef SHADER_HOT_RELOAD_H
+#define SHADER_HOT_RELOAD_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "GLState.h"
+#include "Shader.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#else
+#include <filesystem>
+#endif
+
+/*******************************************************************************************************************************
+Shader hot reload
+*******************************************************************************************************************************/
+/* Watches shader source files and rebuilds their program whenever one is saved, without stalling the render loop:
+
+       - Changes are picked up with inotify on Linux (by polling modification times elsewhere).
+       - Compiling and linking happen on a background thread with its own hidden GLFW window whose context shares
+         objects with the main one (glfwCreateWindow's last argument, as in glfw's examples/sharing.c). Program
+         objects are shared, so the main context can use what the background one linked.
+       - The background thread fences the new program. update(), called by the render loop between frames, swaps it
+         in once the fence has signalled - checked with a zero timeout, so it never waits - and deletes the old one.
+
+   A shader that fails to compile or link prints its log and the old program stays in use.
+
+       ShaderReloader reloader(window);                    // main thread, after the window is created
+       size_t hello = reloader.watch("hello.vert", "hello.frag", program);
+       reloader.start();
+       ...
+       if (reloader.update())                              // once per frame, at the frame boundary
+           program = reloader.program(hello);
+
+   The reloader deletes programs it replaces; the one in use when it's destroyed is left to the caller. */
+class ShaderReloader
+{
+public:
+    /* Must be called on the main thread (GLFW only creates windows there) with the context's window hints still set */
+    explicit ShaderReloader(GLFWwindow* mainWindow)
+    {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        context = glfwCreateWindow(1, 1, "Shader compiler", NULL, mainWindow);
+        if (!context)
+            std::cout << "ERROR::SHADER_RELOAD::CANNOT_CREATE_SHARED_CONTEXT" << std::endl;
+    }
+
+    ~ShaderReloader()
+    {
+        running.store(false);
+        if (thread.joinable())
+            thread.join();
+
+        for (Watched& w : watched)
+            if (w.pendingProgram)
+            {
+                glDeleteSync(w.pendingFence);
+                glDeleteProgram(w.pendingProgram);
+            }
+        if (context)
+            glfwDestroyWindow(context);
+#ifdef __linux__
+        if (notifyFd >= 0)
+            close(notifyFd);
+#endif
+    }
+
+    ShaderReloader(const ShaderReloader&) = delete;
+    ShaderReloader& operator=(const ShaderReloader&) = delete;
+
+    /* Registers a program built from the two files. Call before start(). */
+    size_t watch(const std::string& vertexPath, const std::string& fragmentPath, unsigned int program)
+    {
+        Watched w;
+        w.paths[0] = vertexPath;
+        w.paths[1] = fragmentPath;
+        w.program = program;
+        watched.push_back(w);
+        return watched.size() - 1;
+    }
+
+    bool start()
+    {
+        if (!context || thread.joinable())
+            return false;
+        running.store(true);
+        thread = std::thread(&ShaderReloader::run, this);
+        return true;
+    }
+
+    /* Main thread, between frames. Swaps in every rebuilt program whose fence has signalled; returns true if any was. */
+    bool update()
+    {
+        bool changed = false;
+        std::lock_guard<std::mutex> lock(mutex);
+        for (Watched& w : watched)
+        {
+            if (!w.pendingProgram)
+                continue;
+            const GLenum status = glClientWaitSync(w.pendingFence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                continue; // Not finished yet; try again next frame
+
+            glDeleteSync(w.pendingFence);
+            glDeleteProgram(w.program);
+            glState.forgetProgram(w.program);
+            w.program = w.pendingProgram;
+            w.pendingProgram = 0;
+            w.pendingFence = NULL;
+            reloads++;
+            changed = true;
+        }
+        return changed;
+    }
+
+    /* Main thread. The program currently in use for a watched pair of files. */
+    unsigned int program(size_t handle) const { return watched[handle].program; }
+
+    unsigned int reloadCount() const { return reloads; }
+    unsigned int failureCount() const { return failures.load(); }
+
+private:
+    struct Watched
+    {
+        std::string paths[2];       // vertex, fragment
+        unsigned int program = 0;   // In use by the main thread
+        unsigned int pendingProgram = 0; // Built by the background thread, waiting for update(); guarded by mutex
+        GLsync pendingFence = NULL;
+    };
+
+    void run()
+    {
+        glfwMakeContextCurrent(context);
+
+        std::vector<bool> dirty(watched.size(), false);
+        while (running.load())
+        {
+            if (!waitForChanges(dirty))
+                continue;
+
+            /* Editors often save in several steps (truncate, write, rename); give them a moment to finish */
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            waitForChanges(dirty, 0);
+
+            for (size_t i = 0; i < watched.size(); i++)
+                if (dirty[i])
+                {
+                    rebuild(i);
+                    dirty[i] = false;
+                }
+        }
+
+        glfwMakeContextCurrent(NULL);
+    }
+
+    /* Background thread. Compiles and links a new program and hands it to update(). */
+    void rebuild(size_t index)
+    {
+        std::string sources[2];
+        if (!loadShaderFile(watched[index].paths[0], sources[0]) || !loadShaderFile(watched[index].paths[1], sources[1]))
+        {
+            failures++;
+            return;
+        }
+
+        const unsigned int vertexShader = compileShader(GL_VERTEX_SHADER, sources[0].c_str(), "VERTEX");
+        const unsigned int fragmentShader = compileShader(GL_FRAGMENT_SHADER, sources[1].c_str(), "FRAGMENT");
+        unsigned int program = glCreateProgram();
+        glAttachShader(program, vertexShader);
+        glAttachShader(program, fragmentShader);
+        glLinkProgram(program);
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+
+        /* Asking for the link status waits for the compiler, but only this thread waits */
+        if (!checkProgramLinked(program))
+        {
+            glDeleteProgram(program);
+            failures++;
+            return;
+        }
+        std::cout << "Reloaded " << watched[index].paths[0] << " + " << watched[index].paths[1] << std::endl;
+
+        /* The main context may only use the program once everything this context did to it has completed */
+        GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        Watched& w = watched[index];
+        if (w.pendingProgram) // Saved again before the previous rebuild was picked up
+        {
+            glDeleteSync(w.pendingFence);
+            glDeleteProgram(w.pendingProgram);
+        }
+        w.pendingProgram = program;
+        w.pendingFence = fence;
+    }
+
+#ifdef __linux__
+    /* Marks programs whose files changed. Waits up to timeoutMs for the first change; returns true if there was one. */
+    bool waitForChanges(std::vector<bool>& dirty, int timeoutMs = 100)
+    {
+        if (notifyFd < 0 && !startWatching())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+            return false;
+        }
+
+        pollfd pfd = { notifyFd, POLLIN, 0 };
+        if (poll(&pfd, 1, timeoutMs) <= 0)
+            return false;
+
+        bool any = false;
+        alignas(inotify_event) char buffer[4096];
+        ssize_t length;
+        while ((length = read(notifyFd, buffer, sizeof(buffer))) > 0)
+            for (char* p = buffer; p < buffer + length; p += sizeof(inotify_event) + ((inotify_event*)p)->len)
+            {
+                const inotify_event* event = (const inotify_event*)p;
+                if (event->len == 0)
+                    continue;
+                for (size_t i = 0; i < watched.size(); i++)
+                    for (const std::string& path : watched[i].paths)
+                        if (watchedDirectory(event->wd) == directoryOf(path) && fileNameOf(path) == event->name)
+                        {
+                            dirty[i] = true;
+                            any = true;
+                        }
+            }
+        return any;
+    }
+
+    /* Watches directories rather than files: editors that save by writing a new file and renaming it over the old
+       one would otherwise leave us watching a deleted inode */
+    bool startWatching()
+    {
+        notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (notifyFd < 0)
+        {
+            std::cout << "ERROR::SHADER_RELOAD::INOTIFY_FAILED" << std::endl;
+            return false;
+        }
+        for (const Watched& w : watched)
+            for (const std::string& path : w.paths)
+            {
+                const std::string directory = directoryOf(path);
+                const int wd = inotify_add_watch(notifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+                if (wd < 0)
+                    std::cout << "ERROR::SHADER_RELOAD::CANNOT_WATCH " << directory << std::endl;
+                else if (watchedDirectory(wd).empty())
+                    directories.push_back(std::make_pair(wd, directory));
+            }
+        return true;
+    }
+
+    std::string watchedDirectory(int wd) const
+    {
+        for (const std::pair<int, std::string>& d : directories)
+            if (d.first == wd)
+                return d.second;
+        return std::string();
+    }
+
+    int notifyFd = -1;
+    std::vector<std::pair<int, std::string>> directories;
+#else
+    /* Without inotify, compare modification times a few times a second */
+    bool waitForChanges(std::vector<bool>& dirty, int timeoutMs = 250)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeoutMs));
+        if (modified.empty())
+            for (const Watched& w : watched)
+                for (const std::string& path : w.paths)
+                    modified.push_back(lastWriteTime(path));
+
+        bool any = false;
+        size_t f = 0;
+        for (size_t i = 0; i < watched.size(); i++)
+            for (const std::string& path : watched[i].paths)
+            {
+                const std::filesystem::file_time_type time = lastWriteTime(path);
+                if (time != modified[f])
+                {
+                    modified[f] = time;
+                    dirty[i] = true;
+                    any = true;
+                }
+                f++;
+            }
+        return any;
+    }
+
+    static std::filesystem::file_time_type lastWriteTime(const std::string& path)
+    {
+        std::error_code error;
+        return std::filesystem::last_write_time(path, error);
+    }
+
+    std::vector<std::filesystem::file_time_type> modified;
+#endif
+
+    static std::string directoryOf(const std::string& path)
+    {
+        const size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? std::string(".") : path.substr(0, slash);
+    }
+
+    static std::string fileNameOf(const std::string& path)
+    {
+        const size_t slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+    GLFWwindow* context = NULL;
+    std::thread thread;
+    std::atomic<bool> running{ false };
+    std::mutex mutex;
+    std::vector<Watched> watched;
+    unsigned int reloads = 0;
+    std::atomic<unsigned int> failures{ 0 };
+};
+
+#endif
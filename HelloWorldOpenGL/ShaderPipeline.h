@@ -0,0 +1,193 @@
+#ifndef SHADER_PIPELINE_H
+#define SHADER_PIPELINE_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "GLExtensions.h"
+#include "GLState.h"
+#include "ProgramCache.h"
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+/*******************************************************************************************************************************
+Deferred shader compilation
+*******************************************************************************************************************************/
+/* glCompileShader/glLinkProgram only queue work. What actually makes us wait is asking for the result
+   (glGetShaderiv(GL_COMPILE_STATUS), glGetProgramiv(GL_LINK_STATUS)) because the driver has to finish first.
+   Asking right after every compile serializes all shaders, so instead:
+       1: submit() every program up front. This compiles and links without looking at any status.
+       2: Do other startup work (buffers, textures...) while the driver compiles. With GL_KHR_parallel_shader_compile
+          it does so on its own threads.
+       3: program() the first time a program is needed. Only then do we check (and wait for) the result.
+   ready() lets a caller poll without blocking via GL_COMPLETION_STATUS_KHR, e.g. to draw a placeholder meanwhile.
+   Programs found in the ProgramCache skip all of this and are ready immediately. */
+class ShaderPipeline
+{
+public:
+    typedef size_t Handle;
+
+    explicit ShaderPipeline(ProgramCache& cache)
+        : cache(cache), timerFrequency((double)glfwGetTimerFrequency())
+    {
+        /* Let the driver pick how many compiler threads to use */
+        if (glext.parallelShaderCompile)
+            glext.MaxShaderCompilerThreads(0xFFFFFFFFu);
+    }
+
+    ~ShaderPipeline()
+    {
+        for (Entry& entry : entries)
+            releaseShaders(entry);
+    }
+
+    Handle submit(const char* vertexSource, const char* fragmentSource)
+    {
+        const uint64_t start = glfwGetTimerValue();
+
+        Entry entry;
+        const char* sources[] = { vertexSource, fragmentSource };
+        entry.key = cache.key(sources, 2);
+        entry.program = cache.tryLoad(entry.key);
+
+        if (entry.program)
+            entry.resolved = true;
+        else
+        {
+            entry.vertexShader = submitShader(GL_VERTEX_SHADER, vertexSource);
+            entry.fragmentShader = submitShader(GL_FRAGMENT_SHADER, fragmentSource);
+
+            entry.program = glCreateProgram();
+            glAttachShader(entry.program, entry.vertexShader);
+            glAttachShader(entry.program, entry.fragmentShader);
+            cache.prepareForStore(entry.program);
+            glLinkProgram(entry.program); // Fails cleanly if a shader didn't compile; we find out in resolve()
+        }
+
+        entry.submitMs = toMs(glfwGetTimerValue() - start);
+        entries.push_back(entry);
+        return entries.size() - 1;
+    }
+
+    /* Non-blocking. Without the parallel compile extension we can't ask, so anything unresolved reports ready and
+       the first program() call pays for it. */
+    bool ready(Handle handle) const
+    {
+        const Entry& entry = entries[handle];
+        if (entry.resolved || !glext.parallelShaderCompile)
+            return true;
+
+        int done = 0;
+        glGetProgramiv(entry.program, GL_COMPLETION_STATUS_KHR, &done);
+        return done != 0;
+    }
+
+    /* Blocks until the program is linked. Returns 0 if compiling or linking failed (the log has been printed) */
+    unsigned int program(Handle handle)
+    {
+        Entry& entry = entries[handle];
+        if (!entry.resolved)
+            resolve(entry);
+        return entry.linked ? entry.program : 0;
+    }
+
+    /* Resolve everything that's still outstanding, e.g. before the first frame */
+    void finish()
+    {
+        for (Entry& entry : entries)
+            if (!entry.resolved)
+                resolve(entry);
+    }
+
+    /* Time the main thread actually spent on shaders: submitting plus waiting in program()/finish() */
+    double blockingMs() const
+    {
+        double ms = 0.0;
+        for (const Entry& entry : entries)
+            ms += entry.submitMs + entry.waitMs;
+        return ms;
+    }
+
+private:
+    struct Entry
+    {
+        uint64_t key = 0;
+        unsigned int vertexShader = 0;
+        unsigned int fragmentShader = 0;
+        unsigned int program = 0;
+        bool resolved = false;
+        bool linked = true;
+        double submitMs = 0.0;
+        double waitMs = 0.0;
+    };
+
+    static unsigned int submitShader(GLenum type, const char* source)
+    {
+        unsigned int shader = glCreateShader(type);
+        glShaderSource(shader, 1, &source, NULL);
+        glCompileShader(shader);
+        return shader;
+    }
+
+    void resolve(Entry& entry)
+    {
+        const uint64_t start = glfwGetTimerValue();
+
+        /* The link status is the first query that has to wait for the compiler */
+        int success = 0;
+        glGetProgramiv(entry.program, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            reportShader(entry.vertexShader, "VERTEX");
+            reportShader(entry.fragmentShader, "FRAGMENT");
+            checkProgramLinked(entry.program);
+        }
+
+        entry.waitMs = toMs(glfwGetTimerValue() - start);
+        entry.linked = success != 0;
+        entry.resolved = true;
+
+        if (entry.linked)
+            cache.store(entry.key, entry.program, entry.submitMs + entry.waitMs);
+        releaseShaders(entry);
+        if (!entry.linked)
+        {
+            /* Deleting the program also detaches the failed shaders, which frees them */
+            glDeleteProgram(entry.program);
+            glState.forgetProgram(entry.program);
+            entry.program = 0;
+        }
+    }
+
+    static void reportShader(unsigned int shader, const char* label)
+    {
+        int success = 0;
+        char infoLog[512];
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        if (!success)
+        {
+            glGetShaderInfoLog(shader, 512, NULL, infoLog);
+            std::cout << "ERROR::SHADER::" << label << "::COMPILATION_FAILED\n" << infoLog << std::endl;
+        }
+    }
+
+    /* Shader objects aren't needed once the program is linked */
+    static void releaseShaders(Entry& entry)
+    {
+        if (entry.vertexShader)
+            glDeleteShader(entry.vertexShader);
+        if (entry.fragmentShader)
+            glDeleteShader(entry.fragmentShader);
+        entry.vertexShader = entry.fragmentShader = 0;
+    }
+
+    double toMs(uint64_t ticks) const { return (double)ticks * 1000.0 / timerFrequency; }
+
+    ProgramCache& cache;
+    double timerFrequency;
+    std::vector<Entry> entries;
+};
+
+#endif
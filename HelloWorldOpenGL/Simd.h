@@ -0,0 +1,45 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+/*******************************************************************************************************************************
+SIMD configuration
+*******************************************************************************************************************************/
+/* Which vector instruction sets the hot loops may use. SSE2 is always there on x86-64; AVX/AVX2 only when the compiler
+   was told it may use them (-DHELLO_NATIVE_ARCH=ON builds with -march=native, MSVC needs /arch:AVX2). Everything has a
+   scalar fallback, so other CPUs (ARM, ...) still build; they just don't get the speedup.
+
+       HELLO_SSE2   4 x float
+       HELLO_AVX    8 x float
+       HELLO_AVX2   8 x int32 as well */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HELLO_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX__)
+#define HELLO_AVX 1
+#endif
+
+#if defined(__AVX2__)
+#define HELLO_AVX2 1
+#endif
+
+#if defined(HELLO_AVX) || defined(HELLO_AVX2)
+#include <immintrin.h>
+#endif
+
+/* Human-readable name of the widest path compiled in, for benchmark output */
+inline const char* simdName()
+{
+#if defined(HELLO_AVX2)
+    return "avx2";
+#elif defined(HELLO_AVX)
+    return "avx";
+#elif defined(HELLO_SSE2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+#endif
@@ -0,0 +1,217 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+
+/*******************************************************************************************************************************
+Snapshot exchange between two threads
+*******************************************************************************************************************************/
+/* A triple buffer: the writer always has a slot of its own to fill, the reader always has a slot of its own to read,
+   and the third slot holds the newest published value. Publishing and acquiring each swap one index with a single
+   atomic exchange, so neither side ever waits for the other and a snapshot never changes while it's being read.
+
+       writer: fill back(), publish()
+       reader: const T& s = acquire();   // newest complete snapshot, unchanged until the next acquire() */
+template <typename T>
+class SnapshotBuffer
+{
+public:
+    T& back() { return slots[backIndex]; }
+
+    void publish()
+    {
+        backIndex = latest.exchange(backIndex | FreshBit, std::memory_order_acq_rel) & IndexMask;
+    }
+
+    const T& acquire()
+    {
+        if (latest.load(std::memory_order_relaxed) & FreshBit)
+            frontIndex = latest.exchange(frontIndex, std::memory_order_acq_rel) & IndexMask;
+        return slots[frontIndex];
+    }
+
+private:
+    static const unsigned int FreshBit = 4;
+    static const unsigned int IndexMask = 3;
+
+    T slots[3] = {};
+    std::atomic<unsigned int> latest{ 1 };
+    unsigned int backIndex = 0;  // Only touched by the writer
+    unsigned int frontIndex = 2; // Only touched by the reader
+};
+
+/*******************************************************************************************************************************
+Fixed-timestep simulation
+*******************************************************************************************************************************/
+/* The state of the world at one simulation tick. It's copied around by value, so keep it small and plain. */
+struct SimState
+{
+    uint64_t tick;
+    double time;       // seconds since the simulation started
+    float position[2]; // offset of the rectangle, in clip space
+    float velocity[2];
+};
+
+/* What the render thread needs to interpolate: the last two ticks */
+struct SimSnapshot
+{
+    SimState previous;
+    SimState current;
+};
+
+/* Runs the simulation on its own thread at a fixed rate, however fast or slow frames are rendered.
+   The render thread reads input on the main thread (GLFW requires it) and hands it over with setInput(); it draws
+   sample(), which blends the two latest ticks so motion stays smooth when the render and simulation rates differ.
+   That puts what's on screen up to one tick behind the simulation. */
+class Simulation
+{
+public:
+    enum Input : uint32_t
+    {
+        InputLeft = 1,
+        InputRight = 2,
+        InputUp = 4,
+        InputDown = 8
+    };
+
+    typedef std::chrono::steady_clock Clock;
+
+    explicit Simulation(double ticksPerSecond = 60.0)
+        : dt(1.0 / ticksPerSecond)
+    {
+        SimSnapshot& first = snapshots.back();
+        first.previous = first.current = initialState();
+        snapshots.publish();
+    }
+
+    ~Simulation() { stop(); }
+
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+
+    void start()
+    {
+        if (thread.joinable())
+            return;
+        epoch = Clock::now();
+        running.store(true);
+        thread = std::thread(&Simulation::run, this);
+    }
+
+    void stop()
+    {
+        running.store(false);
+        if (thread.joinable())
+            thread.join();
+    }
+
+    /* Bitmask of Input values held down right now */
+    void setInput(uint32_t bits) { input.store(bits, std::memory_order_relaxed); }
+
+    /* The state to draw this frame: one tick behind, interpolated to the current time */
+    SimState sample()
+    {
+        const SimSnapshot& snapshot = snapshots.acquire();
+        double alpha = (seconds() - snapshot.current.time) / dt;
+        alpha = alpha < 0.0 ? 0.0 : alpha > 1.0 ? 1.0 : alpha;
+
+        SimState state = snapshot.current;
+        for (int i = 0; i < 2; i++)
+            state.position[i] = snapshot.previous.position[i] +
+                                (snapshot.current.position[i] - snapshot.previous.position[i]) * (float)alpha;
+        return state;
+    }
+
+    void printSummary(std::ostream& out) const
+    {
+        out << "Simulation: " << ticks.load() << " ticks at " << 1.0 / dt << " Hz, " << skipped.load()
+            << " skipped to catch up" << std::endl;
+    }
+
+private:
+    /* If the thread falls further behind than this (e.g. the process was suspended), drop the backlog instead of
+       simulating it all at once */
+    static const int MaxCatchUpTicks = 8;
+
+    static SimState initialState()
+    {
+        SimState state = SimState();
+        state.velocity[0] = 0.4f;
+        state.velocity[1] = 0.3f;
+        return state;
+    }
+
+    double seconds() const { return std::chrono::duration<double>(Clock::now() - epoch).count(); }
+
+    void run()
+    {
+        SimState state = initialState();
+        SimState previous = state;
+
+        uint64_t nextTick = 1;
+        while (running.load(std::memory_order_relaxed))
+        {
+            std::this_thread::sleep_until(epoch + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>((double)nextTick * dt)));
+
+            /* Usually one tick per wake-up, more if we woke up late */
+            const double now = seconds();
+            if (now - (double)nextTick * dt > MaxCatchUpTicks * dt)
+            {
+                const uint64_t behind = (uint64_t)(now / dt) - nextTick;
+                skipped.fetch_add(behind, std::memory_order_relaxed);
+                nextTick += behind;
+            }
+            for (; (double)nextTick * dt <= now; nextTick++)
+            {
+                previous = state;
+                step(state, input.load(std::memory_order_relaxed));
+                state.tick = nextTick;
+                state.time = (double)nextTick * dt;
+                ticks.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            SimSnapshot& snapshot = snapshots.back();
+            snapshot.previous = previous;
+            snapshot.current = state;
+            snapshots.publish();
+        }
+    }
+
+    /* Advances state by one tick: the keys push the rectangle around, and it bounces off the edges of the window */
+    void step(SimState& state, uint32_t keys) const
+    {
+        const float push = 2.0f * (float)dt, drag = 1.0f - 0.5f * (float)dt;
+        state.velocity[0] += ((keys & InputRight) ? push : 0.0f) - ((keys & InputLeft) ? push : 0.0f);
+        state.velocity[1] += ((keys & InputUp) ? push : 0.0f) - ((keys & InputDown) ? push : 0.0f);
+
+        for (int i = 0; i < 2; i++)
+        {
+            if (keys)
+                state.velocity[i] *= drag;
+            state.position[i] += state.velocity[i] * (float)dt;
+
+            /* The rectangle spans [-0.5, 0.5], so an offset of +-0.5 puts its edge on the edge of the window */
+            if (state.position[i] > 0.5f || state.position[i] < -0.5f)
+            {
+                state.position[i] = state.position[i] > 0.0f ? 1.0f - state.position[i] : -1.0f - state.position[i];
+                state.velocity[i] = -state.velocity[i];
+            }
+        }
+    }
+
+    double dt;
+    Clock::time_point epoch;
+    SnapshotBuffer<SimSnapshot> snapshots;
+    std::thread thread;
+    std::atomic<bool> running{ false };
+    std::atomic<uint32_t> input{ 0 };
+    std::atomic<uint64_t> ticks{ 0 };
+    std::atomic<uint64_t> skipped{ 0 };
+};
+
+#endif
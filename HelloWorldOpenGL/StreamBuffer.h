@@ -0,0 +1,188 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <glad/glad.h>
+
+#include "GLExtensions.h"
+#include "GLState.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+/*******************************************************************************************************************************
+Triple-buffered streaming buffer
+*******************************************************************************************************************************/
+/* For data that changes every frame, glBufferData/glBufferSubData make the driver either copy our data or wait until the
+   GPU is done reading the previous contents. Instead we allocate one buffer split into Regions parts and write straight
+   into its memory:
+
+       frame N    GPU reads region 0
+       frame N+1  GPU reads region 1
+       frame N+2  CPU writes region 2   <- we only wait if the GPU is still on frame N-1 when we come back to a region
+
+   A fence (glFenceSync) is placed after the draws that read a region; beginFrame() waits on that fence before handing
+   the region out again. Nothing is ever orphaned and the driver never synchronizes behind our back.
+
+   With GL 4.4 / ARB_buffer_storage the buffer is mapped once, persistently and coherently (GL_MAP_PERSISTENT_BIT |
+   GL_MAP_COHERENT_BIT), so writes are visible to the GPU without any further calls. Older drivers map each region with
+   GL_MAP_UNSYNCHRONIZED_BIT (the fence already makes that safe) and unmap it in commit(), because GL can't draw from a
+   buffer that is mapped without GL_MAP_PERSISTENT_BIT.
+
+   Usage per frame:
+       stream.beginFrame();
+       StreamBuffer::Allocation a = stream.allocate(bytes); // as often as needed, a.data == NULL when the region is full
+       memcpy(a.data, ...);
+       stream.commit();   // done writing
+       draw using a.offset
+       stream.endFrame(); // after the draws that read this region */
+class StreamBuffer
+{
+public:
+    static const unsigned int Regions = 3;
+
+    struct Allocation
+    {
+        void* data;     // Where to write. NULL if the region has no room left
+        size_t offset;  // Byte offset into buffer() for glVertexAttribPointer/glBindBufferRange/...
+    };
+
+    struct Stats
+    {
+        unsigned int frames = 0;
+        unsigned int stalls = 0;  // beginFrame() had to wait for the GPU
+    };
+
+    StreamBuffer(GLenum target, size_t regionSize)
+        : target(target), regionSize(regionSize), persistent(glext.bufferStorage)
+    {
+        glGenBuffers(1, &id);
+        glState.bindBuffer(target, id);
+
+        const GLsizeiptr totalSize = (GLsizeiptr)(regionSize * Regions);
+        if (persistent)
+        {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glext.BufferStorage(target, totalSize, NULL, flags);
+            mapped = (uint8_t*)glMapBufferRange(target, 0, totalSize, flags);
+            if (!mapped)
+            {
+                /* Immutable storage can't be respecified, so start over with a plain buffer */
+                std::cout << "ERROR::STREAM_BUFFER::PERSISTENT_MAP_FAILED mapping every frame instead" << std::endl;
+                persistent = false;
+                glDeleteBuffers(1, &id);
+                glState.forgetBuffer(id);
+                glGenBuffers(1, &id);
+                glState.bindBuffer(target, id);
+            }
+        }
+        if (!persistent)
+            glBufferData(target, totalSize, NULL, GL_STREAM_DRAW);
+    }
+
+    ~StreamBuffer()
+    {
+        for (GLsync& fence : fences)
+            if (fence)
+                glDeleteSync(fence);
+
+        if (mapped || regionMapped)
+        {
+            glState.bindBuffer(target, id);
+            glUnmapBuffer(target);
+        }
+        glDeleteBuffers(1, &id);
+        glState.forgetBuffer(id);
+    }
+
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+    unsigned int buffer() const { return id; }
+    size_t capacity() const { return regionSize; }
+    bool isPersistent() const { return persistent; }
+    const Stats& statistics() const { return stats; }
+
+    /* Moves to the next region, waiting for the GPU if it is still reading it */
+    void beginFrame()
+    {
+        region = (region + 1) % Regions;
+        used = 0;
+        waitForRegion(region);
+
+        if (!persistent)
+        {
+            glState.bindBuffer(target, id);
+            regionMapped = (uint8_t*)glMapBufferRange(target, region * regionSize, regionSize,
+                GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+        }
+        stats.frames++;
+    }
+
+    Allocation allocate(size_t bytes, size_t alignment = 16)
+    {
+        if (!persistent && !regionMapped)
+            return Allocation{ NULL, 0 }; // Already committed
+
+        const size_t start = (used + alignment - 1) / alignment * alignment;
+        if (start + bytes > regionSize)
+            return Allocation{ NULL, 0 };
+
+        used = start + bytes;
+        uint8_t* base = persistent ? mapped + region * regionSize : regionMapped;
+        return Allocation{ base + start, region * regionSize + start };
+    }
+
+    /* Done writing this region; the allocations may be drawn from after this */
+    void commit()
+    {
+        if (!regionMapped)
+            return;
+
+        glState.bindBuffer(target, id);
+        if (used)
+            glFlushMappedBufferRange(target, 0, used);
+        glUnmapBuffer(target);
+        regionMapped = NULL;
+    }
+
+    /* Call once the draws reading this region have been issued */
+    void endFrame()
+    {
+        commit();
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+private:
+    void waitForRegion(unsigned int index)
+    {
+        GLsync& fence = fences[index];
+        if (!fence)
+            return;
+
+        /* Ask without waiting first so we can tell a real stall from a region that was already free */
+        GLenum result = glClientWaitSync(fence, 0, 0);
+        if (result == GL_TIMEOUT_EXPIRED)
+        {
+            stats.stalls++;
+            do
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1 ms steps
+            while (result == GL_TIMEOUT_EXPIRED);
+        }
+        glDeleteSync(fence);
+        fence = 0;
+    }
+
+    GLenum target;
+    size_t regionSize;
+    bool persistent;
+    unsigned int id = 0;
+    uint8_t* mapped = NULL;        // whole buffer, persistent path
+    uint8_t* regionMapped = NULL;  // current region, fallback path
+    unsigned int region = Regions - 1;
+    size_t used = 0;
+    GLsync fences[Regions] = {};
+    Stats stats;
+};
+
+#endif
@@ -0,0 +1,383 @@
+#ifndef TEXTURE_BINDING_H
+#define TEXTURE_BINDING_H
+
+#include <glad/glad.h>
+
+#include "GLExtensions.h"
+#include "GLState.h"
+#include "StreamBuffer.h"
+#include "TextureImage.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*******************************************************************************************************************************
+Texture tables: draws pick their texture without a bind in between
+*******************************************************************************************************************************/
+/* If every draw samples its own texture, each needs a glBindTexture before it and no two can be merged. A TextureTable
+   holds a set of same-size textures, and a draw just names a slot:
+
+       Bindless   GL_ARB_bindless_texture on GL 4.3. Every texture gets a 64-bit handle, made resident once. Each
+                  frame the handle of every draw goes into a shader storage buffer, which the fragment shader
+                  indexes by draw number.
+       Array      anywhere else. The textures are layers of one GL_TEXTURE_2D_ARRAY that is bound once, and each
+                  draw passes its layer.
+
+   Either way a draw gets (draw number, layer) as an integer vertex attribute with divisor 1. With
+   glMultiDrawElementsIndirect, each queued draw becomes one indirect command whose baseInstance selects its attribute
+   value. A run of draws sharing program and VAO is then one GL call, whatever textures they use. Without it each
+   draw sets the attribute with glVertexAttribI2ui and is drawn on its own, which still saves the texture binds.
+
+   The shaders take their #version line and declarations from vertexSource()/fragmentSource(). Vertex shaders call
+   passMaterial() in main(); fragment shaders call sampleMaterial(uv) in place of texture(sampler, uv).
+
+   Usage:
+       TextureTable table(256, 256, 64);
+       uint32_t slot = table.add(pixels);  // RGBA8, width * height * 4 bytes, rows bottom to top
+       table.prepareProgram(program);      // once after linking
+       per frame:
+           table.draw(program, vao, slot, indexCount, firstIndex, baseVertex); // no GL calls
+           table.submit(GL_TRIANGLES, GL_UNSIGNED_INT);                        // once, after the last draw()
+
+   The table uses vertex attribute 7 of every VAO it draws from. */
+class TextureTable
+{
+public:
+    enum class Mode { Bindless, Array };
+
+    static const uint32_t NoSlot = 0xFFFFFFFFu;
+    static const unsigned int MaterialAttribute = 7;
+    static const unsigned int HandleBinding = 3; // shader storage binding of the per-draw handles
+    static const unsigned int ArrayUnit = 7;     // texture unit the array texture stays bound to
+
+    struct Stats
+    {
+        size_t frames = 0;
+        size_t draws = 0; // queued in the last frame
+        size_t calls = 0; // GL draw calls they took
+        size_t totalDraws = 0;
+        size_t totalCalls = 0;
+        unsigned int grows = 0;
+    };
+
+    /* allowBindless = false forces the array path, e.g. to compare the two */
+    TextureTable(int width, int height, uint32_t capacity, GLenum internalFormat = GL_RGBA8, bool allowBindless = true)
+        : width(width), height(height), capacity(capacity), internalFormat(internalFormat),
+          tableMode(allowBindless && glext.bindlessTexture && glext.atLeast(4, 3) ? Mode::Bindless : Mode::Array),
+          stream(new StreamBuffer(GL_ARRAY_BUFFER, 64 * 1024))
+    {
+        GLint alignment = 16;
+        if (tableMode == Mode::Bindless)
+            glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        storageAlignment = std::max((size_t)alignment, (size_t)16);
+
+        if (tableMode == Mode::Array)
+        {
+            GLint maxLayers = 256;
+            glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+            if (this->capacity > (uint32_t)maxLayers)
+            {
+                std::cout << "ERROR::TEXTURE_TABLE::TOO_MANY_LAYERS " << capacity << " > " << maxLayers << std::endl;
+                this->capacity = (uint32_t)maxLayers;
+            }
+
+            glGenTextures(1, &arrayTexture);
+            glState.bindTexture(ArrayUnit, GL_TEXTURE_2D_ARRAY, arrayTexture);
+            const int levels = TextureImage::mipCount(width, height);
+            for (int level = 0; level < levels; level++)
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, std::max(1, width >> level),
+                             std::max(1, height >> level), (GLsizei)this->capacity, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+            setSamplerParameters(GL_TEXTURE_2D_ARRAY);
+        }
+    }
+
+    ~TextureTable()
+    {
+        for (size_t i = 0; i < textures.size(); i++)
+        {
+            glext.MakeTextureHandleNonResident(handles[i]);
+            glDeleteTextures(1, &textures[i]);
+            glState.forgetTexture(textures[i]);
+        }
+        if (arrayTexture)
+        {
+            glDeleteTextures(1, &arrayTexture);
+            glState.forgetTexture(arrayTexture);
+        }
+    }
+
+    TextureTable(const TextureTable&) = delete;
+    TextureTable& operator=(const TextureTable&) = delete;
+
+    Mode mode() const { return tableMode; }
+    const char* modeName() const { return tableMode == Mode::Bindless ? "bindless" : "texture array"; }
+    uint32_t size() const { return count; }
+    const Stats& statistics() const { return stats; }
+
+    /* Uploads a width x height RGBA8 image and returns its slot, or NoSlot when the table is full */
+    uint32_t add(const uint8_t* rgba)
+    {
+        if (count >= capacity)
+        {
+            std::cout << "ERROR::TEXTURE_TABLE::FULL " << capacity << " textures" << std::endl;
+            return NoSlot;
+        }
+
+        if (tableMode == Mode::Bindless)
+        {
+            /* A handle freezes the texture's state, so everything is set up before asking for one */
+            unsigned int texture = 0;
+            glGenTextures(1, &texture);
+            glState.bindTexture(0, GL_TEXTURE_2D, texture);
+            glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+            glGenerateMipmap(GL_TEXTURE_2D);
+            setSamplerParameters(GL_TEXTURE_2D);
+
+            const GLuint64 handle = glext.GetTextureHandle(texture);
+            glext.MakeTextureHandleResident(handle);
+            textures.push_back(texture);
+            handles.push_back(handle);
+        }
+        else
+        {
+            glState.bindTexture(ArrayUnit, GL_TEXTURE_2D_ARRAY, arrayTexture);
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint)count, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+                            rgba);
+            mipmapsStale = true; // regenerated once at the next submit, not per layer
+        }
+        return count++;
+    }
+
+    /* Shader sources with the table's #version line and declarations in front of `body` */
+    std::string vertexSource(const std::string& body) const
+    {
+        return std::string(tableMode == Mode::Bindless ? "#version 430 core\n" : "#version 330 core\n") +
+               "layout (location = 7) in uvec2 aMaterial; // (draw number, layer)\n"
+               "flat out uvec2 vMaterial;\n"
+               "void passMaterial() { vMaterial = aMaterial; }\n" + body;
+    }
+
+    std::string fragmentSource(const std::string& body) const
+    {
+        if (tableMode == Mode::Bindless)
+            return "#version 430 core\n"
+                   "#extension GL_ARB_bindless_texture : require\n"
+                   "flat in uvec2 vMaterial;\n"
+                   "layout (std430, binding = 3) readonly buffer MaterialHandles { uvec2 materialHandles[]; };\n"
+                   "vec4 sampleMaterial(vec2 uv) { return texture(sampler2D(materialHandles[vMaterial.x]), uv); }\n" +
+                   body;
+        return "#version 330 core\n"
+               "flat in uvec2 vMaterial;\n"
+               "uniform sampler2DArray materialArray;\n"
+               "vec4 sampleMaterial(vec2 uv) { return texture(materialArray, vec3(uv, float(vMaterial.y))); }\n" +
+               body;
+    }
+
+    /* Points the program's array sampler at ArrayUnit; nothing to do for bindless programs */
+    void prepareProgram(unsigned int program)
+    {
+        if (tableMode != Mode::Array)
+            return;
+        glState.useProgram(program);
+        glUniform1i(glGetUniformLocation(program, "materialArray"), (GLint)ArrayUnit);
+    }
+
+    /* Queues an indexed draw; firstIndex counts indices, not bytes. No GL calls until submit(). */
+    void draw(unsigned int program, unsigned int vertexArray, uint32_t slot, uint32_t indexCount,
+              uint32_t firstIndex = 0, int32_t baseVertex = 0)
+    {
+        queued.push_back(QueuedDraw{ program, vertexArray, slot, indexCount, firstIndex, baseVertex });
+    }
+
+    /* Issues everything queued since the last submit and fences the per-frame data. Returns the GL draw calls made. */
+    size_t submit(GLenum mode = GL_TRIANGLES, GLenum indexType = GL_UNSIGNED_INT)
+    {
+        const size_t drawCount = queued.size();
+        if (drawCount == 0)
+            return 0;
+
+        if (mipmapsStale)
+        {
+            glState.bindTexture(ArrayUnit, GL_TEXTURE_2D_ARRAY, arrayTexture);
+            glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+            mipmapsStale = false;
+        }
+
+        /* One allocation per frame: [handles][indirect commands][attributes] */
+        const bool multiDraw = glext.multiDrawIndirect;
+        const size_t handleBytes = tableMode == Mode::Bindless ? drawCount * sizeof(GLuint64) : 0;
+        const size_t commandStart = roundUp(handleBytes, 16);
+        const size_t attributeStart = commandStart + (multiDraw ? roundUp(drawCount * sizeof(Command), 16) : 0);
+        const size_t total = attributeStart + (multiDraw ? drawCount * 2 * sizeof(uint32_t) : 0);
+
+        StreamBuffer::Allocation allocation = { NULL, 0 };
+        if (total > 0)
+        {
+            stream->beginFrame();
+            allocation = stream->allocate(total, storageAlignment);
+            if (!allocation.data)
+            {
+                /* GL keeps the old buffer's storage until the draws still reading it are done */
+                const size_t bytes = std::max(stream->capacity() * 2, roundUp(total, 64 * 1024));
+                stream.reset();
+                stream.reset(new StreamBuffer(GL_ARRAY_BUFFER, bytes));
+                stream->beginFrame();
+                allocation = stream->allocate(total, storageAlignment);
+                stats.grows++;
+            }
+            if (!allocation.data)
+            {
+                /* Nowhere to write the handles and commands; drawing would read whatever is in the buffer */
+                std::cout << "ERROR::TEXTURE_TABLE::UPLOAD_FAILED " << total << " bytes, " << drawCount
+                          << " draws skipped" << std::endl;
+                stream->endFrame();
+                queued.clear();
+                return 0;
+            }
+
+            uint8_t* base = (uint8_t*)allocation.data;
+            GLuint64* drawHandles = (GLuint64*)base;
+            Command* commands = (Command*)(base + commandStart);
+            uint32_t* attributes = (uint32_t*)(base + attributeStart);
+            for (size_t i = 0; i < drawCount; i++)
+            {
+                const QueuedDraw& d = queued[i];
+                if (handleBytes)
+                    drawHandles[i] = handles[d.slot];
+                if (multiDraw)
+                {
+                    commands[i] = Command{ d.indexCount, 1, d.firstIndex, d.baseVertex, (uint32_t)i };
+                    attributes[i * 2] = (uint32_t)i;
+                    attributes[i * 2 + 1] = d.slot;
+                }
+            }
+            stream->commit();
+        }
+
+        if (tableMode == Mode::Bindless)
+            glState.bindBufferRange(GL_SHADER_STORAGE_BUFFER, HandleBinding, stream->buffer(), allocation.offset,
+                                    handleBytes);
+        else
+            glState.bindTexture(ArrayUnit, GL_TEXTURE_2D_ARRAY, arrayTexture);
+        if (multiDraw)
+            glState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, stream->buffer());
+
+        const size_t indexSize = indexType == GL_UNSIGNED_SHORT ? 2 : indexType == GL_UNSIGNED_BYTE ? 1 : 4;
+        size_t calls = 0;
+        for (size_t first = 0; first < drawCount;)
+        {
+            /* A run of draws with the same program and VAO */
+            size_t end = first + 1;
+            while (end < drawCount && queued[end].program == queued[first].program &&
+                   queued[end].vertexArray == queued[first].vertexArray)
+                end++;
+
+            glState.useProgram(queued[first].program);
+            glState.bindVertexArray(queued[first].vertexArray);
+            if (multiDraw)
+            {
+                glState.bindBuffer(GL_ARRAY_BUFFER, stream->buffer());
+                glVertexAttribIPointer(MaterialAttribute, 2, GL_UNSIGNED_INT, 0,
+                                       (const void*)(uintptr_t)(allocation.offset + attributeStart));
+                glVertexAttribDivisor(MaterialAttribute, 1);
+                glEnableVertexAttribArray(MaterialAttribute);
+                const size_t commandOffset = allocation.offset + commandStart + first * sizeof(Command);
+                glState.multiDrawElementsIndirect(mode, indexType, (const void*)(uintptr_t)commandOffset,
+                                                  (GLsizei)(end - first));
+                calls++;
+            }
+            else
+            {
+                glDisableVertexAttribArray(MaterialAttribute);
+                for (size_t i = first; i < end; i++)
+                {
+                    const QueuedDraw& d = queued[i];
+                    glVertexAttribI2ui(MaterialAttribute, (GLuint)i, d.slot);
+                    glState.drawElementsBaseVertex(mode, (GLsizei)d.indexCount, indexType,
+                                                   (const void*)(uintptr_t)(d.firstIndex * indexSize), d.baseVertex);
+                    calls++;
+                }
+            }
+            first = end;
+        }
+
+        if (total > 0)
+            stream->endFrame();
+        queued.clear();
+
+        stats.frames++;
+        stats.draws = drawCount;
+        stats.calls = calls;
+        stats.totalDraws += drawCount;
+        stats.totalCalls += calls;
+        return calls;
+    }
+
+    void printSummary(std::ostream& out) const
+    {
+        if (stats.frames == 0)
+            return;
+        out << "Texture table (" << modeName() << (glext.multiDrawIndirect ? ", multi-draw" : "") << "): " << count
+            << " textures, " << stats.totalDraws / stats.frames << " draws in " << stats.totalCalls / stats.frames
+            << " GL calls per frame";
+        if (stats.grows)
+            out << ", buffer grown " << stats.grows << " times";
+        out << std::endl;
+    }
+
+private:
+    /* Layout glMultiDrawElementsIndirect reads */
+    struct Command
+    {
+        uint32_t count;
+        uint32_t instanceCount;
+        uint32_t firstIndex;
+        int32_t baseVertex;
+        uint32_t baseInstance;
+    };
+
+    struct QueuedDraw
+    {
+        unsigned int program;
+        unsigned int vertexArray;
+        uint32_t slot;
+        uint32_t indexCount;
+        uint32_t firstIndex;
+        int32_t baseVertex;
+    };
+
+    static size_t roundUp(size_t bytes, size_t alignment) { return (bytes + alignment - 1) / alignment * alignment; }
+
+    static void setSamplerParameters(GLenum target)
+    {
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+    int width;
+    int height;
+    uint32_t capacity;
+    GLenum internalFormat;
+    Mode tableMode;
+    uint32_t count = 0;
+    size_t storageAlignment = 16;
+
+    std::vector<unsigned int> textures; // bindless: one texture and handle per slot
+    std::vector<GLuint64> handles;
+    unsigned int arrayTexture = 0;      // array: one layer per slot
+    bool mipmapsStale = false;
+
+    std::unique_ptr<StreamBuffer> stream;
+    std::vector<QueuedDraw> queued;
+    Stats stats;
+};
+
+#endif
@@ -0,0 +1,807 @@
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+#include <glad/glad.h>
+
+#include "GLExtensions.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/*******************************************************************************************************************************
+Block-compressed texture formats
+*******************************************************************************************************************************/
+/* GPUs sample these formats directly, so a texture stays 4-8x smaller in VRAM and in every cache on the way to the
+   shader, not just on disk. All of them store 4x4 pixel blocks in 8 or 16 bytes:
+
+       BC1    RGB, 4 bpp     Two RGB565 endpoints, 2-bit indices. Opaque colour textures.
+       BC3    RGBA, 8 bpp    BC1 colour plus a BC4 block for alpha.
+       BC5    RG, 8 bpp      Two BC4 blocks (two endpoints + 3-bit indices each). Normal maps (z = sqrt(1 - x^2 - y^2)).
+       BC7    RGBA, 8 bpp    Much better quality than BC1/BC3. We only write mode 6 (one RGBA7777+p-bit endpoint pair,
+                             4-bit indices), which decoders handle like any other BC7 block.
+       ETC2   RGB, 4 bpp     The mobile/GLES format, core in GL 4.3. We write the ETC1-compatible individual and
+                             differential modes, which are valid ETC2 blocks.
+
+   The encoders fit endpoints along the block's principal axis, then refine them with a least-squares fit to the
+   chosen indices. That's far from what the best offline compressors do, but fast and decent. */
+enum class TextureFormat : uint32_t
+{
+    BC1 = 1,
+    BC3,
+    BC5,
+    BC7,
+    ETC2,
+};
+
+struct TextureFormatInfo
+{
+    TextureFormat format;
+    const char* name;
+    GLenum glFormat;
+    uint32_t blockBytes;
+    int channels; // How many of R, G, B, A the format keeps; the ones CompressionError compares
+};
+
+inline const TextureFormatInfo* textureFormatInfo(TextureFormat format)
+{
+    static const TextureFormatInfo formats[] = {
+        { TextureFormat::BC1, "bc1", GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 8, 3 },
+        { TextureFormat::BC3, "bc3", GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 16, 4 },
+        { TextureFormat::BC5, "bc5", GL_COMPRESSED_RG_RGTC2, 16, 2 },
+        { TextureFormat::BC7, "bc7", GL_COMPRESSED_RGBA_BPTC_UNORM, 16, 4 },
+        { TextureFormat::ETC2, "etc2", GL_COMPRESSED_RGB8_ETC2, 8, 3 },
+    };
+    for (const TextureFormatInfo& info : formats)
+        if (info.format == format)
+            return &info;
+    return NULL;
+}
+
+inline const TextureFormatInfo* textureFormatByName(const std::string& name)
+{
+    for (uint32_t f = (uint32_t)TextureFormat::BC1; f <= (uint32_t)TextureFormat::ETC2; f++)
+        if (name == textureFormatInfo((TextureFormat)f)->name)
+            return textureFormatInfo((TextureFormat)f);
+    return NULL;
+}
+
+/* Whether the current context can sample the format. Call after loadGLExtensions(). */
+inline bool textureFormatSupported(TextureFormat format)
+{
+    switch (format)
+    {
+    case TextureFormat::BC1:
+    case TextureFormat::BC3: return glext.textureCompressionS3tc;
+    case TextureFormat::BC5: return true;
+    case TextureFormat::BC7: return glext.textureCompressionBptc;
+    case TextureFormat::ETC2: return glext.textureCompressionEtc2;
+    }
+    return false;
+}
+
+/* Bytes of one width x height level; partial blocks at the edges count as whole ones */
+inline size_t compressedLevelSize(TextureFormat format, int width, int height)
+{
+    return (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4) * textureFormatInfo(format)->blockBytes;
+}
+
+/*******************************************************************************************************************************
+Endpoint fitting
+*******************************************************************************************************************************/
+/* 16 pixels as floats. Blocks hanging over the edge of the image repeat its last row/column. */
+struct PixelBlock
+{
+    float p[16][4];
+};
+
+inline void loadPixelBlock(const uint8_t* rgba, int width, int height, int blockX, int blockY, PixelBlock& block)
+{
+    for (int y = 0; y < 4; y++)
+    {
+        const int sy = std::min(blockY * 4 + y, height - 1);
+        for (int x = 0; x < 4; x++)
+        {
+            const uint8_t* src = rgba + ((size_t)sy * width + std::min(blockX * 4 + x, width - 1)) * 4;
+            for (int c = 0; c < 4; c++)
+                block.p[y * 4 + x][c] = (float)src[c];
+        }
+    }
+}
+
+/* Two endpoints on the line that best fits the block's colours (first n channels): the mean plus/minus the extent
+   of the pixels along the principal axis, found by power iteration on the covariance matrix */
+inline void fitEndpoints(const PixelBlock& block, int n, float e0[4], float e1[4])
+{
+    float mean[4] = {};
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < n; c++)
+            mean[c] += block.p[i][c] * (1.0f / 16.0f);
+
+    float cov[4][4] = {};
+    for (int i = 0; i < 16; i++)
+        for (int a = 0; a < n; a++)
+            for (int b = 0; b < n; b++)
+                cov[a][b] += (block.p[i][a] - mean[a]) * (block.p[i][b] - mean[b]);
+
+    int widest = 0;
+    for (int c = 1; c < n; c++)
+        if (cov[c][c] > cov[widest][widest])
+            widest = c;
+    float axis[4] = {};
+    for (int c = 0; c < n; c++)
+        axis[c] = cov[widest][c];
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[4] = {};
+        float length = 0.0f;
+        for (int a = 0; a < n; a++)
+        {
+            for (int b = 0; b < n; b++)
+                next[a] += cov[a][b] * axis[b];
+            length = std::max(length, std::fabs(next[a]));
+        }
+        if (length < 1e-6f)
+            break; // Flat block: every pixel the same colour
+        for (int c = 0; c < n; c++)
+            axis[c] = next[c] / length;
+    }
+
+    float minT = 0.0f, maxT = 0.0f, lengthSquared = 0.0f;
+    for (int c = 0; c < n; c++)
+        lengthSquared += axis[c] * axis[c];
+    if (lengthSquared > 1e-12f)
+        for (int i = 0; i < 16; i++)
+        {
+            float t = 0.0f;
+            for (int c = 0; c < n; c++)
+                t += (block.p[i][c] - mean[c]) * axis[c];
+            t /= lengthSquared;
+            minT = std::min(minT, t);
+            maxT = std::max(maxT, t);
+        }
+    for (int c = 0; c < 4; c++)
+    {
+        e0[c] = c < n ? std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * minT)) : 255.0f;
+        e1[c] = c < n ? std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * maxT)) : 255.0f;
+    }
+}
+
+/* The endpoints minimizing the squared error when pixel i is e0 + weights[i] * (e1 - e0). Returns false when the
+   weights don't pin them down (all pixels on the same index). */
+inline bool refineEndpoints(const PixelBlock& block, int n, const float weights[16], float e0[4], float e1[4])
+{
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f, pa[4] = {}, pb[4] = {};
+    for (int i = 0; i < 16; i++)
+    {
+        const float b = weights[i], a = 1.0f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int c = 0; c < n; c++)
+        {
+            pa[c] += a * block.p[i][c];
+            pb[c] += b * block.p[i][c];
+        }
+    }
+    const float det = aa * bb - ab * ab;
+    if (std::fabs(det) < 1e-6f)
+        return false;
+    for (int c = 0; c < n; c++)
+    {
+        e0[c] = std::min(255.0f, std::max(0.0f, (bb * pa[c] - ab * pb[c]) / det));
+        e1[c] = std::min(255.0f, std::max(0.0f, (aa * pb[c] - ab * pa[c]) / det));
+    }
+    return true;
+}
+
+/* Picks the nearest palette entry for each pixel; returns the total squared error over the first n channels */
+inline float chooseIndices(const PixelBlock& block, int n, const float (*palette)[4], int entries, uint8_t indices[16])
+{
+    float total = 0.0f;
+    for (int i = 0; i < 16; i++)
+    {
+        float best = 1e30f;
+        for (int e = 0; e < entries; e++)
+        {
+            float error = 0.0f;
+            for (int c = 0; c < n; c++)
+            {
+                const float d = block.p[i][c] - palette[e][c];
+                error += d * d;
+            }
+            if (error < best)
+            {
+                best = error;
+                indices[i] = (uint8_t)e;
+            }
+        }
+        total += best;
+    }
+    return total;
+}
+
+/* Little-endian bit packing for the BC7 layout */
+struct BlockBits
+{
+    uint8_t* bytes;
+    unsigned int position = 0;
+
+    void write(uint32_t value, unsigned int bits)
+    {
+        for (unsigned int i = 0; i < bits; i++, position++)
+            if (value >> i & 1u)
+                bytes[position >> 3] |= (uint8_t)(1u << (position & 7));
+    }
+
+    uint32_t read(unsigned int bits)
+    {
+        uint32_t value = 0;
+        for (unsigned int i = 0; i < bits; i++, position++)
+            value |= (uint32_t)(bytes[position >> 3] >> (position & 7) & 1u) << i;
+        return value;
+    }
+};
+
+/*******************************************************************************************************************************
+BC1 / BC4
+*******************************************************************************************************************************/
+inline uint16_t packRgb565(const float c[3])
+{
+    const int r = (int)std::lround(c[0] * 31.0f / 255.0f), g = (int)std::lround(c[1] * 63.0f / 255.0f),
+              b = (int)std::lround(c[2] * 31.0f / 255.0f);
+    return (uint16_t)(r << 11 | g << 5 | b);
+}
+
+inline void unpackRgb565(uint16_t v, float c[4])
+{
+    const int r = v >> 11, g = v >> 5 & 63, b = v & 31;
+    c[0] = (float)(r << 3 | r >> 2);
+    c[1] = (float)(g << 2 | g >> 4);
+    c[2] = (float)(b << 3 | b >> 2);
+    c[3] = 255.0f;
+}
+
+/* The four colours of a block. c0 > c1 selects the four-colour mode; otherwise index 2 is the midpoint and index 3 is
+   black (transparent for RGBA DXT1). BC3's colour block is always four-colour. */
+inline void bc1Palette(uint16_t c0, uint16_t c1, bool alwaysFourColours, float palette[4][4])
+{
+    unpackRgb565(c0, palette[0]);
+    unpackRgb565(c1, palette[1]);
+    for (int c = 0; c < 3; c++)
+        if (c0 > c1 || alwaysFourColours)
+        {
+            palette[2][c] = std::floor((2.0f * palette[0][c] + palette[1][c]) / 3.0f);
+            palette[3][c] = std::floor((palette[0][c] + 2.0f * palette[1][c]) / 3.0f);
+        }
+        else
+        {
+            palette[2][c] = std::floor((palette[0][c] + palette[1][c]) / 2.0f);
+            palette[3][c] = 0.0f;
+        }
+    palette[2][3] = 255.0f;
+    palette[3][3] = c0 > c1 || alwaysFourColours ? 255.0f : 0.0f;
+}
+
+/* Quantizes the endpoints and picks indices; returns the squared error */
+inline float encodeBc1Endpoints(const PixelBlock& block, const float e0[4], const float e1[4], uint8_t out[8])
+{
+    uint16_t c0 = packRgb565(e0), c1 = packRgb565(e1);
+    if (c0 < c1)
+        std::swap(c0, c1); // Four-colour mode needs c0 > c1; the indices below follow whichever order we end up with
+
+    float palette[4][4];
+    bc1Palette(c0, c1, true, palette);
+    uint8_t indices[16] = {};
+    const float error = chooseIndices(block, 3, palette, c0 == c1 ? 1 : 4, indices);
+
+    uint32_t bits = 0;
+    for (int i = 0; i < 16; i++)
+        bits |= (uint32_t)indices[i] << (i * 2);
+    out[0] = (uint8_t)c0;
+    out[1] = (uint8_t)(c0 >> 8);
+    out[2] = (uint8_t)c1;
+    out[3] = (uint8_t)(c1 >> 8);
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (uint8_t)(bits >> (i * 8));
+    return error;
+}
+
+inline void encodeBc1Block(const PixelBlock& block, uint8_t out[8])
+{
+    float e0[4], e1[4];
+    fitEndpoints(block, 3, e0, e1);
+    float best = encodeBc1Endpoints(block, e0, e1, out);
+
+    /* Weights of indices 0..3 along c0 -> c1 */
+    static const float weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+    for (int iteration = 0; iteration < 2; iteration++)
+    {
+        const uint32_t bits =
+            (uint32_t)out[4] | (uint32_t)out[5] << 8 | (uint32_t)out[6] << 16 | (uint32_t)out[7] << 24;
+        float w[16];
+        for (int i = 0; i < 16; i++)
+            w[i] = weights[bits >> (i * 2) & 3];
+        unpackRgb565((uint16_t)(out[0] | out[1] << 8), e0);
+        unpackRgb565((uint16_t)(out[2] | out[3] << 8), e1);
+        if (!refineEndpoints(block, 3, w, e0, e1))
+            break;
+
+        uint8_t candidate[8];
+        const float error = encodeBc1Endpoints(block, e0, e1, candidate);
+        if (error >= best)
+            break;
+        best = error;
+        std::memcpy(out, candidate, 8);
+    }
+}
+
+/* One channel: two 8-bit endpoints and a 3-bit index per pixel. With a0 > a1 the six values in between are
+   interpolated, which is the mode we always write. */
+inline void encodeBc4Block(const PixelBlock& block, int channel, uint8_t out[8])
+{
+    float lo = 255.0f, hi = 0.0f;
+    for (int i = 0; i < 16; i++)
+    {
+        lo = std::min(lo, block.p[i][channel]);
+        hi = std::max(hi, block.p[i][channel]);
+    }
+    const int a0 = (int)std::lround(hi), a1 = (int)std::lround(lo);
+
+    uint64_t bits = 0;
+    if (a0 != a1)
+        for (int i = 0; i < 16; i++)
+        {
+            /* Palette order: a0, a1, then 6/7 a0 + 1/7 a1 ... 1/7 a0 + 6/7 a1 */
+            const float t = (hi - block.p[i][channel]) / (hi - lo) * 7.0f; // 0 at a0, 7 at a1
+            const int step = (int)std::lround(t);
+            const uint64_t index = step == 0 ? 0 : step == 7 ? 1 : (uint64_t)(step + 1);
+            bits |= index << (i * 3);
+        }
+    out[0] = (uint8_t)a0;
+    out[1] = (uint8_t)a1;
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (uint8_t)(bits >> (i * 8));
+}
+
+inline void decodeBc1Block(const uint8_t* in, bool alwaysFourColours, uint8_t out[16][4])
+{
+    float palette[4][4];
+    bc1Palette((uint16_t)(in[0] | in[1] << 8), (uint16_t)(in[2] | in[3] << 8), alwaysFourColours, palette);
+    const uint32_t bits = (uint32_t)in[4] | (uint32_t)in[5] << 8 | (uint32_t)in[6] << 16 | (uint32_t)in[7] << 24;
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 4; c++)
+            out[i][c] = (uint8_t)palette[bits >> (i * 2) & 3][c];
+}
+
+inline void decodeBc4Block(const uint8_t* in, int channel, uint8_t out[16][4])
+{
+    const int a0 = in[0], a1 = in[1];
+    int values[8] = { a0, a1 };
+    for (int i = 2; i < 8; i++)
+    {
+        if (a0 > a1)
+            values[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+        else
+            values[i] = i < 6 ? ((6 - i) * a0 + (i - 1) * a1) / 5 : i == 6 ? 0 : 255; // Four steps plus 0 and 255
+    }
+    uint64_t bits = 0;
+    for (int i = 0; i < 6; i++)
+        bits |= (uint64_t)in[2 + i] << (i * 8);
+    for (int i = 0; i < 16; i++)
+        out[i][channel] = (uint8_t)values[bits >> (i * 3) & 7];
+}
+
+/*******************************************************************************************************************************
+BC7 (mode 6)
+*******************************************************************************************************************************/
+const int Bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+/* 7 bits per channel plus a p-bit shared by the endpoint's four channels: value = q << 1 | p */
+inline void quantizeBc7Endpoint(const float e[4], int q[4], int& p)
+{
+    float bestError = 1e30f;
+    for (int pbit = 0; pbit < 2; pbit++)
+    {
+        int candidate[4];
+        float error = 0.0f;
+        for (int c = 0; c < 4; c++)
+        {
+            candidate[c] = std::min(127, std::max(0, (int)std::lround((e[c] - (float)pbit) * 0.5f)));
+            const float d = (float)(candidate[c] << 1 | pbit) - e[c];
+            error += d * d;
+        }
+        if (error < bestError)
+        {
+            bestError = error;
+            p = pbit;
+            std::memcpy(q, candidate, sizeof(candidate));
+        }
+    }
+}
+
+inline void bc7Palette(const int q[2][4], const int p[2], float palette[16][4])
+{
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 4; c++)
+        {
+            const int a = q[0][c] << 1 | p[0], b = q[1][c] << 1 | p[1];
+            palette[i][c] = (float)(((64 - Bc7Weights4[i]) * a + Bc7Weights4[i] * b + 32) >> 6);
+        }
+}
+
+inline float encodeBc7Endpoints(const PixelBlock& block, const float e0[4], const float e1[4], uint8_t out[16])
+{
+    int q[2][4], p[2];
+    quantizeBc7Endpoint(e0, q[0], p[0]);
+    quantizeBc7Endpoint(e1, q[1], p[1]);
+
+    float palette[16][4];
+    bc7Palette(q, p, palette);
+    uint8_t indices[16];
+    const float error = chooseIndices(block, 4, palette, 16, indices);
+
+    /* Pixel 0's index is stored without its top bit, so it has to be < 8: swap the endpoints if it isn't */
+    if (indices[0] & 8)
+    {
+        std::swap(q[0], q[1]);
+        std::swap(p[0], p[1]);
+        for (uint8_t& index : indices)
+            index = (uint8_t)(15 - index);
+    }
+
+    std::memset(out, 0, 16);
+    BlockBits bits = { out };
+    bits.write(1u << 6, 7); // Mode 6
+    for (int c = 0; c < 4; c++)
+    {
+        bits.write((uint32_t)q[0][c], 7);
+        bits.write((uint32_t)q[1][c], 7);
+    }
+    bits.write((uint32_t)p[0], 1);
+    bits.write((uint32_t)p[1], 1);
+    bits.write(indices[0], 3);
+    for (int i = 1; i < 16; i++)
+        bits.write(indices[i], 4);
+    return error;
+}
+
+inline void readBc7Mode6(uint8_t* in, int q[2][4], int p[2], uint8_t indices[16])
+{
+    BlockBits bits = { in };
+    bits.read(7);
+    for (int c = 0; c < 4; c++)
+    {
+        q[0][c] = (int)bits.read(7);
+        q[1][c] = (int)bits.read(7);
+    }
+    p[0] = (int)bits.read(1);
+    p[1] = (int)bits.read(1);
+    indices[0] = (uint8_t)bits.read(3);
+    for (int i = 1; i < 16; i++)
+        indices[i] = (uint8_t)bits.read(4);
+}
+
+inline void encodeBc7Block(const PixelBlock& block, uint8_t out[16])
+{
+    float e0[4], e1[4];
+    fitEndpoints(block, 4, e0, e1);
+    float best = encodeBc7Endpoints(block, e0, e1, out);
+
+    for (int iteration = 0; iteration < 2; iteration++)
+    {
+        int q[2][4], p[2];
+        uint8_t indices[16];
+        readBc7Mode6(out, q, p, indices);
+        float w[16];
+        for (int i = 0; i < 16; i++)
+            w[i] = (float)Bc7Weights4[indices[i]] / 64.0f;
+        if (!refineEndpoints(block, 4, w, e0, e1))
+            break;
+
+        uint8_t candidate[16];
+        const float error = encodeBc7Endpoints(block, e0, e1, candidate);
+        if (error >= best)
+            break;
+        best = error;
+        std::memcpy(out, candidate, 16);
+    }
+}
+
+/* Only mode 6, the one we write; other modes decode as black */
+inline void decodeBc7Block(const uint8_t* in, uint8_t out[16][4])
+{
+    if ((in[0] & 0x7F) != 1u << 6)
+    {
+        std::memset(out, 0, 64);
+        return;
+    }
+    uint8_t copy[16];
+    std::memcpy(copy, in, 16);
+    int q[2][4], p[2];
+    uint8_t indices[16];
+    readBc7Mode6(copy, q, p, indices);
+    float palette[16][4];
+    bc7Palette(q, p, palette);
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 4; c++)
+            out[i][c] = (uint8_t)palette[indices[i]][c];
+}
+
+/*******************************************************************************************************************************
+ETC2 (ETC1-compatible modes)
+*******************************************************************************************************************************/
+/* The block is split into two 2x4 halves (or 4x2 when "flipped"). Each half has a base colour and picks one of eight
+   intensity tables; every pixel adds one of its table's four offsets to all three channels. Bits are big-endian and
+   pixels are numbered down the columns: pixel (x, y) is bit x * 4 + y. */
+const int EtcModifiers[8][2] = {
+    { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 }
+};
+
+inline int etcOffset(int table, int selector)
+{
+    /* selector = msb << 1 | lsb: 0 -> +small, 1 -> +large, 2 -> -small, 3 -> -large */
+    const int magnitude = EtcModifiers[table][selector & 1];
+    return selector & 2 ? -magnitude : magnitude;
+}
+
+inline bool etcInHalf(int x, int y, bool flip, int half) { return (flip ? y >= 2 : x >= 2) == (half == 1); }
+
+/* Best table and selectors for one half with the given base colour; returns the squared error. Each table's four
+   colours are worked out once, and a table is abandoned as soon as it can't beat the best one so far. */
+inline float fitEtcHalf(const PixelBlock& block, bool flip, int half, const int base[3], int& table,
+                        uint8_t selectors[16])
+{
+    int pixels[8][3], bits[8], count = 0;
+    for (int y = 0; y < 4; y++)
+        for (int x = 0; x < 4; x++)
+            if (etcInHalf(x, y, flip, half))
+            {
+                for (int c = 0; c < 3; c++)
+                    pixels[count][c] = (int)block.p[y * 4 + x][c];
+                bits[count++] = x * 4 + y;
+            }
+
+    int best = 1 << 30;
+    for (int t = 0; t < 8; t++)
+    {
+        int colours[4][3];
+        for (int s = 0; s < 4; s++)
+            for (int c = 0; c < 3; c++)
+                colours[s][c] = std::min(255, std::max(0, base[c] + etcOffset(t, s)));
+
+        int total = 0;
+        uint8_t chosen[8];
+        for (int i = 0; i < 8 && total < best; i++)
+        {
+            int bestPixel = 1 << 30;
+            for (int s = 0; s < 4; s++)
+            {
+                const int dr = colours[s][0] - pixels[i][0], dg = colours[s][1] - pixels[i][1],
+                          db = colours[s][2] - pixels[i][2];
+                const int error = dr * dr + dg * dg + db * db;
+                if (error < bestPixel)
+                {
+                    bestPixel = error;
+                    chosen[i] = (uint8_t)s;
+                }
+            }
+            total += bestPixel;
+        }
+        if (total < best)
+        {
+            best = total;
+            table = t;
+            for (int i = 0; i < 8; i++)
+                selectors[bits[i]] = chosen[i];
+        }
+    }
+    return (float)best;
+}
+
+inline void encodeEtc2Block(const PixelBlock& block, uint8_t out[8])
+{
+    float bestError = 1e30f;
+    for (int flip = 0; flip < 2; flip++)
+    {
+        float average[2][3] = {};
+        for (int y = 0; y < 4; y++)
+            for (int x = 0; x < 4; x++)
+                for (int c = 0; c < 3; c++)
+                    average[etcInHalf(x, y, flip != 0, 1) ? 1 : 0][c] += block.p[y * 4 + x][c] / 8.0f;
+
+        bool differentialFits = false;
+        for (int differential = 1; differential >= 0; differential--)
+        {
+            /* Differential: 5-bit base colours, the second stored as a 3-bit signed delta from the first.
+               Individual: two independent 4-bit colours. */
+            int quantized[2][3], base[2][3];
+            bool fits = true;
+            for (int half = 0; half < 2; half++)
+                for (int c = 0; c < 3; c++)
+                {
+                    const int levels = differential ? 31 : 15;
+                    quantized[half][c] = (int)std::lround(average[half][c] * (float)levels / 255.0f);
+                    const int q = quantized[half][c];
+                    base[half][c] = differential ? (q << 3 | q >> 2) : (q << 4 | q);
+                }
+            if (differential)
+                for (int c = 0; c < 3; c++)
+                    fits = fits && quantized[1][c] - quantized[0][c] >= -4 && quantized[1][c] - quantized[0][c] <= 3;
+            if (!fits)
+                continue;
+            if (!differential && differentialFits)
+                continue; // 4-bit colours are coarser and rarely win when the 5-bit ones fit
+            differentialFits = differential != 0;
+
+            int tables[2];
+            uint8_t selectors[16];
+            const float error = fitEtcHalf(block, flip != 0, 0, base[0], tables[0], selectors) +
+                                fitEtcHalf(block, flip != 0, 1, base[1], tables[1], selectors);
+            if (error >= bestError)
+                continue;
+            bestError = error;
+
+            for (int c = 0; c < 3; c++)
+                out[c] = differential ? (uint8_t)(quantized[0][c] << 3 | ((quantized[1][c] - quantized[0][c]) & 7))
+                                      : (uint8_t)(quantized[0][c] << 4 | quantized[1][c]);
+            out[3] = (uint8_t)(tables[0] << 5 | tables[1] << 2 | differential << 1 | flip);
+            uint32_t msb = 0, lsb = 0;
+            for (int i = 0; i < 16; i++)
+            {
+                msb |= (uint32_t)(selectors[i] >> 1) << i;
+                lsb |= (uint32_t)(selectors[i] & 1) << i;
+            }
+            out[4] = (uint8_t)(msb >> 8);
+            out[5] = (uint8_t)msb;
+            out[6] = (uint8_t)(lsb >> 8);
+            out[7] = (uint8_t)lsb;
+        }
+    }
+}
+
+/* Individual and differential modes only, the ones we write (ETC2's T/H/planar modes decode as black) */
+inline void decodeEtc2Block(const uint8_t* in, uint8_t out[16][4])
+{
+    const bool differential = (in[3] & 2) != 0, flip = (in[3] & 1) != 0;
+    int base[2][3];
+    for (int c = 0; c < 3; c++)
+        if (differential)
+        {
+            const int q0 = in[c] >> 3, delta = (in[c] & 7) >= 4 ? (in[c] & 7) - 8 : (in[c] & 7), q1 = q0 + delta;
+            if (q1 < 0 || q1 > 31)
+            {
+                std::memset(out, 0, 64);
+                return;
+            }
+            base[0][c] = q0 << 3 | q0 >> 2;
+            base[1][c] = q1 << 3 | q1 >> 2;
+        }
+        else
+        {
+            base[0][c] = (in[c] >> 4) * 17;
+            base[1][c] = (in[c] & 15) * 17;
+        }
+    const int tables[2] = { in[3] >> 5, in[3] >> 2 & 7 };
+    const uint32_t msb = (uint32_t)in[4] << 8 | in[5], lsb = (uint32_t)in[6] << 8 | in[7];
+    for (int y = 0; y < 4; y++)
+        for (int x = 0; x < 4; x++)
+        {
+            const int half = etcInHalf(x, y, flip, 1) ? 1 : 0, bit = x * 4 + y;
+            const int selector = (int)((msb >> bit & 1) << 1 | (lsb >> bit & 1));
+            for (int c = 0; c < 3; c++)
+            {
+                const int value = base[half][c] + etcOffset(tables[half], selector);
+                out[y * 4 + x][c] = (uint8_t)std::min(255, std::max(0, value));
+            }
+            out[y * 4 + x][3] = 255;
+        }
+}
+
+/*******************************************************************************************************************************
+Whole levels
+*******************************************************************************************************************************/
+inline void encodeBlock(TextureFormat format, const PixelBlock& block, uint8_t* out)
+{
+    switch (format)
+    {
+    case TextureFormat::BC1: encodeBc1Block(block, out); break;
+    case TextureFormat::BC3: encodeBc4Block(block, 3, out); encodeBc1Block(block, out + 8); break;
+    case TextureFormat::BC5: encodeBc4Block(block, 0, out); encodeBc4Block(block, 1, out + 8); break;
+    case TextureFormat::BC7: encodeBc7Block(block, out); break;
+    case TextureFormat::ETC2: encodeEtc2Block(block, out); break;
+    }
+}
+
+inline void decodeBlock(TextureFormat format, const uint8_t* in, uint8_t out[16][4])
+{
+    switch (format)
+    {
+    case TextureFormat::BC1: decodeBc1Block(in, false, out); break;
+    case TextureFormat::BC3: decodeBc1Block(in + 8, true, out); decodeBc4Block(in, 3, out); break;
+    case TextureFormat::BC5:
+        std::memset(out, 0, 64);
+        decodeBc4Block(in, 0, out);
+        decodeBc4Block(in + 8, 1, out);
+        for (int i = 0; i < 16; i++)
+            out[i][3] = 255;
+        break;
+    case TextureFormat::BC7: decodeBc7Block(in, out); break;
+    case TextureFormat::ETC2: decodeEtc2Block(in, out); break;
+    }
+}
+
+/* Compresses one RGBA8 level into out. Rows of blocks are spread over the pool's workers; every block is
+   independent, so this scales with the number of cores. */
+inline void encodeTextureLevel(ThreadPool& pool, TextureFormat format, const uint8_t* rgba, int width, int height,
+                               std::vector<uint8_t>& out)
+{
+    const int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    const uint32_t blockBytes = textureFormatInfo(format)->blockBytes;
+    out.resize(compressedLevelSize(format, width, height));
+
+    uint8_t* blocks = out.data();
+    pool.parallelFor((size_t)blocksY, 1, [&](size_t begin, size_t end, unsigned int)
+    {
+        PixelBlock block;
+        for (size_t by = begin; by < end; by++)
+            for (int bx = 0; bx < blocksX; bx++)
+            {
+                loadPixelBlock(rgba, width, height, bx, (int)by, block);
+                encodeBlock(format, block, blocks + ((size_t)by * blocksX + bx) * blockBytes);
+            }
+    });
+}
+
+/* Expands a compressed level back to RGBA8, to measure what the compression lost */
+inline void decodeTextureLevel(TextureFormat format, const uint8_t* blocks, int width, int height,
+                               std::vector<uint8_t>& rgba)
+{
+    const int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    const uint32_t blockBytes = textureFormatInfo(format)->blockBytes;
+    rgba.resize((size_t)width * height * 4);
+    uint8_t pixels[16][4];
+    for (int by = 0; by < blocksY; by++)
+        for (int bx = 0; bx < blocksX; bx++)
+        {
+            decodeBlock(format, blocks + ((size_t)by * blocksX + bx) * blockBytes, pixels);
+            for (int y = 0; y < 4 && by * 4 + y < height; y++)
+                for (int x = 0; x < 4 && bx * 4 + x < width; x++)
+                    std::memcpy(&rgba[((size_t)(by * 4 + y) * width + bx * 4 + x) * 4], pixels[y * 4 + x], 4);
+        }
+}
+
+/* Squared error summed over the channels the format keeps, and how many values that covered. Add these up over
+   levels or images before turning them into a PSNR. */
+struct CompressionError
+{
+    double squaredError = 0.0;
+    double values = 0.0;
+
+    void add(const uint8_t* original, const uint8_t* decoded, size_t pixels, int channels)
+    {
+        for (size_t i = 0; i < pixels; i++)
+            for (int c = 0; c < channels; c++)
+            {
+                const double d = (double)original[i * 4 + c] - (double)decoded[i * 4 + c];
+                squaredError += d * d;
+            }
+        values += (double)pixels * channels;
+    }
+
+    /* Peak signal-to-noise ratio in dB; higher is better. Around 40 dB is hard to tell from the original, 30 dB
+       shows artifacts on close inspection. A perfect match is reported as 99. */
+    double psnr() const
+    {
+        if (values == 0.0 || squaredError == 0.0)
+            return 99.0;
+        return 10.0 * std::log10(255.0 * 255.0 / (squaredError / values));
+    }
+};
+
+#endif
@@ -0,0 +1,181 @@
+#ifndef TEXTURE_FILE_H
+#define TEXTURE_FILE_H
+
+#include <glad/glad.h>
+
+#include "GLState.h"
+#include "MappedFile.h"
+#include "TextureCompression.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*******************************************************************************************************************************
+Compressed texture files (.htex)
+*******************************************************************************************************************************/
+/* Written by tools/TextureCooker, read by loadTextureFile. Like .hmesh (MeshFile.h) the blobs are stored exactly as
+   glCompressedTexImage2D wants them, so loading is: map the file, check the header, pass pointers into the mapping.
+
+       TextureFileHeader     magic, format, size, and where each mip level is
+       padding
+       level blobs           smallest level first (as in KTX2), each starting on a TextureFileAlignment boundary
+
+   Levels are only aligned to 16 bytes, not to pages like mesh blobs: a mip chain has a dozen levels, most of them
+   tiny, and 16 bytes is a whole number of blocks for every format. All values are little-endian. */
+const uint32_t TextureFileMagic = 0x58455448; // "HTEX"
+const uint32_t TextureFileVersion = 1;
+const uint64_t TextureFileAlignment = 16;
+const uint32_t TextureFileMaxLevels = 16;
+
+struct TextureFileLevel
+{
+    uint64_t offset;
+    uint64_t bytes;
+    uint32_t width;
+    uint32_t height;
+};
+
+struct TextureFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t format;        // TextureFormat
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+    TextureFileLevel levels[TextureFileMaxLevels]; // Indexed by mip level, 0 = full size
+};
+
+/* A texture loaded from a .htex file */
+struct GpuTexture
+{
+    unsigned int id = 0;
+    int width = 0;
+    int height = 0;
+    int levels = 0;
+
+    void destroy()
+    {
+        glDeleteTextures(1, &id);
+        glState.forgetTexture(id);
+        id = 0;
+    }
+};
+
+/* levels[i] must hold compressedLevelSize(format, width >> i, height >> i) bytes */
+inline bool writeTextureFile(const std::string& path, TextureFormat format, int width, int height,
+                             const std::vector<std::vector<uint8_t>>& levels)
+{
+    if (levels.empty() || levels.size() > TextureFileMaxLevels)
+    {
+        std::cout << "ERROR::TEXTURE_FILE::TOO_MANY_LEVELS " << levels.size() << std::endl;
+        return false;
+    }
+
+    TextureFileHeader header = TextureFileHeader();
+    header.magic = TextureFileMagic;
+    header.version = TextureFileVersion;
+    header.format = (uint32_t)format;
+    header.width = (uint32_t)width;
+    header.height = (uint32_t)height;
+    header.levelCount = (uint32_t)levels.size();
+
+    uint64_t offset = sizeof(TextureFileHeader);
+    for (size_t i = levels.size(); i-- > 0;)
+    {
+        offset = (offset + TextureFileAlignment - 1) / TextureFileAlignment * TextureFileAlignment;
+        TextureFileLevel& level = header.levels[i];
+        level.offset = offset;
+        level.bytes = levels[i].size();
+        level.width = (uint32_t)std::max(1, width >> i);
+        level.height = (uint32_t)std::max(1, height >> i);
+        offset += level.bytes;
+    }
+
+    std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+        std::cout << "ERROR::TEXTURE_FILE::CANNOT_WRITE " << path << std::endl;
+        return false;
+    }
+
+    static const char zeros[TextureFileAlignment] = {};
+    uint64_t written = sizeof(header);
+    out.write((const char*)&header, sizeof(header));
+    for (size_t i = levels.size(); i-- > 0;)
+    {
+        out.write(zeros, (std::streamsize)(header.levels[i].offset - written));
+        out.write((const char*)levels[i].data(), (std::streamsize)levels[i].size());
+        written = header.levels[i].offset + header.levels[i].bytes;
+    }
+    return (bool)out;
+}
+
+/* Maps the file, validates it and uploads every level. Returns false (and prints why) if the file is unusable or the
+   driver can't sample its format. */
+inline bool loadTextureFile(const std::string& path, GpuTexture& texture)
+{
+    MappedFile file(path);
+    if (!file.isOpen())
+        return false;
+
+    const TextureFileHeader* header = (const TextureFileHeader*)file.range(0, sizeof(TextureFileHeader));
+    if (!header || header->magic != TextureFileMagic || header->version != TextureFileVersion)
+    {
+        std::cout << "ERROR::TEXTURE_FILE::NOT_A_TEXTURE_FILE " << path << std::endl;
+        return false;
+    }
+
+    const TextureFormat format = (TextureFormat)header->format;
+    const TextureFormatInfo* info = textureFormatInfo(format);
+    bool valid = info && header->width > 0 && header->height > 0 && header->levelCount > 0 &&
+                 header->levelCount <= TextureFileMaxLevels;
+    for (uint32_t i = 0; valid && i < header->levelCount; i++)
+    {
+        const TextureFileLevel& level = header->levels[i];
+        valid = level.width == (uint32_t)std::max(1, (int)header->width >> i) &&
+                level.height == (uint32_t)std::max(1, (int)header->height >> i) &&
+                level.bytes == compressedLevelSize(format, (int)level.width, (int)level.height) &&
+                file.range(level.offset, level.bytes) != NULL;
+    }
+    if (!valid)
+    {
+        std::cout << "ERROR::TEXTURE_FILE::CORRUPT " << path << std::endl;
+        return false;
+    }
+    if (!textureFormatSupported(format))
+    {
+        std::cout << "ERROR::TEXTURE_FILE::FORMAT_NOT_SUPPORTED " << info->name << " (" << path << ")" << std::endl;
+        return false;
+    }
+
+    texture.width = (int)header->width;
+    texture.height = (int)header->height;
+    texture.levels = (int)header->levelCount;
+    glGenTextures(1, &texture.id);
+    glState.bindTexture(0, GL_TEXTURE_2D, texture.id);
+
+    /* Straight from the mapping: the driver copies (or transcodes) each level once and that's the only copy. Going
+       through the levels in file order also makes the page faults sequential. */
+    for (int i = texture.levels - 1; i >= 0; i--)
+    {
+        const TextureFileLevel& level = header->levels[i];
+        glCompressedTexImage2D(GL_TEXTURE_2D, i, info->glFormat, (GLsizei)level.width, (GLsizei)level.height, 0,
+                               (GLsizei)level.bytes, file.range(level.offset, level.bytes));
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture.levels - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, texture.levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    /* glCompressedTexImage2D has copied the data by the time it returns, so the mapping can go now */
+    return true;
+}
+
+#endif
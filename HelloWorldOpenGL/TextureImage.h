@@ -0,0 +1,180 @@
+#ifndef TEXTURE_IMAGE_H
+#define TEXTURE_IMAGE_H
+
+#include "MappedFile.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*******************************************************************************************************************************
+RGBA8 images and mip chains
+*******************************************************************************************************************************/
+/* levels[0] is the full-size image, each further level half the size of the previous one (rounded down, at least 1)
+   down to 1x1. Rows go bottom to top like GL expects. */
+struct TextureImage
+{
+    int width = 0;
+    int height = 0;
+    std::vector<std::vector<uint8_t>> levels;
+
+    int levelWidth(int level) const { return std::max(1, width >> level); }
+    int levelHeight(int level) const { return std::max(1, height >> level); }
+
+    static int mipCount(int width, int height)
+    {
+        int count = 1;
+        while ((std::max(width, height) >> count) > 0)
+            count++;
+        return count;
+    }
+};
+
+/* Averages pairs of source pixels from two rows into count output pixels: out[x] = (2x, 2x+1 of row0 and row1 + 2) / 4
+   per channel. Both rows must have 2 * count pixels. */
+inline void downsampleRows(const uint8_t* row0, const uint8_t* row1, uint8_t* out, int count)
+{
+    int x = 0;
+#if defined(HELLO_AVX2)
+    /* 8 source pixels per row -> 4 output pixels. Unpacking works within each 128-bit half, so the halves are
+       reduced separately and put back together with one permute. */
+    const __m256i wideZero = _mm256_setzero_si256();
+    const __m256i wideTwo = _mm256_set1_epi16(2);
+    for (; x + 4 <= count; x += 4)
+    {
+        const __m256i a = _mm256_loadu_si256((const __m256i*)(row0 + x * 8));
+        const __m256i b = _mm256_loadu_si256((const __m256i*)(row1 + x * 8));
+        /* Pixels 0,1 | 4,5 and 2,3 | 6,7 as 16-bit sums of the two rows */
+        const __m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(a, wideZero), _mm256_unpacklo_epi8(b, wideZero));
+        const __m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(a, wideZero), _mm256_unpackhi_epi8(b, wideZero));
+        const __m256i pairLo = _mm256_add_epi16(lo, _mm256_srli_si256(lo, 8));
+        const __m256i pairHi = _mm256_add_epi16(hi, _mm256_srli_si256(hi, 8));
+        const __m256i sum = _mm256_srli_epi16(_mm256_add_epi16(_mm256_unpacklo_epi64(pairLo, pairHi), wideTwo), 2);
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(sum, sum), 0x08); // qwords 0 and 2
+        _mm_storeu_si128((__m128i*)(out + x * 4), _mm256_castsi256_si128(packed));
+    }
+#endif
+#if defined(HELLO_SSE2)
+    /* 4 source pixels per row -> 2 output pixels */
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+    for (; x + 2 <= count; x += 2)
+    {
+        const __m128i a = _mm_loadu_si128((const __m128i*)(row0 + x * 8));
+        const __m128i b = _mm_loadu_si128((const __m128i*)(row1 + x * 8));
+        const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+        const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+        const __m128i pairLo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+        const __m128i pairHi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+        const __m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(pairLo, pairHi), two), 2);
+        _mm_storel_epi64((__m128i*)(out + x * 4), _mm_packus_epi16(sum, sum));
+    }
+#endif
+    for (; x < count; x++)
+        for (int c = 0; c < 4; c++)
+            out[x * 4 + c] =
+                (uint8_t)((row0[x * 8 + c] + row0[x * 8 + 4 + c] + row1[x * 8 + c] + row1[x * 8 + 4 + c] + 2) >> 2);
+}
+
+/* Fills in levels[1..] from levels[0] with a 2x2 box filter. Odd sizes repeat the last row/column. */
+inline void buildMipChain(TextureImage& image)
+{
+    const int count = TextureImage::mipCount(image.width, image.height);
+    image.levels.resize(count);
+    for (int level = 1; level < count; level++)
+    {
+        const int srcWidth = image.levelWidth(level - 1), srcHeight = image.levelHeight(level - 1);
+        const int width = image.levelWidth(level), height = image.levelHeight(level);
+        const uint8_t* src = image.levels[level - 1].data();
+        std::vector<uint8_t>& dst = image.levels[level];
+        dst.resize((size_t)width * height * 4);
+
+        /* Output pixels whose two source columns both exist go through the SIMD path */
+        const int paired = std::min(width, srcWidth / 2);
+        for (int y = 0; y < height; y++)
+        {
+            const uint8_t* row0 = src + (size_t)std::min(y * 2, srcHeight - 1) * srcWidth * 4;
+            const uint8_t* row1 = src + (size_t)std::min(y * 2 + 1, srcHeight - 1) * srcWidth * 4;
+            uint8_t* out = &dst[(size_t)y * width * 4];
+            downsampleRows(row0, row1, out, paired);
+            for (int x = paired; x < width; x++)
+            {
+                const int x0 = std::min(x * 2, srcWidth - 1) * 4, x1 = std::min(x * 2 + 1, srcWidth - 1) * 4;
+                for (int c = 0; c < 4; c++)
+                    out[x * 4 + c] = (uint8_t)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+            }
+        }
+    }
+}
+
+/*******************************************************************************************************************************
+PPM files
+*******************************************************************************************************************************/
+/* Binary PPM (P6, 8 bits per channel), about the simplest image format there is. Alpha is set to 255. */
+inline bool decodePpm(const uint8_t* data, size_t size, TextureImage& image)
+{
+    size_t pos = 0;
+    int header[3] = {};
+    if (size < 2 || data[0] != 'P' || data[1] != '6')
+        return false;
+    pos = 2;
+    for (int& value : header)
+    {
+        /* Whitespace and # comments may sit between the header fields */
+        while (pos < size && (std::isspace(data[pos]) || data[pos] == '#'))
+        {
+            if (data[pos] == '#')
+                while (pos < size && data[pos] != '\n')
+                    pos++;
+            else
+                pos++;
+        }
+        if (pos >= size || !std::isdigit(data[pos]))
+            return false;
+        while (pos < size && std::isdigit(data[pos]) && value < (1 << 20))
+            value = value * 10 + (data[pos++] - '0');
+    }
+    pos++; // Exactly one whitespace character before the pixels
+
+    const int width = header[0], height = header[1];
+    if (width <= 0 || height <= 0 || header[2] != 255 || pos + (size_t)width * height * 3 > size)
+        return false;
+
+    image.width = width;
+    image.height = height;
+    image.levels.assign(1, std::vector<uint8_t>((size_t)width * height * 4));
+    for (int y = 0; y < height; y++)
+    {
+        const uint8_t* in = data + pos + (size_t)(height - 1 - y) * width * 3; // PPM rows go top to bottom
+        uint8_t* out = &image.levels[0][(size_t)y * width * 4];
+        for (int x = 0; x < width; x++)
+        {
+            out[x * 4 + 0] = in[x * 3 + 0];
+            out[x * 4 + 1] = in[x * 3 + 1];
+            out[x * 4 + 2] = in[x * 3 + 2];
+            out[x * 4 + 3] = 255;
+        }
+    }
+    return true;
+}
+
+/* Maps and decodes a .ppm file; prints why if it can't */
+inline bool loadPpmFile(const std::string& path, TextureImage& image)
+{
+    MappedFile file;
+    if (!file.open(path))
+        return false;
+    if (!decodePpm(file.data(), file.size(), image))
+    {
+        std::cout << "ERROR::TEXTURE::UNSUPPORTED_FORMAT " << path << " (expected a binary P6 .ppm)" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,340 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "GLExtensions.h"
+#include "GLState.h"
+#include "StreamBuffer.h"
+#include "TextureImage.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*******************************************************************************************************************************
+Texture streaming
+*******************************************************************************************************************************/
+/* Loads textures without the render loop ever waiting for one:
+
+       - Decoding and mip generation run on ThreadPool workers.
+       - The pixels go to GL through a pixel unpack buffer (a StreamBuffer on GL_PIXEL_UNPACK_BUFFER), so
+         glTexSubImage2D only queues a copy the GPU does later instead of the driver copying our memory right away.
+       - update() uploads at most budgetBytes per frame. Big levels are split into bands of rows.
+       - The smallest mips go first, across all textures. GL_TEXTURE_BASE_LEVEL is lowered each time a finer level is
+         complete, so a texture is usable as soon as its 1x1 level is in and sharpens over the following frames.
+
+       ThreadPool pool;
+       TextureStreamer streamer(pool, 4 << 20);
+       size_t wall = streamer.requestFile("wall.ppm");
+       ...
+       streamer.update();                          // once per frame, main thread
+       if (unsigned int id = streamer.texture(wall))
+           glState.bindTexture(0, GL_TEXTURE_2D, id);
+
+   Textures are RGBA8 with trilinear filtering. The streamer owns them and deletes them when it is destroyed. */
+class TextureStreamer
+{
+public:
+    typedef std::function<bool(TextureImage& image)> Decoder;
+
+    struct Stats
+    {
+        unsigned int requested = 0;
+        unsigned int failed = 0;
+        unsigned int complete = 0;
+        unsigned int uploadFrames = 0;  // update() calls that uploaded anything
+        size_t uploadedBytes = 0;
+        size_t maxFrameBytes = 0;
+        double maxUpdateMs = 0.0;       // Main-thread time of the slowest update()
+    };
+
+    TextureStreamer(ThreadPool& pool, size_t budgetBytes = 4 << 20)
+        : pool(pool), budget(budgetBytes), pixels(GL_PIXEL_UNPACK_BUFFER, budgetBytes),
+          shared(std::make_shared<Shared>())
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0); // glTexImage2D with a pointer would read from the buffer otherwise
+    }
+
+    ~TextureStreamer()
+    {
+        /* Decodes that haven't started yet skip their work; Shared outlives the ones still running */
+        {
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            shared->cancelled = true;
+        }
+        for (Streamed& t : textures)
+            if (t.id)
+            {
+                glDeleteTextures(1, &t.id);
+                glState.forgetTexture(t.id);
+            }
+    }
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    /* Runs decode on a worker; it fills in levels[0] (and may fill in the rest), mips are built afterwards */
+    size_t request(Decoder decode)
+    {
+        const size_t handle = textures.size();
+        textures.push_back(Streamed());
+        stats.requested++;
+
+        std::shared_ptr<Shared> s = shared;
+        pool.submit([s, handle, decode](unsigned int)
+        {
+            Decoded result;
+            result.handle = handle;
+            if (!s->isCancelled())
+            {
+                result.ok = decode(result.image) && result.image.width > 0 && result.image.height > 0 &&
+                            !result.image.levels.empty();
+                if (result.ok && result.image.levels.size() == 1)
+                    buildMipChain(result.image);
+            }
+            std::lock_guard<std::mutex> lock(s->mutex);
+            s->decoded.push_back(std::move(result));
+        });
+        return handle;
+    }
+
+    /* A binary .ppm file, mapped and decoded on a worker */
+    size_t requestFile(const std::string& path)
+    {
+        return request([path](TextureImage& image) { return loadPpmFile(path, image); });
+    }
+
+    /* Main thread, once per frame. Creates textures for finished decodes and uploads up to the budget. */
+    void update()
+    {
+        const double start = nowMs();
+        receiveDecoded();
+
+        /* Pick bands until the budget is used up. Copying into the buffer has to finish (commit) before GL may
+           read from it, so the glTexSubImage2D calls are collected and issued afterwards. */
+        struct Band { size_t texture; int level, y, rows; size_t offset; };
+        std::vector<Band> bands;
+        size_t used = 0;
+        bool begun = false;
+        for (;;)
+        {
+            const size_t index = nextToUpload();
+            if (index == NoTexture)
+                break;
+            Streamed& t = textures[index];
+            const int width = std::max(1, t.width >> t.level), height = std::max(1, t.height >> t.level);
+            const size_t rowBytes = (size_t)width * 4;
+            if (rowBytes > budget)
+            {
+                std::cout << "ERROR::TEXTURE::ROW_LARGER_THAN_BUDGET " << rowBytes << " bytes" << std::endl;
+                dropTexture(t);
+                continue;
+            }
+
+            const int rows = (int)std::min<size_t>((size_t)(height - t.row), (budget - used) / rowBytes);
+            if (rows <= 0)
+                break;
+            if (!begun)
+            {
+                pixels.beginFrame();
+                begun = true;
+            }
+            StreamBuffer::Allocation a = pixels.allocate((size_t)rows * rowBytes, 4);
+            if (!a.data)
+                break;
+            std::memcpy(a.data, &t.pixels[t.level][(size_t)t.row * rowBytes], (size_t)rows * rowBytes);
+            bands.push_back(Band{ index, t.level, t.row, rows, a.offset });
+            used += (size_t)rows * rowBytes;
+
+            t.row += rows;
+            if (t.row == height)
+            {
+                std::vector<uint8_t>().swap(t.pixels[t.level]); // Uploaded; the CPU copy can go
+                t.level--;
+                t.row = 0;
+            }
+        }
+        if (!begun)
+            return;
+        pixels.commit();
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixels.buffer());
+        for (const Band& band : bands)
+        {
+            Streamed& t = textures[band.texture];
+            const int width = std::max(1, t.width >> band.level), height = std::max(1, t.height >> band.level);
+            glState.bindTexture(0, GL_TEXTURE_2D, t.id);
+            glTexSubImage2D(GL_TEXTURE_2D, band.level, 0, band.y, width, band.rows, GL_RGBA, GL_UNSIGNED_BYTE,
+                            (const void*)band.offset);
+
+            /* Commands run in order, so draws issued after this already see the whole level */
+            if (band.y + band.rows == height)
+            {
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, band.level);
+                t.resident = band.level;
+                if (band.level == 0)
+                {
+                    t.pixels.clear();
+                    stats.complete++;
+                }
+            }
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        pixels.endFrame();
+
+        stats.uploadFrames++;
+        stats.uploadedBytes += used;
+        stats.maxFrameBytes = std::max(stats.maxFrameBytes, used);
+        stats.maxUpdateMs = std::max(stats.maxUpdateMs, nowMs() - start);
+    }
+
+    /* 0 until the texture's smallest mip is in; after that it can be bound and sampled */
+    unsigned int texture(size_t handle) const { return textures[handle].resident >= 0 ? textures[handle].id : 0; }
+
+    /* Finest level uploaded so far, -1 for none. 0 means the texture is complete. */
+    int residentLevel(size_t handle) const { return textures[handle].resident; }
+    bool isComplete(size_t handle) const { return textures[handle].resident == 0; }
+    bool isFailed(size_t handle) const { return textures[handle].failed; }
+
+    /* True once every requested texture is complete or has failed */
+    bool idle() const { return stats.complete + stats.failed == stats.requested; }
+
+    size_t frameBudget() const { return budget; }
+    const Stats& statistics() const { return stats; }
+
+    void printSummary(std::ostream& out) const
+    {
+        out << "Texture streaming: " << stats.complete << " of " << stats.requested << " textures complete";
+        if (stats.failed)
+            out << ", " << stats.failed << " failed";
+        out << ", " << stats.uploadedBytes / (1024.0 * 1024.0) << " MB in " << stats.uploadFrames
+            << " frames (budget " << budget / 1024 << " KB, most in one frame " << stats.maxFrameBytes / 1024
+            << " KB), slowest update " << stats.maxUpdateMs << " ms, " << pixels.statistics().stalls
+            << " waits for the GPU" << std::endl;
+    }
+
+private:
+    static const size_t NoTexture = (size_t)-1;
+
+    struct Decoded
+    {
+        size_t handle = 0;
+        bool ok = false;
+        TextureImage image;
+    };
+
+    /* Shared with the decode jobs, which may outlive the streamer */
+    struct Shared
+    {
+        std::mutex mutex;
+        std::vector<Decoded> decoded;
+        bool cancelled = false;
+
+        bool isCancelled()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return cancelled;
+        }
+    };
+
+    struct Streamed
+    {
+        unsigned int id = 0;
+        int width = 0, height = 0;
+        std::vector<std::vector<uint8_t>> pixels; // Levels still to upload
+        int level = -1;     // Level being uploaded, counting down to 0; -1 when there's nothing (left) to upload
+        int row = 0;        // First row of level not uploaded yet
+        int resident = -1;  // GL_TEXTURE_BASE_LEVEL
+        bool failed = false;
+    };
+
+    static double nowMs() { return glfwGetTime() * 1000.0; }
+
+    /* Allocates every level up front, so uploads only ever fill in existing storage */
+    void receiveDecoded()
+    {
+        std::vector<Decoded> decoded;
+        {
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            decoded.swap(shared->decoded);
+        }
+        for (Decoded& d : decoded)
+        {
+            Streamed& t = textures[d.handle];
+            if (!d.ok)
+            {
+                t.failed = true;
+                stats.failed++;
+                continue;
+            }
+
+            const int levels = (int)d.image.levels.size();
+            t.width = d.image.width;
+            t.height = d.image.height;
+            t.pixels = std::move(d.image.levels);
+            t.level = levels - 1;
+
+            glGenTextures(1, &t.id);
+            glState.bindTexture(0, GL_TEXTURE_2D, t.id);
+            if (glext.textureStorage)
+                glext.TexStorage2D(GL_TEXTURE_2D, levels, GL_RGBA8, t.width, t.height);
+            else
+                for (int level = 0; level < levels; level++)
+                    glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, std::max(1, t.width >> level),
+                                 std::max(1, t.height >> level), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, levels - 1);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        }
+    }
+
+    /* The texture whose next level is the smallest; the earliest request wins a tie */
+    size_t nextToUpload() const
+    {
+        size_t best = NoTexture;
+        size_t bestPixels = 0;
+        for (size_t i = 0; i < textures.size(); i++)
+        {
+            const Streamed& t = textures[i];
+            if (t.level < 0)
+                continue;
+            const size_t levelPixels = (size_t)std::max(1, t.width >> t.level) * std::max(1, t.height >> t.level);
+            if (best == NoTexture || levelPixels < bestPixels)
+            {
+                best = i;
+                bestPixels = levelPixels;
+            }
+        }
+        return best;
+    }
+
+    void dropTexture(Streamed& t)
+    {
+        t.pixels.clear();
+        t.level = -1;
+        t.failed = true;
+        stats.failed++;
+    }
+
+    ThreadPool& pool;
+    size_t budget;
+    StreamBuffer pixels;
+    std::shared_ptr<Shared> shared;
+    std::vector<Streamed> textures;
+    Stats stats;
+};
+
+#endif
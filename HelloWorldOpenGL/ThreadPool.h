@@ -0,0 +1,148 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*******************************************************************************************************************************
+Worker threads
+*******************************************************************************************************************************/
+/* A fixed set of worker threads for CPU-side work (recording draws, encoding, mesh processing...). None of them ever
+   touches GL; only the thread that owns the context may do that.
+
+   Every job gets a worker index in [0, slots()) so it can write to per-thread storage without locking. The thread
+   calling parallelFor() helps out and uses the last index, slots() - 1.
+
+       ThreadPool pool;                        // one thread per core, counting the calling thread
+       pool.parallelFor(count, 256, [&](size_t begin, size_t end, unsigned worker) { ... });
+       pool.submit([&](unsigned worker) { ... });  pool.wait(); */
+class ThreadPool
+{
+public:
+    typedef std::function<void(unsigned int worker)> Job;
+
+    /* One worker per hardware thread, minus one for the thread calling parallelFor() */
+    static unsigned int defaultThreads() { return std::max(1u, std::thread::hardware_concurrency()) - 1; }
+
+    /* threads = 0 is allowed: parallelFor() then runs everything on the calling thread */
+    explicit ThreadPool(unsigned int threads = defaultThreads())
+    {
+        for (unsigned int i = 0; i < threads; i++)
+            workers.emplace_back(&ThreadPool::run, this, i);
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quitting = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /* Number of distinct worker indices a job can see, including the calling thread's */
+    unsigned int slots() const { return (unsigned int)workers.size() + 1; }
+
+    void submit(Job job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(std::move(job));
+            pending++;
+        }
+        wake.notify_one();
+    }
+
+    /* Blocks until every submitted job has finished */
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return pending == 0; });
+    }
+
+    /* Calls fn(begin, end, worker) over [0, count) in chunks of grain items and returns when all of them are done */
+    template <typename F>
+    void parallelFor(size_t count, size_t grain, F fn)
+    {
+        if (count == 0)
+            return;
+        grain = std::max<size_t>(grain, 1);
+        const size_t chunks = (count + grain - 1) / grain;
+
+        struct Shared
+        {
+            std::atomic<size_t> next{ 0 };
+            std::atomic<size_t> finished{ 0 };
+            std::mutex mutex;
+            std::condition_variable done;
+        };
+        std::shared_ptr<Shared> shared = std::make_shared<Shared>();
+
+        /* Claims chunks until there are none left; whoever finishes the last one wakes the caller */
+        auto drain = [shared, count, grain, chunks, &fn](unsigned int worker)
+        {
+            size_t ran = 0;
+            for (size_t chunk = shared->next++; chunk < chunks; chunk = shared->next++, ran++)
+                fn(chunk * grain, std::min(count, (chunk + 1) * grain), worker);
+            if (ran && shared->finished.fetch_add(ran) + ran == chunks)
+            {
+                std::lock_guard<std::mutex> lock(shared->mutex);
+                shared->done.notify_all();
+            }
+        };
+
+        const size_t helpers = std::min<size_t>(workers.size(), chunks - 1);
+        for (size_t i = 0; i < helpers; i++)
+            submit(drain);
+        drain(slots() - 1);
+
+        std::unique_lock<std::mutex> lock(shared->mutex);
+        shared->done.wait(lock, [&] { return shared->finished.load() == chunks; });
+    }
+
+private:
+    void run(unsigned int index)
+    {
+        for (;;)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return quitting || !jobs.empty(); });
+                if (jobs.empty())
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            job(index);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--pending == 0)
+                done.notify_all();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::deque<Job> jobs;
+    size_t pending = 0;
+    bool quitting = false;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+};
+
+#endif
@@ -0,0 +1,327 @@
+#ifndef UNIFORM_BUFFER_H
+#define UNIFORM_BUFFER_H
+
+#include <glad/glad.h>
+
+#include "GLExtensions.h"
+#include "GLState.h"
+#include "StreamBuffer.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/*******************************************************************************************************************************
+Uniform block layouts from C++ structs
+*******************************************************************************************************************************/
+/* A block is declared once, as a list of GLSL types and names:
+
+       #define DRAW_UNIFORMS(MEMBER) \
+           MEMBER(vec4, position)    \
+           MEMBER(float, scale)
+       HELLO_UNIFORM_BLOCK(DrawUniforms, Std140, DRAW_UNIFORMS);
+
+   which makes a struct DrawUniforms with members `position` and `scale`, aligned the way std140 (or std430) puts them,
+   so it can be memcpy'd into a buffer as is. The struct also knows its GLSL declaration (uniformBlockGlsl) and can
+   check a linked program's idea of the block against its own (bindUniformBlock).
+
+   Only scalars, vectors and mat4 (column-major) are supported. For those std140 and std430 agree on every offset;
+   they only differ in the alignment of the whole struct, which is what its size (and so an array's stride) is
+   rounded up to: 16 bytes for std140, the largest member for std430. Arrays of blocks go in the buffer, not in a
+   block. */
+enum class UniformLayout { Std140, Std430 };
+
+/* One per GLSL type: the C++ type that holds it (a scalar, or an array of `count` of them) and its base alignment */
+#define HELLO_GLSL_TYPE(glslName, Scalar, count, alignment)                                                            \
+    struct GlslType_##glslName                                                                                         \
+    {                                                                                                                  \
+        typedef std::conditional<count == 1, Scalar, std::array<Scalar, count>>::type Type;                            \
+        static constexpr size_t align = alignment;                                                                     \
+    }
+HELLO_GLSL_TYPE(float, float, 1, 4);
+HELLO_GLSL_TYPE(int, int32_t, 1, 4);
+HELLO_GLSL_TYPE(uint, uint32_t, 1, 4);
+HELLO_GLSL_TYPE(vec2, float, 2, 8);
+HELLO_GLSL_TYPE(vec3, float, 3, 16);
+HELLO_GLSL_TYPE(vec4, float, 4, 16);
+HELLO_GLSL_TYPE(ivec2, int32_t, 2, 8);
+HELLO_GLSL_TYPE(ivec4, int32_t, 4, 16);
+HELLO_GLSL_TYPE(uvec4, uint32_t, 4, 16);
+HELLO_GLSL_TYPE(mat4, float, 16, 16);
+
+struct UniformBlockMember
+{
+    const char* name;
+    size_t offset;
+};
+
+constexpr size_t uniformBlockAlignment(UniformLayout layout, std::initializer_list<size_t> memberAlignments)
+{
+    size_t alignment = layout == UniformLayout::Std140 ? 16 : 4;
+    for (size_t member : memberAlignments)
+        alignment = member > alignment ? member : alignment;
+    return alignment;
+}
+
+#define HELLO_UNIFORM_MEMBER(type, name) alignas(GlslType_##type::align) GlslType_##type::Type name;
+#define HELLO_UNIFORM_ALIGNMENT(type, name) GlslType_##type::align,
+#define HELLO_UNIFORM_GLSL(type, name) "    " #type " " #name ";\n"
+#define HELLO_UNIFORM_OFFSET(type, name) UniformBlockMember{ #name, offsetof(Self, name) },
+
+#define HELLO_UNIFORM_BLOCK(Name, layout, MEMBERS)                                                                     \
+    struct alignas(uniformBlockAlignment(UniformLayout::layout, { MEMBERS(HELLO_UNIFORM_ALIGNMENT) })) Name            \
+    {                                                                                                                  \
+        MEMBERS(HELLO_UNIFORM_MEMBER)                                                                                  \
+                                                                                                                       \
+        static constexpr UniformLayout Layout = UniformLayout::layout;                                                 \
+        static constexpr const char* GlslName = #Name;                                                                 \
+        static constexpr const char* GlslMembers = MEMBERS(HELLO_UNIFORM_GLSL);                                        \
+        static std::vector<UniformBlockMember> memberOffsets()                                                         \
+        {                                                                                                              \
+            typedef Name Self;                                                                                         \
+            return { MEMBERS(HELLO_UNIFORM_OFFSET) };                                                                  \
+        }                                                                                                              \
+    };                                                                                                                 \
+    static_assert(std::is_standard_layout<Name>::value && std::is_trivially_copyable<Name>::value,                     \
+                  #Name " has to be plain data to be copied into a buffer")
+
+/* "layout(std140) uniform Name { ... };" for a uniform block, "layout(std430) buffer Name { ... };" for a storage
+   block, to paste into a shader or print when the shader's copy is out of date */
+template <typename Block>
+inline std::string uniformBlockGlsl(const char* instanceName = NULL)
+{
+    std::string text = Block::Layout == UniformLayout::Std140 ? "layout(std140) uniform " : "layout(std430) buffer ";
+    text += Block::GlslName;
+    text += "\n{\n";
+    text += Block::GlslMembers;
+    text += "}";
+    if (instanceName)
+        text += std::string(" ") + instanceName;
+    return text + ";\n";
+}
+
+/* Points the program's uniform block of the same name at binding point `binding`, after checking that GL lays it out
+   exactly like the struct. Prints the declaration the shader should have and returns false if not. (Storage blocks
+   can only be inspected with GL 4.3's program interface queries, so they aren't checked here.) */
+template <typename Block>
+inline bool bindUniformBlock(unsigned int program, unsigned int binding)
+{
+    const GLuint index = glGetUniformBlockIndex(program, Block::GlslName);
+    if (index == GL_INVALID_INDEX)
+    {
+        std::cout << "ERROR::UNIFORM_BLOCK::NOT_FOUND " << Block::GlslName << std::endl;
+        return false;
+    }
+
+    bool matches = true;
+    for (const UniformBlockMember& member : Block::memberOffsets())
+    {
+        /* Members of a block without an instance name are called just "member", with one "Block.member" */
+        const std::string qualified = std::string(Block::GlslName) + "." + member.name;
+        const char* names[2] = { member.name, qualified.c_str() };
+        GLuint uniform = GL_INVALID_INDEX;
+        for (const char* name : names)
+            if (uniform == GL_INVALID_INDEX)
+                glGetUniformIndices(program, 1, &name, &uniform);
+
+        /* The compiler may drop members the shader never reads; those can't be wrong */
+        if (uniform == GL_INVALID_INDEX)
+            continue;
+        GLint offset = -1;
+        glGetActiveUniformsiv(program, 1, &uniform, GL_UNIFORM_OFFSET, &offset);
+        if (offset != (GLint)member.offset)
+        {
+            std::cout << "ERROR::UNIFORM_BLOCK::LAYOUT_MISMATCH " << Block::GlslName << "." << member.name
+                      << " is at byte " << offset << " in GLSL but " << member.offset << " in C++" << std::endl;
+            matches = false;
+        }
+    }
+    GLint size = 0;
+    glGetActiveUniformBlockiv(program, index, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+    if ((size_t)size > sizeof(Block))
+    {
+        std::cout << "ERROR::UNIFORM_BLOCK::LAYOUT_MISMATCH " << Block::GlslName << " is " << size
+                  << " bytes in GLSL but " << sizeof(Block) << " in C++" << std::endl;
+        matches = false;
+    }
+    if (!matches)
+    {
+        std::cout << "The shader should declare:" << std::endl << uniformBlockGlsl<Block>();
+        return false;
+    }
+
+    glUniformBlockBinding(program, index, binding);
+    return true;
+}
+
+/*******************************************************************************************************************************
+Uniform ring: every block of a frame in one transfer
+*******************************************************************************************************************************/
+/* Setting uniforms with glUniform* costs a driver call per value per draw, and the values live in the program, so
+   each draw has to wait for the last one's to be set. Here each draw's data is a block in one big buffer instead, and
+   a draw only picks its block with glBindBufferRange:
+
+       ring.beginFrame();                                       // no GL: may run before the workers start
+       uint32_t at = ring.writer(worker).push(drawUniforms);    // on any thread, one writer per thread
+       ring.upload();                                           // GL thread: one copy into the buffer
+       ring.bind(DrawBinding, worker, at, sizeof(drawUniforms)); // per draw; glState skips repeats
+       ...draws...
+       ring.endFrame();                                         // after the draws that read it
+
+   Writers collect blocks in ordinary memory, padded to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+   (GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT for storage blocks) so every block can be bound on its own. upload()
+   then moves the frame's data into a StreamBuffer region in one go: one memcpy per writer, straight into mapped
+   memory. If a frame doesn't fit, the buffer is replaced by one twice as big. */
+class UniformRing
+{
+public:
+    /* Blocks recorded by one thread. Not thread safe: give each thread its own. */
+    class Writer
+    {
+    public:
+        /* Copies the block and returns where it went, for UniformRing::bind */
+        template <typename Block>
+        uint32_t push(const Block& block)
+        {
+            const size_t offset = data.size();
+            data.resize(offset + (sizeof(Block) + alignment - 1) / alignment * alignment);
+            std::memcpy(&data[offset], &block, sizeof(Block));
+            return (uint32_t)offset;
+        }
+
+        size_t size() const { return data.size(); }
+
+    private:
+        friend class UniformRing;
+        std::vector<uint8_t> data;
+        size_t alignment = 256;
+    };
+
+    struct Stats
+    {
+        unsigned int frames = 0;
+        size_t frameBytes = 0;     // uploaded by the last frame
+        size_t maxFrameBytes = 0;
+        uint64_t totalBytes = 0;
+        uint64_t binds = 0;        // bind() calls; see glState's counters for how many reached GL
+        unsigned int grows = 0;    // times a frame didn't fit and the buffer was replaced
+    };
+
+    /* frameBytes is the starting size of each of the StreamBuffer's regions */
+    UniformRing(size_t frameBytes, unsigned int writerCount = 1, GLenum target = GL_UNIFORM_BUFFER)
+        : target(target), writers(std::max(1u, writerCount)), bases(writers.size(), 0)
+    {
+        GLint value = 0;
+        glGetIntegerv(target == GL_SHADER_STORAGE_BUFFER ? GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT
+                                                         : GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT,
+                      &value);
+        alignment = std::max<size_t>((size_t)value, 16);
+        for (Writer& writer : writers)
+            writer.alignment = alignment;
+        stream.reset(new StreamBuffer(target, roundUp(std::max<size_t>(frameBytes, alignment))));
+    }
+
+    UniformRing(const UniformRing&) = delete;
+    UniformRing& operator=(const UniformRing&) = delete;
+
+    size_t offsetAlignment() const { return alignment; }
+    unsigned int writerCount() const { return (unsigned int)writers.size(); }
+    Writer& writer(unsigned int index) { return writers[index]; }
+    unsigned int buffer() const { return stream->buffer(); }
+    const Stats& statistics() const { return stats; }
+
+    /* Forgets last frame's blocks */
+    void beginFrame()
+    {
+        for (Writer& writer : writers)
+            writer.data.clear();
+    }
+
+    /* Copies everything the writers have recorded into the buffer. Call once per frame, before the first bind(). */
+    void upload()
+    {
+        size_t total = 0;
+        for (const Writer& writer : writers)
+            total += writer.data.size();
+
+        stream->beginFrame();
+        StreamBuffer::Allocation allocation = stream->allocate(total, alignment);
+        if (!allocation.data && total > 0)
+        {
+            /* The old buffer goes now; GL keeps its storage until the draws still reading it are done */
+            const size_t bytes = roundUp(std::max(stream->capacity() * 2, total));
+            stream.reset();
+            stream.reset(new StreamBuffer(target, bytes));
+            stream->beginFrame();
+            allocation = stream->allocate(total, alignment);
+            stats.grows++;
+        }
+        if (!allocation.data && total > 0)
+        {
+            /* Draws binding these blocks would read stale data; better to see it in the log than on screen */
+            std::cout << "ERROR::UNIFORM_RING::UPLOAD_FAILED " << total << " bytes of uniform blocks skipped"
+                      << std::endl;
+            stream->commit();
+            uploaded = false;
+            return;
+        }
+        uploaded = true;
+
+        size_t offset = 0;
+        for (size_t w = 0; w < writers.size(); w++)
+        {
+            bases[w] = allocation.offset + offset;
+            if (!writers[w].data.empty())
+                std::memcpy((uint8_t*)allocation.data + offset, writers[w].data.data(), writers[w].data.size());
+            offset += writers[w].data.size();
+        }
+        stream->commit();
+
+        stats.frames++;
+        stats.frameBytes = total;
+        stats.maxFrameBytes = std::max(stats.maxFrameBytes, total);
+        stats.totalBytes += total;
+    }
+
+    /* Binds bytes at `offset` of what writer `writerIndex` recorded to `binding` */
+    void bind(unsigned int binding, unsigned int writerIndex, uint32_t offset, size_t bytes)
+    {
+        if (!uploaded)
+            return; // This frame's upload failed; there is nothing to bind
+        glState.bindBufferRange(target, binding, stream->buffer(), bases[writerIndex] + offset, bytes);
+        stats.binds++;
+    }
+
+    /* Fences this frame's region; call after the draws that read it */
+    void endFrame() { stream->endFrame(); }
+
+    void printSummary(std::ostream& out) const
+    {
+        out << "Uniform ring: " << (stats.frames ? stats.totalBytes / stats.frames : 0) / 1024 << " KB per frame (max "
+            << stats.maxFrameBytes / 1024 << " KB) in one upload each, offset alignment " << alignment << ", "
+            << (stats.frames ? (double)stats.binds / (double)stats.frames : 0.0) << " binds per frame, "
+            << stream->statistics().stalls << " stalls, " << stats.grows << " grows ("
+            << (stream->isPersistent() ? "persistent" : "mapped per frame") << ")" << std::endl;
+    }
+
+private:
+    size_t roundUp(size_t bytes) const { return (bytes + alignment - 1) / alignment * alignment; }
+
+    GLenum target;
+    size_t alignment = 256;
+    std::vector<Writer> writers;
+    std::vector<size_t> bases; // where each writer's blocks start in the buffer this frame
+    bool uploaded = false;     // upload() found room for this frame's blocks
+    std::unique_ptr<StreamBuffer> stream;
+    Stats stats;
+};
+
+#endif
@@ -0,0 +1,328 @@
+#ifndef VERTEX_PACKING_H
+#define VERTEX_PACKING_H
+
+#include <glad/glad.h>
+
+#include "Mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+/*******************************************************************************************************************************
+Compact vertex and index encodings
+*******************************************************************************************************************************/
+/* HelloWindow.cpp stores positions as three GL_FLOATs and indices as GL_UNSIGNED_INT. Most meshes don't need that
+   precision, and every byte we don't store is a byte the GPU doesn't have to fetch. packMesh() writes:
+
+       position  PositionEncoding::Half    4 x GL_HALF_FLOAT (w = 1)                                  8 bytes
+                 PositionEncoding::Snorm16 4 x GL_SHORT, normalized, relative to the mesh bounds      8 bytes
+                                           (decoded in the shader with VertexLayout::positionScale/Offset)
+                 PositionEncoding::Float   3 x GL_FLOAT                                              12 bytes
+       normal    GL_INT_2_10_10_10_REV, normalized (10 bits per component)                            4 bytes
+       uv        2 x GL_HALF_FLOAT                                                                    4 bytes
+       index     GL_UNSIGNED_BYTE / GL_UNSIGNED_SHORT / GL_UNSIGNED_INT, the smallest that fits the vertex count
+
+   A float vertex with normal and uv is 32 bytes; packed it is 16. Together with 16-bit indices that halves the memory
+   and bandwidth of a typical mesh. The QuantizationReport says how much accuracy that cost.
+
+   Attribute locations stay the same as MeshData::interleave (0 position, 1 normal, 2 uv), so the same shaders work. */
+enum class PositionEncoding { Float, Half, Snorm16 };
+
+struct QuantizationReport
+{
+    size_t bytesBefore = 0;            // float vertices + 32-bit indices
+    size_t bytesAfter = 0;
+    double maxPositionError = 0.0;     // model space units
+    double rmsPositionError = 0.0;
+    double boundsDiagonal = 0.0;       // for putting the position error in proportion
+    double maxNormalErrorDegrees = 0.0;
+    double maxUvError = 0.0;
+
+    void print(std::ostream& out) const
+    {
+        out << "Vertex packing: " << bytesBefore << " -> " << bytesAfter << " bytes ("
+            << (bytesAfter ? (double)bytesBefore / (double)bytesAfter : 0.0) << "x smaller); position error max "
+            << maxPositionError << " rms " << rmsPositionError << " (" << 100.0 * maxPositionError / std::max(boundsDiagonal, 1e-30)
+            << "% of bounds), normal error max " << maxNormalErrorDegrees << " deg, uv error max " << maxUvError << std::endl;
+    }
+};
+
+struct PackedMesh
+{
+    VertexLayout layout;
+    std::vector<uint8_t> vertices;
+    std::vector<uint8_t> indices;
+    GLenum indexType = GL_UNSIGNED_INT;
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+    QuantizationReport report;
+
+    void upload(GpuMesh& mesh) const
+    {
+        mesh.create(layout, vertices.data(), vertices.size(), indices.data(), indexCount, indexType);
+    }
+};
+
+/*******************************************************************************************************************************
+Scalar encoders
+*******************************************************************************************************************************/
+/* IEEE 754 binary16, round to nearest even. Handles denormals, overflow to infinity and NaN. */
+inline uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, 4);
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const uint32_t exponent = (bits >> 23) & 0xFF;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if (exponent == 0xFF) // Inf / NaN
+        return (uint16_t)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+
+    int halfExponent = (int)exponent - 127 + 15;
+    if (halfExponent >= 31) // Too large: infinity
+        return (uint16_t)(sign | 0x7C00);
+
+    if (halfExponent <= 0) // Denormal or zero
+    {
+        if (halfExponent < -10)
+            return (uint16_t)sign;
+        mantissa |= 0x800000;
+        const uint32_t shift = (uint32_t)(14 - halfExponent);
+        uint32_t half = mantissa >> shift;
+        const uint32_t rest = mantissa & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1)))
+            half++;
+        return (uint16_t)(sign | half);
+    }
+
+    uint32_t half = ((uint32_t)halfExponent << 10) | (mantissa >> 13);
+    const uint32_t rest = mantissa & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        half++; // May carry into the exponent, which is exactly right
+    return (uint16_t)(sign | half);
+}
+
+inline float halfToFloat(uint16_t half)
+{
+    const uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+    const uint32_t exponent = (half >> 10) & 0x1F;
+    const uint32_t mantissa = half & 0x3FF;
+
+    float value;
+    if (exponent == 0)
+        value = std::ldexp((float)mantissa, -24);
+    else if (exponent == 31)
+        value = mantissa ? NAN : INFINITY;
+    else
+        value = std::ldexp((float)(mantissa | 0x400), (int)exponent - 25);
+    return sign ? -value : value;
+}
+
+/* [-1,1] -> normalized signed integer with the given number of bits */
+inline int32_t floatToSnorm(float value, int bits)
+{
+    const float maxValue = (float)((1 << (bits - 1)) - 1);
+    return (int32_t)std::lround(std::min(std::max(value, -1.0f), 1.0f) * maxValue);
+}
+
+inline float snormToFloat(int32_t value, int bits)
+{
+    const float maxValue = (float)((1 << (bits - 1)) - 1);
+    return std::max((float)value / maxValue, -1.0f);
+}
+
+/* xyz in [-1,1] -> GL_INT_2_10_10_10_REV (x in the low bits, w = 0) */
+inline uint32_t packNormal1010102(float x, float y, float z)
+{
+    return ((uint32_t)floatToSnorm(x, 10) & 0x3FF) |
+           (((uint32_t)floatToSnorm(y, 10) & 0x3FF) << 10) |
+           (((uint32_t)floatToSnorm(z, 10) & 0x3FF) << 20);
+}
+
+inline void unpackNormal1010102(uint32_t packed, float out[3])
+{
+    for (int i = 0; i < 3; i++)
+    {
+        int32_t value = (int32_t)((packed >> (10 * i)) & 0x3FF);
+        if (value & 0x200)
+            value -= 0x400; // Sign extend
+        out[i] = snormToFloat(value, 10);
+    }
+}
+
+/* Smallest index type that can address vertexCount vertices */
+inline GLenum chooseIndexType(size_t vertexCount)
+{
+    if (vertexCount <= 0x100)
+        return GL_UNSIGNED_BYTE;
+    if (vertexCount <= 0x10000)
+        return GL_UNSIGNED_SHORT;
+    return GL_UNSIGNED_INT;
+}
+
+/*******************************************************************************************************************************
+Mesh packer
+*******************************************************************************************************************************/
+/* allowByteIndices: GL_UNSIGNED_BYTE indices are legal everywhere but some GPUs convert them on the CPU, so callers
+   that care can ask for 16 bits as the minimum. */
+inline PackedMesh packMesh(const MeshData& mesh, PositionEncoding positions = PositionEncoding::Snorm16,
+                           bool allowByteIndices = true)
+{
+    PackedMesh packed;
+    const size_t vertexCount = mesh.vertexCount();
+    const bool hasNormals = !mesh.normals.empty();
+    const bool hasUvs = !mesh.uvs.empty();
+    packed.vertexCount = vertexCount;
+    packed.indexCount = mesh.indices.size();
+
+    /* Bounds, for Snorm16 and for the report */
+    float lower[3] = { INFINITY, INFINITY, INFINITY }, upper[3] = { -INFINITY, -INFINITY, -INFINITY };
+    for (size_t v = 0; v < vertexCount; v++)
+        for (int i = 0; i < 3; i++)
+        {
+            lower[i] = std::min(lower[i], mesh.positions[v * 3 + i]);
+            upper[i] = std::max(upper[i], mesh.positions[v * 3 + i]);
+        }
+    double diagonal = 0.0;
+    for (int i = 0; i < 3 && vertexCount; i++)
+        diagonal += (double)(upper[i] - lower[i]) * (upper[i] - lower[i]);
+    packed.report.boundsDiagonal = std::sqrt(diagonal);
+
+    /* Layout */
+    VertexLayout& layout = packed.layout;
+    uint32_t offset = 0;
+    if (positions == PositionEncoding::Float)
+    {
+        layout.add(0, 3, GL_FLOAT, false, 0);
+        offset = 12;
+    }
+    else
+    {
+        layout.add(0, 4, positions == PositionEncoding::Half ? GL_HALF_FLOAT : GL_SHORT,
+                   positions == PositionEncoding::Snorm16, 0);
+        offset = 8;
+    }
+    const uint32_t normalOffset = offset;
+    if (hasNormals)
+    {
+        layout.add(1, 4, GL_INT_2_10_10_10_REV, true, normalOffset);
+        offset += 4;
+    }
+    const uint32_t uvOffset = offset;
+    if (hasUvs)
+    {
+        layout.add(2, 2, GL_HALF_FLOAT, false, uvOffset);
+        offset += 4;
+    }
+    layout.stride = offset;
+
+    if (positions == PositionEncoding::Snorm16)
+        for (int i = 0; i < 3; i++)
+        {
+            const float center = vertexCount ? (lower[i] + upper[i]) * 0.5f : 0.0f;
+            const float extent = vertexCount ? (upper[i] - lower[i]) * 0.5f : 0.0f;
+            layout.positionOffset[i] = center;
+            layout.positionScale[i] = extent > 0.0f ? extent : 1.0f;
+        }
+
+    /* Vertices */
+    packed.vertices.assign(vertexCount * layout.stride, 0);
+    double squaredErrorSum = 0.0;
+    QuantizationReport& report = packed.report;
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        uint8_t* out = &packed.vertices[v * layout.stride];
+        const float* p = &mesh.positions[v * 3];
+        float decoded[3];
+
+        if (positions == PositionEncoding::Float)
+        {
+            std::memcpy(out, p, 12);
+            std::memcpy(decoded, p, 12);
+        }
+        else if (positions == PositionEncoding::Half)
+        {
+            uint16_t h[4] = { floatToHalf(p[0]), floatToHalf(p[1]), floatToHalf(p[2]), floatToHalf(1.0f) };
+            std::memcpy(out, h, 8);
+            for (int i = 0; i < 3; i++)
+                decoded[i] = halfToFloat(h[i]);
+        }
+        else
+        {
+            int16_t s[4];
+            for (int i = 0; i < 3; i++)
+            {
+                s[i] = (int16_t)floatToSnorm((p[i] - layout.positionOffset[i]) / layout.positionScale[i], 16);
+                decoded[i] = snormToFloat(s[i], 16) * layout.positionScale[i] + layout.positionOffset[i];
+            }
+            s[3] = 32767;
+            std::memcpy(out, s, 8);
+        }
+
+        double squared = 0.0;
+        for (int i = 0; i < 3; i++)
+            squared += (double)(decoded[i] - p[i]) * (decoded[i] - p[i]);
+        squaredErrorSum += squared;
+        report.maxPositionError = std::max(report.maxPositionError, std::sqrt(squared));
+
+        if (hasNormals)
+        {
+            const float* n = &mesh.normals[v * 3];
+            const uint32_t word = packNormal1010102(n[0], n[1], n[2]);
+            std::memcpy(out + normalOffset, &word, 4);
+
+            float back[3];
+            unpackNormal1010102(word, back);
+            const double lengths = std::sqrt((double)(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) *
+                                             (back[0] * back[0] + back[1] * back[1] + back[2] * back[2]));
+            if (lengths > 0.0)
+            {
+                const double cosine = (n[0] * back[0] + n[1] * back[1] + n[2] * back[2]) / lengths;
+                const double degrees = std::acos(std::min(1.0, std::max(-1.0, cosine))) * 180.0 / 3.14159265358979;
+                report.maxNormalErrorDegrees = std::max(report.maxNormalErrorDegrees, degrees);
+            }
+        }
+
+        if (hasUvs)
+        {
+            const float* uv = &mesh.uvs[v * 2];
+            const uint16_t h[2] = { floatToHalf(uv[0]), floatToHalf(uv[1]) };
+            std::memcpy(out + uvOffset, h, 4);
+            for (int i = 0; i < 2; i++)
+                report.maxUvError = std::max(report.maxUvError, (double)std::fabs(halfToFloat(h[i]) - uv[i]));
+        }
+    }
+    report.rmsPositionError = vertexCount ? std::sqrt(squaredErrorSum / (double)vertexCount) : 0.0;
+
+    /* Indices */
+    packed.indexType = chooseIndexType(vertexCount);
+    if (!allowByteIndices && packed.indexType == GL_UNSIGNED_BYTE)
+        packed.indexType = GL_UNSIGNED_SHORT;
+    const size_t size = indexSize(packed.indexType);
+    packed.indices.resize(mesh.indices.size() * size);
+    for (size_t i = 0; i < mesh.indices.size(); i++)
+    {
+        const uint32_t index = mesh.indices[i];
+        if (size == 1)
+            packed.indices[i] = (uint8_t)index;
+        else if (size == 2)
+        {
+            const uint16_t narrow = (uint16_t)index;
+            std::memcpy(&packed.indices[i * 2], &narrow, 2);
+        }
+        else
+            std::memcpy(&packed.indices[i * 4], &index, 4);
+    }
+
+    report.bytesBefore = vertexCount * (3 + (hasNormals ? 3 : 0) + (hasUvs ? 2 : 0)) * sizeof(float) +
+                         mesh.indices.size() * sizeof(uint32_t);
+    report.bytesAfter = packed.vertices.size() + packed.indices.size();
+    return packed;
+}
+
+#endif
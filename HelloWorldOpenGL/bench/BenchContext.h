@@ -0,0 +1,66 @@
+#ifndef BENCH_CONTEXT_H
+#define BENCH_CONTEXT_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "BenchTimer.h"
+#include "../GLExtensions.h"
+
+#include <iostream>
+
+/*******************************************************************************************************************************
+Context setup shared by the benchmarks
+*******************************************************************************************************************************/
+/* Same setup as HelloWindow.cpp but with a hidden window, no vsync, and the newest core profile the driver gives us
+   (several benchmarks compare a GL 4.x path with its fallback). Returns NULL if no context could be created. */
+inline GLFWwindow* createBenchContext(int width = 800, int height = 600)
+{
+    if (!glfwInit())
+    {
+        std::cout << "Failed to initialize GLFW" << std::endl;
+        return NULL;
+    }
+
+    const int versions[][2] = { { 4, 6 }, { 4, 5 }, { 4, 4 }, { 4, 3 }, { 4, 1 }, { 3, 3 } };
+    GLFWwindow* window = NULL;
+    for (const int* version : versions)
+    {
+        glfwDefaultWindowHints();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, version[0]);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, version[1]);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        window = glfwCreateWindow(width, height, "LearnOpenGL benchmark", NULL, NULL);
+        if (window)
+            break;
+    }
+    if (window == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return NULL;
+    }
+
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        glfwTerminate();
+        return NULL;
+    }
+    loadGLExtensions();
+    glfwSwapInterval(0);
+    glViewport(0, 0, width, height);
+
+    std::cout << "GL " << glGetString(GL_VERSION) << " on " << glGetString(GL_RENDERER) << std::endl;
+    return window;
+}
+
+/* Seconds on GLFW's high resolution timer; benchMs() (BenchTimer.h) is the same without GLFW */
+inline double benchSeconds()
+{
+    return (double)glfwGetTimerValue() / (double)glfwGetTimerFrequency();
+}
+
+#endif
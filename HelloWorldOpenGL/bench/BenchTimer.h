@@ -0,0 +1,15 @@
+#ifndef BENCH_TIMER_H
+#define BENCH_TIMER_H
+
+#include <chrono>
+
+/*******************************************************************************************************************************
+Wall-clock timer for the benchmarks and tools that don't create a GL context
+*******************************************************************************************************************************/
+/* Milliseconds on the steady clock. benchSeconds() (BenchContext.h) needs glfwInit(); this doesn't. */
+inline double benchMs()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#endif
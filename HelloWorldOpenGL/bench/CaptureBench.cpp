@@ -0,0 +1,109 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "BenchContext.h"
+#include "../FrameCapture.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*******************************************************************************************************************************
+Frame capture: synchronous glReadPixels + PNG vs FrameCapture
+*******************************************************************************************************************************/
+/* Renders F frames of a few hundred scissored clears (cheap to draw, but not one flat colour, so the PNGs cost what
+   real ones do) and captures every frame three ways:
+       none    no capture, the baseline
+       sync    glReadPixels into memory and stbi_write_png on the render thread, as glfw's examples/offscreen.c does
+       async   FrameCapture: fenced pixel pack buffers, encoding on its own thread
+   and reports average and worst frame time (glFinish included) and how many frames were written or dropped.
+   The files go to DIR (default: the current directory) and are deleted afterwards.
+   Usage: CaptureBench [frames] [width] [height] [dir] */
+int main(int argc, char** argv)
+{
+    const int frames = argc > 1 ? std::atoi(argv[1]) : 60;
+    const int width = argc > 2 ? std::atoi(argv[2]) : 1280;
+    const int height = argc > 3 ? std::atoi(argv[3]) : 720;
+    const std::string pattern = std::string(argc > 4 ? argv[4] : ".") + "/capture_bench_%05u.png";
+
+    GLFWwindow* window = createBenchContext(width, height);
+    if (!window)
+        return -1;
+
+    std::vector<uint8_t> pixels((size_t)width * height * 4);
+    std::cout << "method,width,height,frame_ms,max_frame_ms,written,dropped" << std::endl;
+    const char* const methods[] = { "none", "sync", "async" };
+    for (int method = 0; method < 3; method++)
+    {
+        std::unique_ptr<FrameCapture> capture;
+        if (method == 2)
+            capture.reset(new FrameCapture(pattern));
+
+        double total = 0.0, worst = 0.0;
+        unsigned int written = 0;
+        uint32_t seed = 1;
+        for (int frame = -2; frame < frames; frame++) // Two warm-up frames
+        {
+            const double start = benchSeconds();
+            glDisable(GL_SCISSOR_TEST);
+            glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            glEnable(GL_SCISSOR_TEST);
+            for (int i = 0; i < 300; i++)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                glScissor((int)(seed >> 8) % width, (int)(seed >> 16) % height, 8 + (int)(seed & 127),
+                          8 + (int)(seed >> 25));
+                glClearColor((float)(seed & 255) / 255.0f, (float)((seed >> 8) & 255) / 255.0f,
+                             (float)((seed >> 16) & 255) / 255.0f, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT);
+            }
+            glDisable(GL_SCISSOR_TEST);
+
+            if (method == 1 && frame >= 0)
+            {
+                char path[1024];
+                std::snprintf(path, sizeof(path), pattern.c_str(), (unsigned int)frame);
+                glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+                written += stbi_write_png(path, width, height, 4, pixels.data(), width * 4) != 0;
+            }
+            else if (method == 2 && frame >= 0)
+                capture->capture(width, height);
+
+            glfwSwapBuffers(window);
+            glFinish();
+            if (frame >= 0)
+            {
+                const double seconds = benchSeconds() - start;
+                total += seconds;
+                worst = std::max(worst, seconds);
+            }
+        }
+
+        unsigned int dropped = 0;
+        if (capture)
+        {
+            capture->finish();
+            written = capture->statistics().written;
+            dropped = capture->statistics().dropped;
+            capture->printSummary(std::cout);
+            capture.reset();
+        }
+        std::cout << methods[method] << ',' << width << ',' << height << ',' << total * 1000.0 / frames << ','
+                  << worst * 1000.0 << ',' << written << ',' << dropped << std::endl;
+
+        for (int frame = 0; frame < frames; frame++)
+        {
+            char path[1024];
+            std::snprintf(path, sizeof(path), pattern.c_str(), (unsigned int)frame);
+            std::remove(path);
+        }
+    }
+
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "BenchContext.h"
+#include "../CommandList.h"
+#include "../ProgramCache.h"
+#include "../ThreadPool.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+/*******************************************************************************************************************************
+Recording draws on 1..N threads
+*******************************************************************************************************************************/
+/* Each object gets the kind of per-draw CPU work a scene walk does: build a rotation, transform the corners of its
+   rectangle, reject it if it's off screen, and record a draw with its offset. We time recording on 1, 2, 4... threads,
+   merging the lists, and replaying them on the GL thread (glFinish included).
+   Usage: CommandListBench [objects] [frames per step] */
+const char* const offsetVertexShaderSource =
+"#version 330 core\n"
+"layout (location = 0) in vec3 aPos;\n"
+"uniform vec4 uTransform;\n" // xy offset, zw = cos/sin of the rotation
+"void main()\n"
+"{\n"
+"   vec2 p = vec2(aPos.x * uTransform.z - aPos.y * uTransform.w, aPos.x * uTransform.w + aPos.y * uTransform.z);\n"
+"   gl_Position = vec4(p * 0.05 + uTransform.xy, aPos.z, 1.0);\n"
+"}\0";
+
+const char* const offsetFragmentShaderSource =
+"#version 330 core\n"
+"out vec4 FragColor;\n"
+"void main()\n"
+"{\n"
+"   FragColor = vec4(1.0f, 0.5f, 0.2f, 1.0f);\n"
+"}\n\0";
+
+int main(int argc, char** argv)
+{
+    const size_t objects = argc > 1 ? (size_t)std::atoll(argv[1]) : 100000;
+    const int frames = argc > 2 ? std::atoi(argv[2]) : 20;
+
+    GLFWwindow* window = createBenchContext();
+    if (!window)
+        return -1;
+
+    float vertices[] = {
+     0.5f,  0.5f, 0.0f,
+     0.5f, -0.5f, 0.0f,
+    -0.5f, -0.5f, 0.0f,
+    -0.5f,  0.5f, 0.0f
+    };
+    unsigned int indices[] = { 0, 1, 3, 1, 2, 3 };
+
+    unsigned int VAO, VBO, EBO;
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+
+    ProgramCache cache("");
+    const unsigned int program = cache.load(offsetVertexShaderSource, offsetFragmentShaderSource);
+    const GLint transformLocation = glGetUniformLocation(program, "uTransform");
+    const uint64_t key = makeDrawKey(program, VAO);
+
+    /* Objects wander a little outside the screen so some of them get culled */
+    std::vector<float> positions(objects * 2);
+    uint32_t seed = 1;
+    for (float& p : positions)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        p = (float)(seed >> 8) / (float)(1 << 24) * 2.4f - 1.2f;
+    }
+
+    std::cout << "objects,threads,record_ms,merge_ms,replay_ms,draws" << std::endl;
+    const unsigned int maxThreads = ThreadPool::defaultThreads() + 1;
+    for (unsigned int threads = 1; ; threads = std::min(threads * 2, maxThreads))
+    {
+        ThreadPool pool(threads - 1);
+        std::vector<CommandList> lists(pool.slots());
+        CommandQueue queue;
+        double record = 0.0, merge = 0.0, replay = 0.0;
+        size_t draws = 0;
+
+        for (int frame = -2; frame < frames; frame++) // Two warm-up frames
+        {
+            const float time = (float)frame * 0.01f;
+            const double start = benchSeconds();
+            for (CommandList& list : lists)
+                list.clear();
+            pool.parallelFor(objects, 1024, [&](size_t begin, size_t end, unsigned int worker)
+            {
+                CommandList& list = lists[worker];
+                for (size_t i = begin; i < end; i++)
+                {
+                    const float angle = time + (float)i * 0.001f;
+                    const float c = std::cos(angle), s = std::sin(angle);
+                    const float x = positions[i * 2], y = positions[i * 2 + 1];
+
+                    /* Bounds of the rotated rectangle (half size 0.025) */
+                    const float extent = 0.025f * (std::fabs(c) + std::fabs(s));
+                    if (x + extent < -1.0f || x - extent > 1.0f || y + extent < -1.0f || y - extent > 1.0f)
+                        continue;
+
+                    const UniformValue transform = { transformLocation, 4, { x, y, c, s } };
+                    list.draw(key, (uint32_t)i, program, VAO, 6, GL_UNSIGNED_INT, 0, &transform, 1);
+                }
+            });
+            const double recorded = benchSeconds();
+
+            queue.merge(lists.data(), lists.size());
+            const double merged = benchSeconds();
+
+            glClear(GL_COLOR_BUFFER_BIT);
+            const size_t issued = queue.issue(lists.data());
+            glfwSwapBuffers(window);
+            glFinish();
+            const double replayed = benchSeconds();
+
+            if (frame >= 0)
+            {
+                record += recorded - start;
+                merge += merged - recorded;
+                replay += replayed - merged;
+                draws = issued;
+            }
+        }
+
+        std::cout << objects << ',' << threads << ',' << record * 1000.0 / frames << ',' << merge * 1000.0 / frames
+                  << ',' << replay * 1000.0 / frames << ',' << draws << std::endl;
+        if (threads == maxThreads)
+            break;
+    }
+
+    glDeleteProgram(program);
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,105 @@
+#include "BenchTimer.h"
+#include "../Culling.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+/*******************************************************************************************************************************
+Frustum culling: brute force vs BVH
+*******************************************************************************************************************************/
+/* Random boxes in a 1000^3 cube and a perspective camera panning through it. For each object count we time:
+       build      SceneBvh::build
+       brute      cullBruteForce, one scalar box test per object
+       bvh        SceneBvh::cull
+       refit      moving 1% of the objects, update() + refit()
+   "objects per ms" is objects in the scene (not visible ones) divided by the cull time. Both culls must agree on how
+   many objects are visible. This one doesn't need a GL context.
+   Usage: CullingBench [max objects] [views per step] */
+static float random01(uint32_t& seed)
+{
+    seed = seed * 1664525u + 1013904223u;
+    return (float)(seed >> 8) / (float)(1 << 24);
+}
+
+static Aabb randomBox(uint32_t& seed)
+{
+    Aabb box;
+    const float size = 0.5f + random01(seed) * 1.5f;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        const float centre = random01(seed) * 1000.0f - 500.0f;
+        box.min[axis] = centre - size;
+        box.max[axis] = centre + size;
+    }
+    return box;
+}
+
+int main(int argc, char** argv)
+{
+    const size_t maxObjects = argc > 1 ? (size_t)std::atoll(argv[1]) : 1000000;
+    const int views = argc > 2 ? std::atoi(argv[2]) : 20;
+
+    const Mat4 projection = Mat4::perspective(1.0f, 16.0f / 9.0f, 0.1f, 600.0f);
+
+    std::cout << "objects,simd,build_ms,brute_ms,bvh_ms,brute_objects_per_ms,bvh_objects_per_ms,visible,"
+              << "refit_1pct_ms,refit_nodes" << std::endl;
+    for (size_t count = 10000; count <= maxObjects; count *= 10)
+    {
+        uint32_t seed = 1;
+        std::vector<Aabb> boxes(count);
+        for (Aabb& box : boxes)
+            box = randomBox(seed);
+
+        SceneBvh bvh;
+        double start = benchMs();
+        bvh.build(boxes);
+        const double buildMs = benchMs() - start;
+
+        std::vector<uint32_t> bruteVisible, bvhVisible;
+        double bruteMs = 0.0, bvhMs = 0.0, refitMs = 0.0;
+        size_t visible = 0, refitNodes = 0;
+        for (int view = 0; view < views; view++)
+        {
+            /* Pan along x, looking down -z from the front face of the cube */
+            const float x = -400.0f + 800.0f * (float)view / (float)views;
+            const Frustum frustum = Frustum::fromMatrix(projection * Mat4::translation(-x, 0.0f, -500.0f));
+
+            start = benchMs();
+            cullBruteForce(boxes, frustum, bruteVisible);
+            bruteMs += benchMs() - start;
+
+            start = benchMs();
+            bvh.cull(frustum, bvhVisible);
+            bvhMs += benchMs() - start;
+
+            if (bruteVisible.size() != bvhVisible.size())
+            {
+                std::cout << "ERROR::CULLING_BENCH::MISMATCH brute " << bruteVisible.size() << " bvh "
+                          << bvhVisible.size() << std::endl;
+                return -1;
+            }
+            visible += bvhVisible.size();
+
+            /* Move 1% of the objects a little, as animation would */
+            start = benchMs();
+            for (size_t i = (size_t)view; i < count; i += 100)
+            {
+                for (int axis = 0; axis < 3; axis++)
+                {
+                    const float step = random01(seed) * 2.0f - 1.0f;
+                    boxes[i].min[axis] += step;
+                    boxes[i].max[axis] += step;
+                }
+                bvh.update((uint32_t)i, boxes[i]);
+            }
+            refitNodes += bvh.refit();
+            refitMs += benchMs() - start;
+        }
+
+        std::cout << count << ',' << simdName() << ',' << buildMs << ',' << bruteMs / views << ',' << bvhMs / views << ','
+                  << (double)count * views / bruteMs << ',' << (double)count * views / bvhMs << ',' << visible / views
+                  << ',' << refitMs / views << ',' << refitNodes / views << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include "BenchTimer.h"
+#include "../CommandList.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+/*******************************************************************************************************************************
+Draw sorting: radix sort vs std::sort on 64-bit keys, and the state changes sorting saves
+*******************************************************************************************************************************/
+/* Records N draws into 4 command lists, the way 4 worker threads would, each with a random layer (10% UI),
+   translucency (15%), one of 16 programs, 32 VAOs and 256 textures, and a depth. Keys come from makeSortKey with
+   VAO and texture as the material. For N = 1k, 10k, ... it prints:
+
+       recorded   program/VAO/texture changes if the draws went out in recording order
+       std_sort   time to sort the keys with std::sort on (key, sequence), what CommandQueue used to do
+       radix      the same with radixSort (the order is checked to be identical)
+       merge      all of CommandQueue::merge: gathering the lists, sorting and counting state changes
+
+   No GL context needed; nothing here calls GL.
+   Usage: DrawSortBench [max draws] */
+static uint32_t nextRandom(uint32_t& seed)
+{
+    seed = seed * 1664525u + 1013904223u;
+    return seed >> 8;
+}
+
+static void printRow(const char* method, size_t draws, double ms, const CommandQueue::Statistics& stats)
+{
+    std::cout << method << ',' << draws << ',' << ms << ',' << (ms > 0.0 ? (double)draws / (ms * 1000.0) : 0.0)
+              << ',' << stats.programChanges << ',' << stats.vertexArrayChanges << ',' << stats.textureChanges << ','
+              << stats.changes() << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    const size_t maxDraws = argc > 1 ? (size_t)std::atoll(argv[1]) : 1000000;
+    const size_t listCount = 4;
+
+    std::cout << "method,draws,sort_ms,mdraws_per_s,program_changes,vao_changes,texture_changes,state_changes"
+              << std::endl;
+    for (size_t draws = 1000; draws <= std::max((size_t)1000, maxDraws); draws *= 10)
+    {
+        std::vector<CommandList> lists(listCount);
+        uint32_t seed = 7;
+        for (size_t i = 0; i < draws; i++)
+        {
+            const uint32_t layer = nextRandom(seed) % 10 == 0 ? 1 : 0;
+            const bool translucent = nextRandom(seed) % 100 < 15;
+            const uint32_t program = 1 + nextRandom(seed) % 16;
+            const uint32_t vertexArray = 1 + nextRandom(seed) % 32;
+            const uint32_t texture = 1 + nextRandom(seed) % 256;
+            const float depth = (float)(nextRandom(seed) & 0xFFFF) / 65535.0f;
+
+            const uint64_t key = makeSortKey(layer, translucent, program, vertexArray << 8 | texture, depth);
+            lists[i * listCount / draws].draw(key, (uint32_t)i, program, vertexArray, 6, GL_UNSIGNED_INT, 0, NULL, 0,
+                                              1, GL_TRIANGLES, texture);
+        }
+
+        /* merge() fills in the recorded-order counts as well as the sorted ones */
+        CommandQueue queue;
+        queue.merge(lists.data(), lists.size());
+        std::cout << "recorded," << draws << ",0,0,,,," << queue.statistics().recordedChanges << std::endl;
+
+        std::vector<SortEntry> entries;
+        for (size_t l = 0; l < lists.size(); l++)
+            for (size_t i = 0; i < lists[l].packets.size(); i++)
+            {
+                const DrawPacket& packet = lists[l].packets[i];
+                entries.push_back(SortEntry{ packet.key, packet.sequence, (uint32_t)(l << 24 | i) });
+            }
+
+        const int repeats = draws >= 1000000 ? 5 : 20;
+        std::vector<SortEntry> sorted, scratch;
+        double comparisonMs = 0.0, radixMs = 0.0, mergeMs = 0.0;
+        for (int r = 0; r < repeats; r++)
+        {
+            sorted = entries;
+            double start = benchMs();
+            std::sort(sorted.begin(), sorted.end(), [](const SortEntry& a, const SortEntry& b)
+                { return a.key != b.key ? a.key < b.key : a.sequence < b.sequence; });
+            comparisonMs += benchMs() - start;
+            const std::vector<SortEntry> reference = sorted;
+
+            sorted = entries;
+            start = benchMs();
+            radixSort(sorted, scratch);
+            radixMs += benchMs() - start;
+            for (size_t i = 0; i < draws; i++)
+                if (sorted[i].payload != reference[i].payload)
+                {
+                    std::cout << "ERROR::DRAW_SORT_BENCH::ORDER_MISMATCH at " << i << std::endl;
+                    return -1;
+                }
+
+            start = benchMs();
+            queue.merge(lists.data(), lists.size());
+            mergeMs += benchMs() - start;
+        }
+
+        const CommandQueue::Statistics& stats = queue.statistics();
+        printRow("std_sort", draws, comparisonMs / repeats, stats);
+        printRow("radix", draws, radixMs / repeats, stats);
+        printRow("merge", draws, mergeMs / repeats, stats);
+    }
+    return 0;
+}
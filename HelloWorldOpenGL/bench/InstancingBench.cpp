@@ -0,0 +1,84 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "BenchContext.h"
+#include "../BatchRenderer.h"
+#include "../ProgramCache.h"
+
+#include <cstdlib>
+#include <iostream>
+
+/*******************************************************************************************************************************
+Instanced rectangles: how many per second?
+*******************************************************************************************************************************/
+/* Draws the rectangle from HelloWindow.cpp N times per frame with BatchRenderer, for N = 1k ... 1M.
+   Each frame ends with glFinish so the time includes the GPU (or llvmpipe) actually drawing the quads.
+   Usage: InstancingBench [frames per step] */
+int main(int argc, char** argv)
+{
+    const int frames = argc > 1 ? std::atoi(argv[1]) : 20;
+
+    GLFWwindow* window = createBenchContext();
+    if (!window)
+        return -1;
+
+    float vertices[] = {
+     0.5f,  0.5f, 0.0f,
+     0.5f, -0.5f, 0.0f,
+    -0.5f, -0.5f, 0.0f,
+    -0.5f,  0.5f, 0.0f
+    };
+    unsigned int indices[] = { 0, 1, 3, 1, 2, 3 };
+
+    unsigned int VAO, VBO, EBO;
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+
+    ProgramCache cache("");
+    unsigned int program = cache.load(instancedVertexShaderSource, instancedFragmentShaderSource);
+
+    BatchRenderer batch(VAO, 6, GL_UNSIGNED_INT);
+
+    std::cout << "instances,frames,ms_per_frame,instances_per_second" << std::endl;
+    for (size_t count = 1000; count <= 1000000; count *= 10)
+    {
+        fillQuadGrid(batch, count);
+
+        /* Warm-up so buffer allocation and shader specialisation don't land in the measurement */
+        for (int i = 0; i < 2; i++)
+        {
+            glClear(GL_COLOR_BUFFER_BIT);
+            batch.draw(program);
+            glFinish();
+        }
+
+        const double start = benchSeconds();
+        for (int i = 0; i < frames; i++)
+        {
+            glClear(GL_COLOR_BUFFER_BIT);
+            batch.draw(program);
+            glfwSwapBuffers(window);
+            glFinish();
+        }
+        const double seconds = benchSeconds() - start;
+
+        std::cout << count << ',' << frames << ',' << seconds * 1000.0 / frames << ','
+                  << (double)count * frames / seconds << std::endl;
+    }
+
+    glDeleteProgram(program);
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "BenchContext.h"
+#include "../GLState.h"
+#include "../Mat4.h"
+#include "../MeshSimplifier.h"
+#include "../ProgramCache.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+/*******************************************************************************************************************************
+Levels of detail: simplification time, and triangles and frame time on a dense scene
+*******************************************************************************************************************************/
+/* First simplifies a 65k-triangle sphere into L levels with buildLodChain on 1..N threads and prints the time and
+   each level's triangles and error as comments. Then draws a field of S x S of those spheres in rows going away
+   from a camera that dollies back and forth (with a little shake, like a hand-held camera or physics jitter):
+       full           every sphere at level 0
+       lod            selectLod with the default 25% hysteresis
+       no_hysteresis  selectLod with none, to show how often objects near a switching distance flip
+   and reports triangles drawn, frame time (glFinish included) and level switches per frame.
+   Usage: LodBench [side] [frames] [levels] */
+int main(int argc, char** argv)
+{
+    const size_t side = argc > 1 ? (size_t)std::atoll(argv[1]) : 16;
+    const int frames = argc > 2 ? std::atoi(argv[2]) : 200;
+    const unsigned int levels = argc > 3 ? (unsigned int)std::atoi(argv[3]) : 5;
+    const int width = 1280, height = 720;
+
+    GLFWwindow* window = createBenchContext(width, height);
+    if (!window)
+        return -1;
+
+    const MeshData sphere = makeSphereMesh(256, 128);
+    std::vector<LodLevel> chain;
+    for (unsigned int threads = 1; threads <= std::max(1u, ThreadPool::defaultThreads() + 1); threads *= 2)
+    {
+        ThreadPool pool(threads - 1);
+        const double start = benchSeconds();
+        chain = buildLodChain(sphere, levels, &pool);
+        std::cout << "# simplification on " << threads << " threads: " << (benchSeconds() - start) * 1000.0 << " ms"
+                  << std::endl;
+    }
+    for (size_t level = 0; level < chain.size(); level++)
+        std::cout << "# level " << level << ": " << chain[level].mesh.triangleCount() << " triangles, error "
+                  << chain[level].error << std::endl;
+
+    GpuLodMesh lodMesh;
+    lodMesh.create(chain);
+    ProgramCache cache("");
+    const unsigned int program = cache.load(lodVertexShaderSource, meshFragmentShaderSource);
+    const GLint transformLocation = glGetUniformLocation(program, "uTransform");
+    glState.useProgram(program);
+    glState.setDepthTest(true);
+
+    const float fovY = 0.9f;
+    const Mat4 projection = Mat4::perspective(fovY, (float)width / (float)height, 0.1f, 500.0f);
+    std::cout << "method,objects,triangles_per_frame,frame_ms,switches_per_frame" << std::endl;
+    const char* const methods[] = { "full", "lod", "no_hysteresis" };
+    for (int method = 0; method < 3; method++)
+    {
+        std::vector<int> current(side * side, -1);
+        size_t triangles = 0, switches = 0;
+        double seconds = 0.0;
+        for (int frame = -2; frame < frames; frame++) // Two warm-up frames
+        {
+            const float phase = (float)std::max(frame, 0) / (float)frames * 6.2831853f * 2.0f;
+            const float cameraZ = 4.0f + 0.5f * (float)side * 3.0f * (0.5f - 0.5f * std::cos(phase)) +
+                                  0.2f * std::sin((float)frame * 1.7f);
+            const Mat4 viewProjection = projection * Mat4::translation(0.0f, -1.0f, -cameraZ);
+
+            glState.resetCounters();
+            const double start = benchSeconds();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            size_t frameTriangles = 0, frameSwitches = 0;
+            for (size_t i = 0; i < current.size(); i++)
+            {
+                const float x = ((float)(i % side) - 0.5f * (float)(side - 1)) * 1.5f;
+                const float z = -2.0f - 3.0f * (float)(i / side);
+                int level = 0;
+                if (method > 0)
+                {
+                    const float distance = std::sqrt(x * x + 1.0f + (z - cameraZ) * (z - cameraZ));
+                    level = selectLod(lodMesh.errors.data(), lodMesh.levelCount(), current[i],
+                                      pixelsPerUnit(distance, fovY, (float)height), 1.0f, method == 1 ? 0.25f : 0.0f);
+                }
+                frameSwitches += current[i] >= 0 && level != current[i];
+                current[i] = level;
+
+                const Mat4 transform = viewProjection * Mat4::translation(x, 0.0f, z);
+                glUniformMatrix4fv(transformLocation, 1, GL_FALSE, transform.m);
+                lodMesh.draw(level);
+                frameTriangles += lodMesh.triangles(level);
+            }
+            glfwSwapBuffers(window);
+            glFinish();
+
+            if (frame >= 0)
+            {
+                seconds += benchSeconds() - start;
+                triangles += frameTriangles;
+                switches += frameSwitches;
+            }
+        }
+
+        std::cout << methods[method] << ',' << current.size() << ',' << triangles / frames << ','
+                  << seconds * 1000.0 / frames << ',' << (double)switches / frames << std::endl;
+    }
+
+    lodMesh.destroy();
+    glDeleteProgram(program);
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "BenchContext.h"
+#include "../Mesh.h"
+#include "../MeshFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+/*******************************************************************************************************************************
+Mesh file loading: mmap + upload vs read into the heap + upload
+*******************************************************************************************************************************/
+/* Writes a grid mesh of roughly MB megabytes as a .hmesh file and then loads it three ways:
+       read      std::ifstream into a heap buffer, no GL at all. The I/O floor.
+       heap      read into a heap buffer, then glBufferData from it (one extra copy)
+       mmap      loadMeshFile: map the file and hand the mapping to GL
+   All timings include glFinish, so the data is really in the driver's hands. The file was just written, so it is
+   most likely in the page cache; drop caches first to measure cold loads.
+   Usage: MeshLoadBench [MB] [path] */
+static double readOnly(const char* path, std::vector<char>& bytes)
+{
+    const double start = benchSeconds();
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    bytes.resize((size_t)in.tellg());
+    in.seekg(0);
+    in.read(bytes.data(), (std::streamsize)bytes.size());
+    return benchSeconds() - start;
+}
+
+int main(int argc, char** argv)
+{
+    const size_t megabytes = argc > 1 ? (size_t)std::atoi(argv[1]) : 256;
+    const char* path = argc > 2 ? argv[2] : "MeshLoadBench.hmesh";
+
+    GLFWwindow* window = createBenchContext();
+    if (!window)
+        return -1;
+
+    /* 32 bytes per vertex + ~24 bytes of indices per vertex */
+    const uint32_t side = std::max(16u, (uint32_t)std::sqrt((double)megabytes * 1024.0 * 1024.0 / 56.0));
+    {
+        MeshData grid = makeGridMesh(side - 1, side - 1);
+        VertexLayout layout;
+        std::vector<float> vertices = grid.interleave(layout);
+        if (!writeMeshFile(path, layout, vertices.data(), (uint32_t)grid.vertexCount(), grid.indices.data(),
+                           (uint32_t)grid.indices.size(), GL_UNSIGNED_INT))
+            return -1;
+    }
+
+    std::vector<char> bytes;
+    const double readSeconds = readOnly(path, bytes);
+    const double fileMB = (double)bytes.size() / (1024.0 * 1024.0);
+
+    /* heap: the same validation-free path a naive loader would take */
+    double heapSeconds;
+    {
+        const double start = benchSeconds();
+        readOnly(path, bytes);
+        const MeshFileHeader* header = (const MeshFileHeader*)bytes.data();
+        GpuMesh mesh;
+        mesh.create(header->layout, bytes.data() + header->vertexOffset, (size_t)header->vertexBytes,
+                    bytes.data() + header->indexOffset, header->indexCount, header->indexType);
+        glFinish();
+        heapSeconds = benchSeconds() - start;
+        mesh.destroy();
+    }
+    bytes.clear();
+    bytes.shrink_to_fit();
+
+    double mmapSeconds;
+    {
+        const double start = benchSeconds();
+        GpuMesh mesh;
+        if (!loadMeshFile(path, mesh))
+            return -1;
+        glFinish();
+        mmapSeconds = benchSeconds() - start;
+        mesh.destroy();
+    }
+
+    std::cout << "method,mb,ms,mb_per_second" << std::endl;
+    std::cout << "read," << fileMB << ',' << readSeconds * 1000.0 << ',' << fileMB / readSeconds << std::endl;
+    std::cout << "heap," << fileMB << ',' << heapSeconds * 1000.0 << ',' << fileMB / heapSeconds << std::endl;
+    std::cout << "mmap," << fileMB << ',' << mmapSeconds * 1000.0 << ',' << fileMB / mmapSeconds << std::endl;
+
+    std::remove(path);
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "BenchContext.h"
+#include "../Mesh.h"
+#include "../MeshOptimizer.h"
+#include "../ProgramCache.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+/*******************************************************************************************************************************
+Triangle order before and after optimizeMesh
+*******************************************************************************************************************************/
+/* A dense sphere with its triangles shuffled (what a careless exporter produces) is drawn as-is and after
+   optimizeMesh(). Prints ACMR/ATVR from the FIFO cache simulation plus the measured frame time, which on llvmpipe is
+   dominated by vertex shading and so follows ACMR closely.
+   Usage: MeshOptimizerBench [segments] [frames] */
+static double drawFrames(GLFWwindow* window, const MeshData& data, const MeshProgram& program, int frames)
+{
+    VertexLayout layout;
+    std::vector<float> vertices = data.interleave(layout);
+    GpuMesh mesh;
+    mesh.create(layout, vertices.data(), vertices.size() * sizeof(float), data.indices.data(), data.indices.size(),
+                GL_UNSIGNED_INT);
+
+    mesh.draw(program);
+    glFinish();
+
+    const double start = benchSeconds();
+    for (int i = 0; i < frames; i++)
+    {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        mesh.draw(program);
+        glfwSwapBuffers(window);
+    }
+    glFinish();
+    const double ms = (benchSeconds() - start) * 1000.0 / frames;
+
+    mesh.destroy();
+    return ms;
+}
+
+int main(int argc, char** argv)
+{
+    const uint32_t segments = argc > 1 ? (uint32_t)std::atoi(argv[1]) : 1024;
+    const int frames = argc > 2 ? std::atoi(argv[2]) : 30;
+
+    GLFWwindow* window = createBenchContext();
+    if (!window)
+        return -1;
+    glEnable(GL_DEPTH_TEST);
+
+    ProgramCache cache("");
+    MeshProgram program(cache.load(meshVertexShaderSource, meshFragmentShaderSource));
+
+    MeshData sphere = makeSphereMesh(segments, segments / 2);
+    shuffleTriangles(sphere.indices);
+
+    std::cout << "order,acmr,atvr,ms_per_frame" << std::endl;
+    CacheStats before = analyzeVertexCache(sphere.indices, sphere.vertexCount());
+    std::cout << "shuffled," << before.acmr << ',' << before.atvr << ',' << drawFrames(window, sphere, program, frames)
+              << std::endl;
+
+    const double start = benchSeconds();
+    MeshOptimizationReport report = optimizeMesh(sphere);
+    const double optimizeMs = (benchSeconds() - start) * 1000.0;
+
+    std::cout << "optimized," << report.after.acmr << ',' << report.after.atvr << ','
+              << drawFrames(window, sphere, program, frames) << std::endl;
+    std::cout << "# " << sphere.triangleCount() << " triangles optimized in " << optimizeMs << " ms" << std::endl;
+    std::cout << "# ";
+    report.print(std::cout);
+
+    glDeleteProgram(program.id);
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include "BenchTimer.h"
+#include "../Culling.h"
+#include "../OcclusionCulling.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+/*******************************************************************************************************************************
+Software occlusion culling: raster and test time, and how much it removes after frustum culling
+*******************************************************************************************************************************/
+/* A city: a grid of B x B buildings (the occluders, one box each) with objects scattered in the streets between them,
+   seen by a camera walking down the middle street at eye height. Per thread count (1, 2, 4, ... up to one per core):
+       raster_ms        OcclusionCuller::render, occluders into the depth buffer and the hierarchy
+       test_ms          OcclusionCuller::cull over what SceneBvh::cull kept
+       objects_per_ms   those candidates divided by test_ms
+   and how many objects the frustum leaves and how many of those occlusion removes. This one doesn't need a GL
+   context.
+   Usage: OcclusionBench [buildings per side] [objects] [views] */
+static float random01(uint32_t& seed)
+{
+    seed = seed * 1664525u + 1013904223u;
+    return (float)(seed >> 8) / (float)(1 << 24);
+}
+
+int main(int argc, char** argv)
+{
+    const int side = argc > 1 ? std::atoi(argv[1]) : 20;
+    const size_t objectCount = argc > 2 ? (size_t)std::atoll(argv[2]) : 200000;
+    const int views = argc > 3 ? std::atoi(argv[3]) : 50;
+
+    /* Blocks of 20 x 20 with 10-wide streets; buildings between 8 and 40 high */
+    const float block = 20.0f, street = 10.0f, pitch = block + street;
+    const float half = 0.5f * pitch * (float)side;
+    uint32_t seed = 1;
+    std::vector<Aabb> buildings;
+    for (int z = 0; z < side; z++)
+        for (int x = 0; x < side; x++)
+        {
+            const float x0 = (float)x * pitch - half + street * 0.5f, z0 = (float)z * pitch - half + street * 0.5f;
+            buildings.push_back(Aabb{ { x0, 0.0f, z0 }, { x0 + block, 8.0f + random01(seed) * 32.0f, z0 + block } });
+        }
+
+    /* Objects anywhere on the ground, pushed out of the buildings into the nearest street */
+    std::vector<Aabb> objects(objectCount);
+    for (Aabb& box : objects)
+    {
+        float p[2] = { random01(seed) * 2.0f * half - half, random01(seed) * 2.0f * half - half };
+        for (float& v : p)
+        {
+            const float local = v + half - std::floor((v + half) / pitch) * pitch;
+            if (local > street * 0.5f && local < street * 0.5f + block)
+                v += street * 0.5f + block - local + 1.0f;
+        }
+        const float size = 0.3f + random01(seed);
+        box = Aabb{ { p[0], 0.0f, p[1] }, { p[0] + size, size * 2.0f, p[1] + size } };
+    }
+
+    SceneBvh bvh;
+    bvh.build(objects);
+    const Mat4 projection = Mat4::perspective(1.0f, 16.0f / 9.0f, 0.5f, 2000.0f);
+
+    std::cout << "threads,simd,occluder_triangles,raster_ms,test_ms,objects_per_ms,frustum_visible,occlusion_visible"
+              << std::endl;
+    for (unsigned int threads = 1; threads <= std::max(1u, ThreadPool::defaultThreads() + 1); threads *= 2)
+    {
+        ThreadPool pool(threads - 1);
+        OcclusionCuller culler;
+        for (const Aabb& building : buildings)
+            culler.addOccluder(building);
+
+        std::vector<uint32_t> candidates, kept;
+        double rasterMs = 0.0, testMs = 0.0;
+        size_t frustumVisible = 0, occlusionVisible = 0;
+        for (int view = 0; view < views; view++)
+        {
+            /* Down the street at x = 0, eyes 1.7 up, looking along -z */
+            const float z = half - 2.0f * half * (float)view / (float)views;
+            const Mat4 viewProjection = projection * Mat4::translation(0.0f, -1.7f, -z);
+            bvh.cull(Frustum::fromMatrix(viewProjection), candidates);
+
+            double start = benchMs();
+            culler.render(viewProjection, &pool);
+            rasterMs += benchMs() - start;
+
+            start = benchMs();
+            culler.cull(objects, candidates, kept, &pool);
+            testMs += benchMs() - start;
+
+            frustumVisible += candidates.size();
+            occlusionVisible += kept.size();
+        }
+
+        std::cout << threads << ',' << simdName() << ',' << culler.stats().triangles << ',' << rasterMs / views << ','
+                  << testMs / views << ',' << (double)frustumVisible / testMs << ',' << frustumVisible / views << ','
+                  << occlusionVisible / views << std::endl;
+    }
+    return 0;
+}
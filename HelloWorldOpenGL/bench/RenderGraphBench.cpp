@@ -0,0 +1,97 @@
+#include "BenchTimer.h"
+#include "../RenderGraph.h"
+
+#include <cstdlib>
+#include <iostream>
+
+/*******************************************************************************************************************************
+Render graph: culling, target aliasing and framebuffer changes as the pipeline grows
+*******************************************************************************************************************************/
+/* Declares a made-up but typical frame and compiles it (no GL context needed; compiling never touches GL):
+
+       gbuffer      albedo + normal + depth at full size
+       shadows      S shadow maps, read by lighting
+       lighting     -> hdr
+       effects      N post effects, each reading the previous result and writing a new target, at full or half size
+       debug views  one per 4 effects, which nothing reads (culled)
+       overlays     one UI layer per effect, all drawn into the same target and declared in between the effects, the
+                    way separate systems tend to add their passes
+       present      effects + UI -> backbuffer
+
+   For N = 1, 4, 16, ... it prints how many passes survive, how much transient memory the targets would take with
+   one object each against what they take packed, framebuffer changes in declaration order against the compiled
+   order, and how long compile() takes.
+   Usage: RenderGraphBench [max effects] [width] [height] */
+static void declareFrame(RenderGraph& graph, int effects, int width, int height)
+{
+    typedef RenderGraph::Resource Resource;
+    const RenderGraph::Execute nothing = [](RenderGraph::PassContext&) {};
+    graph.reset();
+
+    const Resource albedo = graph.createTexture("albedo", width, height, GL_RGBA8);
+    const Resource normal = graph.createTexture("normal", width, height, GL_RGB10_A2);
+    const Resource depth = graph.createRenderbuffer("depth", width, height, GL_DEPTH24_STENCIL8);
+    graph.addPass("gbuffer").write(albedo).write(normal).write(depth).run(nothing);
+
+    std::vector<Resource> shadowMaps;
+    for (int s = 0; s < 4; s++)
+    {
+        shadowMaps.push_back(graph.createTexture("shadow map", 1024, 1024, GL_DEPTH_COMPONENT32F));
+        graph.addPass("shadows").write(shadowMaps.back()).run(nothing);
+    }
+
+    Resource color = graph.createTexture("hdr", width, height, GL_RGBA16F);
+    RenderGraph::Pass& lighting = graph.addPass("lighting").read(albedo).read(normal).write(color).write(depth);
+    for (Resource shadowMap : shadowMaps)
+        lighting.read(shadowMap);
+    lighting.run(nothing);
+
+    const Resource ui = graph.createTexture("ui", width, height, GL_RGBA8);
+    for (int e = 0; e < effects; e++)
+    {
+        const int scale = (e / 2) % 2 + 1; // two effects at full size, two at half size, ...
+        const Resource next = graph.createTexture("effect", width / scale, height / scale, GL_RGBA16F);
+        graph.addPass("effect").read(color).write(next).run(nothing);
+        color = next;
+
+        graph.addPass("overlay").write(ui).run(nothing);
+
+        if (e % 4 == 3)
+        {
+            const Resource debug = graph.createTexture("debug view", width, height, GL_RGBA8);
+            graph.addPass("debug view").read(color).read(normal).write(debug).run(nothing);
+        }
+    }
+    graph.addPass("present").read(color).read(ui).write(graph.backbuffer(width, height)).run(nothing);
+}
+
+int main(int argc, char** argv)
+{
+    const int maxEffects = argc > 1 ? std::atoi(argv[1]) : 256;
+    const int width = argc > 2 ? std::atoi(argv[2]) : 1920;
+    const int height = argc > 3 ? std::atoi(argv[3]) : 1080;
+
+    std::cout << "effects,passes,culled,targets,objects,unshared_mb,shared_mb,declared_binds,sorted_binds,compile_us"
+              << std::endl;
+    RenderGraph graph;
+    for (int effects = 1; effects <= std::max(1, maxEffects); effects *= 4)
+    {
+        /* Declaring is part of what the loop pays every frame, so it's timed too */
+        const int repeats = 20;
+        const double start = benchMs();
+        for (int r = 0; r < repeats; r++)
+        {
+            declareFrame(graph, effects, width, height);
+            if (!graph.compile())
+                return -1;
+        }
+        const double compileUs = (benchMs() - start) * 1000.0 / repeats;
+
+        const RenderGraph::Statistics& stats = graph.statistics();
+        std::cout << effects << ',' << stats.passes << ',' << stats.culledPasses << ',' << stats.targets << ','
+                  << stats.sharedTargets << ',' << (double)stats.targetBytes / (1024.0 * 1024.0) << ','
+                  << (double)stats.sharedBytes / (1024.0 * 1024.0) << ',' << stats.declaredBinds << ','
+                  << stats.sortedBinds << ',' << compileUs << std::endl;
+    }
+    return 0;
+}
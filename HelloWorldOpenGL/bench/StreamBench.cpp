@@ -0,0 +1,77 @@
+#include "BenchTimer.h"
+#include "../FrameStream.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*******************************************************************************************************************************
+Frame streaming: RGBA to YUV 4:2:0, scalar vs SIMD, and writing a Y4M stream
+*******************************************************************************************************************************/
+/* Converts F frames of noise (so nothing is cheaper than in a real picture) three ways:
+       scalar   rgbaToYuv420Pixel for every 2x2 block, the fallback path
+       simd     rgbaToYuv420 (SSE2 where available; the same as scalar elsewhere)
+       y4m      FrameStream::writeFrame into OUT, conversion and write together
+   and reports time per frame and megapixels per second. simd and scalar must give the same bytes. OUT is /dev/null by
+   default; point it at a pipe into an encoder to see whether it keeps up. This one doesn't need a GL context.
+   Usage: StreamBench [width] [height] [frames] [out] */
+int main(int argc, char** argv)
+{
+    const int width = argc > 1 ? std::atoi(argv[1]) : 1920;
+    const int height = argc > 2 ? std::atoi(argv[2]) : 1080;
+    const int frames = argc > 3 ? std::atoi(argv[3]) : 100;
+    const std::string out = argc > 4 ? argv[4] : "/dev/null";
+
+    std::vector<uint8_t> rgba((size_t)width * height * 4);
+    uint32_t seed = 1;
+    for (uint8_t& byte : rgba)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        byte = (uint8_t)(seed >> 24);
+    }
+    const size_t lumaBytes = (size_t)width * height;
+    const size_t chromaBytes = (size_t)((width + 1) / 2) * ((height + 1) / 2);
+    std::vector<uint8_t> scalar(lumaBytes + chromaBytes * 2), simd(scalar.size());
+
+    std::cout << "method,simd,width,height,frame_ms,mpixels_per_s" << std::endl;
+    const double pixels = (double)width * height * frames;
+    for (int method = 0; method < 3; method++)
+    {
+        std::unique_ptr<FrameStream> stream;
+        if (method == 2)
+        {
+            stream.reset(new FrameStream(out, FrameStream::Y4m, 60));
+            if (!stream->isOpen())
+                return -1;
+        }
+        const double start = benchMs();
+        for (int frame = 0; frame < frames; frame++)
+        {
+            if (method == 0)
+            {
+                for (int y = 0; y < height; y += 2)
+                    for (int x = 0; x < width; x += 2)
+                        rgbaToYuv420Pixel(rgba.data(), width, height, (size_t)width * 4, x, y, scalar.data(),
+                                          scalar.data() + lumaBytes, scalar.data() + lumaBytes + chromaBytes);
+            }
+            else if (method == 1)
+                rgbaToYuv420(rgba.data(), width, height, (size_t)width * 4, simd.data(), simd.data() + lumaBytes,
+                             simd.data() + lumaBytes + chromaBytes);
+            else if (!stream->writeFrame(rgba.data(), width, height))
+                return -1;
+        }
+        const double ms = benchMs() - start;
+
+        if (method == 1 && simd != scalar)
+        {
+            std::cout << "ERROR::STREAM_BENCH::MISMATCH simd and scalar conversions differ" << std::endl;
+            return -1;
+        }
+        const char* const names[] = { "scalar", "simd", "y4m" };
+        std::cout << names[method] << ',' << simdName() << ',' << width << ',' << height << ',' << ms / frames << ','
+                  << pixels / (ms * 1000.0) << std::endl;
+    }
+    return 0;
+}
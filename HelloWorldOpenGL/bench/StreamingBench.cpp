@@ -0,0 +1,132 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "BenchContext.h"
+#include "../ProgramCache.h"
+#include "../StreamBuffer.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+/*******************************************************************************************************************************
+Dynamic vertex upload: glBufferData vs glBufferSubData vs StreamBuffer
+*******************************************************************************************************************************/
+/* Every frame rewrites MB megabytes of vertex data and draws it as points with GL_RASTERIZER_DISCARD, so the GPU has to
+   read the whole buffer but doesn't spend time filling pixels. Reports upload throughput for:
+       BufferData     glBufferData(NULL) orphan + glBufferSubData, the usual GL_DYNAMIC_DRAW/GL_STREAM_DRAW advice
+       BufferSubData  glBufferSubData into the same storage; the driver has to copy or wait for the GPU
+       StreamBuffer   three fenced regions written in place (persistent-mapped if GL 4.4 is available)
+   Usage: StreamingBench [MB per frame] [frames] */
+static const char* pointVertexShaderSource =
+"#version 330 core\n"
+"layout (location = 0) in vec4 aPos;\n"
+"void main()\n"
+"{\n"
+"   gl_Position = aPos;\n"
+"}\0";
+
+static const char* pointFragmentShaderSource =
+"#version 330 core\n"
+"out vec4 FragColor;\n"
+"void main()\n"
+"{\n"
+"   FragColor = vec4(1.0);\n"
+"}\n\0";
+
+/* Stand-in for per-frame CPU work that produces the vertices */
+static void fillVertices(float* out, size_t floats, int frame)
+{
+    for (size_t i = 0; i < floats; i++)
+        out[i] = (float)((i + frame) & 1023) * (1.0f / 1024.0f);
+}
+
+static void report(const char* method, size_t bytes, int frames, double seconds)
+{
+    std::cout << method << ',' << bytes / (1024 * 1024) << ',' << frames << ',' << seconds * 1000.0 / frames << ','
+              << (double)bytes * frames / (1024.0 * 1024.0) / seconds << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    const size_t megabytes = argc > 1 ? (size_t)std::atoi(argv[1]) : 16;
+    const int frames = argc > 2 ? std::atoi(argv[2]) : 100;
+    const size_t bytes = megabytes * 1024 * 1024;
+    const size_t floats = bytes / sizeof(float);
+    const GLsizei points = (GLsizei)(floats / 4);
+
+    GLFWwindow* window = createBenchContext();
+    if (!window)
+        return -1;
+
+    ProgramCache cache("");
+    unsigned int program = cache.load(pointVertexShaderSource, pointFragmentShaderSource);
+    glUseProgram(program);
+    glEnable(GL_RASTERIZER_DISCARD);
+
+    unsigned int VAO;
+    glGenVertexArrays(1, &VAO);
+    glBindVertexArray(VAO);
+    glEnableVertexAttribArray(0);
+
+    std::vector<float> staging(floats);
+    std::cout << "method,mb_per_frame,frames,ms_per_frame,mb_per_second" << std::endl;
+
+    /* glBufferData with orphaning and glBufferSubData without */
+    for (int orphan = 1; orphan >= 0; orphan--)
+    {
+        unsigned int VBO;
+        glGenBuffers(1, &VBO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+        glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, (void*)0);
+        glFinish();
+
+        const double start = benchSeconds();
+        for (int frame = 0; frame < frames; frame++)
+        {
+            fillVertices(staging.data(), floats, frame);
+            if (orphan)
+                glBufferData(GL_ARRAY_BUFFER, bytes, NULL, GL_STREAM_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, staging.data());
+            glDrawArrays(GL_POINTS, 0, points);
+            glfwSwapBuffers(window);
+        }
+        glFinish();
+        report(orphan ? "BufferData" : "BufferSubData", bytes, frames, benchSeconds() - start);
+
+        glDeleteBuffers(1, &VBO);
+    }
+
+    /* StreamBuffer: generate straight into mapped memory, no staging copy */
+    {
+        StreamBuffer stream(GL_ARRAY_BUFFER, bytes);
+        glFinish();
+
+        const double start = benchSeconds();
+        for (int frame = 0; frame < frames; frame++)
+        {
+            stream.beginFrame();
+            StreamBuffer::Allocation upload = stream.allocate(bytes);
+            fillVertices((float*)upload.data, floats, frame);
+            stream.commit();
+
+            glState.bindBuffer(GL_ARRAY_BUFFER, stream.buffer());
+            glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 0, (void*)upload.offset);
+            glDrawArrays(GL_POINTS, 0, points);
+            stream.endFrame();
+            glfwSwapBuffers(window);
+        }
+        glFinish();
+        report(stream.isPersistent() ? "StreamBuffer(persistent)" : "StreamBuffer(unsynchronized)", bytes, frames,
+            benchSeconds() - start);
+        std::cout << "# StreamBuffer waited on the GPU in " << stream.statistics().stalls << " of " << frames
+                  << " frames" << std::endl;
+    }
+
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteProgram(program);
+    glfwTerminate();
+    return 0;
+}
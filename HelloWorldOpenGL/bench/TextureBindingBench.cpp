@@ -0,0 +1,200 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "BenchContext.h"
+#include "../GLState.h"
+#include "../ProgramCache.h"
+#include "../TextureBinding.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+/*******************************************************************************************************************************
+Texture binding: glBindTexture per draw vs a TextureTable (texture array, bindless)
+*******************************************************************************************************************************/
+/* Draws N small quads per frame, each with one of T textures picked at random, three ways:
+       bind       glBindTexture + glDrawElements per draw (glState skips the bind when the texture repeats)
+       array      TextureTable forced onto its GL_TEXTURE_2D_ARRAY path
+       bindless   TextureTable with ARB_bindless_texture, when the driver has it
+   and reports CPU time to submit a frame (glFinish included) and the GL calls it took.
+   Usage: TextureBindingBench [draws] [textures] [frames] */
+const char* const bindVertexShaderSource =
+"#version 330 core\n"
+"layout (location = 0) in vec3 aPos;\n"
+"out vec2 uv;\n"
+"void main()\n"
+"{\n"
+"   uv = aPos.xy + 0.5;\n"
+"   gl_Position = vec4(aPos * 0.1, 1.0);\n"
+"}\0";
+
+const char* const bindFragmentShaderSource =
+"#version 330 core\n"
+"in vec2 uv;\n"
+"out vec4 FragColor;\n"
+"uniform sampler2D image;\n"
+"void main()\n"
+"{\n"
+"   FragColor = texture(image, uv);\n"
+"}\n\0";
+
+/* Bodies for TextureTable::vertexSource/fragmentSource, which add the #version line and declarations */
+const char* const tableVertexShaderBody =
+"layout (location = 0) in vec3 aPos;\n"
+"out vec2 uv;\n"
+"void main()\n"
+"{\n"
+"   passMaterial();\n"
+"   uv = aPos.xy + 0.5;\n"
+"   gl_Position = vec4(aPos * 0.1, 1.0);\n"
+"}\n";
+
+const char* const tableFragmentShaderBody =
+"in vec2 uv;\n"
+"out vec4 FragColor;\n"
+"void main()\n"
+"{\n"
+"   FragColor = sampleMaterial(uv);\n"
+"}\n";
+
+int main(int argc, char** argv)
+{
+    const size_t draws = argc > 1 ? (size_t)std::atoll(argv[1]) : 10000;
+    const uint32_t textureCount = argc > 2 ? (uint32_t)std::atoi(argv[2]) : 64;
+    const int frames = argc > 3 ? std::atoi(argv[3]) : 20;
+    const int size = 64;
+
+    GLFWwindow* window = createBenchContext();
+    if (!window)
+        return -1;
+    std::cout << "# multi-draw indirect " << (glext.multiDrawIndirect ? "yes" : "no") << ", bindless "
+              << (glext.bindlessTexture ? "yes" : "no") << std::endl;
+
+    float vertices[] = {
+     0.5f,  0.5f, 0.0f,
+     0.5f, -0.5f, 0.0f,
+    -0.5f, -0.5f, 0.0f,
+    -0.5f,  0.5f, 0.0f
+    };
+    unsigned int indices[] = { 0, 1, 3, 1, 2, 3 };
+
+    unsigned int VAO, VBO, EBO;
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    glState.bindVertexArray(VAO);
+    glState.bindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    /* Flat colours are enough; what's measured is how the texture gets picked, not what's in it */
+    std::vector<std::vector<uint8_t>> images(textureCount, std::vector<uint8_t>((size_t)size * size * 4));
+    for (uint32_t t = 0; t < textureCount; t++)
+        for (size_t p = 0; p < images[t].size(); p += 4)
+        {
+            images[t][p] = (uint8_t)(t * 37);
+            images[t][p + 1] = (uint8_t)(t * 91);
+            images[t][p + 2] = (uint8_t)(t * 13);
+            images[t][p + 3] = 255;
+        }
+
+    std::vector<uint32_t> picks(draws);
+    uint32_t seed = 1;
+    for (uint32_t& pick : picks)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        pick = (seed >> 8) % textureCount;
+    }
+
+    ProgramCache cache("");
+    std::cout << "method,draws,textures,submit_ms,gl_draw_calls,gl_state_calls" << std::endl;
+    for (int method = 0; method < 3; method++)
+    {
+        if (method == 2 && !glext.bindlessTexture)
+            continue;
+
+        std::unique_ptr<TextureTable> table;
+        std::vector<unsigned int> textures;
+        unsigned int program = 0;
+        if (method == 0)
+        {
+            program = cache.load(bindVertexShaderSource, bindFragmentShaderSource);
+            textures.resize(textureCount);
+            glGenTextures((GLsizei)textureCount, textures.data());
+            for (uint32_t t = 0; t < textureCount; t++)
+            {
+                glState.bindTexture(0, GL_TEXTURE_2D, textures[t]);
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, images[t].data());
+                glGenerateMipmap(GL_TEXTURE_2D);
+            }
+        }
+        else
+        {
+            table.reset(new TextureTable(size, size, textureCount, GL_RGBA8, method == 2));
+            for (uint32_t t = 0; t < textureCount; t++)
+                table->add(images[t].data());
+            const std::string vertex = table->vertexSource(tableVertexShaderBody);
+            const std::string fragment = table->fragmentSource(tableFragmentShaderBody);
+            program = cache.load(vertex.c_str(), fragment.c_str());
+            table->prepareProgram(program);
+        }
+
+        double submit = 0.0;
+        size_t drawCalls = 0, stateCalls = 0;
+        for (int frame = -2; frame < frames; frame++) // Two warm-up frames
+        {
+            glState.resetCounters();
+            glClear(GL_COLOR_BUFFER_BIT);
+            const double start = benchSeconds();
+            if (method == 0)
+            {
+                glState.useProgram(program);
+                glState.bindVertexArray(VAO);
+                for (size_t i = 0; i < draws; i++)
+                {
+                    glState.bindTexture(0, GL_TEXTURE_2D, textures[picks[i]]);
+                    glState.drawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+                }
+            }
+            else
+            {
+                for (size_t i = 0; i < draws; i++)
+                    table->draw(program, VAO, picks[i], 6);
+                table->submit(GL_TRIANGLES, GL_UNSIGNED_INT);
+            }
+            glfwSwapBuffers(window);
+            glFinish();
+
+            if (frame >= 0)
+            {
+                submit += benchSeconds() - start;
+                drawCalls = glState.counters().draws;
+                stateCalls = glState.counters().issued;
+            }
+        }
+
+        const char* const names[] = { "bind", "array", "bindless" };
+        std::cout << names[method] << ',' << draws << ',' << textureCount << ',' << submit * 1000.0 / frames << ','
+                  << drawCalls << ',' << stateCalls << std::endl;
+
+        if (!textures.empty())
+        {
+            for (unsigned int texture : textures)
+                glState.forgetTexture(texture);
+            glDeleteTextures((GLsizei)textures.size(), textures.data());
+        }
+        glDeleteProgram(program);
+        glState.forgetProgram(program);
+    }
+
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    glfwTerminate();
+    return 0;
+}
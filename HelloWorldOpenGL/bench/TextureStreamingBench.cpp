@@ -0,0 +1,136 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "BenchContext.h"
+#include "../TextureStreamer.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+/*******************************************************************************************************************************
+Texture loading: on the main thread vs TextureStreamer
+*******************************************************************************************************************************/
+/* Asks for N textures of SIZE x SIZE on the first frame, then renders a fixed number of frames (clear + swap) and
+   reports how long the frames took:
+       sync      "decode" (generate the pattern), glTexImage2D and glGenerateMipmap right away on the main thread
+       streamed  TextureStreamer: decode + mips on the workers, at most BUDGET MB uploaded per frame
+   first_frame is the first frame where every texture could be drawn, complete_frame the first with every mip in
+   (-1 if that didn't happen within the run). The worst frame is the hitch a player would see.
+   Usage: TextureStreamingBench [textures] [size] [budget MB] [frames] */
+
+/* Stand-in for decoding an image file: some arithmetic per pixel */
+static void generatePattern(int size, unsigned int seed, TextureImage& image)
+{
+    image.width = image.height = size;
+    image.levels.assign(1, std::vector<uint8_t>((size_t)size * size * 4));
+    uint8_t* out = image.levels[0].data();
+    for (int y = 0; y < size; y++)
+        for (int x = 0; x < size; x++, out += 4)
+        {
+            const unsigned int h = ((unsigned int)x * 73856093u) ^ ((unsigned int)y * 19349663u) ^ (seed * 83492791u);
+            out[0] = (uint8_t)(((x >> 4) ^ (y >> 4)) & 1 ? 255 : 40);
+            out[1] = (uint8_t)(h >> 24);
+            out[2] = (uint8_t)(seed * 40);
+            out[3] = 255;
+        }
+}
+
+static void report(const char* method, int textures, int size, double budgetMb, const std::vector<double>& frameMs,
+                   int firstFrame, int completeFrame)
+{
+    double total = 0.0, worst = 0.0;
+    for (double ms : frameMs)
+    {
+        total += ms;
+        worst = std::max(worst, ms);
+    }
+    std::cout << method << ',' << textures << ',' << size << ',' << budgetMb << ',' << frameMs.size() << ','
+              << firstFrame << ',' << completeFrame << ',' << total / frameMs.size() << ',' << worst << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    const int textures = argc > 1 ? std::atoi(argv[1]) : 8;
+    const int size = argc > 2 ? std::atoi(argv[2]) : 4096;
+    const double budgetMb = argc > 3 ? std::atof(argv[3]) : 4.0;
+    const int frames = argc > 4 ? std::atoi(argv[4]) : 300;
+
+    GLFWwindow* window = createBenchContext();
+    if (!window)
+        return -1;
+
+    std::cout << "method,textures,size,budget_mb,frames,first_frame,complete_frame,avg_frame_ms,max_frame_ms" << std::endl;
+    std::vector<double> frameMs;
+
+    /* Everything on the main thread, in the first frame */
+    {
+        std::vector<unsigned int> ids(textures);
+        glGenTextures(textures, ids.data());
+        glFinish();
+
+        frameMs.clear();
+        for (int frame = 0; frame < frames; frame++)
+        {
+            const double start = benchSeconds();
+            if (frame == 0)
+                for (int i = 0; i < textures; i++)
+                {
+                    TextureImage image;
+                    generatePattern(size, (unsigned int)i, image);
+                    glBindTexture(GL_TEXTURE_2D, ids[i]);
+                    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                                 image.levels[0].data());
+                    glGenerateMipmap(GL_TEXTURE_2D);
+                }
+            glClear(GL_COLOR_BUFFER_BIT);
+            glfwSwapBuffers(window);
+            frameMs.push_back((benchSeconds() - start) * 1000.0);
+        }
+        glFinish();
+        report("sync", textures, size, 0.0, frameMs, 0, 0);
+        glDeleteTextures(textures, ids.data());
+    }
+
+    /* Streamed */
+    {
+        ThreadPool pool;
+        TextureStreamer streamer(pool, (size_t)(budgetMb * 1024.0 * 1024.0));
+        glFinish();
+
+        std::vector<size_t> handles;
+        int firstFrame = -1, completeFrame = -1;
+        frameMs.clear();
+        for (int frame = 0; frame < frames; frame++)
+        {
+            const double start = benchSeconds();
+            if (frame == 0)
+                for (int i = 0; i < textures; i++)
+                    handles.push_back(streamer.request([size, i](TextureImage& image)
+                    {
+                        generatePattern(size, (unsigned int)i, image);
+                        return true;
+                    }));
+            streamer.update();
+            glClear(GL_COLOR_BUFFER_BIT);
+            glfwSwapBuffers(window);
+            frameMs.push_back((benchSeconds() - start) * 1000.0);
+
+            bool allVisible = true;
+            for (size_t handle : handles)
+                allVisible = allVisible && streamer.texture(handle) != 0;
+            if (allVisible && firstFrame < 0)
+                firstFrame = frame;
+            if (streamer.idle() && completeFrame < 0)
+                completeFrame = frame;
+        }
+        glFinish();
+        report("streamed", textures, size, budgetMb, frameMs, firstFrame, completeFrame);
+        std::cout << "# ";
+        streamer.printSummary(std::cout);
+    }
+
+    glfwTerminate();
+    return 0;
+}
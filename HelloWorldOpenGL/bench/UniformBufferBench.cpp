@@ -0,0 +1,183 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "BenchContext.h"
+#include "../GLState.h"
+#include "../ProgramCache.h"
+#include "../UniformBuffer.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+/*******************************************************************************************************************************
+Per-draw uniforms: glUniform vs one uniform buffer upload per frame
+*******************************************************************************************************************************/
+/* Draws N small rectangles, each with its own transform, three ways:
+       uniform   glUniform4fv per draw
+       ring      every draw's block goes into a UniformRing, uploaded once, then glBindBufferRange per draw
+       shared    same, but all draws use one block, so glState skips every bind after the first (what sorting by
+                 material buys when draws share their data)
+   and reports CPU time to fill the data, to upload it, and to issue the draws (glFinish included), plus the bytes
+   uploaded per frame.
+   Usage: UniformBufferBench [draws] [frames] */
+const char* const uniformVertexShaderSource =
+"#version 330 core\n"
+"layout (location = 0) in vec3 aPos;\n"
+"uniform vec4 uTransform;\n" // xy offset, zw scale
+"void main()\n"
+"{\n"
+"   gl_Position = vec4(aPos.xy * uTransform.zw + uTransform.xy, aPos.z, 1.0);\n"
+"}\0";
+
+const char* const blockVertexShaderSource =
+"#version 330 core\n"
+"layout (location = 0) in vec3 aPos;\n"
+"layout(std140) uniform BenchDraw\n"
+"{\n"
+"    vec4 transform;\n"
+"};\n"
+"void main()\n"
+"{\n"
+"   gl_Position = vec4(aPos.xy * transform.zw + transform.xy, aPos.z, 1.0);\n"
+"}\0";
+
+const char* const benchFragmentShaderSource =
+"#version 330 core\n"
+"out vec4 FragColor;\n"
+"void main()\n"
+"{\n"
+"   FragColor = vec4(1.0f, 0.5f, 0.2f, 1.0f);\n"
+"}\n\0";
+
+#define BENCH_DRAW(MEMBER) \
+    MEMBER(vec4, transform)
+HELLO_UNIFORM_BLOCK(BenchDraw, Std140, BENCH_DRAW);
+
+int main(int argc, char** argv)
+{
+    const size_t draws = argc > 1 ? (size_t)std::atoll(argv[1]) : 100000;
+    const int frames = argc > 2 ? std::atoi(argv[2]) : 20;
+
+    GLFWwindow* window = createBenchContext();
+    if (!window)
+        return -1;
+
+    float vertices[] = {
+     0.5f,  0.5f, 0.0f,
+     0.5f, -0.5f, 0.0f,
+    -0.5f, -0.5f, 0.0f,
+    -0.5f,  0.5f, 0.0f
+    };
+    unsigned int indices[] = { 0, 1, 3, 1, 2, 3 };
+
+    unsigned int VAO, VBO, EBO;
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glState.bindVertexArray(VAO);
+
+    ProgramCache cache("");
+    const unsigned int uniformProgram = cache.load(uniformVertexShaderSource, benchFragmentShaderSource);
+    const unsigned int blockProgram = cache.load(blockVertexShaderSource, benchFragmentShaderSource);
+    const GLint transformLocation = glGetUniformLocation(uniformProgram, "uTransform");
+    if (!bindUniformBlock<BenchDraw>(blockProgram, 0))
+        return -1;
+
+    std::vector<float> positions(draws * 2);
+    uint32_t seed = 1;
+    for (float& p : positions)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        p = (float)(seed >> 8) / (float)(1 << 24) * 2.0f - 1.0f;
+    }
+
+    UniformRing ring(draws * sizeof(BenchDraw));
+    std::cout << "# offset alignment " << ring.offsetAlignment() << std::endl;
+    std::cout << "method,draws,fill_ms,upload_ms,submit_ms,bytes_per_frame,gl_state_calls" << std::endl;
+    const char* const methods[] = { "uniform", "ring", "shared" };
+    for (int method = 0; method < 3; method++)
+    {
+        double fill = 0.0, upload = 0.0, submit = 0.0;
+        size_t bytes = 0, stateCalls = 0;
+        std::vector<float> transforms(draws * 4);
+        std::vector<uint32_t> blocks(draws);
+        glState.useProgram(method == 0 ? uniformProgram : blockProgram);
+
+        for (int frame = -2; frame < frames; frame++) // Two warm-up frames
+        {
+            const float scale = 0.01f + 0.001f * (float)(frame & 7);
+            const double start = benchSeconds();
+            if (method == 0)
+            {
+                for (size_t i = 0; i < draws; i++)
+                {
+                    float* t = &transforms[i * 4];
+                    t[0] = positions[i * 2];
+                    t[1] = positions[i * 2 + 1];
+                    t[2] = t[3] = scale;
+                }
+            }
+            else
+            {
+                ring.beginFrame();
+                UniformRing::Writer& writer = ring.writer(0);
+                for (size_t i = 0; i < (method == 1 ? draws : 1); i++)
+                {
+                    BenchDraw block;
+                    block.transform = { positions[i * 2], positions[i * 2 + 1], scale, scale };
+                    blocks[i] = writer.push(block);
+                }
+            }
+            const double filled = benchSeconds();
+
+            if (method != 0)
+                ring.upload();
+            const double uploaded = benchSeconds();
+
+            glState.resetCounters();
+            glClear(GL_COLOR_BUFFER_BIT);
+            for (size_t i = 0; i < draws; i++)
+            {
+                if (method == 0)
+                    glUniform4fv(transformLocation, 1, &transforms[i * 4]);
+                else
+                    ring.bind(0, 0, blocks[method == 1 ? i : 0], sizeof(BenchDraw));
+                glState.drawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+            }
+            if (method != 0)
+                ring.endFrame();
+            glfwSwapBuffers(window);
+            glFinish();
+            const double submitted = benchSeconds();
+
+            if (frame >= 0)
+            {
+                fill += filled - start;
+                upload += uploaded - filled;
+                submit += submitted - uploaded;
+                bytes = method == 0 ? draws * 4 * sizeof(float) : ring.statistics().frameBytes;
+                stateCalls = method == 0 ? draws : glState.counters().issued;
+            }
+        }
+
+        std::cout << methods[method] << ',' << draws << ',' << fill * 1000.0 / frames << ','
+                  << upload * 1000.0 / frames << ',' << submit * 1000.0 / frames << ',' << bytes << ','
+                  << stateCalls << std::endl;
+    }
+
+    glDeleteProgram(uniformProgram);
+    glDeleteProgram(blockProgram);
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "BenchContext.h"
+#include "../Mesh.h"
+#include "../ProgramCache.h"
+#include "../VertexPacking.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+/*******************************************************************************************************************************
+Float vs packed vertices
+*******************************************************************************************************************************/
+/* Packs a dense sphere with every position encoding, prints the size and quantization error of each, and draws each
+   version for a number of frames to show what the smaller vertices do to frame time.
+   Usage: VertexPackingBench [segments] [frames] */
+static double drawFrames(GLFWwindow* window, const GpuMesh& mesh, const MeshProgram& program, int frames)
+{
+    for (int i = 0; i < 2; i++)
+        mesh.draw(program);
+    glFinish();
+
+    const double start = benchSeconds();
+    for (int i = 0; i < frames; i++)
+    {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        mesh.draw(program);
+        glfwSwapBuffers(window);
+    }
+    glFinish();
+    return (benchSeconds() - start) * 1000.0 / frames;
+}
+
+int main(int argc, char** argv)
+{
+    const uint32_t segments = argc > 1 ? (uint32_t)std::atoi(argv[1]) : 1024;
+    const int frames = argc > 2 ? std::atoi(argv[2]) : 50;
+
+    GLFWwindow* window = createBenchContext();
+    if (!window)
+        return -1;
+    glEnable(GL_DEPTH_TEST);
+
+    ProgramCache cache("");
+    MeshProgram program(cache.load(meshVertexShaderSource, meshFragmentShaderSource));
+
+    MeshData sphere = makeSphereMesh(segments, segments / 2);
+    std::cout << sphere.vertexCount() << " vertices, " << sphere.triangleCount() << " triangles" << std::endl;
+
+    std::cout << "encoding,bytes,ms_per_frame" << std::endl;
+    {
+        VertexLayout layout;
+        std::vector<float> vertices = sphere.interleave(layout);
+        GpuMesh mesh;
+        mesh.create(layout, vertices.data(), vertices.size() * sizeof(float), sphere.indices.data(),
+                    sphere.indices.size(), GL_UNSIGNED_INT);
+        const size_t bytes = vertices.size() * sizeof(float) + sphere.indices.size() * sizeof(uint32_t);
+        std::cout << "float32," << bytes << ',' << drawFrames(window, mesh, program, frames) << std::endl;
+        mesh.destroy();
+    }
+
+    const PositionEncoding encodings[] = { PositionEncoding::Float, PositionEncoding::Half, PositionEncoding::Snorm16 };
+    const char* names[] = { "packed(float positions)", "packed(half positions)", "packed(snorm16 positions)" };
+    for (int i = 0; i < 3; i++)
+    {
+        PackedMesh packed = packMesh(sphere, encodings[i]);
+        GpuMesh mesh;
+        packed.upload(mesh);
+        std::cout << names[i] << ',' << packed.report.bytesAfter << ',' << drawFrames(window, mesh, program, frames)
+                  << std::endl;
+        std::cout << "# ";
+        packed.report.print(std::cout);
+        mesh.destroy();
+    }
+
+    glDeleteProgram(program.id);
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,15 @@
+#version 330 core // Version declaration
+
+// Declare all input vertex attributes in vertex shader with "in" keyword
+// Right now all we care about position, so we only need a single vertex attribute
+layout (location = 0) in vec3 aPos;
+
+// Where the simulation (Simulation.h) has moved the rectangle to. Uniforms start out as 0, so without it nothing moves
+uniform vec2 uOffset;
+
+void main()
+{
+    // To set the output of the vertex shader we have to assign the position data to the predefined gl_Position variable
+    // gl_Position is a vec4 behind the scenes. As such, we have to cast our input(vec3) to vec4
+    gl_Position = vec4(aPos.x + uOffset.x, aPos.y + uOffset.y, aPos.z, 1.0);
+}
@@ -0,0 +1,21 @@
+#version 330 core
+
+// hello.vert for --uniform-buffer: the offset comes from two uniform blocks instead of a plain uniform
+layout (location = 0) in vec3 aPos;
+
+// These have to match FrameUniforms and DrawUniforms in HelloWindow.cpp. The program checks the offsets after
+// linking and prints the declarations it expects if they don't.
+layout(std140) uniform FrameUniforms
+{
+    vec4 camera;
+};
+
+layout(std140) uniform DrawUniforms
+{
+    vec4 position;
+};
+
+void main()
+{
+    gl_Position = vec4(aPos.xy + position.xy - camera.xy, aPos.z, 1.0);
+}
@@ -0,0 +1,13 @@
+#version 330 core
+
+in vec2 TexCoord;
+
+// Texture unit 0. Until the finest mip has streamed in, this samples a blurrier one
+uniform sampler2D uTexture;
+
+out vec4 FragColor;
+
+void main()
+{
+    FragColor = texture(uTexture, TexCoord);
+}
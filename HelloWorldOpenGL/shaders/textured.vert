@@ -0,0 +1,15 @@
+#version 330 core
+
+// Same rectangle as hello.vert, with a texture stretched over it (--texture, see TextureStreamer.h)
+layout (location = 0) in vec3 aPos;
+
+uniform vec2 uOffset;
+
+out vec2 TexCoord;
+
+void main()
+{
+    // The rectangle goes from -0.5 to 0.5, so its texture coordinates can be worked out from the position
+    TexCoord = aPos.xy + vec2(0.5);
+    gl_Position = vec4(aPos.x + uOffset.x, aPos.y + uOffset.y, aPos.z, 1.0);
+}
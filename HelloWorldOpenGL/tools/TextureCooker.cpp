@@ -0,0 +1,90 @@
+#include "../TextureCompression.h"
+#include "../TextureFile.h"
+#include "../TextureImage.h"
+#include "../ThreadPool.h"
+#include "../bench/BenchTimer.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*******************************************************************************************************************************
+Texture cooker
+*******************************************************************************************************************************/
+/* Turns an image into a ready-to-upload .htex file (TextureFile.h), offline so the game never pays for it:
+       1. decode the .ppm
+       2. build the mip chain (2x2 box filter, SSE2/AVX2 in TextureImage.h)
+       3. block-compress every level on all cores (TextureCompression.h)
+       4. write the levels, smallest first
+   Prints how long each step took, encode throughput, and the PSNR of the compressed texture against the mips it was
+   made from, so formats can be compared on real content.
+   Usage: TextureCooker INPUT.ppm OUTPUT.htex [bc1|bc3|bc5|bc7|etc2] [threads] */
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        std::cout << "Usage: " << argv[0] << " INPUT.ppm OUTPUT.htex [bc1|bc3|bc5|bc7|etc2] [threads]" << std::endl;
+        return -1;
+    }
+    const std::string inputPath = argv[1], outputPath = argv[2];
+    const TextureFormatInfo* info = textureFormatByName(argc > 3 ? argv[3] : "bc7");
+    if (!info)
+    {
+        std::cout << "ERROR::TEXTURE_COOKER::UNKNOWN_FORMAT " << argv[3] << std::endl;
+        return -1;
+    }
+    const unsigned int threads =
+        argc > 4 ? (unsigned int)std::max(1, std::atoi(argv[4])) : ThreadPool::defaultThreads() + 1;
+
+    double start = benchMs();
+    TextureImage image;
+    if (!loadPpmFile(inputPath, image))
+        return -1;
+    const double decodeMs = benchMs() - start;
+
+    start = benchMs();
+    buildMipChain(image);
+    const double mipMs = benchMs() - start;
+
+    ThreadPool pool(threads - 1);
+    std::vector<std::vector<uint8_t>> levels(image.levels.size());
+    size_t pixels = 0, rgbaBytes = 0, compressedBytes = 0;
+    start = benchMs();
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        encodeTextureLevel(pool, info->format, image.levels[i].data(), image.levelWidth((int)i),
+                           image.levelHeight((int)i), levels[i]);
+        pixels += image.levels[i].size() / 4;
+        rgbaBytes += image.levels[i].size();
+        compressedBytes += levels[i].size();
+    }
+    const double encodeMs = benchMs() - start;
+
+    /* Decode again and compare with what went in */
+    CompressionError topError, allError;
+    std::vector<uint8_t> decoded;
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        const int width = image.levelWidth((int)i), height = image.levelHeight((int)i);
+        decodeTextureLevel(info->format, levels[i].data(), width, height, decoded);
+        allError.add(image.levels[i].data(), decoded.data(), (size_t)width * height, info->channels);
+        if (i == 0)
+            topError = allError;
+    }
+
+    if (!writeTextureFile(outputPath, info->format, image.width, image.height, levels))
+        return -1;
+
+    std::cout << inputPath << ": " << image.width << "x" << image.height << ", " << levels.size() << " levels"
+              << std::endl;
+    std::cout << "  decode " << decodeMs << " ms, mips " << mipMs << " ms (" << simdName() << ")" << std::endl;
+    std::cout << "  encode " << info->name << " " << encodeMs << " ms on " << threads << " threads, "
+              << (double)pixels / (encodeMs * 1000.0) << " Mpixel/s" << std::endl;
+    std::cout << "  PSNR " << topError.psnr() << " dB (level 0), " << allError.psnr() << " dB (all levels)"
+              << std::endl;
+    std::cout << "  wrote " << outputPath << ": " << compressedBytes / 1024 << " KB of blocks ("
+              << rgbaBytes / 1024 << " KB as RGBA8)" << std::endl;
+    return 0;
+}